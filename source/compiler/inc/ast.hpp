@@ -219,6 +219,7 @@ private:
 class ASTFunctionNode : public ASTScopeNode {
 private:
 	std::string m_name;
+	std::vector<std::string> m_parameters;
 public:
 	ASTFunctionNode(std::string name)
 		: ASTScopeNode(ASTNodeType::FUNCTION)
@@ -226,27 +227,47 @@ public:
 		{}
 	~ASTFunctionNode() final = default;
 
+	void addParameter(std::string name) { m_parameters.push_back(std::move(name)); }
+
 	[[nodiscard]] const std::string&
 	readName() const {
 		return m_name;
 	}
+
+	[[nodiscard]] const std::vector<std::string>&
+	readParameters() const {
+		return m_parameters;
+	}
 };
 
 class ASTCallNode : public ASTExpressionNode {
 	private:
 		std::string m_functionName;
+		std::vector<ASTBaseNode*> m_arguments;
 	public:
 		ASTCallNode(const std::string& functionName)
 			: ASTExpressionNode(ASTNodeType::CALL_EXPRESSION)
 			, m_functionName(functionName)
 			{}
-		~ASTCallNode() override = default;
+		~ASTCallNode() override
+		{
+			for (auto& argument : m_arguments)
+			{
+				delete argument;
+			}
+		}
+
+		void addArgument(ASTBaseNode* argument) { m_arguments.push_back(argument); }
 
 		[[nodiscard]] const std::string&
 		readFunctionName() const {
 			return m_functionName;
 		}
 
+		[[nodiscard]] const std::vector<ASTBaseNode*>&
+		readArguments() const {
+			return m_arguments;
+		}
 };
 
 } // namespace ciph	
\ No newline at end of file
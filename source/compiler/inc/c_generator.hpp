@@ -0,0 +1,67 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace ciph {
+
+class ASTBaseNode;
+class ASTComparisonExpressionNode;
+class ASTFunctionNode;
+class ASTIdentifierNode;
+class ASTProgramNode;
+class ASTScopeNode;
+class ASTWhileNode;
+
+/*
+ * Ahead of time backend, translates the AST to a self contained C99 translation unit instead of
+ * bytecode. The program body becomes `int16_t <entry>(void)`, every ciph function a static
+ * function and every let a local. Arithmetic goes through small helpers that wrap at 16 bits and
+ * truncate division exactly like the VM. Division by zero, which the VM traps on, sets
+ * `<entry>_trapped` and every function returns 0 from the statement it happened in, so callers
+ * check the flag rather than the return value. Comparisons follow CMP and evaluate to
+ * left - right, `while` follows JLT: the body runs once before the condition is checked. */
+class CGenerator {
+public:
+    explicit CGenerator(const ASTProgramNode* program, std::string entry = "ciph_main")
+        : m_program(program)
+        , m_entry(std::move(entry)) {}
+    ~CGenerator() = default;
+
+    void generateCode();
+
+    const std::string& readSource() const { return m_source; }
+
+private:
+    void generateRuntime();
+    void generateFunction(const ASTFunctionNode* node);
+    void generateBody(const ASTScopeNode* node, const std::string& name, bool isStatic);
+    void generateScope(const ASTScopeNode* node, int depth);
+    void generateWhileStatement(const ASTWhileNode* node, int depth);
+    void generateStatement(const ASTBaseNode* node, int depth);
+
+    void collectLocals(const ASTScopeNode* node, std::vector<std::string>& locals) const;
+
+    std::string expression(const ASTBaseNode* node);
+    std::string comparison(const ASTComparisonExpressionNode* node);
+    std::string identifier(const ASTIdentifierNode* node);
+
+    void line(int depth, const std::string& text);
+    void trapCheck(int depth);
+
+    std::string functionName(const std::string& name) const;
+    static std::string parameterList(const ASTScopeNode* node);
+    static std::string localName(const std::string& name);
+
+    const ASTProgramNode* m_program = nullptr;
+    std::string m_entry;
+    std::map<std::string, const ASTFunctionNode*> m_functions;
+    std::unordered_set<std::string> m_locals;
+    // set by expression() on a division or call, either can leave `<entry>_trapped` set.
+    bool m_mayTrap = false;
+    std::string m_source = "";
+};
+
+} // namespace ciph
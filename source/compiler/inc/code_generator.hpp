@@ -6,9 +6,11 @@
 #include <shared_defines.hpp>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <variant>
 #include <vector>
 #include "lexar_defines.hpp"
+#include "register_allocator.hpp"
 
 namespace ciph {
 
@@ -23,6 +25,7 @@ class ASTReturnNode;
 class ASTScopeNode;
 class ASTWhileNode;
 class ASTCallNode;
+class ASTFunctionNode;
 
 struct IdentifierContext {
     IdentifierContext(const std::string& name, uint8_t offset)
@@ -35,7 +38,7 @@ struct IdentifierContext {
 
     std::string name = "";
     uint8_t offset = 0;
-    uint8_t cur_register = 0xFF;
+    uint8_t cur_register = 0xFF; // register the local lives in, 0xFF when it has a stack slot.
 };
 
 struct PointerContext {
@@ -53,13 +56,25 @@ struct FunctionContext {
 
 struct RegisterValue {
     std::optional<IdentifierContext> value;
+    bool allocated = false; // holds an operand of the expression being generated.
 };
 
+/*
+ * How arithmetic is evaluated. Stack pushes every operand and leaves the result on the stack.
+ * Registers evaluates expression trees into r0 to r6 with the register forms of the arithmetic,
+ * and only falls back to the stack for a subtree when no register is free. It also keeps locals
+ * in registers, RegisterAllocator decides which, and the rest in stack slots. Stack keeps every
+ * local in a stack slot. */
+enum class Evaluation {
+    Stack,
+    Registers
+};
 
 class CodeGenerator {
 public:
-    explicit CodeGenerator(const ASTProgramNode* program)
-        : m_program(program) {}
+    explicit CodeGenerator(const ASTProgramNode* program, Evaluation evaluation = Evaluation::Stack)
+        : m_program(program)
+        , m_evaluation(evaluation) {}
     ~CodeGenerator() = default;
 
     void generateCode();
@@ -72,8 +87,13 @@ private:
 
 
     void generateProgram(const ASTProgramNode* node);
+    void allocateLocals(const ASTScopeNode* body);
+    void holdLocals(const ASTBaseNode* node);
     void generateScope(const ASTScopeNode* node);
+    void generateFunctions(const ASTScopeNode* node);
     void generateFunction(const ASTBaseNode* node);
+    void generateParameters(const ASTFunctionNode* node);
+    void declareFunctions(const ASTScopeNode* node);
 
     // expressions
     void generateExpression(const ASTBaseNode* node);
@@ -83,11 +103,14 @@ private:
     void generateBinaryExpression(  const ASTBinaryExpressionNode* node,
                                     std::optional<registers::def> reg = std::nullopt);
     void generateNumericLiteral(const ASTNumericLiteralNode* node);
-    void generateCall(const ASTCallNode* callNode);
+    void generateCall(const ASTCallNode* callNode, registers::def reg);
+    void generateMoves(std::vector<std::pair<registers::def, registers::def>> moves);
     void generateOperator(  const ASTBinaryExpressionNode* node, std::optional<registers::def> regA = std::nullopt,
                             std::optional<registers::def> regB = std::nullopt);
     void generateOperatorReg(   const ASTBinaryExpressionNode* node, registers::def regA,
                                 std::optional<registers::def> regB = std::nullopt);
+    bool generateRegisterExpression(const ASTBinaryExpressionNode* node, registers::def reg);
+    void generateIntoRegister(const ASTBaseNode* node, registers::def reg);
     void generateCompareOperator(   const ASTComparisonExpressionNode* node, registers::def regA,
                                     std::optional<registers::def> regB = std::nullopt);
     void generateIdentifier(const ASTIdentifierNode* node, registers::def reg = registers::def::imm);
@@ -107,6 +130,8 @@ private:
      * @param reg given register, if sp (stack pointer) is given, value gets pushed onto the stack.
      * @return true: the value was assigned to a register. false: the value was pushed to the stack.   */
     bool peek_offset(uint8_t offset, registers::def reg);
+    void copyRegister(registers::def local, registers::def reg);
+    std::optional<registers::def> localRegister(const ASTBaseNode* node) const;
     
     void pop();
     void emit(instruction::def opCode) { m_bytecode.push_back(static_cast<uint8_t>(opCode)); }
@@ -114,17 +139,31 @@ private:
     void encode(int16_t value);
     void encodeRegister(registers::def reg);
     void encodeOperator(OperatorType op);
+    void encodeOperatorReg(OperatorType op);
+
+    // first of r0 to r6 not holding an operand or a live local, nullopt once they all are.
+    std::optional<registers::def> allocateRegister();
+    void releaseRegister(registers::def reg);
 
     std::array<RegisterValue, static_cast<int>(registers::def::reg_cnt)> m_registers;
 
     // program
+    // words on the stack at the point being generated, a let takes the slot at the top.
     uint16_t m_stackSize = 0;
     std::unordered_map<std::string, IdentifierContext> m_identifiers;
     std::unordered_map<uint16_t, PointerContext> m_pointers;
     std::unordered_map<std::string, FunctionContext> m_functions;
-    std::unordered_map<std::string, std::vector<uint8_t>> m_unresolvedCalls;
+    // parameters each function takes, known before any of them is generated.
+    std::unordered_map<std::string, size_t> m_parameterCounts;
+    // operand positions of the CALLs to a function not generated yet.
+    std::unordered_map<std::string, std::vector<uint16_t>> m_unresolvedCalls;
 
     const ASTProgramNode* m_program = nullptr;
+    Evaluation m_evaluation = Evaluation::Stack;
+    // locals of the body being generated, only with Evaluation::Registers.
+    std::optional<RegisterAllocator> m_allocation;
+    // statement being generated, nullptr in a while condition.
+    const ASTBaseNode* m_statement = nullptr;
     std::vector<uint8_t> m_bytecode = {};
     std::string m_resultBytecode = "";
 };
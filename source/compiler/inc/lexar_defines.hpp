@@ -32,6 +32,7 @@ BOOLEAN,*/
     CLOSE_BRACE,
     OPEN_BRACKET,
     CLOSE_BRACKET,
+    COMMA,
 
     END_OF_FILE,
     UNKNOWN
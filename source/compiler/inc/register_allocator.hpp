@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <shared_defines.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ciph {
+
+class ASTBaseNode;
+class ASTScopeNode;
+
+// Statements of one let, from the one defining it to the last one reading it.
+struct LiveRange {
+    std::string name = "";
+    uint16_t start = 0;
+    uint16_t end = 0;
+    uint32_t weight = 0;                // uses, each weighted by how deep in loops it is.
+    std::optional<registers::def> reg;  // nullopt when spilled to a stack slot.
+    bool fixed = false;                 // parameter that arrives in a register, it stays there.
+};
+
+/*
+ * Linear scan register allocation for the locals of one function body. Statements are numbered
+ * in the order they are generated, the condition of a while after its body, and every let gets a
+ * live range from its definition to its last use. A local read inside a loop it was defined
+ * before stays live to the end of the loop, so the next iteration still finds it. Ranges are
+ * scanned by start and given the lowest free of r0 to r6, at most local_registers at a time so
+ * the expressions in between have temporaries. When none is free, the range with the lowest
+ * weight among the live ones and the new one is spilled to the stack for its whole life.
+ * Parameters of a function body are defined before its first statement, the ones passed in r0 to
+ * r3 keep that register and are never spilled. Functions nested in the body are left to their
+ * own allocation. */
+class RegisterAllocator {
+public:
+    // locals kept in registers at once, the rest of r0 to r6 is left to temporaries.
+    static constexpr uint8_t local_registers = 5;
+    // arguments passed in r0 to r3, the ones after them are pushed by the caller, see CodeGenerator.
+    static constexpr uint8_t register_parameters = 4;
+
+    explicit RegisterAllocator(const ASTScopeNode* body);
+    ~RegisterAllocator() = default;
+
+    void allocate();
+
+    std::optional<registers::def> registerOf(const std::string& name) const;
+    // position of a statement or while condition in the body, nullopt if it wasn't numbered.
+    std::optional<uint16_t> positionOf(const ASTBaseNode* node) const;
+    // registers held by locals live at position, an expression there can't use them.
+    std::vector<registers::def> liveAt(uint16_t position) const;
+    // registers held by locals still read after the statement at position.
+    std::vector<registers::def> liveAfter(uint16_t position) const;
+
+    const std::vector<LiveRange>& readRanges() const { return m_ranges; }
+
+private:
+    struct Loop {
+        uint16_t start = 0;
+        uint16_t end = 0;
+    };
+
+    void numberScope(const ASTScopeNode* node, uint8_t depth);
+    void numberExpression(const ASTBaseNode* node, uint16_t position, uint8_t depth);
+    void define(const std::string& name, uint16_t position);
+    void use(const std::string& name, uint16_t position, uint8_t depth);
+    uint16_t next(const ASTBaseNode* node);
+
+    const ASTScopeNode* m_body = nullptr;
+    uint16_t m_position = 0;
+    std::vector<LiveRange> m_ranges;
+    std::vector<Loop> m_loops;
+    // positions every local is read or written at after its let.
+    std::unordered_map<std::string, std::vector<uint16_t>> m_uses;
+    std::unordered_map<std::string, size_t> m_rangeOf;
+    std::unordered_map<const ASTBaseNode*, uint16_t> m_positions;
+};
+
+} // namespace ciph
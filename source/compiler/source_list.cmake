@@ -3,18 +3,22 @@ set(COMPILER_INC_DIR ${CMAKE_CURRENT_LIST_DIR}/inc)
 
 set(COMPILER_SRC 
     ${COMPILER_SRC}
+    ${COMPILER_SRC_DIR}/c_generator.cpp
     ${COMPILER_SRC_DIR}/code_generator.cpp
     ${COMPILER_SRC_DIR}/lexar.cpp
     ${COMPILER_SRC_DIR}/parser.cpp
+    ${COMPILER_SRC_DIR}/register_allocator.cpp
 )
 
 set(COMPILER_INC 
     ${COMPILER_INC}
     ${COMPILER_INC_DIR}/ast.hpp
+    ${COMPILER_INC_DIR}/c_generator.hpp
     ${COMPILER_INC_DIR}/code_generator.hpp
     ${COMPILER_INC_DIR}/lexar.hpp
     ${COMPILER_INC_DIR}/lexar_defines.hpp
     ${COMPILER_INC_DIR}/parser.hpp
+    ${COMPILER_INC_DIR}/register_allocator.hpp
     ${COMPILER_INC_DIR}/error_defines.hpp
     ${COMPILER_INC_DIR}/error_reporter.hpp
 )
@@ -0,0 +1,325 @@
+#include "c_generator.hpp"
+
+#include <algorithm>
+
+#include <fmt/core.h>
+
+#include "ast.hpp"
+
+using namespace ciph;
+
+namespace {
+
+// Function nodes anywhere in the tree, they are all hoisted to file scope.
+void
+collectFunctions(const ASTScopeNode* node, std::vector<const ASTFunctionNode*>& functions) {
+    for (const ASTBaseNode* statement : node->readStatements()) {
+        if (statement->readType() == ASTNodeType::FUNCTION) {
+            const auto* functionNode = static_cast<const ASTFunctionNode*>(statement);
+            functions.push_back(functionNode);
+            collectFunctions(functionNode, functions);
+        }
+        else if (statement->readType() == ASTNodeType::WHILE) {
+            collectFunctions(static_cast<const ASTWhileNode*>(statement), functions);
+        }
+    }
+}
+
+std::string
+indent(int depth) {
+    return std::string(static_cast<size_t>(depth) * 4, ' ');
+}
+
+} // namespace
+
+void
+CGenerator::generateCode() {
+    m_source.clear();
+    m_functions.clear();
+
+    std::vector<const ASTFunctionNode*> functions;
+    collectFunctions(m_program, functions);
+    for (const ASTFunctionNode* functionNode : functions) {
+        if (m_functions.emplace(functionNode->readName(), functionNode).second == false)
+            fmt::print("Function {} already exists\n", functionNode->readName());
+    }
+
+    generateRuntime();
+
+    for (const auto& [name, functionNode] : m_functions)
+        line(0, fmt::format("static int16_t {}({});", functionName(name), parameterList(functionNode)));
+    if (m_functions.empty() == false)
+        line(0, "");
+
+    for (const ASTFunctionNode* functionNode : functions) {
+        if (m_functions.at(functionNode->readName()) == functionNode)
+            generateFunction(functionNode);
+    }
+
+    generateBody(m_program, m_entry, false);
+}
+
+void
+CGenerator::generateRuntime() {
+    line(0, "/* generated by the ciph C backend */");
+    line(0, "#include <stdint.h>");
+    line(0, "");
+    line(0, fmt::format("int {}_trapped = 0;", m_entry));
+    line(0, "");
+    // unsigned arithmetic wraps without undefined behaviour, narrowing back gives the VM's int16_t.
+    line(0, "static inline int16_t ciph_add(int16_t a, int16_t b) { return (int16_t)(uint16_t)((uint32_t)(uint16_t)a + (uint16_t)b); }");
+    line(0, "static inline int16_t ciph_sub(int16_t a, int16_t b) { return (int16_t)(uint16_t)((uint32_t)(uint16_t)a - (uint16_t)b); }");
+    line(0, "static inline int16_t ciph_mul(int16_t a, int16_t b) { return (int16_t)(uint16_t)((uint32_t)(uint16_t)a * (uint16_t)b); }");
+    line(0, fmt::format("static inline int16_t ciph_div(int16_t a, int16_t b) {{ if (b == 0) {{ {}_trapped = 1; return 0; }} "
+                        "return (int16_t)(uint16_t)((int32_t)a / (int32_t)b); }}", m_entry));
+    line(0, "");
+}
+
+void
+CGenerator::generateFunction(const ASTFunctionNode* node) {
+    generateBody(node, functionName(node->readName()), true);
+}
+
+void
+CGenerator::generateBody(const ASTScopeNode* node, const std::string& name, bool isStatic) {
+    line(0, fmt::format("{}int16_t {}({}) {{", isStatic ? "static " : "", name, parameterList(node)));
+
+    m_locals.clear();
+    if (node->readType() == ASTNodeType::FUNCTION) {
+        for (const std::string& parameter : static_cast<const ASTFunctionNode*>(node)->readParameters())
+            m_locals.insert(parameter);
+    }
+
+    std::vector<std::string> locals;
+    collectLocals(node, locals);
+    for (const std::string& local : locals) {
+        if (m_locals.contains(local) == false) {
+            line(1, fmt::format("int16_t {} = 0;", localName(local)));
+            // a let nothing reads is set but never used, which -Wall -Werror rejects.
+            line(1, fmt::format("(void){};", localName(local)));
+        }
+    }
+
+    generateScope(node, 1);
+    line(1, "return 0;");
+    line(0, "}");
+    line(0, "");
+}
+
+void
+CGenerator::generateScope(const ASTScopeNode* node, int depth) {
+    for (const ASTBaseNode* statement : node->readStatements())
+        generateStatement(statement, depth);
+}
+
+void
+CGenerator::generateStatement(const ASTBaseNode* node, int depth) {
+    if (node == nullptr) {
+        fmt::print("Unknown node type\n");
+        return;
+    }
+
+    m_mayTrap = false;
+    switch (node->readType()) {
+        case ASTNodeType::RETURN: {
+            const auto* returnNode = static_cast<const ASTReturnNode*>(node);
+            line(depth, fmt::format("return {};", expression(returnNode->readExpression())));
+            break;
+        }
+        case ASTNodeType::LET: {
+            const auto* letNode = static_cast<const ASTLetNode*>(node);
+            if (m_locals.insert(letNode->readIdentifier()).second == false) {
+                fmt::print("Identifier already exists\n");
+                break;
+            }
+            line(depth, fmt::format("{} = {};", localName(letNode->readIdentifier()),
+                                    expression(letNode->readExpression())));
+            trapCheck(depth);
+            break;
+        }
+        case ASTNodeType::WHILE: {
+            generateWhileStatement(static_cast<const ASTWhileNode*>(node), depth);
+            break;
+        }
+        case ASTNodeType::FUNCTION: {
+            break; // hoisted to file scope by generateCode.
+        }
+        case ASTNodeType::IDENTIFIER: {
+            line(depth, fmt::format("{};", identifier(static_cast<const ASTIdentifierNode*>(node))));
+            break;
+        }
+        default: {
+            line(depth, fmt::format("(void)({});", expression(node)));
+            trapCheck(depth);
+            break;
+        }
+    }
+}
+
+void
+CGenerator::generateWhileStatement(const ASTWhileNode* node, int depth) {
+    // CodeGenerator places the condition after the body and only emits a branch for <.
+    if (node->readCondition()->readOperator() != OperatorType::LESS_THAN) {
+        fmt::print("Unsupported while condition, the body runs once\n");
+        line(depth, "{");
+        generateScope(node, depth + 1);
+        line(depth, "}");
+        return;
+    }
+
+    line(depth, "do {");
+    generateScope(node, depth + 1);
+    const ASTComparisonExpressionNode* condition = node->readCondition();
+    m_mayTrap = false;
+    std::string difference = fmt::format("ciph_sub({}, {})", expression(condition->readLeft()),
+                                         expression(condition->readRight()));
+    if (m_mayTrap == false) {
+        line(depth, fmt::format("}} while ({} < 0);", difference));
+        return;
+    }
+    line(depth, fmt::format("}} while ({} < 0 && {}_trapped == 0);", difference, m_entry));
+    trapCheck(depth);
+}
+
+void
+CGenerator::collectLocals(const ASTScopeNode* node, std::vector<std::string>& locals) const {
+    for (const ASTBaseNode* statement : node->readStatements()) {
+        if (statement->readType() == ASTNodeType::LET) {
+            const std::string& name = static_cast<const ASTLetNode*>(statement)->readIdentifier();
+            if (std::find(locals.begin(), locals.end(), name) == locals.end())
+                locals.push_back(name);
+        }
+        else if (statement->readType() == ASTNodeType::WHILE) {
+            collectLocals(static_cast<const ASTWhileNode*>(statement), locals);
+        }
+    }
+}
+
+std::string
+CGenerator::expression(const ASTBaseNode* node) {
+    if (node == nullptr) {
+        fmt::print("Unknown node type\n");
+        return "0";
+    }
+
+    switch (node->readType()) {
+        case ASTNodeType::NUMERIC_LITERAL: {
+            int16_t value = static_cast<const ASTNumericLiteralNode*>(node)->readValue();
+            // INT16_MIN has no literal of its own in C.
+            if (value == INT16_MIN)
+                return "INT16_MIN";
+            return fmt::format("(int16_t){}", value);
+        }
+        case ASTNodeType::BINARY_EXPRESSION: {
+            const auto* binaryNode = static_cast<const ASTBinaryExpressionNode*>(node);
+            const char* helper = nullptr;
+            switch (binaryNode->readOperator()) {
+                case OperatorType::ADDITION:
+                    helper = "ciph_add";
+                    break;
+                case OperatorType::SUBTRACTION:
+                    helper = "ciph_sub";
+                    break;
+                case OperatorType::MULTIPLICATION:
+                    helper = "ciph_mul";
+                    break;
+                case OperatorType::DIVISION:
+                    helper = "ciph_div";
+                    m_mayTrap = true;
+                    break;
+                default:
+                    fmt::print("Unknown operator\n");
+                    return "0";
+            }
+            return fmt::format("{}({}, {})", helper, expression(binaryNode->readLeft()),
+                               expression(binaryNode->readRight()));
+        }
+        case ASTNodeType::COMPARISON_EXPRESSION: {
+            return comparison(static_cast<const ASTComparisonExpressionNode*>(node));
+        }
+        case ASTNodeType::IDENTIFIER: {
+            return identifier(static_cast<const ASTIdentifierNode*>(node));
+        }
+        case ASTNodeType::CALL_EXPRESSION: {
+            const auto* callNode = static_cast<const ASTCallNode*>(node);
+            const std::string& name = callNode->readFunctionName();
+            auto function = m_functions.find(name);
+            if (function == m_functions.end()) {
+                fmt::print("Unresolved function call to {}\n", name);
+                return "0";
+            }
+            const std::vector<ASTBaseNode*>& arguments = callNode->readArguments();
+            size_t parameters = function->second->readParameters().size();
+            if (parameters != arguments.size()) {
+                fmt::print("Function {} takes {} arguments, {} given\n", name, parameters, arguments.size());
+                return "0";
+            }
+            m_mayTrap = true;
+            std::string list;
+            for (const ASTBaseNode* argument : arguments)
+                list += fmt::format("{}{}", list.empty() ? "" : ", ", expression(argument));
+            return fmt::format("{}({})", functionName(name), list);
+        }
+        default: {
+            fmt::print("Unknown node type\n");
+            return "0";
+        }
+    }
+}
+
+// CMP leaves left - right behind, which is also what a comparison evaluates to as a value.
+std::string
+CGenerator::comparison(const ASTComparisonExpressionNode* node) {
+    return fmt::format("ciph_sub({}, {})", expression(node->readLeft()), expression(node->readRight()));
+}
+
+std::string
+CGenerator::identifier(const ASTIdentifierNode* node) {
+    if (m_locals.contains(node->readName()) == false) {
+        fmt::print("Identifier not found\n");
+        return "0";
+    }
+
+    std::string name = localName(node->readName());
+    if (node->readOperator() != nullptr) {
+        const auto* op = static_cast<const ASTIncDecNode*>(node->readOperator());
+        return fmt::format("({} = {}({}, 1))", name, op->readIsIncrement() ? "ciph_add" : "ciph_sub", name);
+    }
+    return name;
+}
+
+void
+CGenerator::line(int depth, const std::string& text) {
+    if (text.empty() == false)
+        m_source += indent(depth);
+    m_source += text;
+    m_source += '\n';
+}
+
+// Returns from the function when the statement just emitted may have trapped, like the VM stopping.
+void
+CGenerator::trapCheck(int depth) {
+    if (m_mayTrap)
+        line(depth, fmt::format("if ({}_trapped) return 0;", m_entry));
+}
+
+std::string
+CGenerator::functionName(const std::string& name) const {
+    return fmt::format("{}_fn_{}", m_entry, name);
+}
+
+// The C parameter list of a function, void for the program body and functions without any.
+std::string
+CGenerator::parameterList(const ASTScopeNode* node) {
+    if (node->readType() != ASTNodeType::FUNCTION)
+        return "void";
+    std::string list;
+    for (const std::string& parameter : static_cast<const ASTFunctionNode*>(node)->readParameters())
+        list += fmt::format("{}int16_t {}", list.empty() ? "" : ", ", localName(parameter));
+    return list.empty() ? "void" : list;
+}
+
+std::string
+CGenerator::localName(const std::string& name) {
+    return "v_" + name;
+}
@@ -1,7 +1,10 @@
 #include "code_generator.hpp"
 
+#include <algorithm>
+
 #include <fmt/core.h>
 
+#include <byte_order.hpp>
 #include <disassembler.hpp>
 #include <shared_defines.hpp>
 
@@ -9,6 +12,26 @@
 
 using namespace ciph;
 
+namespace {
+
+// The expression a statement evaluates, nothing of the statement runs after it is done.
+const ASTBaseNode*
+statementExpression(const ASTBaseNode* statement) {
+    switch (statement->readType()) {
+        case ASTNodeType::RETURN:
+            return static_cast<const ASTReturnNode*>(statement)->readExpression();
+        case ASTNodeType::LET:
+            return static_cast<const ASTLetNode*>(statement)->readExpression();
+        case ASTNodeType::WHILE:
+        case ASTNodeType::FUNCTION:
+            return nullptr;
+        default:
+            return statement;
+    }
+}
+
+} // namespace
+
 std::string
 CodeGenerator::disassemble() const {
     Disassembler disassembler(&m_bytecode[0], m_bytecode.size());
@@ -18,29 +41,68 @@ CodeGenerator::disassemble() const {
 void
 CodeGenerator::generateCode() {
     m_bytecode.clear();
-    
-    
-    emit(instruction::def::JMP);
-    uint16_t main_addrs = 1;
-    encode(main_addrs); // placeholder for address
-    m_functions.emplace("main", FunctionContext{"main", main_addrs});
+    m_functions.clear();
+    m_parameterCounts.clear();
+    m_unresolvedCalls.clear();
+    declareFunctions(m_program);
 
+    // the program starts at its first byte and ends in its own RET, functions are laid out after it.
     generateProgram(m_program);
-
-    emit(instruction::def::HALT);
-
-    // patch jump to main
-    // jmp is at position 0, address is at position 1
-    patch(1, m_functions["main"].address);
+    generateFunctions(m_program);
 
     resolveUnresolvedCalls();
 }
 
 void
 CodeGenerator::generateProgram(const ASTProgramNode* node) {
+    allocateLocals(node);
     generateScope(node);
 }
 
+void
+CodeGenerator::allocateLocals(const ASTScopeNode* body) {
+    m_allocation.reset();
+    if (m_evaluation != Evaluation::Registers)
+        return;
+    m_allocation.emplace(body);
+    m_allocation->allocate();
+}
+
+// Marks the registers of the locals live at node as taken, temporaries are only ever held within one.
+void
+CodeGenerator::holdLocals(const ASTBaseNode* node) {
+    if (m_allocation.has_value() == false)
+        return;
+    std::optional<uint16_t> position = m_allocation->positionOf(node);
+    if (position.has_value() == false)
+        return;
+
+    for (uint8_t reg = +registers::def::r0; reg <= +registers::def::r6; reg++)
+        m_registers[reg].allocated = false;
+    for (registers::def reg : m_allocation->liveAt(position.value()))
+        m_registers[+reg].allocated = true;
+}
+
+void
+CodeGenerator::generateFunctions(const ASTScopeNode* node) {
+    for (const ASTBaseNode* statement : node->readStatements()) {
+        if (statement->readType() == ASTNodeType::FUNCTION)
+            generateFunction(statement);
+    }
+}
+
+// Parameter counts of every function, calls are checked against them before the function is generated.
+void
+CodeGenerator::declareFunctions(const ASTScopeNode* node) {
+    for (const ASTBaseNode* statement : node->readStatements()) {
+        if (statement->readType() != ASTNodeType::FUNCTION)
+            continue;
+        const auto* functionNode = static_cast<const ASTFunctionNode*>(statement);
+        m_parameterCounts.try_emplace(functionNode->readName(), functionNode->readParameters().size());
+        declareFunctions(functionNode);
+    }
+}
+
 void
 CodeGenerator::generateFunction(const ASTBaseNode* node) {
     const ASTFunctionNode* functionNode = static_cast<const ASTFunctionNode*>(node);
@@ -54,12 +116,65 @@ CodeGenerator::generateFunction(const ASTBaseNode* node) {
         return;
     }
 
+    // CALL gives the function a frame of its own, its locals start over at fp.
+    m_identifiers.clear();
+    m_registers = {};
+    m_stackSize = 0;
+    allocateLocals(functionNode);
+    generateParameters(functionNode);
     generateScope(functionNode);
+    generateFunctions(functionNode);
+}
+
+/*
+ * Gives every parameter a home before the body runs. The first register_parameters arrive in r0
+ * to r3, the rest on the caller's stack under the frame where PEK_ARG reads them. A parameter
+ * RegisterAllocator kept in a register stays there, the others are copied into stack slots. */
+void
+CodeGenerator::generateParameters(const ASTFunctionNode* node) {
+    const std::vector<std::string>& parameters = node->readParameters();
+    for (size_t index = 0; index < parameters.size(); index++) {
+        if (m_identifiers.contains(parameters[index])) {
+            fmt::print("Identifier already exists\n");
+            continue;
+        }
+        bool inRegister = index < RegisterAllocator::register_parameters;
+        auto argument = static_cast<uint8_t>(index - RegisterAllocator::register_parameters);
+        IdentifierContext identifier(parameters[index], static_cast<uint8_t>(m_stackSize));
+        std::optional<registers::def> reg = m_allocation ? m_allocation->registerOf(parameters[index]) : std::nullopt;
+        if (reg.has_value()) {
+            identifier.cur_register = +reg.value();
+            if (inRegister == false) {
+                emit(instruction::def::PEK_ARG);
+                encodeRegister(reg.value());
+                m_bytecode.push_back(argument);
+            }
+        }
+        else {
+            if (m_stackSize >= UINT8_MAX) {
+                fmt::print("Stack overflow\n");
+                return;
+            }
+            if (inRegister) {
+                emit(instruction::def::PSH_REG);
+                encodeRegister(static_cast<registers::def>(+registers::def::r0 + index));
+            }
+            else {
+                emit(instruction::def::PEK_ARG);
+                encodeRegister(registers::def::sp);
+                m_bytecode.push_back(argument);
+            }
+            m_stackSize++;
+        }
+        m_identifiers.emplace(parameters[index], identifier);
+    }
 }
 
 void
 CodeGenerator::generateScope(const ASTScopeNode* node) {
     for (ASTBaseNode* statement : node->readStatements()) {
+        holdLocals(statement);
+        m_statement = statement;
         switch (statement->readType()) {
             case ASTNodeType::RETURN: {
                 const auto* returnNode = static_cast<const ASTReturnNode*>(statement);
@@ -76,6 +191,9 @@ CodeGenerator::generateScope(const ASTScopeNode* node) {
                 generateWhileStatement(whileNode);
                 break;
             }
+            case ASTNodeType::FUNCTION: {
+                break; // generated after the body declaring it, see generateFunctions.
+            }
             default: {
                 generateExpression(statement, registers::def::sp);
                 break;
@@ -89,7 +207,10 @@ CodeGenerator::generateExpression(const ASTBaseNode* node, registers::def reg) {
     switch (node->readType()) {
         case ASTNodeType::NUMERIC_LITERAL: {
             const auto* numericNode = static_cast<const ASTNumericLiteralNode*>(node);
-            generateNumericLiteral(numericNode);
+            if (m_evaluation == Evaluation::Registers && reg != registers::def::sp)
+                generateIntoRegister(numericNode, reg);
+            else
+                generateNumericLiteral(numericNode);
             break;
         }
         case ASTNodeType::COMPARISON_EXPRESSION: {
@@ -112,7 +233,7 @@ CodeGenerator::generateExpression(const ASTBaseNode* node, registers::def reg) {
         }
         case ASTNodeType::CALL_EXPRESSION: {
             const auto* callNode = static_cast<const ASTCallNode*>(node);
-            generateCall(callNode);
+            generateCall(callNode, reg);
             break;
         }
         default: {
@@ -122,25 +243,150 @@ CodeGenerator::generateExpression(const ASTBaseNode* node, registers::def reg) {
     }
 }
 
+/*
+ * CALL with the result copied from ret into reg. The callee is free to use every register, the
+ * ones the caller still needs, live locals and operands of the expression around the call, are
+ * pushed before it and popped after. A local read for the last time by the arguments of a call
+ * its statement ends with isn't kept. The first register_parameters arguments are passed in r0 to
+ * r3, the rest are pushed last first so the fifth ends up right under the return address, and
+ * dropped once the call returned. */
 void
-CodeGenerator::generateCall(const ASTCallNode* callNode) {
+CodeGenerator::generateCall(const ASTCallNode* callNode, registers::def reg) {
+    const std::vector<ASTBaseNode*>& arguments = callNode->readArguments();
+    if (auto count = m_parameterCounts.find(callNode->readFunctionName());
+        count != m_parameterCounts.end() && count->second != arguments.size()) {
+        fmt::print("Function {} takes {} arguments, {} given\n", callNode->readFunctionName(), count->second,
+                   arguments.size());
+        return;
+    }
+
+    // a call its statement ends with only has to keep the locals read after the statement.
+    std::optional<std::vector<registers::def>> needed;
+    if (m_allocation.has_value() && m_statement != nullptr && statementExpression(m_statement) == callNode) {
+        if (std::optional<uint16_t> position = m_allocation->positionOf(m_statement); position.has_value())
+            needed = m_allocation->liveAfter(position.value());
+    }
+    std::vector<registers::def> saved;
+    for (uint8_t held = +registers::def::r0; held <= +registers::def::ret; held++) {
+        auto candidate = static_cast<registers::def>(held);
+        if (m_registers[held].allocated == false || candidate == reg)
+            continue;
+        if (needed.has_value() && std::find(needed->begin(), needed->end(), candidate) == needed->end())
+            continue;
+        saved.push_back(candidate);
+    }
+    for (registers::def held : saved) {
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::PSH_REG));
+        encodeRegister(held);
+        m_stackSize++;
+    }
+
+    size_t inRegisters = std::min<size_t>(arguments.size(), RegisterAllocator::register_parameters);
+    for (size_t index = arguments.size(); index > inRegisters; index--)
+        generateExpression(arguments[index - 1], registers::def::sp);
+
+    // an argument register can hold a value a later argument still reads, those are filled once all are evaluated.
+    std::vector<std::pair<registers::def, registers::def>> moves;
+    std::vector<registers::def> popped;
+    std::vector<std::pair<registers::def, int16_t>> literals;
+    std::vector<registers::def> temporaries;
+    std::array<bool, RegisterAllocator::register_parameters> pinned{};
+    for (size_t index = 0; index < inRegisters; index++) {
+        const ASTBaseNode* argument = arguments[index];
+        auto target = static_cast<registers::def>(+registers::def::r0 + index);
+        pinned[index] = m_registers[+target].allocated;
+        if (argument->readType() == ASTNodeType::NUMERIC_LITERAL) {
+            literals.emplace_back(target, static_cast<const ASTNumericLiteralNode*>(argument)->readValue());
+        }
+        else if (std::optional<registers::def> local = localRegister(argument); local.has_value()) {
+            moves.emplace_back(target, local.value());
+        }
+        else if (m_registers[+target].allocated == false) {
+            if (m_evaluation == Evaluation::Registers)
+                generateIntoRegister(argument, target);
+            else
+                generateExpression(argument, target);
+            m_registers[+target].allocated = true;
+        }
+        else if (std::optional<registers::def> temporary = allocateRegister(); temporary.has_value()) {
+            if (m_evaluation == Evaluation::Registers)
+                generateIntoRegister(argument, temporary.value());
+            else
+                generateExpression(argument, temporary.value());
+            temporaries.push_back(temporary.value());
+            moves.emplace_back(target, temporary.value());
+        }
+        else {
+            generateExpression(argument, registers::def::sp);
+            popped.push_back(target);
+        }
+    }
+    generateMoves(std::move(moves));
+    for (auto target = popped.rbegin(); target != popped.rend(); target++) {
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::POP_REG));
+        encodeRegister(*target);
+        m_stackSize--;
+    }
+    for (auto [target, value] : literals) {
+        emit(instruction::def::PUT_LIT);
+        encode(value);
+        emit(instruction::def::PUT_REG);
+        encodeRegister(target);
+    }
+
+    emit(instruction::def::CALL);
     if (auto function = m_functions.find(callNode->readFunctionName()); function != m_functions.end()) {
-        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::JMP));
         encode(function->second.address);
     }
     else {
-        if (m_unresolvedCalls.find(callNode->readFunctionName()) == m_unresolvedCalls.end()) {
-            auto [iter, inserted] = m_unresolvedCalls.emplace(callNode->readFunctionName(), std::vector<uint8_t>{});
-            emit(instruction::def::JMP);
-            iter->second.push_back(static_cast<uint8_t>(m_bytecode.size())); // position to patch later
-            encode(0x0000); // placeholder
+        // position to patch once the function is generated.
+        m_unresolvedCalls[callNode->readFunctionName()].push_back(static_cast<uint16_t>(m_bytecode.size()));
+        encode(0x0000);
+    }
+
+    for (size_t index = inRegisters; index < arguments.size(); index++) {
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::POP_REG));
+        encodeRegister(registers::def::imm);
+        m_stackSize--;
+    }
+    for (size_t index = 0; index < inRegisters; index++)
+        m_registers[+registers::def::r0 + index].allocated = pinned[index];
+    for (registers::def temporary : temporaries)
+        releaseRegister(temporary);
+
+    // the result has to be out of ret before a saved ret is popped over it, or pushed under the saved ones.
+    registers::def result = registers::def::ret;
+    if (saved.empty() == false) {
+        result = reg == registers::def::sp ? registers::def::imm : reg;
+        copyRegister(registers::def::ret, result);
+    }
+    for (auto held = saved.rbegin(); held != saved.rend(); held++) {
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::POP_REG));
+        encodeRegister(*held);
+        m_stackSize--;
+    }
+    copyRegister(result, reg);
+}
+
+// Copies every source into its destination as if all at once, a cycle is broken through imm.
+void
+CodeGenerator::generateMoves(std::vector<std::pair<registers::def, registers::def>> moves) {
+    std::erase_if(moves, [](const auto& move) { return move.first == move.second; });
+    while (moves.empty() == false) {
+        auto ready = std::find_if(moves.begin(), moves.end(), [&](const auto& move) {
+            return std::none_of(moves.begin(), moves.end(), [&](const auto& other) { return other.second == move.first; });
+        });
+        if (ready == moves.end()) {
+            registers::def parked = moves.front().first;
+            copyRegister(parked, registers::def::imm);
+            for (auto& move : moves) {
+                if (move.second == parked)
+                    move.second = registers::def::imm;
+            }
+            continue;
         }
-        else {
-            auto& positions = m_unresolvedCalls[callNode->readFunctionName()];
-            emit(instruction::def::JMP);
-            positions.push_back(static_cast<uint8_t>(m_bytecode.size())); // position to patch later
-            encode(0x0000); // placeholder
-        }        
+        copyRegister(ready->second, ready->first);
+        moves.erase(ready);
     }
 }
 
@@ -155,6 +401,9 @@ CodeGenerator::generateComparisonExpression(const ASTComparisonExpressionNode* n
 
 void
 CodeGenerator::generateBinaryExpression(const ASTBinaryExpressionNode* node, std::optional<registers::def> reg) {
+    if (m_evaluation == Evaluation::Registers && generateRegisterExpression(node, reg.value_or(registers::def::sp)))
+        return;
+
     // giving stack pointer, which indicates we're pushing the result to the stack
     generateExpression(node->readLeft(), registers::def::sp);
     generateExpression(node->readRight(), registers::def::sp);
@@ -173,6 +422,8 @@ CodeGenerator::generateWhileStatement(const ASTWhileNode* node) {
 
     generateScope(node);
 
+    m_statement = nullptr;
+    holdLocals(node->readCondition());
     generateComparisonExpression(node->readCondition(), registers::def::sp);
 
     uint16_t end = m_bytecode.size();
@@ -194,9 +445,17 @@ CodeGenerator::generateLetStatement(const ASTLetNode* node) {
             fmt::print("Stack overflow\n");
             return;
         }
-        m_identifiers.emplace(  node->readIdentifier(),
-                                IdentifierContext(node->readIdentifier(), static_cast<uint8_t>(m_stackSize)));
-        generateExpression(node->readExpression(), registers::def::sp);
+        IdentifierContext identifier(node->readIdentifier(), static_cast<uint8_t>(m_stackSize));
+        std::optional<registers::def> reg = m_allocation ? m_allocation->registerOf(node->readIdentifier()) : std::nullopt;
+        if (reg.has_value()) {
+            identifier.cur_register = +reg.value();
+            m_identifiers.emplace(node->readIdentifier(), identifier);
+            generateIntoRegister(node->readExpression(), reg.value());
+        }
+        else {
+            m_identifiers.emplace(node->readIdentifier(), identifier);
+            generateExpression(node->readExpression(), registers::def::sp);
+        }
     }
     else {
         fmt::print("Identifier already exists\n");
@@ -210,6 +469,10 @@ CodeGenerator::generateIdentifier(const ASTIdentifierNode* node, registers::def
             const auto* op = static_cast<const ASTIncDecNode*>(node->readOperator());
             instruction::def opInstruction = op->readIsIncrement() ? instruction::def::INC : instruction::def::DEC;
             m_bytecode.push_back(static_cast<uint8_t>(opInstruction));
+            if (identifier->second.cur_register != 0xFF) {
+                m_bytecode.push_back(identifier->second.cur_register);
+                return;
+            }
             m_bytecode.push_back(+registers::def::sp);
             m_bytecode.push_back(identifier->second.offset);
             return;
@@ -220,6 +483,10 @@ CodeGenerator::generateIdentifier(const ASTIdentifierNode* node, registers::def
         }
     }
     if (auto identifier = m_identifiers.find(node->readName()); identifier != m_identifiers.end()) {
+        if (identifier->second.cur_register != 0xFF) {
+            copyRegister(static_cast<registers::def>(identifier->second.cur_register), reg);
+            return;
+        }
         if (peek_offset(identifier->second.offset, reg) == false)
             m_registers[+reg].value = std::make_optional(identifier->second);
     }
@@ -254,27 +521,126 @@ CodeGenerator::encodeOperator(OperatorType op) {
     }
 }
 
+void
+CodeGenerator::encodeOperatorReg(OperatorType op) {
+    switch (op) {
+        case OperatorType::ADDITION: {
+            m_bytecode.push_back(static_cast<uint8_t>(instruction::def::ADD_REG));
+            break;
+        }
+        case OperatorType::SUBTRACTION: {
+            m_bytecode.push_back(static_cast<uint8_t>(instruction::def::SUB_REG));
+            break;
+        }
+        case OperatorType::MULTIPLICATION: {
+            m_bytecode.push_back(static_cast<uint8_t>(instruction::def::MUL_REG));
+            break;
+        }
+        case OperatorType::DIVISION: {
+            m_bytecode.push_back(static_cast<uint8_t>(instruction::def::DIV_REG));
+            break;
+        }
+        default: {
+            fmt::print("Unknown operator\n");
+            break;
+        }
+    }
+}
+
+// regA = regA <op> regB, without regB the operand is taken from imm.
 void
 CodeGenerator::generateOperatorReg( const ASTBinaryExpressionNode* node, registers::def regA,
                                     std::optional<registers::def> regB) {
-    encodeOperator(node->readOperator());
-
-    if (regA == registers::def::ret) {
-        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::POP_REG));
-        m_bytecode.push_back(+registers::def::ret);
-    }
-    m_stackSize -= 2; // poped twice
+    encodeOperatorReg(node->readOperator());
+    encodeRegister(regA);
+    encodeRegister(regB.value_or(registers::def::imm));
 }
 
 void
 CodeGenerator::generateOperator(const ASTBinaryExpressionNode* node, std::optional<registers::def> regA,
                                 std::optional<registers::def> regB) {
+    encodeOperator(node->readOperator());
+    m_stackSize--; // poped twice & pushed once
+
     if (regA.has_value() && regA.value() != registers::def::sp) {
-        generateOperatorReg(node, regA.value(), regB);
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::POP_REG));
+        encodeRegister(regA.value());
+        m_stackSize--;
+    }
+}
+
+/*
+ * Evaluates node into reg with the register forms of the arithmetic, the left operand into reg
+ * itself and the right one into the next free register. A literal right operand goes through
+ * imm instead and a register local is used where it lives. Given sp, the result is evaluated in a free register and pushed. Returns false
+ * without emitting anything if that needs a register and none is free. */
+bool
+CodeGenerator::generateRegisterExpression(const ASTBinaryExpressionNode* node, registers::def reg) {
+    registers::def target = reg;
+    if (reg == registers::def::sp) {
+        std::optional<registers::def> scratch = allocateRegister();
+        if (scratch.has_value() == false)
+            return false;
+        target = scratch.value();
+    }
+
+    generateIntoRegister(node->readLeft(), target);
+
+    // the left operand has to survive the right one, a call in it included.
+    bool held = m_registers[+target].allocated;
+    m_registers[+target].allocated = true;
+
+    const ASTBaseNode* right = node->readRight();
+    if (right->readType() == ASTNodeType::NUMERIC_LITERAL) {
+        emit(instruction::def::PUT_LIT);
+        encode(static_cast<const ASTNumericLiteralNode*>(right)->readValue());
+        generateOperatorReg(node, target);
+    }
+    else if (std::optional<registers::def> local = localRegister(right); local.has_value()) {
+        generateOperatorReg(node, target, local);
+    }
+    else if (std::optional<registers::def> operand = allocateRegister(); operand.has_value()) {
+        generateIntoRegister(right, operand.value());
+        generateOperatorReg(node, target, operand);
+        releaseRegister(operand.value());
     }
     else {
-        encodeOperator(node->readOperator());
-        m_stackSize--; // poped twice & pushed once
+        // out of registers, the right operand is evaluated on the stack and taken back through imm.
+        generateExpression(right, registers::def::sp);
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::POP_REG));
+        encodeRegister(registers::def::imm);
+        m_stackSize--;
+        generateOperatorReg(node, target);
+    }
+    m_registers[+target].allocated = held;
+
+    if (reg == registers::def::sp) {
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::PSH_REG));
+        encodeRegister(target);
+        m_stackSize++;
+        releaseRegister(target);
+    }
+    return true;
+}
+
+void
+CodeGenerator::generateIntoRegister(const ASTBaseNode* node, registers::def reg) {
+    switch (node->readType()) {
+        case ASTNodeType::NUMERIC_LITERAL: {
+            emit(instruction::def::PUT_LIT);
+            encode(static_cast<const ASTNumericLiteralNode*>(node)->readValue());
+            emit(instruction::def::PUT_REG);
+            encodeRegister(reg);
+            break;
+        }
+        case ASTNodeType::BINARY_EXPRESSION: {
+            generateRegisterExpression(static_cast<const ASTBinaryExpressionNode*>(node), reg);
+            break;
+        }
+        default: {
+            generateExpression(node, reg);
+            break;
+        }
     }
 }
 
@@ -300,6 +666,7 @@ CodeGenerator::generateNumericLiteral(const ASTNumericLiteralNode* node) {
     // 2 byte integer
     int16_t value = node->readValue();
     encode(value);
+    m_stackSize++;
 }
 
 std::string
@@ -324,8 +691,9 @@ CodeGenerator::readRawBytecode() const {
 
 void
 CodeGenerator::encode(int16_t value) {
-    m_bytecode.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
-    m_bytecode.push_back(static_cast<uint8_t>(value & 0xFF));
+    size_t position = m_bytecode.size();
+    m_bytecode.resize(position + 2);
+    byte_order::store_operand(&m_bytecode[position], value);
 }
 
 void
@@ -334,8 +702,36 @@ CodeGenerator::encodeRegister(registers::def reg) {
 }
 
 void CodeGenerator::patch(uint16_t position, uint16_t byte) { 
-    m_bytecode[position] = static_cast<uint8_t>((byte >> 8) & 0xFF);
-    m_bytecode[position + 1] = static_cast<uint8_t>(byte & 0xFF);
+    byte_order::store_operand(&m_bytecode[position], static_cast<int16_t>(byte));
+}
+
+// Copies a register local into reg, pushes it given sp.
+void
+CodeGenerator::copyRegister(registers::def local, registers::def reg) {
+    if (reg == registers::def::sp) {
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::PSH_REG));
+        encodeRegister(local);
+        m_stackSize++;
+    }
+    else if (reg != local) {
+        m_bytecode.push_back(static_cast<uint8_t>(instruction::def::MOV));
+        encodeRegister(reg);
+        encodeRegister(local);
+    }
+}
+
+// Register node reads when it is a plain read of a register local, nullopt otherwise.
+std::optional<registers::def>
+CodeGenerator::localRegister(const ASTBaseNode* node) const {
+    if (node->readType() != ASTNodeType::IDENTIFIER)
+        return std::nullopt;
+    const auto* identifierNode = static_cast<const ASTIdentifierNode*>(node);
+    if (identifierNode->readOperator() != nullptr)
+        return std::nullopt;
+    auto identifier = m_identifiers.find(identifierNode->readName());
+    if (identifier == m_identifiers.end() || identifier->second.cur_register == 0xFF)
+        return std::nullopt;
+    return static_cast<registers::def>(identifier->second.cur_register);
 }
 
 bool
@@ -344,7 +740,26 @@ CodeGenerator::peek_offset(uint8_t offset, registers::def reg) {
     encodeRegister(reg);
     m_bytecode.push_back(offset);
 
-    return reg == registers::def::sp;
+    if (reg != registers::def::sp)
+        return false;
+    m_stackSize++;
+    return true;
+}
+
+std::optional<registers::def>
+CodeGenerator::allocateRegister() {
+    for (uint8_t reg = +registers::def::r0; reg <= +registers::def::r6; reg++) {
+        if (m_registers[reg].allocated == false) {
+            m_registers[reg].allocated = true;
+            return static_cast<registers::def>(reg);
+        }
+    }
+    return std::nullopt;
+}
+
+void
+CodeGenerator::releaseRegister(registers::def reg) {
+    m_registers[+reg].allocated = false;
 }
 
 void CodeGenerator::resolveUnresolvedCalls() {
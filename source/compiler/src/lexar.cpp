@@ -132,6 +132,10 @@ Lexar::lex() {
             push("}", TokenType::CLOSE_BRACE, cursorPosition);
             continue;
         }
+        else if (cursor == ',') {
+            push(",", TokenType::COMMA, cursorPosition);
+            continue;
+        }
         else if (cursor == '\0') // eof
             break;
 
@@ -373,15 +373,41 @@ Parser::parseIdentifier() {
 
     if (token.readType() == TokenType::OPEN_PAREN) {
         m_lexar.pop(); // pop open paren
-        // handle arguments later
+        auto callNode = new ASTCallNode(name);
+        while (m_lexar.peek().readType() != TokenType::CLOSE_PAREN && m_lexar.peek().readType() != TokenType::END_OF_FILE) {
+            if (callNode->readArguments().empty() == false) {
+                auto [comma, comma_token] = m_lexar.popExpect(TokenType::COMMA);
+                if (comma == false) {
+                    delete callNode;
+                    ParserError error{  .code = ErrorCode::SYNTAX_ERROR_PARENTHESIS_MISSMATCH,
+                                        .position = comma_token.readPosition(),
+                                        .additionalInfo = "Expected comma or closing parenthesis for function call"};
+                    return error;
+                }
+            }
+
+            auto argument_result = parseComparisonExpression();
+            auto argument_ptr = std::get_if<ASTBaseNode*>(&argument_result);
+            if (argument_ptr == nullptr || *argument_ptr == nullptr) {
+                delete callNode;
+                if (argument_ptr == nullptr)
+                    return std::get<ParserError>(argument_result);
+                ParserError error{  .code = ErrorCode::SYNTAX_ERROR_EXPECTED_EXPRESSION,
+                                    .position = m_lexar.peek().readPosition(),
+                                    .additionalInfo = fmt::format("Expected argument expression in call to {}", name)};
+                return error;
+            }
+            callNode->addArgument(*argument_ptr);
+        }
         auto [success, result] = m_lexar.popExpect(TokenType::CLOSE_PAREN);
         if (success == false) {
+            delete callNode;
             ParserError error{  .code = ErrorCode::SYNTAX_ERROR_PARENTHESIS_MISSMATCH,
                                 .position = result.readPosition(),
                                 .additionalInfo = "Expected closing parenthesis for function call"};
             return error;
         }
-        return new ASTCallNode(name);
+        return callNode;
     }
     else if (token.readOperator() == OperatorType::INCREMENT) {
         m_lexar.pop();
@@ -409,7 +435,18 @@ Parser::parseFunctionStatement() {
     auto functionNode = new ASTFunctionNode(name);
 
     m_lexar.popExpect(TokenType::OPEN_PAREN);
-    // handle parameters later
+    while (m_lexar.peek().readType() != TokenType::CLOSE_PAREN && m_lexar.peek().readType() != TokenType::END_OF_FILE) {
+        bool separated = functionNode->readParameters().empty() || m_lexar.popExpect(TokenType::COMMA).first;
+        auto [parameter, parameter_token] = m_lexar.popExpect(TokenType::IDENTIFIER);
+        if (separated == false || parameter == false) {
+            delete functionNode;
+            ParserError error{  .code = ErrorCode::SYNTAX_ERROR_EXPECTED_IDENTIFIER,
+                                .position = parameter_token.readPosition(),
+                                .additionalInfo = fmt::format("Expected parameter name in function {}", name)};
+            return error;
+        }
+        functionNode->addParameter(parameter_token.readValue());
+    }
     m_lexar.popExpect(TokenType::CLOSE_PAREN);
 
     parseScopeNode(functionNode);
@@ -0,0 +1,214 @@
+#include "register_allocator.hpp"
+
+#include <algorithm>
+
+#include "ast.hpp"
+
+using namespace ciph;
+
+RegisterAllocator::RegisterAllocator(const ASTScopeNode* body)
+    : m_body(body) {}
+
+void
+RegisterAllocator::allocate() {
+    m_position = 0;
+    m_ranges.clear();
+    m_loops.clear();
+    m_uses.clear();
+    m_rangeOf.clear();
+    m_positions.clear();
+    if (m_body->readType() == ASTNodeType::FUNCTION) {
+        const auto* functionNode = static_cast<const ASTFunctionNode*>(m_body);
+        const std::vector<std::string>& parameters = functionNode->readParameters();
+        for (size_t index = 0; index < parameters.size(); index++) {
+            if (m_rangeOf.contains(parameters[index]))
+                continue;
+            define(parameters[index], 0);
+            if (index < register_parameters) {
+                m_ranges.back().reg = static_cast<registers::def>(+registers::def::r0 + index);
+                m_ranges.back().fixed = true;
+            }
+        }
+    }
+    numberScope(m_body, 0);
+
+    for (LiveRange& range : m_ranges) {
+        for (uint16_t position : m_uses[range.name])
+            range.end = std::max(range.end, position);
+        // the next iteration reads what this one left, a local from before the loop outlives it.
+        for (const Loop& loop : m_loops) {
+            if (range.start >= loop.start)
+                continue;
+            const std::vector<uint16_t>& uses = m_uses[range.name];
+            bool usedInside = std::any_of(uses.begin(), uses.end(), [&](uint16_t position) {
+                return position >= loop.start && position <= loop.end;
+            });
+            if (usedInside)
+                range.end = std::max(range.end, loop.end);
+        }
+    }
+
+    // ranges are numbered in the order their lets are, so by start already.
+    std::vector<LiveRange*> active;
+    for (LiveRange& range : m_ranges) {
+        std::erase_if(active, [&](const LiveRange* live) { return live->end < range.start; });
+
+        if (range.fixed) {
+            active.push_back(&range);
+            continue;
+        }
+        if (active.size() < local_registers) {
+            for (uint8_t reg = +registers::def::r0; reg <= +registers::def::r6; reg++) {
+                bool taken = std::any_of(active.begin(), active.end(), [&](const LiveRange* live) {
+                    return +live->reg.value() == reg;
+                });
+                if (taken == false) {
+                    range.reg = static_cast<registers::def>(reg);
+                    break;
+                }
+            }
+            active.push_back(&range);
+            continue;
+        }
+
+        // spill the coldest, the one that stays live longest when they are as hot.
+        auto coldest = std::min_element(active.begin(), active.end(), [](const LiveRange* a, const LiveRange* b) {
+            if (a->fixed != b->fixed)
+                return b->fixed;
+            return a->weight < b->weight || (a->weight == b->weight && a->end > b->end);
+        });
+        if ((*coldest)->fixed)
+            continue;
+        LiveRange* spilled = *coldest;
+        if (range.weight < spilled->weight || (range.weight == spilled->weight && range.end >= spilled->end))
+            continue;
+
+        range.reg = spilled->reg;
+        spilled->reg = std::nullopt;
+        *coldest = &range;
+    }
+}
+
+std::optional<registers::def>
+RegisterAllocator::registerOf(const std::string& name) const {
+    if (auto range = m_rangeOf.find(name); range != m_rangeOf.end())
+        return m_ranges[range->second].reg;
+    return std::nullopt;
+}
+
+std::optional<uint16_t>
+RegisterAllocator::positionOf(const ASTBaseNode* node) const {
+    if (auto position = m_positions.find(node); position != m_positions.end())
+        return position->second;
+    return std::nullopt;
+}
+
+std::vector<registers::def>
+RegisterAllocator::liveAt(uint16_t position) const {
+    std::vector<registers::def> live;
+    for (const LiveRange& range : m_ranges) {
+        if (range.reg.has_value() && range.start <= position && position <= range.end)
+            live.push_back(range.reg.value());
+    }
+    return live;
+}
+
+std::vector<registers::def>
+RegisterAllocator::liveAfter(uint16_t position) const {
+    std::vector<registers::def> live;
+    for (const LiveRange& range : m_ranges) {
+        if (range.reg.has_value() && range.start <= position && position < range.end)
+            live.push_back(range.reg.value());
+    }
+    return live;
+}
+
+void
+RegisterAllocator::numberScope(const ASTScopeNode* node, uint8_t depth) {
+    for (const ASTBaseNode* statement : node->readStatements()) {
+        switch (statement->readType()) {
+            case ASTNodeType::FUNCTION: {
+                break;
+            }
+            case ASTNodeType::LET: {
+                const auto* letNode = static_cast<const ASTLetNode*>(statement);
+                uint16_t position = next(statement);
+                numberExpression(letNode->readExpression(), position, depth);
+                define(letNode->readIdentifier(), position);
+                break;
+            }
+            case ASTNodeType::RETURN: {
+                const auto* returnNode = static_cast<const ASTReturnNode*>(statement);
+                numberExpression(returnNode->readExpression(), next(statement), depth);
+                break;
+            }
+            case ASTNodeType::WHILE: {
+                const auto* whileNode = static_cast<const ASTWhileNode*>(statement);
+                Loop loop{ m_position, 0 };
+                numberScope(whileNode, static_cast<uint8_t>(depth + 1));
+                const ASTBaseNode* condition = whileNode->readCondition();
+                loop.end = next(condition);
+                numberExpression(condition, loop.end, static_cast<uint8_t>(depth + 1));
+                m_loops.push_back(loop);
+                break;
+            }
+            default: {
+                numberExpression(statement, next(statement), depth);
+                break;
+            }
+        }
+    }
+}
+
+void
+RegisterAllocator::numberExpression(const ASTBaseNode* node, uint16_t position, uint8_t depth) {
+    switch (node->readType()) {
+        case ASTNodeType::IDENTIFIER: {
+            use(static_cast<const ASTIdentifierNode*>(node)->readName(), position, depth);
+            break;
+        }
+        case ASTNodeType::BINARY_EXPRESSION: {
+            const auto* binaryNode = static_cast<const ASTBinaryExpressionNode*>(node);
+            numberExpression(binaryNode->readLeft(), position, depth);
+            numberExpression(binaryNode->readRight(), position, depth);
+            break;
+        }
+        case ASTNodeType::COMPARISON_EXPRESSION: {
+            const auto* comparisonNode = static_cast<const ASTComparisonExpressionNode*>(node);
+            numberExpression(comparisonNode->readLeft(), position, depth);
+            numberExpression(comparisonNode->readRight(), position, depth);
+            break;
+        }
+        case ASTNodeType::CALL_EXPRESSION: {
+            for (const ASTBaseNode* argument : static_cast<const ASTCallNode*>(node)->readArguments())
+                numberExpression(argument, position, depth);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+void
+RegisterAllocator::define(const std::string& name, uint16_t position) {
+    if (m_rangeOf.contains(name))
+        return; // redefinitions are rejected by the code generator.
+    m_rangeOf.emplace(name, m_ranges.size());
+    m_ranges.push_back(LiveRange{ name, position, position, 0, std::nullopt });
+}
+
+void
+RegisterAllocator::use(const std::string& name, uint16_t position, uint8_t depth) {
+    auto range = m_rangeOf.find(name);
+    if (range == m_rangeOf.end())
+        return;
+    m_uses[name].push_back(position);
+    m_ranges[range->second].weight += 1u << (3 * std::min<uint8_t>(depth, 8));
+}
+
+uint16_t
+RegisterAllocator::next(const ASTBaseNode* node) {
+    m_positions[node] = m_position;
+    return m_position++;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+namespace ciph {
+
+/*
+ * How a 16-bit word is laid out in bytes, defined once for the VM, the code generator and the
+ * disassembler. Words in VM memory, the stack, are little endian. Operands in bytecode are big
+ * endian, the format CodeGenerator writes and every hand written program is spelled in.
+ *
+ * Every access is a two byte memcpy, swapped only when the host order differs, which compiles to
+ * a single 16-bit load or store and, for operands on a little endian host, a rotate. No alignment
+ * is assumed. The register file is accessed as plain uint16_t and so is in host order. */
+namespace byte_order {
+
+constexpr std::endian memory = std::endian::little;
+constexpr std::endian operand = std::endian::big;
+
+constexpr uint16_t
+swap(uint16_t value) {
+	return static_cast<uint16_t>((value << 8) | (value >> 8));
+}
+
+template <std::endian Order>
+inline uint16_t
+load(const uint8_t* bytes) {
+	uint16_t value;
+	std::memcpy(&value, bytes, sizeof(value));
+	if constexpr (Order != std::endian::native)
+		value = swap(value);
+	return value;
+}
+
+template <std::endian Order>
+inline void
+store(uint8_t* bytes, uint16_t value) {
+	if constexpr (Order != std::endian::native)
+		value = swap(value);
+	std::memcpy(bytes, &value, sizeof(value));
+}
+
+// Word of VM memory starting at bytes.
+inline int16_t
+load_word(const uint8_t* bytes) {
+	return static_cast<int16_t>(load<memory>(bytes));
+}
+
+inline void
+store_word(uint8_t* bytes, int16_t value) {
+	store<memory>(bytes, static_cast<uint16_t>(value));
+}
+
+// Bytecode operand starting at bytes.
+inline int16_t
+load_operand(const uint8_t* bytes) {
+	return static_cast<int16_t>(load<operand>(bytes));
+}
+
+inline void
+store_operand(uint8_t* bytes, int16_t value) {
+	store<operand>(bytes, static_cast<uint16_t>(value));
+}
+
+} // namespace byte_order
+} // namespace ciph
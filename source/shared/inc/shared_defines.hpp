@@ -41,6 +41,7 @@ enum class def : uint8_t {
 	POP_REG	=		0x40, 	// Pops top of stack to given register.
 	PEK_REG	=		0x50, 	// Copies top value of stack into given register
 	PEK_OFF	=		0x51, 	// Copies value of stack at offset into given register
+	PEK_ARG	=		0x52,	// Copies stack argument n of the current call into given register, pushes it if reg:sp. Argument 0 is the word under the return address.
 	
 	// Control flow instructions
 	JMP	 	=		0xC0, 	// Unconditionally jump to address.
@@ -48,12 +49,27 @@ enum class def : uint8_t {
 	JEQ 	=		0xC2,  	// Jump to address if imm is zero.
 	JGT 	=		0xC3,  	// Jump to address if imm is positive.
 	JLT 	=		0xC4,  	// Jump to address if imm is negative.
+	CALL	=		0xC5,	// Pushes the return address and fp, points fp at sp and jumps to address, counted from the start of the program.
 	CMP 	= 		0xCC, 	// Subtracts rX from rY and puts result in imm, if reg:sp is passed as rX we pop the compared elements from the stack
-	RET	 	=		0xCF, 	// Returns value in imm.
+	RET	 	=		0xCF, 	// Returns to the caller and restores its fp and sp, outside of any call ends the program with the value in ret.
 	HALT	=		0xFE, 	// Terminates the program.
  
 	// Other instructions
-	NOP	 	=		0x00  	// No operation instruction, program counter should just tick pass this.
+	NOP	 	=		0x00,  	// No operation instruction, program counter should just tick pass this.
+
+	// Superinstructions, VM internal. Produced by the decoder's fusion pass and never present in bytecode.
+	ADD_OFF	=		0x60,	// PEK_OFF sp, n; PEK_OFF sp, m; ADD. Pushes the sum of the two stack values.
+	SUB_OFF	=		0x61,	// PEK_OFF sp, n; PEK_OFF sp, m; SUB.
+	MUL_OFF	=		0x62,	// PEK_OFF sp, n; PEK_OFF sp, m; MUL.
+	DIV_OFF	=		0x63,	// PEK_OFF sp, n; PEK_OFF sp, m; DIV.
+	JLT_OFF	=		0x64,	// PEK_OFF sp, n; PSH_LIT lit; CMP sp; JLT. Loop condition, leaves the difference in imm.
+
+	// Quickened forms, VM internal. The decoder specializes PEK_OFF, INC and DEC on their register operand,
+	// literal holds the frame displacement n * 2 + 2 instead of the offset n.
+	PEK_LOC	=		0x65,	// PEK_OFF sp, n. Pushes the stack value at fp + displacement.
+	PEK_LOC_REG =	0x66,	// PEK_OFF rX, n for any rX but sp. Copies the stack value at fp + displacement into rX.
+	INC_LOC	=		0x67,	// INC sp, n. Increments the stack value at fp + displacement.
+	DEC_LOC	=		0x68	// DEC sp, n.
 };
 
 const std::unordered_map<def, std::string> mnemonics = {
@@ -80,9 +96,11 @@ const std::unordered_map<def, std::string> mnemonics = {
 	{def::POP_REG, "POP"},
 	{def::PEK_REG, "PEK"},
 	{def::PEK_OFF, "PEK"},
+	{def::PEK_ARG, "PEK"},
 	{def::JMP, "JMP"},
 	{def::JNZ, "JNZ"},
 	{def::JLT, "JLT"},
+	{def::CALL, "CALL"},
 	{def::CMP, "CMP"},
 	{def::RET, "RET"},
 	{def::NOP, "NOP"}
@@ -101,6 +119,7 @@ enum class def : uint8_t {
     r5,
     r6 = 0x07,
     ret = 0x08,
+    cd = 0x09,      // call depth, frames CALL entered that RET hasn't left yet.
     sp = 0x0A,
     fp = 0x0B,
     bp = 0x0E,
@@ -118,6 +137,7 @@ const std::unordered_map<def, std::string> name = {
 	{ def::r5, "r5" },
 	{ def::r6, "r6" },
 	{ def::ret, "ret" },
+	{ def::cd, "cd" },
 	{ def::sp, "sp" },
 	{ def::fp, "fp" },
 	{ def::bp, "bp" },
@@ -126,11 +146,11 @@ const std::unordered_map<def, std::string> name = {
 
 } // namespace register
 
-inline uint8_t operator+(registers::def reg) {
+constexpr uint8_t operator+(registers::def reg) {
     return static_cast<uint8_t>(reg);
 }
 
-inline uint8_t operator+(instruction::def i)	{
+constexpr uint8_t operator+(instruction::def i)	{
 	return static_cast<uint8_t>(i);
 }
 
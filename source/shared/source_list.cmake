@@ -7,6 +7,7 @@ ${SHARED_SRC_DIR}/disassembler.cpp
 )
 
 set(SHARED_INC ${SHARED_INC}
+${SHARED_INC_DIR}/byte_order.hpp
 ${SHARED_INC_DIR}/shared_defines.hpp
 ${SHARED_INC_DIR}/disassembler.hpp
 )
@@ -1,4 +1,5 @@
 #include "disassembler.hpp"
+#include "byte_order.hpp"
 #include "shared_defines.hpp"
 #include <fmt/core.h>
 
@@ -7,43 +8,76 @@ using namespace ciph;
 std::string Disassembler::disassembleInstruction(size_t& program_count) const
 {
     auto instr = static_cast<instruction::def>(m_program[program_count]);
-    std::string result = fmt::format("{} ", instruction::mnemonics.at(instr));
+    // the decoder's own opcodes have no mnemonic, they never appear in bytecode.
+    auto mnemonic = instruction::mnemonics.find(instr);
+    std::string result = fmt::format("{} ", mnemonic != instruction::mnemonics.end() ? mnemonic->second : "??");
     switch (instr)
     {
         case instruction::def::JLT:
+        case instruction::def::CALL:
         case instruction::def::PSH_LIT:
+        case instruction::def::PUT_LIT:
+        case instruction::def::MOV_MEM:
+        case instruction::def::PSH_MEM:
             result += dissassembleNumericLiteral(program_count);
             break;
         case instruction::def::INC:
         case instruction::def::DEC:
+            // only the stack form has an offset, a register is incremented in place.
+            if (m_program[program_count + 1] != +registers::def::sp) {
+                result += dissassembleReg(program_count);
+                break;
+            }
+            [[fallthrough]];
         case instruction::def::PEK_OFF:
             result += dissassembleReg(program_count);
             result += ", [sp + ";
             result += disassembleOffset(program_count);
             result += "]";
             break;
+        case instruction::def::PEK_ARG:
+            result += dissassembleReg(program_count);
+            result += ", [arg ";
+            result += disassembleOffset(program_count);
+            result += "]";
+            break;
             
+        case instruction::def::PSH_REG:
         case instruction::def::POP_REG:
         case instruction::def::PEK_REG:
+        case instruction::def::PUT_REG:
             result += dissassembleReg(program_count);
             break;            
         case instruction::def::MOV:
+        case instruction::def::ADD_REG:
+        case instruction::def::SUB_REG:
+        case instruction::def::MUL_REG:
+        case instruction::def::DIV_REG:
             result += dissassembleReg(program_count);
             result += ", " + dissassembleReg(program_count);
             break;
         case instruction::def::CMP:
             disassembleInstructionWithOptionalReg(program_count);
             break;
-
+        case instruction::def::ADD_OFF:
+        case instruction::def::SUB_OFF:
+        case instruction::def::MUL_OFF:
+        case instruction::def::DIV_OFF:
+        case instruction::def::JLT_OFF:
+        case instruction::def::PEK_LOC:
+        case instruction::def::PEK_LOC_REG:
+        case instruction::def::INC_LOC:
+        case instruction::def::DEC_LOC:
+        default:
+            break;
     }
     return result += "\n";
 
 }
 std::string Disassembler::dissassembleNumericLiteral(size_t& program_count) const
 {
-    int16_t value = 0;
-    value = (value << 8) | m_program[++program_count];
-    value = (value << 8) | m_program[++program_count];
+    int16_t value = byte_order::load_operand(&m_program[program_count + 1]);
+    program_count += 2;
     return fmt::format("{}", value);
 }
 
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "batch_lanes.hpp"
+#include "decoder.hpp"
+#include "execution_context.hpp"
+
+namespace ciph {
+namespace batch {
+
+// Values of r0 to r6 one instance starts with, the other registers start as load_program leaves them.
+using inputs = std::array<int16_t, 7>;
+
+enum class backend : uint8_t {
+	avx2,		// one AVX2 register per lane_vector, only when the host CPU has it.
+	scalar,		// the same lockstep loop over plain arrays.
+};
+
+struct result {
+	std::vector<int16_t> return_values;
+	std::vector<trap_code> traps;
+	// Instances the lockstep loop gave up on and ran on a ProcessingUnit instead.
+	size_t fallbacks = 0;
+};
+
+// True if the AVX2 lanes were built and the host CPU supports them.
+bool avx2_supported();
+
+} // namespace batch
+
+/*
+ * Runs one program over many independent instances, batch::width at a time in lockstep. Each
+ * instance has its own registers and stack, stored lane by lane so one vector instruction
+ * executes an opcode for every instance in the group. sp, fp, bp and pc stay shared by the lanes
+ * running together, a JLT that goes both ways splits the group and the lanes at the lowest
+ * instruction run first until they catch up with the others and merge again.
+ *
+ * Anything the lockstep loop can't express, a write to sp, fp, bp or pc, a stack access outside
+ * the stack or a division by zero, sends the instance to a fresh ProcessingUnit, which runs it
+ * from the start. Results, traps included, are the same as execute() on one ProcessingUnit per
+ * instance. */
+class BatchExecutor {
+public:
+	BatchExecutor();
+	// m_state points into the executor's own buffers.
+	BatchExecutor(const BatchExecutor&) = delete;
+	BatchExecutor& operator=(const BatchExecutor&) = delete;
+
+	void load_program(uint8_t* program, uint16_t size);
+
+	// Picks the lanes, avx2 falls back to scalar on hosts without it.
+	void set_backend(batch::backend backend);
+	batch::backend backend() const {
+		return m_backend;
+	}
+
+	// instances runs of the program, all starting with r0 to r6 zero.
+	batch::result execute(size_t instances);
+	batch::result execute(const std::vector<batch::inputs>& inputs);
+
+private:
+	void run_group(const batch::inputs* inputs, size_t count, size_t first, batch::result& out);
+	int16_t fallback(const batch::inputs& input, trap_code& trap) const;
+
+	std::shared_ptr<const std::vector<uint8_t>> m_bytes;
+	decoded_program m_program;
+	std::array<uint16_t, +registers::def::reg_cnt> m_initial{};
+	uint16_t m_entry = decoded_program::halt;
+
+	std::vector<batch::lane_vector> m_registers;
+	std::vector<batch::lane_vector> m_stack;
+	batch::lane_state m_state;
+	batch::backend m_backend = batch::backend::scalar;
+};
+
+} // namespace ciph
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <shared_defines.hpp>
+
+#include "decoder.hpp"
+#include "execution_context.hpp"
+
+// The AVX2 lanes live in batch_avx2.cpp, compiled for AVX2 on x86-64 GCC and Clang only.
+#if defined(CIPH_VM_AVX2) && (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#define CIPH_HAS_AVX2 1
+#else
+#define CIPH_HAS_AVX2 0
+#endif
+
+namespace ciph {
+namespace batch {
+
+// int16_t lanes in one AVX2 register, instances run in groups of this many.
+constexpr size_t width = 16;
+
+// One VM word for every lane of a group.
+struct alignas(32) lane_vector {
+	int16_t lane[width];
+};
+
+/*
+ * Everything the lockstep loop works on for one group, owned by BatchExecutor. Lane masks are
+ * bit sets, bit i is lane i. */
+struct lane_state {
+	lane_vector* registers = nullptr;	// reg_cnt entries, sp, fp, bp and pc are not used.
+	lane_vector* stack = nullptr;		// stack[i] is the word at fp + i * 2.
+	uint16_t capacity = 0;				// stack slots that fit in VM memory.
+	uint16_t dirty = 0;					// slots written since the stack was last cleared.
+
+	// The shared registers, as load_program sets them.
+	uint16_t fp = 0;
+	uint16_t bp = 0;
+	uint16_t pc = 0;
+	uint16_t entry = 0;					// decoded instruction pc points at.
+
+	uint16_t live = 0;					// lanes holding an instance.
+	uint16_t bailed = 0;				// lanes to run again on a ProcessingUnit.
+	int16_t return_values[width] = {};
+	trap_code traps[width] = {};
+};
+
+// Runs the live lanes of state to completion on the portable lanes.
+void run_scalar(const decoded_instruction* code, lane_state& state);
+
+#if CIPH_HAS_AVX2
+// Same on AVX2 registers, only call when avx2_supported().
+void run_avx2(const decoded_instruction* code, lane_state& state);
+#endif
+
+} // namespace batch
+} // namespace ciph
@@ -0,0 +1,392 @@
+#pragma once
+
+#include "batch_lanes.hpp"
+
+namespace ciph {
+namespace batch {
+
+/*
+ * The lockstep loop, written once against a set of lane operations. Every operation writes only
+ * the lanes set in mask, a lane_vector of 0 or -1 per lane, so lanes waiting elsewhere in the
+ * program keep their registers and stack. */
+template <typename Lanes>
+class LaneMachine {
+public:
+	LaneMachine(const decoded_instruction* code, lane_state& state)
+		: m_code(code)
+		, m_state(state)
+	{}
+
+	void run() {
+		for (size_t lane = 0; lane < width; lane++) {
+			m_ip_of[lane] = m_state.entry;
+			m_depth_of[lane] = 0;
+		}
+		m_waiting = m_state.live;
+		Lanes::mask(0xFFFF, m_all);
+
+		while (schedule()) {
+			do {
+				execute(m_code[m_ip]);
+			} while (m_active != 0 && m_ip < m_next);
+			park(m_active);
+		}
+	}
+
+private:
+	using def = instruction::def;
+
+	// Picks the waiting lanes at the lowest instruction that share a stack depth, false once none are left.
+	bool schedule() {
+		if (m_waiting == 0)
+			return false;
+
+		uint16_t ip = decoded_program::halt;
+		uint16_t depth = 0;
+		for (size_t lane = 0; lane < width; lane++) {
+			if ((m_waiting >> lane & 1) && m_ip_of[lane] < ip) {
+				ip = m_ip_of[lane];
+				depth = m_depth_of[lane];
+			}
+		}
+
+		uint16_t group = 0;
+		m_next = decoded_program::halt;
+		for (size_t lane = 0; lane < width; lane++) {
+			if ((m_waiting >> lane & 1) == 0)
+				continue;
+			if (m_ip_of[lane] == ip && m_depth_of[lane] == depth)
+				group |= static_cast<uint16_t>(1u << lane);
+			else if (m_ip_of[lane] < m_next)
+				m_next = m_ip_of[lane];
+		}
+
+		m_waiting &= static_cast<uint16_t>(~group);
+		m_ip = ip;
+		m_depth = depth;
+		activate(group);
+		return true;
+	}
+
+	void park(uint16_t lanes) {
+		for (size_t lane = 0; lane < width; lane++) {
+			if (lanes >> lane & 1) {
+				m_ip_of[lane] = m_ip;
+				m_depth_of[lane] = m_depth;
+			}
+		}
+		m_waiting |= lanes;
+		m_active = 0;
+	}
+
+	void activate(uint16_t lanes) {
+		m_active = lanes;
+		if (lanes != 0)
+			Lanes::mask(lanes, m_mask);
+	}
+
+	// The lanes leave the lockstep loop and run again on their own.
+	void bail(uint16_t lanes) {
+		m_state.bailed |= lanes;
+		activate(m_active & static_cast<uint16_t>(~lanes));
+	}
+
+	void finish(trap_code trap) {
+		for (size_t lane = 0; lane < width; lane++) {
+			if (m_active >> lane & 1) {
+				m_state.traps[lane] = trap;
+				if (trap == trap_code::none)
+					m_state.return_values[lane] = m_state.registers[+registers::def::ret].lane[lane];
+			}
+		}
+		m_active = 0;
+	}
+
+	static bool shared(uint8_t reg) {
+		return reg == +registers::def::sp || reg == +registers::def::fp || reg == +registers::def::bp
+			|| reg == +registers::def::pc;
+	}
+
+	// Register as a source operand, the shared ones are broadcast.
+	const lane_vector* get(uint8_t reg) {
+		if (reg >= +registers::def::reg_cnt)
+			return nullptr;
+		if (shared(reg) == false)
+			return &m_state.registers[reg];
+
+		uint16_t value = m_state.pc;
+		if (reg == +registers::def::sp)
+			value = u16(m_state.fp + m_depth * 2);
+		else if (reg == +registers::def::fp)
+			value = m_state.fp;
+		else if (reg == +registers::def::bp)
+			value = m_state.bp;
+		Lanes::fill(m_scratch, i16(value), m_all);
+		return &m_scratch;
+	}
+
+	// Register as a destination, nullptr for the shared ones.
+	lane_vector* target(uint8_t reg) {
+		if (reg >= +registers::def::reg_cnt || shared(reg))
+			return nullptr;
+		return &m_state.registers[reg];
+	}
+
+	// Stack word at slot, nullptr outside the stack.
+	lane_vector* slot(int32_t index) {
+		if (index < 0 || index >= m_state.capacity)
+			return nullptr;
+		return &m_state.stack[index];
+	}
+
+	// Word a push writes to, sp is only moved once the value is in place.
+	lane_vector* top() {
+		if (m_depth >= m_state.capacity)
+			return nullptr;
+		if (m_depth + 1 > m_state.dirty)
+			m_state.dirty = static_cast<uint16_t>(m_depth + 1);
+		return &m_state.stack[m_depth];
+	}
+
+	void arithmetic(def op, lane_vector& dst, const lane_vector& a, const lane_vector& b) {
+		switch (op) {
+			case def::ADD:
+				Lanes::add(dst, a, b, m_mask);
+				break;
+			case def::SUB:
+				Lanes::sub(dst, a, b, m_mask);
+				break;
+			case def::MUL:
+				Lanes::mul(dst, a, b, m_mask);
+				break;
+			default: {
+				// no vector division for 16 bit lanes, a lane with a zero divisor reruns alone and traps there.
+				uint16_t zero = Lanes::zero(b) & m_active;
+				if (zero != 0)
+					bail(zero);
+				for (size_t lane = 0; lane < width; lane++) {
+					if (m_active >> lane & 1)
+						dst.lane[lane] = i16(a.lane[lane] / b.lane[lane]);
+				}
+				break;
+			}
+		}
+	}
+
+	// ADD..DIV for the _OFF and _REG forms.
+	static def base_op(def op) {
+		switch (op) {
+			case def::ADD_OFF:
+			case def::ADD_REG:
+				return def::ADD;
+			case def::SUB_OFF:
+			case def::SUB_REG:
+				return def::SUB;
+			case def::MUL_OFF:
+			case def::MUL_REG:
+				return def::MUL;
+			default:
+				return def::DIV;
+		}
+	}
+
+	void branch(const lane_vector& condition, uint16_t target) {
+		uint16_t taken = Lanes::negative(condition) & m_active;
+		if (taken == m_active) {
+			m_ip = target;
+			return;
+		}
+		if (taken == 0) {
+			m_ip++;
+			return;
+		}
+
+		uint16_t fallthrough = static_cast<uint16_t>(m_ip + 1);
+		uint16_t others = m_active & static_cast<uint16_t>(~taken);
+		m_ip = target;
+		park(taken);
+		m_ip = fallthrough;
+		park(others);
+	}
+
+	void execute(const decoded_instruction& instr) {
+		lane_vector& imm = m_state.registers[+registers::def::imm];
+		switch (instr.opcode) {
+			case def::PSH:
+			case def::PSH_REG:
+			case def::PSH_LIT: {
+				lane_vector* dst = top();
+				if (dst == nullptr)
+					return bail(m_active);
+				if (instr.opcode == def::PSH_LIT) {
+					Lanes::fill(*dst, instr.literal, m_mask);
+				}
+				else {
+					const lane_vector* src = get(instr.opcode == def::PSH ? +registers::def::imm : instr.reg_a);
+					if (src == nullptr)
+						return bail(m_active);
+					Lanes::copy(*dst, *src, m_mask);
+				}
+				m_depth++;
+				break;
+			}
+			case def::ADD:
+			case def::SUB:
+			case def::MUL:
+			case def::DIV: {
+				if (m_depth < 2)
+					return bail(m_active);
+				lane_vector& a = m_state.stack[m_depth - 2];
+				arithmetic(instr.opcode, a, a, m_state.stack[m_depth - 1]);
+				m_depth--;
+				break;
+			}
+			case def::ADD_REG:
+			case def::SUB_REG:
+			case def::MUL_REG:
+			case def::DIV_REG: {
+				lane_vector* dst = target(instr.reg_a);
+				const lane_vector* b = get(instr.reg_b);
+				if (dst == nullptr || b == nullptr)
+					return bail(m_active);
+				arithmetic(base_op(instr.opcode), *dst, *dst, *b);
+				break;
+			}
+			case def::POP_REG: {
+				lane_vector* dst = target(instr.reg_a);
+				if (dst == nullptr || m_depth == 0)
+					return bail(m_active);
+				m_depth--;
+				Lanes::copy(*dst, m_state.stack[m_depth], m_mask);
+				break;
+			}
+			case def::PEK_REG: {
+				lane_vector* dst = target(instr.reg_a);
+				if (dst == nullptr || m_depth == 0)
+					return bail(m_active);
+				Lanes::copy(*dst, m_state.stack[m_depth - 1], m_mask);
+				break;
+			}
+			case def::PEK_OFF:
+			case def::PEK_LOC:
+			case def::PEK_LOC_REG: {
+				int32_t index = instr.opcode == def::PEK_OFF ? instr.literal : (instr.literal - 2) / 2;
+				const lane_vector* src = slot(index);
+				bool push = instr.opcode == def::PEK_LOC || (instr.opcode == def::PEK_OFF && instr.reg_a == +registers::def::sp);
+				lane_vector* dst = push ? top() : target(instr.reg_a);
+				if (src == nullptr || dst == nullptr || (instr.opcode != def::PEK_OFF && (instr.literal & 1)))
+					return bail(m_active);
+				Lanes::copy(*dst, *src, m_mask);
+				if (push)
+					m_depth++;
+				break;
+			}
+			case def::INC:
+			case def::DEC:
+			case def::INC_LOC:
+			case def::DEC_LOC: {
+				int16_t delta = instr.opcode == def::INC || instr.opcode == def::INC_LOC ? 1 : -1;
+				bool local = instr.opcode == def::INC_LOC || instr.opcode == def::DEC_LOC;
+				int32_t index = local ? (instr.literal - 2) / 2 : instr.literal;
+				lane_vector* dst = nullptr;
+				if (local || instr.reg_a == +registers::def::sp) {
+					dst = local && (instr.literal & 1) ? nullptr : slot(index);
+					if (dst != nullptr && index >= m_state.dirty)
+						m_state.dirty = static_cast<uint16_t>(index + 1);
+				}
+				else {
+					dst = target(instr.reg_a);
+				}
+				if (dst == nullptr)
+					return bail(m_active);
+				Lanes::add(*dst, *dst, delta, m_mask);
+				break;
+			}
+			case def::CMP: {
+				if (instr.reg_a == +registers::def::sp) {
+					if (m_depth < 2)
+						return bail(m_active);
+					Lanes::sub(imm, m_state.stack[m_depth - 2], m_state.stack[m_depth - 1], m_mask);
+					m_depth = static_cast<uint16_t>(m_depth - 2);
+				}
+				break;
+			}
+			case def::MOV:
+			case def::PUT_REG: {
+				lane_vector* dst = target(instr.reg_a);
+				const lane_vector* src = get(instr.opcode == def::MOV ? instr.reg_b : +registers::def::imm);
+				if (dst == nullptr || src == nullptr)
+					return bail(m_active);
+				Lanes::copy(*dst, *src, m_mask);
+				break;
+			}
+			case def::PUT_LIT:
+				Lanes::fill(imm, instr.literal, m_mask);
+				break;
+			case def::MOV_MEM:
+			case def::PSH_MEM:
+				// lanes only hold their stack and registers, memory operands run on their own.
+				return bail(m_active);
+			case def::JEQ:
+			case def::JNZ:
+			case def::JGT:
+				break;
+			case def::JLT:
+				return branch(imm, instr.target);
+			case def::ADD_OFF:
+			case def::SUB_OFF:
+			case def::MUL_OFF:
+			case def::DIV_OFF: {
+				const lane_vector* a = slot(instr.reg_a);
+				// the second peek reads the slot the first one would have been pushed to.
+				const lane_vector* b = instr.reg_b == m_depth ? a : slot(instr.reg_b);
+				lane_vector* dst = top();
+				if (a == nullptr || b == nullptr || dst == nullptr)
+					return bail(m_active);
+				arithmetic(base_op(instr.opcode), *dst, *a, *b);
+				m_depth++;
+				break;
+			}
+			case def::JLT_OFF: {
+				const lane_vector* a = slot(instr.reg_a);
+				if (a == nullptr)
+					return bail(m_active);
+				Lanes::add(imm, *a, i16(-instr.literal), m_mask);
+				return branch(imm, instr.target);
+			}
+			case def::CALL:
+				// lanes only hold the stack of one frame, calls run on their own.
+				return bail(m_active);
+			case def::RET:
+				for (size_t lane = 0; lane < width; lane++) {
+					if ((m_active >> lane & 1) && m_state.registers[+registers::def::cd].lane[lane] != 0)
+						return bail(m_active);
+				}
+				return finish(trap_code::none);
+			default:
+				return finish(trap_code::invalid_instruction);
+		}
+		m_ip++;
+	}
+
+	const decoded_instruction* m_code;
+	lane_state& m_state;
+
+	// The group running now, every lane in it is at m_ip with m_depth words on its stack.
+	uint16_t m_active = 0;
+	uint16_t m_ip = 0;
+	uint16_t m_depth = 0;
+	lane_vector m_mask{};
+
+	// Lanes parked at another instruction or depth, m_next is the lowest instruction among them.
+	uint16_t m_waiting = 0;
+	uint16_t m_next = decoded_program::halt;
+	uint16_t m_ip_of[width] = {};
+	uint16_t m_depth_of[width] = {};
+
+	lane_vector m_all{};
+	lane_vector m_scratch{};
+};
+
+} // namespace batch
+} // namespace ciph
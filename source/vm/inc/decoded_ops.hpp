@@ -0,0 +1,594 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <byte_order.hpp>
+#include <shared_defines.hpp>
+
+#include "decoder.hpp"
+#include "execution_context.hpp"
+
+namespace ciph {
+namespace instruction {
+
+// Reads the word ending at address, the stack grows towards higher addresses.
+inline int16_t
+read_below(const uint8_t* memory, uint16_t address) {
+	return byte_order::load_word(&memory[u16(address - 2)]);
+}
+
+inline void
+write_below(uint8_t* memory, uint16_t address, int16_t value) {
+	byte_order::store_word(&memory[u16(address - 2)], value);
+}
+
+/*
+ * Register file and stack as the decoded handlers see them, every access goes straight to VM
+ * memory. Used by the out of line handlers behind decoded_instruction::handler. */
+struct context_registers {
+	explicit context_registers(ExecutionContext& ctx)
+		: context(ctx)
+		, memory(ctx.bytecode)
+	{}
+
+	uint16_t get(uint8_t reg) const { return context.registry[reg]; }
+	void set(uint8_t reg, uint16_t value) { context.registry[reg] = value; }
+
+	uint16_t& pc() { return context.registry[+registers::def::pc]; }
+	uint16_t sp() const { return context.registry[+registers::def::sp]; }
+	uint16_t fp() const { return context.registry[+registers::def::fp]; }
+
+	void push(int16_t value) {
+		uint16_t& sp = context.registry[+registers::def::sp];
+		sp = static_cast<uint16_t>(sp + 2);
+		write_below(memory, sp, value);
+	}
+
+	int16_t pop() {
+		uint16_t& sp = context.registry[+registers::def::sp];
+		int16_t value = read_below(memory, sp);
+		sp = static_cast<uint16_t>(sp - 2);
+		return value;
+	}
+
+	// Stack word ending at address.
+	int16_t load(uint16_t address) const { return read_below(memory, address); }
+	void store(uint16_t address, int16_t value) { write_below(memory, address, value); }
+
+	ExecutionContext& context;
+	uint8_t* memory;
+};
+
+/*
+ * context_registers with every stack and memory operand access checked against the end of VM
+ * memory, for programs the verifier couldn't prove stay inside it. An access that would touch a
+ * byte at or past end, or split a word across address 0, raises trap_code::stack_fault and is
+ * dropped, a load then returns 0. The instruction may still have moved sp, the loop stops right
+ * after it. Register operands need no check, the decoder turns one that is out of range into a
+ * trap. */
+struct checked_registers : context_registers {
+	checked_registers(ExecutionContext& ctx, uint32_t memoryEnd)
+		: context_registers(ctx)
+		, end(memoryEnd)
+	{}
+
+	void push(int16_t value) {
+		uint16_t& sp = context.registry[+registers::def::sp];
+		sp = static_cast<uint16_t>(sp + 2);
+		store(sp, value);
+	}
+
+	int16_t pop() {
+		uint16_t& sp = context.registry[+registers::def::sp];
+		int16_t value = load(sp);
+		sp = static_cast<uint16_t>(sp - 2);
+		return value;
+	}
+
+	int16_t load(uint16_t address) {
+		if (inside(address))
+			return read_below(memory, address);
+		context.trap = trap_code::stack_fault;
+		return 0;
+	}
+
+	void store(uint16_t address, int16_t value) {
+		if (inside(address))
+			write_below(memory, address, value);
+		else
+			context.trap = trap_code::stack_fault;
+	}
+
+	uint32_t end;
+
+private:
+	// The word ending at address, one that would wrap around the end of the address space faults too.
+	bool inside(uint16_t address) const {
+		return address >= 2 && address <= end;
+	}
+};
+
+/*
+ * Register file with pc, sp and fp held in locals for the length of a run. Every store to VM
+ * memory goes through a uint8_t pointer which may alias the register file, so reading them
+ * through context.registry forces a reload after each push.
+ *
+ * The top of the stack is cached as well. sp always has its architectural value, but while
+ * m_cached is set the word below sp lives in m_tos and has not been written to memory yet.
+ * A push spills the previous top and a pop takes it back, so a binary op touches memory once
+ * instead of four times. Stack reads and writes through load/store see the cached word, and
+ * anything that moves sp from outside push/pop spills first.
+ *
+ * Nothing is written back until sync(), VM memory and the register file are stale until then. */
+struct local_registers {
+	explicit local_registers(ExecutionContext& ctx)
+		: context(ctx)
+		, memory(ctx.bytecode)
+		, m_pc(ctx.registry[+registers::def::pc])
+		, m_sp(ctx.registry[+registers::def::sp])
+		, m_fp(ctx.registry[+registers::def::fp])
+	{}
+
+	uint16_t get(uint8_t reg) const {
+		if (reg == +registers::def::sp)
+			return m_sp;
+		if (reg == +registers::def::fp)
+			return m_fp;
+		if (reg == +registers::def::pc)
+			return m_pc;
+		return context.registry[reg];
+	}
+
+	void set(uint8_t reg, uint16_t value) {
+		if (reg == +registers::def::sp) {
+			spill();
+			m_sp = value;
+		}
+		else if (reg == +registers::def::fp)
+			m_fp = value;
+		else if (reg == +registers::def::pc)
+			m_pc = value;
+		else
+			context.registry[reg] = value;
+	}
+
+	uint16_t& pc() { return m_pc; }
+	uint16_t sp() const { return m_sp; }
+	uint16_t fp() const { return m_fp; }
+
+	void push(int16_t value) {
+		spill();
+		m_sp = static_cast<uint16_t>(m_sp + 2);
+		m_tos = value;
+		m_cached = true;
+	}
+
+	int16_t pop() {
+		int16_t value = m_cached ? m_tos : read_below(memory, m_sp);
+		m_cached = false;
+		m_sp = static_cast<uint16_t>(m_sp - 2);
+		return value;
+	}
+
+	int16_t load(uint16_t address) {
+		if (m_cached) {
+			if (address == m_sp)
+				return m_tos;
+			if (overlaps_top(address))
+				spill();
+		}
+		return read_below(memory, address);
+	}
+
+	void store(uint16_t address, int16_t value) {
+		if (m_cached) {
+			if (address == m_sp) {
+				m_tos = value;
+				return;
+			}
+			if (overlaps_top(address))
+				spill();
+		}
+		write_below(memory, address, value);
+	}
+
+	// Writes the cached top of stack to memory and the cached registers back to the register file.
+	void sync() {
+		spill();
+		context.registry[+registers::def::pc] = m_pc;
+		context.registry[+registers::def::sp] = m_sp;
+		context.registry[+registers::def::fp] = m_fp;
+	}
+
+	ExecutionContext& context;
+	uint8_t* memory;
+
+private:
+	void spill() {
+		if (m_cached)
+			write_below(memory, m_sp, m_tos);
+		m_cached = false;
+	}
+
+	// A word ending one byte either side of sp shares a byte with the cached one.
+	bool overlaps_top(uint16_t address) const {
+		return address == u16(m_sp + 1) || address == u16(m_sp - 1);
+	}
+
+	uint16_t m_pc;
+	uint16_t m_sp;
+	uint16_t m_fp;
+	int16_t m_tos = 0;
+	bool m_cached = false;
+};
+
+/*
+ * Bodies of the decoded handlers, written once against either register file above. The handlers
+ * in instructions.cpp instantiate them with context_registers, the switch and threaded loops
+ * inline them with local_registers. Semantics match the byte handlers, see instructions.hpp. */
+namespace ops {
+
+// Address one past the stack slot at offset from the frame, same as PEK_OFF computes it.
+template <typename Registers>
+inline uint16_t
+local_address(Registers& regs, int16_t offset) {
+	return static_cast<uint16_t>(regs.fp() + (offset * 2) + 2);
+}
+
+// Address one past a stack slot the quicken pass already turned into a displacement from the frame.
+template <typename Registers>
+inline uint16_t
+frame_address(Registers& regs, int16_t displacement) {
+	return static_cast<uint16_t>(regs.fp() + displacement);
+}
+
+template <typename Registers, typename Op>
+inline uint16_t
+binary_expression(Registers& regs, uint16_t ip, Op op) {
+	int16_t b = regs.pop();
+	int16_t a = regs.pop();
+	regs.push(i16(op(a, b)));
+	return ip + 1;
+}
+
+// rX = rX <op> rY, with rX in reg_a and rY in reg_b.
+template <typename Registers, typename Op>
+inline uint16_t
+register_expression(Registers& regs, const decoded_instruction& instr, uint16_t ip, Op op) {
+	int16_t a = i16(regs.get(instr.reg_a));
+	int16_t b = i16(regs.get(instr.reg_b));
+	regs.set(instr.reg_a, static_cast<uint16_t>(op(a, b)));
+	return ip + 1;
+}
+
+// Slot the second operand of a superinstruction is read from, the first one's when reg_b names the
+// slot the first peek would have been pushed to.
+template <typename Registers>
+inline uint16_t
+second_local_address(Registers& regs, const decoded_instruction& instr) {
+	uint8_t offset = regs.fp() + (instr.reg_b * 2) == regs.sp() ? instr.reg_a : instr.reg_b;
+	return local_address(regs, offset);
+}
+
+/*
+ * Replaces PEK_OFF sp, reg_a; PEK_OFF sp, reg_b; <op>. Only the result is written to the stack. */
+template <typename Registers, typename Op>
+inline uint16_t
+local_binary_expression(Registers& regs, const decoded_instruction& instr, uint16_t ip, Op op) {
+	int16_t a = regs.load(local_address(regs, instr.reg_a));
+	int16_t b = regs.load(second_local_address(regs, instr));
+	regs.push(i16(op(a, b)));
+	return ip + 1;
+}
+
+// Stops the loop on a zero divisor, a trap the checked registers raised reading it is kept.
+template <typename Registers>
+inline uint16_t
+division_by_zero(Registers& regs) {
+	if (regs.context.trap == trap_code::none)
+		regs.context.trap = trap_code::division_by_zero;
+	return decoded_program::halt;
+}
+
+template <typename Registers>
+inline uint16_t
+push_handler(Registers& regs, const decoded_instruction&, uint16_t ip) {
+	regs.push(i16(regs.get(+registers::def::imm)));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+push_literal_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.push(instr.literal);
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+push_reg_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.push(i16(regs.get(instr.reg_a)));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+add_handler(Registers& regs, const decoded_instruction&, uint16_t ip) {
+	return binary_expression(regs, ip, std::plus<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+sub_handler(Registers& regs, const decoded_instruction&, uint16_t ip) {
+	return binary_expression(regs, ip, std::minus<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+mul_handler(Registers& regs, const decoded_instruction&, uint16_t ip) {
+	return binary_expression(regs, ip, std::multiplies<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+div_handler(Registers& regs, const decoded_instruction&, uint16_t ip) {
+	if (regs.load(regs.sp()) == 0)
+		return division_by_zero(regs);
+	return binary_expression(regs, ip, std::divides<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+add_reg_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	return register_expression(regs, instr, ip, std::plus<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+sub_reg_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	return register_expression(regs, instr, ip, std::minus<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+mul_reg_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	return register_expression(regs, instr, ip, std::multiplies<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+div_reg_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	if (regs.get(instr.reg_b) == 0)
+		return division_by_zero(regs);
+	return register_expression(regs, instr, ip, std::divides<int16_t>{});
+}
+
+// literal is the address of the instruction after the call, see decoder.hpp.
+template <typename Registers>
+inline uint16_t
+call_handler(Registers& regs, const decoded_instruction& instr, uint16_t) {
+	regs.push(instr.literal);
+	regs.push(i16(regs.fp()));
+	regs.set(+registers::def::fp, regs.sp());
+	regs.set(+registers::def::cd, u16(regs.get(+registers::def::cd) + 1));
+	return instr.target;
+}
+
+template <typename Registers>
+inline uint16_t
+return_handler(Registers& regs, const decoded_instruction&, uint16_t) {
+	uint16_t depth = regs.get(+registers::def::cd);
+	regs.set(+registers::def::sp, regs.fp());
+	if (depth == 0) {
+		regs.context.return_value = i16(regs.get(+registers::def::ret));
+		regs.pc() = regs.fp(); // end of the program, same as the byte handler.
+		return decoded_program::halt;
+	}
+
+	regs.set(+registers::def::fp, u16(regs.pop()));
+	uint16_t address = u16(regs.pop());
+	regs.set(+registers::def::cd, u16(depth - 1));
+	uint16_t next = regs.context.program->index_of(address);
+	// a return address the program overwrote, same as a branch off an instruction boundary.
+	if (next == decoded_program::halt && regs.context.trap == trap_code::none)
+		regs.context.trap = trap_code::invalid_instruction;
+	return next;
+}
+
+template <typename Registers>
+inline uint16_t
+peek_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.set(instr.reg_a, static_cast<uint16_t>(regs.load(regs.sp())));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+peek_offset_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	int16_t value = regs.load(local_address(regs, instr.literal));
+	if (instr.reg_a == +registers::def::sp)
+		regs.push(value);
+	else
+		regs.set(instr.reg_a, static_cast<uint16_t>(value));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+pop_reg_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	int16_t value = regs.pop();
+	regs.set(instr.reg_a, static_cast<uint16_t>(value));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+step_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip, int16_t delta) {
+	if (instr.reg_a == +registers::def::sp) {
+		uint16_t address = local_address(regs, instr.literal);
+		regs.store(address, i16(regs.load(address) + delta));
+	}
+	else {
+		regs.set(instr.reg_a, static_cast<uint16_t>(regs.get(instr.reg_a) + delta));
+	}
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+inc_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	return step_handler(regs, instr, ip, 1);
+}
+
+template <typename Registers>
+inline uint16_t
+dec_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	return step_handler(regs, instr, ip, -1);
+}
+
+template <typename Registers>
+inline uint16_t
+cmp_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	if (instr.reg_a == +registers::def::sp) {
+		int16_t b = regs.pop();
+		int16_t a = regs.pop();
+		regs.set(+registers::def::imm, static_cast<uint16_t>(a - b));
+	}
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+mov_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.set(instr.reg_a, regs.get(instr.reg_b));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+put_reg_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.set(instr.reg_a, regs.get(+registers::def::imm));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+put_literal_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.set(+registers::def::imm, static_cast<uint16_t>(instr.literal));
+	return ip + 1;
+}
+
+// literal holds the memory address, the word at it ends two bytes further on.
+template <typename Registers>
+inline uint16_t
+mov_mem_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.store(u16(instr.literal + 2), i16(regs.get(+registers::def::imm)));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+push_mem_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.push(regs.load(u16(instr.literal + 2)));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+jump_eq_handler(Registers&, const decoded_instruction&, uint16_t ip) {
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+jump_nz_handler(Registers&, const decoded_instruction&, uint16_t ip) {
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+jump_gt_handler(Registers&, const decoded_instruction&, uint16_t ip) {
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+jump_lt_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	int16_t result = i16(regs.get(+registers::def::imm));
+	return result < 0 ? instr.target : ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+trap_handler(Registers& regs, const decoded_instruction&, uint16_t) {
+	regs.context.trap = trap_code::invalid_instruction;
+	return decoded_program::halt;
+}
+
+template <typename Registers>
+inline uint16_t
+add_offset_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	return local_binary_expression(regs, instr, ip, std::plus<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+sub_offset_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	return local_binary_expression(regs, instr, ip, std::minus<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+mul_offset_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	return local_binary_expression(regs, instr, ip, std::multiplies<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+div_offset_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	if (regs.load(second_local_address(regs, instr)) == 0)
+		return division_by_zero(regs);
+	return local_binary_expression(regs, instr, ip, std::divides<int16_t>{});
+}
+
+template <typename Registers>
+inline uint16_t
+jump_lt_offset_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	int16_t result = i16(regs.load(local_address(regs, instr.reg_a)) - instr.literal);
+	regs.set(+registers::def::imm, static_cast<uint16_t>(result));
+	return result < 0 ? instr.target : ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+peek_local_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.push(regs.load(frame_address(regs, instr.literal)));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+peek_local_reg_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	regs.set(instr.reg_a, static_cast<uint16_t>(regs.load(frame_address(regs, instr.literal))));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+inc_local_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	uint16_t address = frame_address(regs, instr.literal);
+	regs.store(address, i16(regs.load(address) + 1));
+	return ip + 1;
+}
+
+template <typename Registers>
+inline uint16_t
+dec_local_handler(Registers& regs, const decoded_instruction& instr, uint16_t ip) {
+	uint16_t address = frame_address(regs, instr.literal);
+	regs.store(address, i16(regs.load(address) - 1));
+	return ip + 1;
+}
+
+} // namespace ops
+} // namespace instruction
+} // namespace ciph
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <shared_defines.hpp>
+#include <vector>
+
+#include "execution_context.hpp"
+
+namespace ciph {
+
+struct decoded_instruction;
+
+namespace instruction {
+/*
+ * Handler for a pre-decoded instruction, operands are read from instr instead of the byte stream.
+ * Returns the index of the next instruction to run, decoded_program::halt ends execution. */
+typedef uint16_t (*decoded_handler)(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+} // namespace instruction
+
+/*
+ * Fixed width form of one bytecode instruction. Operands are decoded once at load time so the
+ * interpreter loop never goes back to the byte stream. */
+struct decoded_instruction {
+	instruction::decoded_handler handler = nullptr;
+	int16_t literal = 0;	// sign extended literal, the stack offset of PEK_OFF/INC/DEC, the address of MOV_MEM/PSH_MEM
+							// or the return address CALL pushes.
+	uint16_t target = 0;	// branch or call target as an index into decoded_program::instructions.
+	instruction::def opcode = instruction::def::NOP;
+	uint8_t reg_a = 0;		// register, or the first stack offset of a superinstruction.
+	uint8_t reg_b = 0;		// second register, or the second stack offset of a superinstruction.
+};
+
+struct decoded_program {
+	static constexpr uint16_t halt = 0xFFFF;
+
+	// Index of the instruction starting at byte address pc, halt if pc is not on an instruction boundary.
+	uint16_t index_of(uint16_t pc) const;
+
+	std::vector<decoded_instruction> instructions;
+	// byte_pc[i] is the address of instructions[i] in VM memory, the last entry is the end of the program.
+	// A superinstruction maps to the address of the first instruction it was fused from.
+	std::vector<uint16_t> byte_pc;
+	// block_cost[i] counts the instructions from instructions[i] through the branch, CALL, RET or trap
+	// that ends its basic block, what a bounded run charges for entering the block at i.
+	std::vector<uint16_t> block_cost;
+	// Highest block_cost, a bounded run given at least this much fuel always makes progress.
+	uint16_t largest_block = 0;
+	// Number of superinstructions the fusion pass produced.
+	uint16_t fusions = 0;
+	// Number of instructions the quicken pass specialized.
+	uint16_t quickened = 0;
+};
+
+namespace decoder {
+
+// Opcode given to instructions the decoder rejects, 0xFF has no handler in any engine.
+constexpr instruction::def invalid_opcode = static_cast<instruction::def>(0xFF);
+
+/*
+ * Decodes size bytes of program loaded at address base in VM memory. Unknown opcodes, truncated
+ * operands, registers past reg_cnt and branches or calls that don't land on an instruction boundary
+ * decode into a trap.
+ * With fuse_superinstructions set, common CodeGenerator sequences are rewritten into superinstructions,
+ * with quicken_instructions set, what is left of PEK_OFF, INC and DEC is specialized afterwards.
+ * PEK_ARG always decodes into PEK_LOC or PEK_LOC_REG, with a negative displacement. */
+decoded_program decode(const uint8_t* program, uint16_t size, uint16_t base, bool fuse_superinstructions = true,
+                       bool quicken_instructions = true);
+
+/*
+ * Rewrites PEK_OFF/PEK_OFF/<op>, PSH_LIT/PSH_LIT/<op> and the while loop tail
+ * PEK_OFF/PSH_LIT/CMP/JLT into single instructions. Sequences that a branch or call lands
+ * inside are left alone. Returns the number of fusions applied. */
+uint16_t fuse(decoded_program& program);
+
+/*
+ * Rewrites PEK_OFF, INC and DEC into PEK_LOC, PEK_LOC_REG, INC_LOC and DEC_LOC, which no longer
+ * test their register operand and carry the frame displacement instead of the offset. Only the
+ * decoded stream changes, the bytecode in VM memory and its disassembly stay as they were.
+ * Returns the number of instructions quickened. */
+uint16_t quicken(decoded_program& program);
+
+/*
+ * Fills block_cost, called by decode and fuse whenever the instruction stream changes shape.
+ * Only JLT and JLT_OFF branch in the decoded stream, JEQ, JNZ and JGT fall through. CALL ends a
+ * block too, the callee is charged on entry and the rest of the caller when RET comes back to it. */
+void measure_blocks(decoded_program& program);
+
+} // namespace decoder
+} // namespace ciph
@@ -1,15 +1,46 @@
 #pragma once
 
 #include <cstdint>
+#include <byte_order.hpp>
 
 namespace ciph {
 
-struct ExecutionContext 
+struct decoded_program;
+
+enum class trap_code : uint8_t {
+	none = 0x00,
+	invalid_instruction = 0x01,	// Opcode byte has no handler in the dispatch table.
+	out_of_memory = 0x02,		// The program doesn't fit in VM memory, nothing was run.
+	stack_fault = 0x03,			// A stack access fell outside VM memory, only the checked interpreter raises it.
+	division_by_zero = 0x04,	// DIV, DIV_REG or DIV_OFF with a zero divisor, nothing was written.
+};
+
+// Why a bounded run returned, out_of_fuel and a pc left on the next instruction can be resumed.
+enum class run_status : uint8_t {
+	completed = 0x00,	// RET, context.return_value holds the result.
+	out_of_fuel = 0x01,	// budget spent, pc is where the next run continues.
+	trapped = 0x02,		// context.trap is set and pc is on the faulting instruction.
+};
+
+/*
+ * bytecode is VM memory, the stack lives in it and a program may write anywhere in it. code is
+ * the program image and is only ever read, it may be shared by any number of contexts. With the
+ * two argument constructor the program is expected to be in memory, code is then the same
+ * buffer. */
+struct ExecutionContext
 {
 public:
 	ExecutionContext(uint16_t* reg, uint8_t* _bytecode)
 		: registry(reg)
 		, bytecode(_bytecode)
+		, code(_bytecode)
+	{}
+
+	ExecutionContext(uint16_t* reg, uint8_t* memory, const uint8_t* image, uint16_t imageAddrs)
+		: registry(reg)
+		, bytecode(memory)
+		, code(image)
+		, code_base(imageAddrs)
 	{}
 
 	ExecutionContext()
@@ -17,9 +48,24 @@ public:
 		, bytecode(nullptr)
 	{}
 
-	uint16_t* registry;	
+	// Program byte at address, addresses are the same as in VM memory.
+	uint8_t code_at(uint16_t address) const {
+		return code[static_cast<uint16_t>(address - code_base)];
+	}
+
+	// Operand word starting at address, in byte_order::operand.
+	int16_t operand_at(uint16_t address) const {
+		return byte_order::load_operand(&code[static_cast<uint16_t>(address - code_base)]);
+	}
+
+	uint16_t* registry;
 	uint8_t* bytecode = nullptr;
+	const uint8_t* code = nullptr;
+	uint16_t code_base = 0;		// address code[0] is loaded at.
+	// Decoded form of code the engine running it works from, RET maps return addresses through it.
+	const decoded_program* program = nullptr;
 	int16_t return_value = 0;
+	trap_code trap = trap_code::none;
 };
 
-} // namespace ciph
\ No newline at end of file
+} // namespace ciph
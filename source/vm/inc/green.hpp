@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "decoder.hpp"
+#include "execution_context.hpp"
+#include "verifier.hpp"
+
+namespace ciph {
+namespace green {
+
+struct options {
+	// Instructions a VM runs before it yields, raised to the largest basic block so every
+	// resume makes progress.
+	uint32_t quantum = 1024;
+	// Bytes of stack each VM gets above its program.
+	uint16_t stack_bytes = 256;
+};
+
+/*
+ * A program decoded once, every VM spawned from it shares both the bytes and the decoded form.
+ * Addresses are the ones a ProcessingUnit would load it at. */
+struct image {
+	std::vector<uint8_t> bytes;
+	decoded_program program;
+	uint16_t base = 0;		// address the program is loaded at, bp and pc start here.
+	uint16_t stack = 0;		// sp and fp start here.
+	// VMs whose memory holds verification.extent run unchecked, the others on run_checked.
+	verifier::report verification;
+};
+
+std::shared_ptr<const image> make_image(const uint8_t* program, uint16_t size);
+
+using vm_id = size_t;
+using inputs = std::array<int16_t, 7>;
+
+struct result {
+	run_status status = run_status::out_of_fuel;	// out_of_fuel while the VM is still live.
+	int16_t return_value = 0;
+	trap_code trap = trap_code::none;
+};
+
+// Coroutine a VM runs in, suspended before its first instruction and after its last.
+class task {
+public:
+	struct promise_type {
+		task get_return_object() {
+			return task(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+
+	task() = default;
+	explicit task(std::coroutine_handle<promise_type> handle)
+		: m_handle(handle)
+	{}
+	task(task&& other) noexcept
+		: m_handle(std::exchange(other.m_handle, {}))
+	{}
+	task& operator=(task&& other) noexcept {
+		if (this != &other) {
+			destroy();
+			m_handle = std::exchange(other.m_handle, {});
+		}
+		return *this;
+	}
+	~task() {
+		destroy();
+	}
+
+	std::coroutine_handle<promise_type> handle() const {
+		return m_handle;
+	}
+
+private:
+	void destroy() {
+		if (m_handle)
+			m_handle.destroy();
+	}
+
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+} // namespace green
+
+/*
+ * Multiplexes many ciph programs on the calling thread. Every VM is a coroutine around
+ * interpreter::run_metered, it runs one quantum of fuel and co_awaits back to the scheduler,
+ * which always lands on a basic block boundary, a loop back-edge included. A VM is its
+ * registers, a few hundred bytes of memory and the coroutine frame, the decoded program is
+ * shared through its image.
+ *
+ * Results match execute() on a ProcessingUnit with stack_bytes of stack. A verified program that
+ * fits runs on interpreter::run_metered, anything else on interpreter::run_checked, which traps
+ * with stack_fault instead of running off the end of the VM's memory. */
+class GreenScheduler {
+public:
+	explicit GreenScheduler(green::options options = {});
+	// Owns the coroutine frames, each holds a reference to its vm.
+	GreenScheduler(const GreenScheduler&) = delete;
+	GreenScheduler& operator=(const GreenScheduler&) = delete;
+
+	// Queues a VM at the start of program with r0 to r6 set, it first runs on the next resume.
+	green::vm_id spawn(std::shared_ptr<const green::image> program, const green::inputs& inputs = {});
+
+	// Resumes every VM that was ready when called once, returns how many are still live.
+	size_t run_once();
+	// Resumes VMs round robin until every one has finished.
+	void run();
+
+	size_t live() const {
+		return m_ready.size();
+	}
+	size_t size() const {
+		return m_vms.size();
+	}
+
+	const green::result& result(green::vm_id id) const {
+		return m_vms[id]->outcome;
+	}
+
+private:
+	struct vm {
+		std::shared_ptr<const green::image> program;
+		std::unique_ptr<uint8_t[]> memory;	// registers, the program's addresses, then the stack.
+		uint32_t memory_size = 0;
+		bool checked = false;
+		ExecutionContext context;
+		green::result outcome;
+		green::task body;
+	};
+
+	static green::task run_vm(vm& state, uint32_t quantum);
+
+	green::options m_options;
+	std::vector<std::unique_ptr<vm>> m_vms;
+	std::deque<std::coroutine_handle<>> m_ready;
+};
+
+} // namespace ciph
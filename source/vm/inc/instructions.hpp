@@ -1,7 +1,8 @@
 #pragma once
 
 #include <shared_defines.hpp>
-#include <unordered_map>
+#include <array>
+#include "decoder.hpp"
 #include "execution_context.hpp"
 
 namespace ciph {
@@ -27,41 +28,133 @@ void add_handler(ExecutionContext& context);
 void sub_handler(ExecutionContext& context);
 void mul_handler(ExecutionContext& context);
 void div_handler(ExecutionContext& context);
+void add_reg_handler(ExecutionContext& context);
+void sub_reg_handler(ExecutionContext& context);
+void mul_reg_handler(ExecutionContext& context);
+void div_reg_handler(ExecutionContext& context);
+void call_handler(ExecutionContext& context);
 void return_handler(ExecutionContext& context);
 void peek_handler(ExecutionContext& context);
 void peek_offset_handler(ExecutionContext& context);
+void peek_argument_handler(ExecutionContext& context);
 void pop_reg_handler(ExecutionContext& context);
 void inc_handler(ExecutionContext& context);
 void dec_handler(ExecutionContext& context);
 void cmp_handler(ExecutionContext& context);
 void mov_handler(ExecutionContext& context);
+void put_reg_handler(ExecutionContext& context);
+void put_literal_handler(ExecutionContext& context);
+void mov_mem_handler(ExecutionContext& context);
+void push_mem_handler(ExecutionContext& context);
 void jump_eq_handler(ExecutionContext& context);
 void jump_nz_handler(ExecutionContext& context);
 void jump_gt_handler(ExecutionContext& context);
 void jump_lt_handler(ExecutionContext& context);
 
-static std::unordered_map<def, handler> handlers = {
-	{def::PSH, push_handler},
-	{def::PSH_REG, push_reg_handler},
-	{def::PSH_LIT, push_literal_handler},
-	{def::ADD, add_handler},
-	{def::SUB, sub_handler},
-	{def::MUL, mul_handler},
-	{def::DIV, div_handler},
-	{def::POP_REG, pop_reg_handler},
-	{def::PEK_REG, peek_handler},
-	{def::PEK_OFF, peek_offset_handler},
-	{def::RET, return_handler},
-	{def::INC, inc_handler},
-	{def::DEC, dec_handler},
-	{def::CMP, cmp_handler},
-	{def::MOV, mov_handler},
-	{def::JEQ, jump_eq_handler},
-	{def::JNZ, jump_nz_handler},
-	{def::JGT, jump_gt_handler},
-	{def::JLT, jump_lt_handler}
-
-}; // handlers
+// Raises trap_code::invalid_instruction, used for every opcode without a handler.
+void trap_handler(ExecutionContext& context);
+
+/*
+ * Dense dispatch table indexed directly by the opcode byte. Every slot that has no handler
+ * points at trap_handler, so an unknown opcode never reaches a null function pointer. */
+struct dispatch_table {
+	constexpr handler operator[](def instr) const { return entries[static_cast<uint8_t>(instr)]; }
+	constexpr handler operator[](uint8_t opcode) const { return entries[opcode]; }
+
+	std::array<handler, 256> entries;
+};
+
+constexpr dispatch_table
+make_dispatch_table() {
+	dispatch_table table{};
+	table.entries.fill(trap_handler);
+
+	table.entries[+def::PSH] = push_handler;
+	table.entries[+def::PSH_REG] = push_reg_handler;
+	table.entries[+def::PSH_LIT] = push_literal_handler;
+	table.entries[+def::ADD] = add_handler;
+	table.entries[+def::SUB] = sub_handler;
+	table.entries[+def::MUL] = mul_handler;
+	table.entries[+def::DIV] = div_handler;
+	table.entries[+def::ADD_REG] = add_reg_handler;
+	table.entries[+def::SUB_REG] = sub_reg_handler;
+	table.entries[+def::MUL_REG] = mul_reg_handler;
+	table.entries[+def::DIV_REG] = div_reg_handler;
+	table.entries[+def::POP_REG] = pop_reg_handler;
+	table.entries[+def::PEK_REG] = peek_handler;
+	table.entries[+def::PEK_OFF] = peek_offset_handler;
+	table.entries[+def::PEK_ARG] = peek_argument_handler;
+	table.entries[+def::CALL] = call_handler;
+	table.entries[+def::RET] = return_handler;
+	table.entries[+def::INC] = inc_handler;
+	table.entries[+def::DEC] = dec_handler;
+	table.entries[+def::CMP] = cmp_handler;
+	table.entries[+def::MOV] = mov_handler;
+	table.entries[+def::PUT_REG] = put_reg_handler;
+	table.entries[+def::PUT_LIT] = put_literal_handler;
+	table.entries[+def::MOV_MEM] = mov_mem_handler;
+	table.entries[+def::PSH_MEM] = push_mem_handler;
+	table.entries[+def::JEQ] = jump_eq_handler;
+	table.entries[+def::JNZ] = jump_nz_handler;
+	table.entries[+def::JGT] = jump_gt_handler;
+	table.entries[+def::JLT] = jump_lt_handler;
+	return table;
+}
+
+inline constexpr dispatch_table handlers = make_dispatch_table(); // handlers
+
+/*
+ * Handlers for pre-decoded instructions, see decoder.hpp. Same semantics as the byte handlers
+ * above, but they never touch pc. Branches and CALL return their resolved target, RET the
+ * instruction after the CALL it goes back to. RET out of the program and traps return
+ * decoded_program::halt. */
+namespace decoded {
+
+uint16_t push_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t push_literal_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t push_reg_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+
+uint16_t add_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t sub_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t mul_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t div_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t add_reg_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t sub_reg_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t mul_reg_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t div_reg_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t call_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t return_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t peek_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t peek_offset_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t pop_reg_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t inc_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t dec_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t cmp_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t mov_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t put_reg_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t put_literal_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t mov_mem_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t push_mem_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t jump_eq_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t jump_nz_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t jump_gt_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t jump_lt_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t trap_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+
+// superinstructions
+uint16_t add_offset_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t sub_offset_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t mul_offset_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t div_offset_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t jump_lt_offset_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+
+// quickened
+uint16_t peek_local_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t peek_local_reg_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t inc_local_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+uint16_t dec_local_handler(ExecutionContext& context, const decoded_instruction& instr, uint16_t ip);
+
+} // namespace decoded
 
 } // namespace instruction
 } // namespace ciph
\ No newline at end of file
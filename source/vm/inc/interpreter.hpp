@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include "decoder.hpp"
+#include "execution_context.hpp"
+
+// Labels-as-values is a GCC/Clang extension, other compilers get the switch based loop.
+#if defined(__GNUC__) || defined(__clang__)
+#define CIPH_HAS_COMPUTED_GOTO 1
+#else
+#define CIPH_HAS_COMPUTED_GOTO 0
+#endif
+
+namespace ciph {
+namespace interpreter {
+
+/*
+ * Interpreter loops over a decoded program. All of them start at the instruction pc points at,
+ * run until the RET that leaves the outermost frame or a trap and return context.return_value. pc is only written back when the
+ * loop ends, a trap leaves it on the faulting instruction. The switch and threaded loops do the
+ * same for sp and fp and also cache the top of the stack, the register file and the stack in VM
+ * memory are only current again once they return. run() is the engine picked at build
+ * time through the CIPH_VM_DISPATCH cache variable, the others are exposed for tests and benchmarks. */
+int16_t run(ExecutionContext& context, const decoded_program& program);
+
+// Central loop, one indirect call through decoded_instruction::handler per instruction.
+int16_t run_table(ExecutionContext& context, const decoded_program& program);
+
+// Portable fallback, one switch per instruction. Handlers are inlined with pc, sp and fp kept in locals.
+int16_t run_switch(ExecutionContext& context, const decoded_program& program);
+
+#if CIPH_HAS_COMPUTED_GOTO
+// Threaded code, every handler ends in its own indirect jump to the next one. Keeps pc, sp and fp
+// in locals like run_switch.
+int16_t run_threaded(ExecutionContext& context, const decoded_program& program);
+#endif
+
+/*
+ * Bounded form of run_switch, runs at most fuel decoded instructions and subtracts what it charged.
+ * Fuel is charged a whole basic block at a time when the block is entered, so the only checks are
+ * on entry and after a branch, a call or a return. A block that doesn't fit stops the run before it starts
+ * with pc on its first instruction, calling again with more fuel resumes from there. A budget
+ * smaller than the block at pc makes no progress. */
+run_status run_metered(ExecutionContext& context, const decoded_program& program, uint32_t& fuel);
+
+// Runs the single instruction at pc and writes the next pc back, false once the program ended.
+bool step(ExecutionContext& context, const decoded_program& program);
+
+/*
+ * The engines above trust the program: stack accesses aren't bounds checked and running past the
+ * last instruction reads past the decoded stream. They are only safe on programs the verifier
+ * accepted, see verifier.hpp. The checked forms below run anything, a stack access outside
+ * memory_size bytes of VM memory traps with stack_fault and falling off the end of the program
+ * with invalid_instruction. Fuel is charged the same way as run_metered. */
+run_status run_checked(ExecutionContext& context, const decoded_program& program, uint32_t memory_size,
+                       uint32_t& fuel);
+int16_t run_checked(ExecutionContext& context, const decoded_program& program, uint32_t memory_size);
+bool step_checked(ExecutionContext& context, const decoded_program& program, uint32_t memory_size);
+
+} // namespace interpreter
+} // namespace ciph
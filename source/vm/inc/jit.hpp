@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "decoder.hpp"
+#include "execution_context.hpp"
+
+// The JIT emits x86-64 System V code into mmap'd memory, everything else runs interpreted.
+#if defined(CIPH_VM_JIT) && defined(__x86_64__) && defined(__linux__)
+#define CIPH_HAS_JIT 1
+#else
+#define CIPH_HAS_JIT 0
+#endif
+
+namespace ciph {
+namespace jit {
+
+/*
+ * Page aligned copy of generated code. Mapped read/write while the code is copied in and
+ * switched to read/execute before it is ever run, never both at once. */
+class ExecutableMemory {
+public:
+	ExecutableMemory() = default;
+	explicit ExecutableMemory(const std::vector<uint8_t>& code);
+	~ExecutableMemory();
+
+	ExecutableMemory(ExecutableMemory&& other) noexcept;
+	ExecutableMemory& operator=(ExecutableMemory&& other) noexcept;
+	ExecutableMemory(const ExecutableMemory&) = delete;
+	ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	void release();
+
+	uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+/*
+ * Native code for one decoded program. Every decoded instruction has an entry point, so
+ * execution can leave native code at any instruction and come back at the next one. */
+struct compiled_program {
+	bool empty() const { return code.data() == nullptr; }
+
+	ExecutableMemory code;
+	// entry[i] is the offset of decoded_program::instructions[i] into code.
+	std::vector<uint32_t> entry;
+	// Instructions compiled into a side exit, these always run in the interpreter.
+	uint16_t fallbacks = 0;
+};
+
+/*
+ * Compiles the whole decoded program, returns an empty compiled_program when the host has no JIT.
+ * Instructions the JIT does not handle, such as anything reading or writing pc and decoder traps,
+ * become side exits back into the interpreter. */
+compiled_program compile(const decoded_program& program);
+
+/*
+ * Runs native code from the instruction at pc until RET or a trap, with the same result,
+ * register file and trap state as interpreter::run. Side exits run one instruction through
+ * interpreter::step and re-enter native code after it. An empty native program runs interpreted. */
+int16_t run(ExecutionContext& context, const decoded_program& program, const compiled_program& native);
+
+} // namespace jit
+} // namespace ciph
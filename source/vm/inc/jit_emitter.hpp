@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "decoder.hpp"
+#include "jit.hpp"
+#include "x64_assembler.hpp"
+
+namespace ciph {
+namespace jit {
+
+/*
+ * Native calling convention of everything the emitter produces, System V: memory base, register
+ * file and the address to start at. Returns the index of the instruction the interpreter has to
+ * continue with, or decoded_program::halt after RET. */
+typedef uint16_t (*native_function)(uint8_t* memory, uint16_t* registry, const uint8_t* entry);
+
+/*
+ * Instruction selection shared by the whole program compiler and the trace compiler. VM memory,
+ * the register file, sp and fp stay pinned in callee saved registers between prologue() and the
+ * epilogue, everything else lives in VM memory. Subclasses decide where conditional branches go. */
+class Emitter {
+public:
+	using label = x64::Assembler::label;
+
+	virtual ~Emitter() = default;
+
+	/*
+	 * False for instructions that always run in the interpreter, pc operands and decoder traps, and
+	 * for CALL and RET, which only the whole program compiler emits through the frame helpers below. */
+	static bool supported(const decoded_instruction& instr);
+
+protected:
+	Emitter();
+
+	// Saves callee saved registers, loads sp and fp and jumps to the entry argument.
+	void prologue();
+
+	// Emits the pending side exits and the epilogue, returns the finished code.
+	const std::vector<uint8_t>& finish();
+
+	// Leaves native code, the interpreter continues at instruction ip.
+	void exit_now(uint16_t ip);
+
+	// Side exit to instruction ip, emitted out of line by finish().
+	label exit_label(uint16_t ip);
+
+	/*
+	 * Emits instr, returns false without emitting anything if it isn't supported. Conditional
+	 * branches compute their condition and call branch() with the sign flag set when taken. */
+	bool instruction(const decoded_instruction& instr, uint16_t ip);
+
+	virtual void branch(const decoded_instruction& instr, uint16_t ip) = 0;
+
+	// CALL up to the jump, pushes return_address and fp and points fp at the new frame.
+	void enter_frame(uint16_t return_address);
+	// Sets the zero flag when RET would end the program, no call is left to return from.
+	void test_call_depth();
+	// Return address of the current frame into dst, the frame is left as it is.
+	void load_return_address(x64::reg dst);
+	// RET inside a call up to the jump, drops the frame and restores the caller's fp.
+	void leave_frame();
+	// RET outside of any call, ends the program.
+	void end_program();
+
+	x64::Assembler m_asm;
+
+private:
+	void load(x64::reg dst, uint8_t vmreg);
+	void store(uint8_t vmreg, x64::reg src);
+	void push(x64::reg src);
+	void pop(x64::reg dst);
+	void arithmetic(instruction::def op);
+	void divisor_check(uint16_t ip);
+
+	label m_epilogue;
+	std::map<uint16_t, label> m_exits;
+};
+
+} // namespace jit
+} // namespace ciph
@@ -2,42 +2,88 @@
 #include <cstdint>
 #include <algorithm>
 
+#include "memory_pool.hpp"
+
 namespace ciph {
 
-template <size_t N>
+/*
+ * Where load_program puts each segment of VM memory. Registers come first, then the code, the
+ * stack starts on the next even address after it and may grow up to end. */
+struct memory_layout {
+    uint16_t registers = 0;
+    uint16_t code = 0;      // bp and pc start here.
+    uint16_t stack = 0;     // sp and fp start here.
+    uint32_t end = 0;       // one past the last byte of memory.
+};
+
+/*
+ * VM memory, sized when constructed. Addresses are 16 bit, so max_size covers every address a
+ * program can form; smaller memories rely on the program staying inside them. The buffer comes
+ * from memory_pool and is not cleared, only what allocate hands out is zeroed. */
 class Memory {
 public:
-    Memory() {
-        m_memory = new uint8_t[N];
-        m_size = N;
+    static constexpr uint32_t default_size = 0x1000; // 4KB
+    static constexpr uint32_t max_size = 0x10000;
+
+    explicit Memory(uint32_t size = default_size) {
+        m_size = std::min(std::max<uint32_t>(size, 0x100), max_size);
+        m_memory = memory_pool::acquire(m_size);
         m_allocPointer = 0;
     };
     ~Memory() {
-        delete[] m_memory;
+        memory_pool::release(m_memory, m_size);
     }
 
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+
     uint16_t* allocate(uint16_t size) {
-        size *= 2;
+        uint32_t bytes = static_cast<uint32_t>(size) * 2;
         uint16_t* ptr = reinterpret_cast<uint16_t*>(&m_memory[m_allocPointer]);
-        std::fill_n(&m_memory[m_allocPointer], size, 0x00); // fill with 0x0
-        m_allocPointer += size;        
+        std::fill_n(&m_memory[m_allocPointer], bytes, 0x00); // fill with 0x0
+        m_allocPointer += bytes;
         return ptr;
     }
 
-    uint16_t load(uint8_t* program, uint16_t size) {
-        if (m_allocPointer + size > m_size) {
+    bool fits(uint32_t size) const {
+        return m_allocPointer + size <= m_size;
+    }
+
+    uint16_t load(const uint8_t* program, uint16_t size) {
+        if (fits(size) == false) {
             return 0x0;
             // out of memory
         }
         if (size == 0)
-            return m_allocPointer;
-        
+            return static_cast<uint16_t>(m_allocPointer);
+
         std::copy(program, program + size, &m_memory[m_allocPointer]);
-        uint16_t addrs = m_allocPointer;
+        return reserve(size);
+    }
+
+    // Address space for size bytes that are never written, for a program kept outside memory.
+    uint16_t reserve(uint16_t size) {
+        if (fits(size) == false)
+            return 0x0; // out of memory
+        uint16_t addrs = static_cast<uint16_t>(m_allocPointer);
         m_allocPointer += size;
         return addrs;
     }
 
+    uint32_t size() const {
+        return m_size;
+    }
+
+    // Bytes handed out by allocate and load so far.
+    uint32_t allocated() const {
+        return m_allocPointer;
+    }
+
+    // Everything below bytes counts as in use and the rest as free, the next allocation starts there.
+    void set_allocated(uint32_t bytes) {
+        m_allocPointer = std::min(bytes, m_size);
+    }
+
     uint8_t* getMemory(uint16_t address) const {
         return &m_memory[address];
     }
@@ -48,8 +94,8 @@ public:
 
 private:
     uint8_t* m_memory;
-    uint16_t m_size;
-    uint16_t m_allocPointer;
+    uint32_t m_size;
+    uint32_t m_allocPointer;
 };
 
-} // namespace ciph
\ No newline at end of file
+} // namespace ciph
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ciph {
+namespace memory_pool {
+
+/*
+ * Thread local free lists of VM memory blocks, one per power of two size from 256 bytes to
+ * 64KB. Blocks come back with whatever the last VM left in them, Memory only zeroes what it
+ * hands out through allocate. A block may be released on a different thread than the one that
+ * acquired it, it then joins that thread's free list. */
+
+struct stats {
+	uint64_t hits = 0;		// acquires served from the free list.
+	uint64_t misses = 0;	// acquires that had to new[] a block.
+	size_t cached = 0;		// blocks waiting in the free lists.
+};
+
+// A block of at least size bytes.
+uint8_t* acquire(uint32_t size);
+// Gives back a block acquire returned for the same size.
+void release(uint8_t* block, uint32_t size);
+
+// Blocks of each size this thread keeps, 0 makes acquire and release plain new[] and delete[].
+void set_cache_limit(size_t blocks);
+size_t cache_limit();
+
+// This thread's counters.
+stats thread_stats();
+
+} // namespace memory_pool
+} // namespace ciph
@@ -1,7 +1,14 @@
 #pragma once
+#include <memory>
+#include <vector>
+
+#include "decoder.hpp"
+#include "jit.hpp"
 #include "memory.hpp"
 #include "shared_defines.hpp"
 #include "execution_context.hpp"
+#include "tracing.hpp"
+#include "verifier.hpp"
 
 namespace ciph {
 
@@ -37,36 +44,167 @@ public:
     uint16_t* pc;
 };
 
+enum class execution_mode : uint8_t {
+    interpreter,    // interpreter::run, the loop picked by CIPH_VM_DISPATCH.
+    jit,            // jit::run on native code, falls back to the interpreter without a JIT.
+    tracing,        // tracing::run, only hot loops are compiled.
+};
+
+/*
+ * A ProcessingUnit frozen after load_program, and possibly after some execution. The program
+ * image, decoded program and native code are immutable and shared with every unit restored from
+ * it, only VM memory up to the last byte the program can have written is copied. */
+struct vm_snapshot {
+    std::shared_ptr<const decoded_program> program;
+    std::shared_ptr<const jit::compiled_program> native;    // null unless it was compiled.
+    std::shared_ptr<const verifier::report> verification;
+    std::shared_ptr<const std::vector<uint8_t>> image;
+    // from address 0, the register file included, up to sp or the verified extent if that is higher.
+    std::vector<uint8_t> memory;
+    uint32_t memory_size = Memory::default_size;
+    uint32_t allocated = 0;
+    memory_layout layout;
+    int16_t return_value = 0;
+    trap_code trap = trap_code::none;
+    execution_mode mode = execution_mode::interpreter;
+    tracing::options tracing;
+};
+
 class ProcessingUnit {
 public:
-    ProcessingUnit();
+    // memorySize is rounded into [0x100, Memory::max_size].
+    explicit ProcessingUnit(uint32_t memorySize = Memory::default_size);
+    // Same as restore(from) on a new unit with the snapshot's memory size.
+    explicit ProcessingUnit(const vm_snapshot& from);
     
-    void load_program(uint8_t* program, uint16_t size);
 
+    // Loading again replaces the previous program, the unit can be reused for any number of them.
+    void load_program(const uint8_t* program, uint16_t size);
+    /*
+     * Runs image in place, the unit keeps a reference and never copies or writes it, so any number
+     * of units can share one image. Loading the image that is already loaded only restarts. */
+    void load_program(std::shared_ptr<const std::vector<uint8_t>> image);
+    // Puts memory, registers and trap state back to how load_program left them, without decoding again.
+    void restart();
+    // Drops the program and leaves the unit as if just constructed, keeping its memory block.
+    void reset();
+
+    // Captures the unit as it is now, a later restore or fork starts from exactly here.
+    std::shared_ptr<const vm_snapshot> snapshot() const;
+    /*
+     * Copies the snapshot's memory back and shares its decoded program, traces start cold. A
+     * snapshot bigger than this unit's memory leaves it trapped with out_of_memory. */
+    void restore(const vm_snapshot& from);
+    static std::unique_ptr<ProcessingUnit> fork(const vm_snapshot& from);
+
+    // Picks how execute() runs, switching to jit compiles the loaded program if needed.
+    void set_execution_mode(execution_mode mode);
+    execution_mode mode() const {
+        return m_mode;
+    }
+
+    // Thresholds for execution_mode::tracing, traces compiled so far are kept.
+    void set_tracing_options(const tracing::options& opts) {
+        m_tracing = opts;
+    }
+
+    /*
+     * Every entry point runs the unchecked engines only when the program was verified, fits in
+     * memory and sp and fp are at the depth verified for pc outside of any call. Anything else, a
+     * program that writes sp, one that recurses, one resumed inside a call or registers changed
+     * from outside included, runs on interpreter::run_checked. */
     int16_t execute();
+    /*
+     * Runs at most budget instructions whatever the execution mode, through interpreter::run_metered.
+     * out_of_fuel can be resumed by calling again, the result is in context().return_value once
+     * completed. Fuel is charged for a whole basic block on entering it, a budget below the cost of
+     * the next block returns out_of_fuel without running anything. A budget of at least
+     * largest_block() always makes progress, a fixed quantum has to be that big. */
+    run_status execute(uint32_t budget);
+    /*
+     * Runs one instruction as it was written, on the checked interpreter and without superinstructions,
+     * so pc stops on every instruction a Disassembler lists. Either execute() started where step()
+     * left pc inside a superinstruction steps to its end first, a unit of fuel for each instruction. */
     bool step();
 
+    // Fuel left over from the last bounded execute.
+    uint32_t fuel() const {
+        return m_fuel;
+    }
+
+    // Cost of the longest basic block in the loaded program, the smallest budget sure to make progress.
+    uint16_t largest_block() const {
+        return m_program->largest_block;
+    }
+
     uint16_t* registries() const {
         return m_reg_memory;
     }
 
+    // Registers and stack, the code's addresses are reserved but it is read from the image.
     uint8_t* memory() const {
         return m_memory.getMemory();
     }
 
+    uint32_t memory_size() const {
+        return m_memory.size();
+    }
+
+    const memory_layout& layout() const {
+        return m_layout;
+    }
+
     const ExecutionContext& context() const {
         return m_context;
     }
+
+    const decoded_program& program() const {
+        return *m_program;
+    }
+
+    // What the verifier found when the program was loaded.
+    const verifier::report& verification() const {
+        return *m_verification;
+    }
+
+    const jit::compiled_program& native() const;
+
+    const tracing::trace_cache& traces() const {
+        return m_traces;
+    }
 private:
-    
+    void reset_memory();
+    // Whether the unchecked engines are safe to start from the unit's current state.
+    bool unchecked() const;
+    // The program decoded without superinstructions, built on the first step().
+    const decoded_program& stepping_program();
+    // Whether pc is on an instruction that was fused into a superinstruction, but not its first.
+    bool inside_superinstruction();
+    // Nothing runs on a unit whose program didn't fit.
+    bool out_of_memory() const {
+        return m_context.trap == trap_code::out_of_memory;
+    }
+
     Registers m_registers;
     uint16_t* m_reg_memory;
 
     ExecutionContext m_context;
+    std::shared_ptr<const std::vector<uint8_t>> m_image;
+    // Shared with snapshots, replaced rather than modified.
+    std::shared_ptr<const decoded_program> m_program;
+    // program() itself when nothing was fused, reset whenever it is replaced.
+    std::shared_ptr<const decoded_program> m_stepping;
+    std::shared_ptr<const jit::compiled_program> m_native;
+    std::shared_ptr<const verifier::report> m_verification;
+    tracing::trace_cache m_traces;
+    tracing::options m_tracing;
+    execution_mode m_mode = execution_mode::interpreter;
+    uint32_t m_fuel = 0;
     
     //uint16_t* m_registries;
 
-    Memory<0x1000> m_memory; // 4KB
+    Memory m_memory;
+    memory_layout m_layout;
     uint8_t* ptr = nullptr;
 };
 
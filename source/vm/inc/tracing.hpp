@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "decoder.hpp"
+#include "execution_context.hpp"
+#include "jit.hpp"
+
+namespace ciph {
+namespace tracing {
+
+struct options {
+	// Taken back-edges to a loop header before its next iteration is recorded.
+	uint16_t hot_threshold = 50;
+	// Recordings longer than this are given up, the loop keeps running interpreted.
+	uint16_t max_trace_length = 256;
+	// Failed recordings of the same header before it is never recorded again.
+	uint16_t max_aborts = 3;
+};
+
+// Native code for one iteration of a loop, entered at its header and looping until a guard fails.
+struct compiled_trace {
+	jit::ExecutableMemory code;
+	uint32_t entry = 0;
+	uint16_t header = 0;
+	uint16_t length = 0;	// decoded instructions in the recorded iteration.
+};
+
+/*
+ * Per program tracing state, kept between runs so loops stay compiled. Indexed by decoded
+ * instruction, only loop headers (targets of a taken backward branch) are ever counted. */
+struct trace_cache {
+	static constexpr uint16_t no_trace = 0xFFFF;
+
+	// Clears everything and sizes the cache for a program of instructions decoded instructions.
+	void reset(size_t instructions);
+
+	std::vector<uint16_t> back_edges;
+	std::vector<uint16_t> aborts;
+	// trace_of[header] indexes traces, no_trace if the header has none.
+	std::vector<uint16_t> trace_of;
+	std::vector<compiled_trace> traces;
+
+	// Times native code was entered, each one ends in a guard or side exit.
+	uint32_t entries = 0;
+};
+
+/*
+ * Interprets the program like interpreter::run_table and counts taken backward JLT/JLT_OFF
+ * per target. Once a header reaches hot_threshold the next iteration is recorded instruction by
+ * instruction and compiled into a native loop, with a guard on every conditional branch that
+ * leaves the loop when it goes the other way than it did while recording. Recording is given up
+ * on instructions the JIT doesn't handle, RET, traps, a backward branch to another header (an
+ * inner loop gets its own trace) or when it gets longer than max_trace_length.
+ * Runs interpreted on hosts without a JIT. Same result, register file and trap state as interpreter::run. */
+int16_t run(ExecutionContext& context, const decoded_program& program, trace_cache& cache, const options& opts);
+
+} // namespace tracing
+} // namespace ciph
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "decoder.hpp"
+
+namespace ciph {
+namespace verifier {
+
+// Why a program was rejected, the first problem found on a path from the entry point.
+enum class status : uint8_t {
+	verified = 0x00,
+	invalid_instruction,	// reaches a trap: unknown opcode, truncated operands, a register past reg_cnt or a branch off an instruction boundary.
+	falls_off_end,			// can run past the last instruction without a RET.
+	frame_write,			// writes sp, fp or cd, the stack depth or the frame RET returns from isn't known after it.
+	stack_underflow,		// pops or peeks more words than are on the stack, or a CALL leaves fewer than its function reads with PEK_ARG.
+	stack_mismatch,			// two paths reach the same instruction with different stack depths.
+	register_memory,		// a memory operand addresses the register file, which the engines keep in locals.
+};
+
+// Depth of an instruction no path from the entry point reaches.
+constexpr uint16_t unreachable = 0xFFFF;
+
+// Extent of a program that can call a function while it is already running, no memory size fits it.
+constexpr uint32_t unbounded = 0xFFFFFFFF;
+
+struct report {
+	status result = status::verified;
+	uint16_t at = 0;				// instruction index the problem is at.
+	uint16_t max_depth = 0;			// stack words at the deepest point of any one frame.
+	// One past the highest byte of memory the program can read or write, the stack slots it
+	// addresses through fp, the frames of the deepest chain of calls and the words its memory
+	// operands name included. unbounded if calls can recurse.
+	uint32_t extent = 0;
+	// Stack words at each instruction above the fp of the function it is in, the same on every
+	// path to it. Only filled when verified.
+	std::vector<uint16_t> depth;
+
+	bool verified() const {
+		return result == status::verified;
+	}
+
+	// Verified and every access stays inside memory_size bytes, the unchecked engines are safe.
+	bool fits(uint32_t memory_size) const {
+		return verified() && extent <= memory_size;
+	}
+};
+
+/*
+ * Checks a decoded program once at load time, with the stack starting at address stack and the
+ * entry point at its first instruction. Follows every path through the program and gives each
+ * instruction a fixed stack depth, so sp and the slots fp addresses are known statically and
+ * bounded by extent. The target of a CALL is checked as a function of its own starting on an
+ * empty stack, the instruction after the CALL keeps the caller's depth. Words a function reads
+ * with PEK_ARG have to be on the stack of every CALL to it. A verified program runs on the
+ * unchecked engines as long as it fits in VM memory and sp and fp are where the depth says they
+ * should be. Division by zero depends on values, it isn't checked here, every engine traps on it
+ * with trap_code::division_by_zero. */
+report verify(const decoded_program& program, uint16_t stack);
+
+} // namespace verifier
+} // namespace ciph
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "execution_context.hpp"
+
+namespace ciph {
+namespace pool {
+
+struct job {
+	// Shared between jobs, a worker only decodes a program again when it gets a different one.
+	std::shared_ptr<const std::vector<uint8_t>> program;
+	uint16_t entry = 0;					// byte offset into program execution starts at.
+	std::array<int16_t, 7> inputs{};	// r0 to r6 at entry.
+};
+
+struct job_result {
+	int16_t return_value = 0;
+	trap_code trap = trap_code::none;
+};
+
+struct counters {
+	uint64_t submitted = 0;
+	uint64_t completed = 0;
+	uint64_t stolen = 0;				// jobs run by a worker other than the one they were queued on.
+	uint64_t queue_wait_total_ns = 0;	// summed time between submit and a worker picking the job up.
+	uint64_t queue_wait_max_ns = 0;
+	uint64_t uptime_ns = 0;				// since the pool started.
+
+	double jobs_per_second() const {
+		return uptime_ns == 0 ? 0.0 : static_cast<double>(completed) * 1e9 / static_cast<double>(uptime_ns);
+	}
+
+	double mean_queue_wait_ns() const {
+		return completed == 0 ? 0.0 : static_cast<double>(queue_wait_total_ns) / static_cast<double>(completed);
+	}
+};
+
+} // namespace pool
+
+/*
+ * Runs jobs on a fixed set of worker threads, each with its own ProcessingUnit that is reused from
+ * job to job. Every worker owns a deque: submits from outside the pool are spread round robin,
+ * submits from a worker go to its own deque. A worker takes its newest job first and, once its
+ * deque is empty, steals the oldest job of another worker before going to sleep.
+ * The destructor runs every job already submitted before joining the workers. */
+class VmPool {
+public:
+	explicit VmPool(size_t workers = std::thread::hardware_concurrency());
+	~VmPool();
+
+	VmPool(const VmPool&) = delete;
+	VmPool& operator=(const VmPool&) = delete;
+
+	std::future<pool::job_result> submit(pool::job job);
+	// Calls done on the worker that ran the job, cheaper than a future for many small jobs.
+	void submit(pool::job job, std::function<void(const pool::job_result&)> done);
+	// Runs all jobs and blocks until every one of them has finished.
+	std::vector<pool::job_result> run(const std::vector<pool::job>& jobs);
+
+	// Blocks until every job submitted so far has finished.
+	void wait_idle();
+
+	size_t workers() const {
+		return m_workers.size();
+	}
+
+	pool::counters counters() const;
+
+private:
+	struct task {
+		pool::job job;
+		std::function<void(const pool::job_result&)> done;
+		std::chrono::steady_clock::time_point queued;
+	};
+
+	struct worker {
+		std::mutex lock;
+		std::deque<task> tasks;
+		std::thread thread;
+	};
+
+	void enqueue(task&& item);
+	bool take(size_t self, task& item);
+	void work(size_t self);
+	void finished(const task& item, std::chrono::steady_clock::time_point started);
+
+	std::vector<std::unique_ptr<worker>> m_workers;
+	std::atomic<size_t> m_next{ 0 };
+
+	// Bumped on every enqueue and on shutdown, idle workers wait for it to change.
+	std::atomic<uint32_t> m_wake{ 0 };
+	std::atomic<bool> m_stopping{ false };
+
+	std::atomic<uint64_t> m_submitted{ 0 };
+	std::atomic<uint64_t> m_completed{ 0 };
+	std::atomic<uint64_t> m_stolen{ 0 };
+	std::atomic<uint64_t> m_wait_total{ 0 };
+	std::atomic<uint64_t> m_wait_max{ 0 };
+	std::chrono::steady_clock::time_point m_started;
+};
+
+} // namespace ciph
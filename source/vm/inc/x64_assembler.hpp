@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ciph {
+namespace x64 {
+
+enum class reg : uint8_t {
+	rax = 0, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+	r8, r9, r10, r11, r12, r13, r14, r15
+};
+
+// [base + index + disp], index is optional.
+struct mem {
+	mem(reg b, int32_t d = 0) : base(b), disp(d) {}
+	mem(reg b, reg i, int32_t d = 0) : base(b), index(i), has_index(true), disp(d) {}
+
+	reg base;
+	reg index = reg::rax;
+	bool has_index = false;
+	int32_t disp = 0;
+};
+
+enum class condition : uint8_t {
+	zero = 0x4,
+	not_zero = 0x5,
+	sign = 0x8,
+	not_sign = 0x9,
+	less = 0xC,
+};
+
+/*
+ * Minimal x86-64 encoder for the JIT, only what the code generators need. Memory operands
+ * always use a 32 bit displacement so no base register needs special casing. Jumps take a label
+ * which may be bound later, finalize() patches every rel32 once all labels are bound. */
+class Assembler {
+public:
+	using label = size_t;
+
+	label new_label();
+	void bind(label target);
+	bool bound(label target) const;
+	size_t position() const { return m_code.size(); }
+
+	void push(reg r);
+	void pop(reg r);
+	void ret();
+
+	void mov64(reg dst, reg src);
+	void mov32(reg dst, reg src);
+	void mov32(reg dst, uint32_t imm);
+	void mov16(reg dst, reg src);
+	void movzx16(reg dst, reg src);
+	void movzx16(reg dst, const mem& src);
+	void movsx16(reg dst, reg src);
+	void movsx16(reg dst, const mem& src);
+	void store16(const mem& dst, reg src);
+	void store16(const mem& dst, uint16_t imm);
+
+	void add16(reg dst, int16_t imm);
+	void sub16(reg dst, int16_t imm);
+	void add32(reg dst, reg src);
+	void add32(reg dst, int32_t imm);
+	void sub32(reg dst, reg src);
+	void sub32(reg dst, int32_t imm);
+	void imul32(reg dst, reg src);
+	void cmp32(reg a, reg b);
+	void cmp32(reg a, int32_t imm);
+	void test32(reg a, reg b);
+	void test16(reg a, reg b);
+	void cdq();
+	void idiv32(reg divisor);
+
+	void jmp(label target);
+	void jmp(reg target);
+	void jcc(condition cc, label target);
+
+	// Resolves every jump, returns the finished code.
+	const std::vector<uint8_t>& finalize();
+
+private:
+	void emit(uint8_t byte) { m_code.push_back(byte); }
+	void emit32(uint32_t value);
+	void rex(bool wide, uint8_t r, uint8_t x, uint8_t b, bool force = false);
+	void rex_mem(bool wide, uint8_t r, const mem& m);
+	void modrm_reg(uint8_t r, uint8_t rm);
+	void modrm_mem(uint8_t r, const mem& m);
+	void alu32(uint8_t opcode, reg dst, reg src);
+	void alu32_imm(uint8_t ext, reg dst, int32_t imm);
+	void alu16_imm(uint8_t ext, reg dst, int16_t imm);
+	void rel32(label target);
+
+	std::vector<uint8_t> m_code;
+	std::vector<int64_t> m_labels;
+	std::vector<std::pair<size_t, label>> m_fixups;
+};
+
+} // namespace x64
+} // namespace ciph
@@ -3,17 +3,43 @@ set(VM_INC_DIR ${CMAKE_CURRENT_LIST_DIR}/inc)
 
 set(VM_SRC 
     ${VM_SRC}
+    ${VM_SRC_DIR}/batch.cpp
+    ${VM_SRC_DIR}/batch_avx2.cpp
+    ${VM_SRC_DIR}/decoder.cpp
+    ${VM_SRC_DIR}/green.cpp
     ${VM_SRC_DIR}/instructions.cpp
+    ${VM_SRC_DIR}/interpreter.cpp
+    ${VM_SRC_DIR}/jit.cpp
+    ${VM_SRC_DIR}/jit_emitter.cpp
+    ${VM_SRC_DIR}/memory_pool.cpp
+    ${VM_SRC_DIR}/tracing.cpp
+    ${VM_SRC_DIR}/verifier.cpp
+    ${VM_SRC_DIR}/vm_pool.cpp
+    ${VM_SRC_DIR}/x64_assembler.cpp
 
     ${VM_SRC_DIR}/processing_unit.cpp    
 )
 
 set(VM_INC 
     ${VM_INC}
+    ${VM_INC_DIR}/batch.hpp
+    ${VM_INC_DIR}/batch_lanes.hpp
+    ${VM_INC_DIR}/batch_machine.hpp
+    ${VM_INC_DIR}/decoded_ops.hpp
+    ${VM_INC_DIR}/decoder.hpp
     ${VM_INC_DIR}/execution_context.hpp    
+    ${VM_INC_DIR}/green.hpp
     ${VM_INC_DIR}/instructions.hpp
+    ${VM_INC_DIR}/interpreter.hpp
+    ${VM_INC_DIR}/jit.hpp
+    ${VM_INC_DIR}/jit_emitter.hpp
     ${VM_INC_DIR}/memory.hpp
-    ${VM_INC_DIR}/processing_unit.hpp    
+    ${VM_INC_DIR}/memory_pool.hpp
+    ${VM_INC_DIR}/processing_unit.hpp
+    ${VM_INC_DIR}/tracing.hpp
+    ${VM_INC_DIR}/verifier.hpp
+    ${VM_INC_DIR}/vm_pool.hpp
+    ${VM_INC_DIR}/x64_assembler.hpp
 )
 
 set(VM_ALL_SRC 
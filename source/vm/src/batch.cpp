@@ -0,0 +1,192 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "batch_machine.hpp"
+#include "processing_unit.hpp"
+
+using namespace ciph;
+
+namespace {
+
+// VM memory of one ProcessingUnit, the stack of an instance can't grow past it.
+constexpr size_t memory_size = Memory::default_size;
+
+// Lane operations on plain arrays, written so the compiler is free to vectorize them itself.
+struct scalar_lanes {
+    using lane_vector = batch::lane_vector;
+
+    static void mask(uint16_t bits, lane_vector& out) {
+        for (size_t lane = 0; lane < batch::width; lane++)
+            out.lane[lane] = static_cast<int16_t>((bits >> lane & 1) ? -1 : 0);
+    }
+
+    static void fill(lane_vector& dst, int16_t value, const lane_vector& mask) {
+        for (size_t lane = 0; lane < batch::width; lane++)
+            dst.lane[lane] = static_cast<int16_t>((value & mask.lane[lane]) | (dst.lane[lane] & ~mask.lane[lane]));
+    }
+
+    static void copy(lane_vector& dst, const lane_vector& src, const lane_vector& mask) {
+        for (size_t lane = 0; lane < batch::width; lane++)
+            dst.lane[lane] = static_cast<int16_t>((src.lane[lane] & mask.lane[lane]) | (dst.lane[lane] & ~mask.lane[lane]));
+    }
+
+    static void add(lane_vector& dst, const lane_vector& a, const lane_vector& b, const lane_vector& mask) {
+        for (size_t lane = 0; lane < batch::width; lane++)
+            blend(dst, lane, a.lane[lane] + b.lane[lane], mask);
+    }
+
+    static void add(lane_vector& dst, const lane_vector& a, int16_t b, const lane_vector& mask) {
+        for (size_t lane = 0; lane < batch::width; lane++)
+            blend(dst, lane, a.lane[lane] + b, mask);
+    }
+
+    static void sub(lane_vector& dst, const lane_vector& a, const lane_vector& b, const lane_vector& mask) {
+        for (size_t lane = 0; lane < batch::width; lane++)
+            blend(dst, lane, a.lane[lane] - b.lane[lane], mask);
+    }
+
+    static void mul(lane_vector& dst, const lane_vector& a, const lane_vector& b, const lane_vector& mask) {
+        for (size_t lane = 0; lane < batch::width; lane++)
+            blend(dst, lane, a.lane[lane] * b.lane[lane], mask);
+    }
+
+    static uint16_t negative(const lane_vector& a) {
+        uint16_t bits = 0;
+        for (size_t lane = 0; lane < batch::width; lane++)
+            bits |= static_cast<uint16_t>((a.lane[lane] < 0 ? 1u : 0u) << lane);
+        return bits;
+    }
+
+    static uint16_t zero(const lane_vector& a) {
+        uint16_t bits = 0;
+        for (size_t lane = 0; lane < batch::width; lane++)
+            bits |= static_cast<uint16_t>((a.lane[lane] == 0 ? 1u : 0u) << lane);
+        return bits;
+    }
+
+private:
+    // Narrows the int result like the VM's i16 and keeps the lanes outside mask.
+    static void blend(lane_vector& dst, size_t lane, int value, const lane_vector& mask) {
+        int16_t result = i16(value);
+        dst.lane[lane] = static_cast<int16_t>((result & mask.lane[lane]) | (dst.lane[lane] & ~mask.lane[lane]));
+    }
+};
+
+} // namespace
+
+void
+batch::run_scalar(const decoded_instruction* code, lane_state& state) {
+    LaneMachine<scalar_lanes>(code, state).run();
+}
+
+bool
+batch::avx2_supported() {
+#if CIPH_HAS_AVX2
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+BatchExecutor::BatchExecutor()
+    : m_registers(+registers::def::reg_cnt) {
+    m_backend = batch::avx2_supported() ? batch::backend::avx2 : batch::backend::scalar;
+}
+
+void
+BatchExecutor::load_program(uint8_t* program, uint16_t size) {
+    m_bytes = std::make_shared<const std::vector<uint8_t>>(program, program + size);
+
+    // lay the program out exactly like a ProcessingUnit does, the fallback runs on one.
+    ProcessingUnit unit;
+    unit.load_program(m_bytes);
+    m_program = unit.program();
+    std::copy_n(unit.registries(), m_initial.size(), m_initial.begin());
+
+    uint16_t fp = m_initial[+registers::def::fp];
+    m_entry = m_program.index_of(m_initial[+registers::def::pc]);
+    m_stack.assign(fp < memory_size ? (memory_size - fp) / 2 : 0, batch::lane_vector{});
+
+    m_state = batch::lane_state{};
+    m_state.registers = m_registers.data();
+    m_state.stack = m_stack.data();
+    m_state.capacity = static_cast<uint16_t>(m_stack.size());
+    m_state.fp = fp;
+    m_state.bp = m_initial[+registers::def::bp];
+    m_state.pc = m_initial[+registers::def::pc];
+    m_state.entry = m_entry;
+}
+
+void
+BatchExecutor::set_backend(batch::backend backend) {
+    m_backend = backend == batch::backend::avx2 && batch::avx2_supported() ? batch::backend::avx2 : batch::backend::scalar;
+}
+
+batch::result
+BatchExecutor::execute(size_t instances) {
+    return execute(std::vector<batch::inputs>(instances, batch::inputs{}));
+}
+
+batch::result
+BatchExecutor::execute(const std::vector<batch::inputs>& inputs) {
+    batch::result out;
+    out.return_values.assign(inputs.size(), 0);
+    out.traps.assign(inputs.size(), trap_code::none);
+    for (size_t first = 0; first < inputs.size(); first += batch::width)
+        run_group(inputs.data() + first, std::min(batch::width, inputs.size() - first), first, out);
+    return out;
+}
+
+void
+BatchExecutor::run_group(const batch::inputs* inputs, size_t count, size_t first, batch::result& out) {
+    if (m_entry == decoded_program::halt) {
+        std::fill_n(out.traps.begin() + static_cast<std::ptrdiff_t>(first), count, trap_code::invalid_instruction);
+        return;
+    }
+
+    // words left on the stack by the last group would be visible through peeks above sp.
+    std::fill_n(m_stack.begin(), m_state.dirty, batch::lane_vector{});
+    m_state.dirty = 0;
+    for (uint8_t reg = 0; reg < +registers::def::reg_cnt; reg++)
+        std::fill_n(m_registers[reg].lane, batch::width, static_cast<int16_t>(m_initial[reg]));
+    for (size_t lane = 0; lane < count; lane++) {
+        for (size_t reg = 0; reg < inputs[lane].size(); reg++)
+            m_registers[+registers::def::r0 + reg].lane[lane] = inputs[lane][reg];
+    }
+
+    m_state.live = static_cast<uint16_t>((1u << count) - 1);
+    m_state.bailed = 0;
+    std::fill_n(m_state.return_values, batch::width, int16_t(0));
+    std::fill_n(m_state.traps, batch::width, trap_code::none);
+
+#if CIPH_HAS_AVX2
+    if (m_backend == batch::backend::avx2)
+        batch::run_avx2(m_program.instructions.data(), m_state);
+    else
+#endif
+        batch::run_scalar(m_program.instructions.data(), m_state);
+
+    for (size_t lane = 0; lane < count; lane++) {
+        if (m_state.bailed >> lane & 1) {
+            out.return_values[first + lane] = fallback(inputs[lane], out.traps[first + lane]);
+            out.fallbacks++;
+        }
+        else {
+            out.return_values[first + lane] = m_state.return_values[lane];
+            out.traps[first + lane] = m_state.traps[lane];
+        }
+    }
+}
+
+int16_t
+BatchExecutor::fallback(const batch::inputs& input, trap_code& trap) const {
+    ProcessingUnit unit;
+    unit.load_program(m_bytes);
+    for (size_t reg = 0; reg < input.size(); reg++)
+        unit.registries()[+registers::def::r0 + reg] = static_cast<uint16_t>(input[reg]);
+    int16_t result = unit.execute();
+    trap = unit.context().trap;
+    return result;
+}
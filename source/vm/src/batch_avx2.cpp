@@ -0,0 +1,102 @@
+#include "batch_lanes.hpp"
+
+#if CIPH_HAS_AVX2
+#include <immintrin.h>
+
+/*
+ * Everything from here on is compiled for AVX2 and may only run once batch::avx2_supported() said
+ * yes. The headers above are included first so nothing shared with the rest of the VM picks it up. */
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+#include "batch_machine.hpp"
+
+using namespace ciph;
+
+namespace {
+
+struct avx2_lanes {
+    using lane_vector = batch::lane_vector;
+
+    static void mask(uint16_t bits, lane_vector& out) {
+        const __m256i lane_bits = _mm256_setr_epi16(0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+                                                    0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000,
+                                                    static_cast<short>(0x8000));
+        __m256i selected = _mm256_and_si256(_mm256_set1_epi16(static_cast<short>(bits)), lane_bits);
+        store(out, _mm256_cmpeq_epi16(selected, lane_bits));
+    }
+
+    static void fill(lane_vector& dst, int16_t value, const lane_vector& mask) {
+        blend(dst, _mm256_set1_epi16(value), mask);
+    }
+
+    static void copy(lane_vector& dst, const lane_vector& src, const lane_vector& mask) {
+        blend(dst, load(src), mask);
+    }
+
+    static void add(lane_vector& dst, const lane_vector& a, const lane_vector& b, const lane_vector& mask) {
+        blend(dst, _mm256_add_epi16(load(a), load(b)), mask);
+    }
+
+    static void add(lane_vector& dst, const lane_vector& a, int16_t b, const lane_vector& mask) {
+        blend(dst, _mm256_add_epi16(load(a), _mm256_set1_epi16(b)), mask);
+    }
+
+    static void sub(lane_vector& dst, const lane_vector& a, const lane_vector& b, const lane_vector& mask) {
+        blend(dst, _mm256_sub_epi16(load(a), load(b)), mask);
+    }
+
+    static void mul(lane_vector& dst, const lane_vector& a, const lane_vector& b, const lane_vector& mask) {
+        blend(dst, _mm256_mullo_epi16(load(a), load(b)), mask);
+    }
+
+    static uint16_t negative(const lane_vector& a) {
+        return lane_bits(_mm256_srai_epi16(load(a), 15));
+    }
+
+    static uint16_t zero(const lane_vector& a) {
+        return lane_bits(_mm256_cmpeq_epi16(load(a), _mm256_setzero_si256()));
+    }
+
+private:
+    static __m256i load(const lane_vector& v) {
+        return _mm256_load_si256(reinterpret_cast<const __m256i*>(v.lane));
+    }
+
+    static void store(lane_vector& v, __m256i value) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(v.lane), value);
+    }
+
+    static void blend(lane_vector& dst, __m256i value, const lane_vector& mask) {
+        store(dst, _mm256_blendv_epi8(load(dst), value, load(mask)));
+    }
+
+    // One bit per lane of a vector holding 0 or -1 in every lane.
+    static uint16_t lane_bits(__m256i lanes) {
+        // movemask gives two equal bits per 16 bit lane, keep every other one and pack them.
+        uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(lanes)) & 0x55555555u;
+        bits = (bits | (bits >> 1)) & 0x33333333u;
+        bits = (bits | (bits >> 2)) & 0x0F0F0F0Fu;
+        bits = (bits | (bits >> 4)) & 0x00FF00FFu;
+        bits = (bits | (bits >> 8)) & 0x0000FFFFu;
+        return static_cast<uint16_t>(bits);
+    }
+};
+
+} // namespace
+
+void
+batch::run_avx2(const decoded_instruction* code, lane_state& state) {
+    LaneMachine<avx2_lanes>(code, state).run();
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
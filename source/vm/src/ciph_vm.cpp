@@ -5,6 +5,7 @@
 #include <iostream>
 #include <variant>
 
+#include "byte_order.hpp"
 #include "code_generator.hpp"
 #include "disassembler.hpp"
 //#include "error_reporter.hpp"
@@ -54,10 +55,8 @@ PrintStack(ProcessingUnit& pu, int x, int y) {
     uint16_t stackEnd = pu.registries()[+registers::def::fp];
 
     while (stackTop > stackEnd) {
-        int16_t value = 0;
-
-        value = (value << 8) | pu.memory()[--stackTop];
-        value = (value << 8) | pu.memory()[--stackTop];
+        stackTop -= 2;
+        int16_t value = byte_order::load_word(&pu.memory()[stackTop]);
         gotoxy(x, ++y);
         fmt::println("0x{} [offset: {}] {:04X}", stackTop, stackSize - ++cnt, value);
     }
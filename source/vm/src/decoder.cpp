@@ -0,0 +1,427 @@
+#include "decoder.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+#include <byte_order.hpp>
+
+#include "instructions.hpp"
+
+using namespace ciph;
+
+uint16_t
+decoded_program::index_of(uint16_t pc) const {
+    auto itr = std::lower_bound(byte_pc.begin(), byte_pc.end(), pc);
+    if (itr == byte_pc.end() || *itr != pc || itr == byte_pc.end() - 1)
+        return halt;
+    return static_cast<uint16_t>(itr - byte_pc.begin());
+}
+
+namespace {
+
+decoded_instruction
+make_trap() {
+    decoded_instruction trap;
+    trap.opcode = decoder::invalid_opcode;
+    trap.handler = instruction::decoded::trap_handler;
+    return trap;
+}
+
+/*
+ * Decodes the instruction at position, returns its length in bytes or 0 if the operands
+ * run past the end of the program. Mirrors how far each byte handler advances pc. */
+uint16_t
+decode_instruction(const uint8_t* program, uint16_t size, uint16_t position, decoded_instruction& out) {
+    using instruction::def;
+    namespace decoded = instruction::decoded;
+
+    auto operands = [&](uint16_t count) { return position + count < size; };
+    // register operands index the register file directly, anything past it decodes into a trap.
+    auto in_range = [&](std::initializer_list<uint8_t> regs) {
+        for (uint8_t reg : regs) {
+            if (reg >= +registers::def::reg_cnt) {
+                out = make_trap();
+                return false;
+            }
+        }
+        return true;
+    };
+    out.opcode = static_cast<def>(program[position]);
+
+    switch (out.opcode) {
+        case def::PSH: out.handler = decoded::push_handler; return 1;
+        case def::ADD: out.handler = decoded::add_handler; return 1;
+        case def::SUB: out.handler = decoded::sub_handler; return 1;
+        case def::MUL: out.handler = decoded::mul_handler; return 1;
+        case def::DIV: out.handler = decoded::div_handler; return 1;
+        case def::RET: out.handler = decoded::return_handler; return 1;
+        case def::JEQ: out.handler = decoded::jump_eq_handler; return 1;
+        case def::JNZ: out.handler = decoded::jump_nz_handler; return 1;
+        case def::JGT: out.handler = decoded::jump_gt_handler; return 1;
+
+        case def::PSH_REG:
+        case def::POP_REG:
+        case def::PEK_REG:
+        case def::PUT_REG:
+        case def::CMP: {
+            if (operands(1) == false)
+                return 0;
+            out.reg_a = program[position + 1];
+            if (in_range({ out.reg_a }) == false)
+                return 2;
+            if (out.opcode == def::PSH_REG)
+                out.handler = decoded::push_reg_handler;
+            else if (out.opcode == def::POP_REG)
+                out.handler = decoded::pop_reg_handler;
+            else if (out.opcode == def::PEK_REG)
+                out.handler = decoded::peek_handler;
+            else if (out.opcode == def::PUT_REG)
+                out.handler = decoded::put_reg_handler;
+            else
+                out.handler = decoded::cmp_handler;
+            return 2;
+        }
+
+        case def::INC:
+        case def::DEC: {
+            if (operands(1) == false)
+                return 0;
+            out.reg_a = program[position + 1];
+            if (in_range({ out.reg_a }) == false)
+                return 2;
+            out.handler = out.opcode == def::INC ? decoded::inc_handler : decoded::dec_handler;
+            if (out.reg_a != +registers::def::sp)
+                return 2;
+            if (operands(2) == false)
+                return 0;
+            out.literal = program[position + 2];
+            return 3;
+        }
+
+        case def::PSH_LIT:
+        case def::PUT_LIT:
+        case def::MOV_MEM:
+        case def::PSH_MEM:
+        case def::JLT:
+        case def::CALL: {
+            if (operands(2) == false)
+                return 0;
+            // a literal, a memory address, a branch offset or a call address.
+            out.literal = byte_order::load_operand(&program[position + 1]);
+            if (out.opcode == def::PSH_LIT)
+                out.handler = decoded::push_literal_handler;
+            else if (out.opcode == def::PUT_LIT)
+                out.handler = decoded::put_literal_handler;
+            else if (out.opcode == def::MOV_MEM)
+                out.handler = decoded::mov_mem_handler;
+            else if (out.opcode == def::PSH_MEM)
+                out.handler = decoded::push_mem_handler;
+            else if (out.opcode == def::JLT)
+                out.handler = decoded::jump_lt_handler;
+            else
+                out.handler = decoded::call_handler;
+            return 3;
+        }
+
+        case def::PEK_OFF: {
+            if (operands(2) == false)
+                return 0;
+            out.reg_a = program[position + 1];
+            out.literal = program[position + 2];
+            if (in_range({ out.reg_a }) == false)
+                return 3;
+            out.handler = decoded::peek_offset_handler;
+            return 3;
+        }
+
+        case def::PEK_ARG: {
+            if (operands(2) == false)
+                return 0;
+            out.reg_a = program[position + 1];
+            if (in_range({ out.reg_a }) == false)
+                return 3;
+            // only ever decoded to its quickened form, a displacement under the return address.
+            bool local = out.reg_a == +registers::def::sp;
+            out.opcode = local ? def::PEK_LOC : def::PEK_LOC_REG;
+            out.handler = local ? decoded::peek_local_handler : decoded::peek_local_reg_handler;
+            out.literal = static_cast<int16_t>(-(program[position + 2] * 2) - 4);
+            return 3;
+        }
+
+        case def::MOV:
+        case def::ADD_REG:
+        case def::SUB_REG:
+        case def::MUL_REG:
+        case def::DIV_REG: {
+            if (operands(2) == false)
+                return 0;
+            out.reg_a = program[position + 1];
+            out.reg_b = program[position + 2];
+            if (in_range({ out.reg_a, out.reg_b }) == false)
+                return 3;
+            if (out.opcode == def::MOV)
+                out.handler = decoded::mov_handler;
+            else if (out.opcode == def::ADD_REG)
+                out.handler = decoded::add_reg_handler;
+            else if (out.opcode == def::SUB_REG)
+                out.handler = decoded::sub_reg_handler;
+            else if (out.opcode == def::MUL_REG)
+                out.handler = decoded::mul_reg_handler;
+            else
+                out.handler = decoded::div_reg_handler;
+            return 3;
+        }
+
+        default:
+            // unknown opcodes trap, nothing after them is reachable by falling through.
+            out = make_trap();
+            return 1;
+    }
+}
+
+bool
+is_local_peek(const decoded_instruction& instr) {
+    return instr.opcode == instruction::def::PEK_OFF && instr.reg_a == +registers::def::sp;
+}
+
+bool
+is_stack_binary(const decoded_instruction& instr) {
+    using instruction::def;
+    return instr.opcode == def::ADD || instr.opcode == def::SUB || instr.opcode == def::MUL ||
+           instr.opcode == def::DIV;
+}
+
+// PEK_OFF sp, n; PEK_OFF sp, m; <op>
+bool
+fuse_local_binary(const decoded_instruction* code, decoded_instruction& out) {
+    using instruction::def;
+    namespace decoded = instruction::decoded;
+    if (is_local_peek(code[0]) == false || is_local_peek(code[1]) == false || is_stack_binary(code[2]) == false)
+        return false;
+
+    out = decoded_instruction{};
+    out.reg_a = static_cast<uint8_t>(code[0].literal);
+    out.reg_b = static_cast<uint8_t>(code[1].literal);
+    switch (code[2].opcode) {
+        case def::ADD: out.opcode = def::ADD_OFF; out.handler = decoded::add_offset_handler; break;
+        case def::SUB: out.opcode = def::SUB_OFF; out.handler = decoded::sub_offset_handler; break;
+        case def::MUL: out.opcode = def::MUL_OFF; out.handler = decoded::mul_offset_handler; break;
+        default: out.opcode = def::DIV_OFF; out.handler = decoded::div_offset_handler; break;
+    }
+    return true;
+}
+
+// PSH_LIT a; PSH_LIT b; <op> folds into PSH_LIT (a op b).
+bool
+fuse_literal_binary(const decoded_instruction* code, decoded_instruction& out) {
+    using instruction::def;
+    if (code[0].opcode != def::PSH_LIT || code[1].opcode != def::PSH_LIT || is_stack_binary(code[2]) == false)
+        return false;
+
+    int16_t a = code[0].literal;
+    int16_t b = code[1].literal;
+    int16_t value = 0;
+    switch (code[2].opcode) {
+        case def::ADD: value = i16(a + b); break;
+        case def::SUB: value = i16(a - b); break;
+        case def::MUL: value = i16(a * b); break;
+        default:
+            if (b == 0)
+                return false; // leave the division to trap at runtime.
+            value = i16(a / b);
+            break;
+    }
+
+    out = code[0];
+    out.literal = value;
+    return true;
+}
+
+// PEK_OFF sp, n; PSH_LIT lit; CMP sp; JLT target
+bool
+fuse_loop_condition(const decoded_instruction* code, decoded_instruction& out) {
+    using instruction::def;
+    if (is_local_peek(code[0]) == false || code[1].opcode != def::PSH_LIT || code[2].opcode != def::CMP ||
+        code[2].reg_a != +registers::def::sp || code[3].opcode != def::JLT)
+        return false;
+
+    out = decoded_instruction{};
+    out.opcode = def::JLT_OFF;
+    out.handler = instruction::decoded::jump_lt_offset_handler;
+    out.reg_a = static_cast<uint8_t>(code[0].literal);
+    out.literal = code[1].literal;
+    out.target = code[3].target;
+    return true;
+}
+
+// Branches and calls, the instructions target is resolved for.
+bool
+has_target(const decoded_instruction& instr) {
+    using instruction::def;
+    return instr.opcode == def::JLT || instr.opcode == def::JLT_OFF || instr.opcode == def::CALL;
+}
+
+} // namespace
+
+uint16_t
+decoder::fuse(decoded_program& program) {
+    const std::vector<decoded_instruction>& code = program.instructions;
+    size_t count = code.size();
+
+    std::vector<bool> isTarget(count, false);
+    for (const decoded_instruction& instr : code) {
+        if (has_target(instr))
+            isTarget[instr.target] = true;
+    }
+
+    // no instruction after the first one of a sequence may be a branch target.
+    auto fusable = [&](size_t at, size_t length) {
+        if (at + length > count)
+            return false;
+        for (size_t i = at + 1; i < at + length; i++) {
+            if (isTarget[i])
+                return false;
+        }
+        return true;
+    };
+
+    decoded_program fused;
+    fused.instructions.reserve(count);
+    fused.byte_pc.reserve(count + 1);
+    std::vector<uint16_t> remap(count, decoded_program::halt);
+
+    size_t i = 0;
+    while (i < count) {
+        remap[i] = static_cast<uint16_t>(fused.instructions.size());
+        fused.byte_pc.push_back(program.byte_pc[i]);
+
+        decoded_instruction out;
+        size_t length = 1;
+        if (fusable(i, 4) && fuse_loop_condition(&code[i], out))
+            length = 4;
+        else if (fusable(i, 3) && (fuse_local_binary(&code[i], out) || fuse_literal_binary(&code[i], out)))
+            length = 3;
+        else
+            out = code[i];
+
+        fused.instructions.push_back(out);
+        if (length > 1)
+            fused.fusions++;
+        i += length;
+    }
+    fused.byte_pc.push_back(program.byte_pc.back());
+
+    for (decoded_instruction& instr : fused.instructions) {
+        if (has_target(instr))
+            instr.target = remap[instr.target];
+    }
+
+    measure_blocks(fused);
+    fused.fusions += program.fusions;
+    fused.quickened = program.quickened;
+    program = std::move(fused);
+    return program.fusions;
+}
+
+uint16_t
+decoder::quicken(decoded_program& program) {
+    using instruction::def;
+    namespace decoded = instruction::decoded;
+    for (decoded_instruction& instr : program.instructions) {
+        bool local = instr.reg_a == +registers::def::sp;
+        switch (instr.opcode) {
+            case def::PEK_OFF:
+                instr.opcode = local ? def::PEK_LOC : def::PEK_LOC_REG;
+                instr.handler = local ? decoded::peek_local_handler : decoded::peek_local_reg_handler;
+                break;
+            case def::INC:
+                if (local == false)
+                    continue;
+                instr.opcode = def::INC_LOC;
+                instr.handler = decoded::inc_local_handler;
+                break;
+            case def::DEC:
+                if (local == false)
+                    continue;
+                instr.opcode = def::DEC_LOC;
+                instr.handler = decoded::dec_local_handler;
+                break;
+            default:
+                continue;
+        }
+        instr.literal = static_cast<int16_t>(instr.literal * 2 + 2);
+        program.quickened++;
+    }
+    return program.quickened;
+}
+
+void
+decoder::measure_blocks(decoded_program& program) {
+    using instruction::def;
+    size_t count = program.instructions.size();
+    program.block_cost.assign(count, 0);
+    program.largest_block = 0;
+    uint16_t run = 0;
+    for (size_t i = count; i-- > 0;) {
+        def opcode = program.instructions[i].opcode;
+        bool ends = opcode == def::JLT || opcode == def::JLT_OFF || opcode == def::CALL || opcode == def::RET ||
+                    opcode == invalid_opcode;
+        run = ends ? 1 : static_cast<uint16_t>(run + 1);
+        program.block_cost[i] = run;
+        program.largest_block = std::max(program.largest_block, run);
+    }
+}
+
+decoded_program
+decoder::decode(const uint8_t* program, uint16_t size, uint16_t base, bool fuse_superinstructions,
+                bool quicken_instructions) {
+    decoded_program result;
+    result.instructions.reserve(size);
+    result.byte_pc.reserve(size + 1);
+
+    uint16_t position = 0;
+    while (position < size) {
+        decoded_instruction instr;
+        uint16_t length = decode_instruction(program, size, position, instr);
+        result.byte_pc.push_back(static_cast<uint16_t>(base + position));
+        if (length == 0) {
+            result.instructions.push_back(make_trap());
+            position = size;
+            break;
+        }
+        result.instructions.push_back(instr);
+        position += length;
+    }
+    result.byte_pc.push_back(static_cast<uint16_t>(base + position));
+
+    // resolve branches and calls now that every instruction boundary is known.
+    for (size_t i = 0; i < result.instructions.size(); i++) {
+        decoded_instruction& instr = result.instructions[i];
+        uint16_t destination = 0;
+        if (instr.opcode == instruction::def::JLT) {
+            // the byte handler leaves pc on the last operand byte, subtracts and the loop steps once.
+            destination = static_cast<uint16_t>(result.byte_pc[i] + 3 - instr.literal);
+        }
+        else if (instr.opcode == instruction::def::CALL) {
+            destination = static_cast<uint16_t>(base + instr.literal);
+            // what CALL pushes, the operand isn't needed once the target is known.
+            instr.literal = static_cast<int16_t>(result.byte_pc[i + 1]);
+        }
+        else {
+            continue;
+        }
+
+        uint16_t target = result.index_of(destination);
+        if (target == decoded_program::halt)
+            instr = make_trap();
+        else
+            instr.target = target;
+    }
+
+    if (fuse_superinstructions)
+        fuse(result);
+    else
+        measure_blocks(result);
+    if (quicken_instructions)
+        quicken(result);
+    return result;
+}
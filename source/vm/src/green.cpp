@@ -0,0 +1,90 @@
+#include "green.hpp"
+
+#include <algorithm>
+
+#include "interpreter.hpp"
+#include "processing_unit.hpp"
+
+using namespace ciph;
+
+std::shared_ptr<const green::image>
+green::make_image(const uint8_t* program, uint16_t size) {
+    auto result = std::make_shared<image>();
+    result->bytes.assign(program, program + size);
+
+    // lay the program out exactly like a ProcessingUnit does so results and addresses match, VMs
+    // size their own memory so the layout comes from the largest one.
+    ProcessingUnit unit(Memory::max_size);
+    unit.load_program(program, size);
+    result->program = unit.program();
+    result->base = unit.registries()[+registers::def::bp];
+    result->stack = unit.registries()[+registers::def::fp];
+    result->verification = unit.verification();
+    return result;
+}
+
+GreenScheduler::GreenScheduler(green::options options)
+    : m_options(options) {
+}
+
+green::vm_id
+GreenScheduler::spawn(std::shared_ptr<const green::image> program, const green::inputs& inputs) {
+    auto state = std::make_unique<vm>();
+    const green::image& image = *program;
+    size_t bytes = std::min<size_t>(static_cast<size_t>(image.stack) + m_options.stack_bytes, Memory::max_size);
+    state->memory = std::make_unique<uint8_t[]>(bytes);
+    state->memory_size = static_cast<uint32_t>(bytes);
+    state->checked = image.verification.fits(state->memory_size) == false;
+
+    uint16_t* registry = reinterpret_cast<uint16_t*>(state->memory.get());
+    registry[+registers::def::pc] = image.base;
+    registry[+registers::def::bp] = image.base;
+    registry[+registers::def::sp] = image.stack;
+    registry[+registers::def::fp] = image.stack;
+    for (size_t reg = 0; reg < inputs.size(); reg++)
+        registry[+registers::def::r0 + reg] = static_cast<uint16_t>(inputs[reg]);
+    state->context = ExecutionContext(registry, state->memory.get(), image.bytes.data(), image.base);
+    state->program = std::move(program);
+
+    uint32_t quantum = std::max<uint32_t>(m_options.quantum, image.program.largest_block);
+    state->body = run_vm(*state, quantum);
+    m_ready.push_back(state->body.handle());
+    m_vms.push_back(std::move(state));
+    return m_vms.size() - 1;
+}
+
+size_t
+GreenScheduler::run_once() {
+    for (size_t count = m_ready.size(); count > 0; count--) {
+        std::coroutine_handle<> handle = m_ready.front();
+        m_ready.pop_front();
+        handle.resume();
+        if (handle.done() == false)
+            m_ready.push_back(handle);
+    }
+    return m_ready.size();
+}
+
+void
+GreenScheduler::run() {
+    while (run_once() > 0) {
+    }
+}
+
+green::task
+GreenScheduler::run_vm(vm& state, uint32_t quantum) {
+    for (;;) {
+        uint32_t fuel = quantum;
+        const decoded_program& program = state.program->program;
+        run_status status = state.checked ? interpreter::run_checked(state.context, program, state.memory_size, fuel)
+                                          : interpreter::run_metered(state.context, program, fuel);
+        if (status != run_status::out_of_fuel) {
+            state.outcome.status = status;
+            state.outcome.return_value = state.context.return_value;
+            state.outcome.trap = state.context.trap;
+            co_return;
+        }
+        // out of fuel on a block boundary, pc is where the next resume continues.
+        co_await std::suspend_always{};
+    }
+}
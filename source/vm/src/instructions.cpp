@@ -1,59 +1,60 @@
 #include "instructions.hpp"
 
 #include <functional>
+#include <byte_order.hpp>
 
+#include "decoded_ops.hpp"
 #include "processing_unit.hpp"
 
 using namespace ciph;
 
-template <typename T, size_t N = sizeof(T)>
-T
-read(uint8_t* bytecode, uint16_t& pc) {
-    uint8_t value[N]{0};
-    for (size_t i = 0; i < N; i++) {
-        value[i] |= bytecode[++pc];
-    }
+namespace {
+
+// Operand word starting at pc, pc is left on its last byte.
+int16_t
+read_operand(const ExecutionContext& context, uint16_t& pc) {
+    int16_t value = context.operand_at(pc);
+    pc++;
+    return value;
+}
 
-    return *reinterpret_cast<T*>(value);
+// Same as trap_handler, pc is left on the DIV or DIV_REG opcode once the dispatch loop advances it.
+void
+division_by_zero(ExecutionContext& context) {
+    context.trap = trap_code::division_by_zero;
+    context.registry[+registers::def::pc]--;
 }
 
+} // namespace
+
 int16_t
 instruction::stack_read_at_offset(uint8_t* bytecode, uint16_t& sp) {
-    int16_t value = 0;
-    value = (value << 8) | bytecode[--sp];
-    value = (value << 8) | bytecode[--sp];
-    return value;
+    sp = u16(sp - 2);
+    return byte_order::load_word(&bytecode[sp]);
 }
 
 int16_t
 instruction::read_word(uint8_t* bytecode, uint16_t& pc) {
-    int16_t value = 0;
-    value = (value << 8) | bytecode[pc];
-    value = (value << 8) | bytecode[++pc];
+    int16_t value = byte_order::load_operand(&bytecode[pc]);
+    pc++;
     return value;
 }
 
 void
 instruction::write_int16(uint8_t* bytecode, uint16_t& pc, int16_t value) {
-    bytecode[pc++] = static_cast<uint8_t>(value & u8(0xFF));
-    bytecode[pc++] = static_cast<uint8_t>((value >> 8) & u8(0xFF));
+    byte_order::store_word(&bytecode[pc], value);
+    pc = u16(pc + 2);
 }
 
 int16_t
 instruction::pop_helper(ExecutionContext& context) {
     uint16_t& sp = context.registry[+registers::def::sp];
-    int16_t value = 0;
-    value = (value << 8) | context.bytecode[--sp];
-    value = (value << 8) | context.bytecode[--sp];
-    return value;
+    return stack_read_at_offset(context.bytecode, sp);
 }
 
 int16_t
 instruction::peek_helper(uint8_t* bytecode, uint16_t sp) {
-    int16_t value = 0;
-    value = (value << 8) | bytecode[--sp];
-    value = (value << 8) | bytecode[--sp];
-    return value;
+    return stack_read_at_offset(bytecode, sp);
 }
 
 void
@@ -69,11 +70,12 @@ instruction::push_helper_reg(ExecutionContext& context, registers::def reg) {
 }
 
 /*
- * The binary_stack_expression function is a helper function that takes a lambda function that
- * represents the binary operation. Assumes that rhs will be ontop of stack and lhs underneath.
- * pushes back the result onto the stack */
+ * The binary_stack_expression function is a helper function templated on the functor that
+ * represents the binary operation, so every arithmetic handler compiles down to its own loop-free
+ * body. Assumes that rhs will be ontop of stack and lhs underneath. pushes back the result onto the stack */
+template <typename Op>
 void
-binary_stack_expression(ExecutionContext& context, std::function<int16_t(int16_t, int16_t)> op) {
+binary_stack_expression(ExecutionContext& context, Op op) {
     // b will be the top of the stack
     int16_t b = instruction::pop_helper(context);
 
@@ -84,30 +86,73 @@ binary_stack_expression(ExecutionContext& context, std::function<int16_t(int16_t
     instruction::push_helper(context, op(a, b));
 }
 
+/*
+ * Register form of binary_stack_expression, reads rX and rY from the operands and puts the
+ * result into rX. Passing imm as rY gives the "rY unspecified" form from shared_defines.hpp. */
+template <typename Op>
+void
+binary_register_expression(ExecutionContext& context, Op op) {
+    uint16_t& pc = context.registry[+registers::def::pc];
+    uint8_t regX = context.code_at(++pc);
+    uint8_t regY = context.code_at(++pc);
+    int16_t a = i16(context.registry[regX]);
+    int16_t b = i16(context.registry[regY]);
+    context.registry[regX] = static_cast<uint16_t>(op(a, b));
+}
+
 void
 instruction::add_handler(ExecutionContext& context) {
-    binary_stack_expression(context, [](int16_t a, int16_t b) { return a + b; });
+    binary_stack_expression(context, std::plus<int16_t>{});
 }
 
 void
 instruction::sub_handler(ExecutionContext& context) {
-    binary_stack_expression(context, [](int16_t a, int16_t b) { return a - b; });
+    binary_stack_expression(context, std::minus<int16_t>{});
 }
 
 void
 instruction::mul_handler(ExecutionContext& context) {
-    binary_stack_expression(context, [](int16_t a, int16_t b) { return a * b; });
+    binary_stack_expression(context, std::multiplies<int16_t>{});
 }
 
 void
 instruction::div_handler(ExecutionContext& context) {
-    binary_stack_expression(context, [](int16_t a, int16_t b) { return a / b; });
+    if (peek_helper(context.bytecode, context.registry[+registers::def::sp]) == 0) {
+        division_by_zero(context);
+        return;
+    }
+    binary_stack_expression(context, std::divides<int16_t>{});
+}
+
+void
+instruction::add_reg_handler(ExecutionContext& context) {
+    binary_register_expression(context, std::plus<int16_t>{});
+}
+
+void
+instruction::sub_reg_handler(ExecutionContext& context) {
+    binary_register_expression(context, std::minus<int16_t>{});
+}
+
+void
+instruction::mul_reg_handler(ExecutionContext& context) {
+    binary_register_expression(context, std::multiplies<int16_t>{});
+}
+
+void
+instruction::div_reg_handler(ExecutionContext& context) {
+    uint16_t pc = context.registry[+registers::def::pc];
+    if (context.registry[context.code_at(u16(pc + 2))] == 0) {
+        division_by_zero(context);
+        return;
+    }
+    binary_register_expression(context, std::divides<int16_t>{});
 }
 
 void
 instruction::peek_handler(ExecutionContext& context) {
     uint16_t& pc = context.registry[+registers::def::pc];
-    uint8_t reg = context.bytecode[++pc];
+    uint8_t reg = context.code_at(++pc);
     uint16_t sp = context.registry[+registers::def::sp];
     int16_t value = peek_helper(context.bytecode, sp); // peek top of stack.
     context.registry[reg] = static_cast<uint16_t>(value);
@@ -121,21 +166,21 @@ instruction::push_handler(ExecutionContext& context) {
 void
 instruction::push_reg_handler(ExecutionContext& context) {
     uint16_t& pc = context.registry[+registers::def::pc];
-    uint8_t reg = context.bytecode[++pc];
+    uint8_t reg = context.code_at(++pc);
     instruction::push_helper(context, i16(context.registry[reg]));
 }
 
 void
 instruction::push_literal_handler(ExecutionContext& context) {
     uint16_t& programCnt = context.registry[+registers::def::pc];
-    int16_t value = read_word(context.bytecode, ++programCnt);
+    int16_t value = read_operand(context, ++programCnt);
     instruction::push_helper(context, value);
 }
 
 void
 instruction::cmp_handler(ExecutionContext& context) {
     uint16_t& programCnt = context.registry[+registers::def::pc];
-    uint8_t reg = context.bytecode[++programCnt];
+    uint8_t reg = context.code_at(++programCnt);
     if (reg == +registers::def::sp) {
         int16_t b = pop_helper(context);
         int16_t a = pop_helper(context);
@@ -146,57 +191,118 @@ instruction::cmp_handler(ExecutionContext& context) {
 void
 instruction::mov_handler(ExecutionContext& context) {
     uint16_t& programCnt = context.registry[+registers::def::pc];
-    uint8_t regX = context.bytecode[++programCnt];
-    uint8_t regY = context.bytecode[++programCnt];
+    uint8_t regX = context.code_at(++programCnt);
+    uint8_t regY = context.code_at(++programCnt);
     context.registry[regX] = context.registry[regY];
 }
 
 void
-instruction::return_handler(ExecutionContext& context) {
-    context.return_value = context.registry[+registers::def::ret];
+instruction::put_reg_handler(ExecutionContext& context) {
+    uint16_t& programCnt = context.registry[+registers::def::pc];
+    uint8_t reg = context.code_at(++programCnt);
+    context.registry[reg] = context.registry[+registers::def::imm];
+}
 
+void
+instruction::put_literal_handler(ExecutionContext& context) {
+    uint16_t& programCnt = context.registry[+registers::def::pc];
+    int16_t value = read_operand(context, ++programCnt);
+    context.registry[+registers::def::imm] = static_cast<uint16_t>(value);
+}
+
+// The operand is the address of a word in VM memory, stored in the same order as the stack.
+void
+instruction::mov_mem_handler(ExecutionContext& context) {
+    uint16_t& programCnt = context.registry[+registers::def::pc];
+    uint16_t address = static_cast<uint16_t>(read_operand(context, ++programCnt));
+    byte_order::store_word(&context.bytecode[address], i16(context.registry[+registers::def::imm]));
+}
+
+void
+instruction::push_mem_handler(ExecutionContext& context) {
+    uint16_t& programCnt = context.registry[+registers::def::pc];
+    uint16_t address = static_cast<uint16_t>(read_operand(context, ++programCnt));
+    push_helper(context, byte_order::load_word(&context.bytecode[address]));
+}
+
+/*
+ * Frame of a call, from the caller's sp up: return address, the caller's fp, then the callee's
+ * stack with fp pointing at its first word. The callee's locals are addressed from there just like
+ * the program's own are from the stack base, arguments the caller pushed sit right under the
+ * return address, see PEK_ARG. */
+void
+instruction::call_handler(ExecutionContext& context) {
+    uint16_t& pc = context.registry[+registers::def::pc];
+    uint16_t address = static_cast<uint16_t>(read_operand(context, ++pc));
+    push_helper(context, i16(pc + 1));
+    push_helper_reg(context, registers::def::fp);
+    context.registry[+registers::def::fp] = context.registry[+registers::def::sp];
+    context.registry[+registers::def::cd]++;
+    pc = u16(context.registry[+registers::def::bp] + address - 1);
+}
+
+void
+instruction::return_handler(ExecutionContext& context) {
     uint16_t& pc = context.registry[+registers::def::pc];
     uint16_t& fp = context.registry[+registers::def::fp];
     uint16_t& sp = context.registry[+registers::def::sp];
-    pc = fp - 1; // setting the pc to the end of the program
+    uint16_t& depth = context.registry[+registers::def::cd];
     sp = fp;
-}
+    if (depth > 0) {
+        fp = u16(pop_helper(context));
+        pc = u16(pop_helper(context) - 1);
+        depth--;
+        return;
+    }
 
-struct peek_offset_instrction {
-    uint8_t reg;
-    uint8_t offset;
-};
+    context.return_value = context.registry[+registers::def::ret];
+    pc = fp - 1; // setting the pc to the end of the program
+}
 
 void
 instruction::peek_offset_handler(ExecutionContext& context) {
-    auto peek = read<peek_offset_instrction>(context.bytecode, context.registry[+registers::def::pc]);
-    uint16_t sp = context.registry[+registers::def::fp] + (peek.offset * 2) + 2;
+    uint16_t& pc = context.registry[+registers::def::pc];
+    uint8_t reg = context.code_at(++pc);
+    uint8_t offset = context.code_at(++pc);
+    uint16_t sp = context.registry[+registers::def::fp] + (offset * 2) + 2;
+    int16_t value = instruction::stack_read_at_offset(context.bytecode, sp);
+
+    if (reg == +registers::def::sp)
+        push_helper(context, value);
+    else
+        context.registry[reg] = value;
+}
+
+// Argument n is the word at fp - 6 - n * 2, under the return address and the saved fp.
+void
+instruction::peek_argument_handler(ExecutionContext& context) {
+    uint16_t& pc = context.registry[+registers::def::pc];
+    uint8_t reg = context.code_at(++pc);
+    uint8_t argument = context.code_at(++pc);
+    uint16_t sp = static_cast<uint16_t>(context.registry[+registers::def::fp] - (argument * 2) - 4);
     int16_t value = instruction::stack_read_at_offset(context.bytecode, sp);
-    
 
-    if (peek.reg == +registers::def::sp)
+    if (reg == +registers::def::sp)
         push_helper(context, value);
     else
-        context.registry[peek.reg] = value;
+        context.registry[reg] = value;
 }
 
 void
 instruction::pop_reg_handler(ExecutionContext& context) {
     uint16_t& pc = context.registry[+registers::def::pc];
-    uint8_t reg = context.bytecode[++pc];
+    uint8_t reg = context.code_at(++pc);
     context.registry[reg] = pop_helper(context);
 }
 
 void
 instruction::inc_handler(ExecutionContext& context) {
     uint16_t& pc = context.registry[+registers::def::pc];
-    uint8_t reg = context.bytecode[++pc];
+    uint8_t reg = context.code_at(++pc);
 
     if (reg == +registers::def::sp) {
-        uint8_t offset = context.bytecode[++pc];
-        offset *= 2;
-        offset += context.registry[+registers::def::fp] + 2;
-        uint16_t offset16 = static_cast<uint16_t>(offset);
+        uint16_t offset16 = context.code_at(++pc);
+        offset16 = static_cast<uint16_t>(offset16 * 2 + context.registry[+registers::def::fp] + 2);
         int16_t value = stack_read_at_offset(context.bytecode, offset16);
         value++;
         write_int16(context.bytecode, offset16, value);
@@ -208,13 +314,11 @@ instruction::inc_handler(ExecutionContext& context) {
 void
 instruction::dec_handler(ExecutionContext& context) {
     uint16_t& pc = context.registry[+registers::def::pc];
-    uint8_t reg = context.bytecode[++pc];
+    uint8_t reg = context.code_at(++pc);
 
     if (reg == +registers::def::sp) {
-        uint8_t offset = context.bytecode[++pc];
-        offset *= 2;
-        offset += context.registry[+registers::def::fp] + 2;
-        uint16_t offset16 = static_cast<uint16_t>(offset);
+        uint16_t offset16 = context.code_at(++pc);
+        offset16 = static_cast<uint16_t>(offset16 * 2 + context.registry[+registers::def::fp] + 2);
         int16_t value = stack_read_at_offset(context.bytecode, offset16);
         value--;
         write_int16(context.bytecode, offset16, value);
@@ -237,9 +341,70 @@ instruction::jump_gt_handler(ExecutionContext& context) {
 void
 instruction::jump_lt_handler(ExecutionContext& context) {
     uint16_t& pc = context.registry[+registers::def::pc];
-    int16_t value = read_word(context.bytecode, ++pc);
+    int16_t value = read_operand(context, ++pc);
     int16_t result = i16(context.registry[+registers::def::imm]);
     if (result < 0) {
         pc -= value;
     }
-}
\ No newline at end of file
+}
+void
+instruction::trap_handler(ExecutionContext& context) {
+    context.trap = trap_code::invalid_instruction;
+    // leave pc on the faulting opcode once the dispatch loop advances it.
+    context.registry[+registers::def::pc]--;
+}
+
+/*
+ * Pre-decoded handlers, the bodies live in decoded_ops.hpp */
+
+#define CIPH_DECODED_HANDLER(name)                                                                      \
+    uint16_t instruction::decoded::name(ExecutionContext& context, const decoded_instruction& instr,    \
+                                        uint16_t ip) {                                                  \
+        context_registers regs(context);                                                               \
+        return ops::name(regs, instr, ip);                                                              \
+    }
+
+CIPH_DECODED_HANDLER(push_handler)
+CIPH_DECODED_HANDLER(push_literal_handler)
+CIPH_DECODED_HANDLER(push_reg_handler)
+CIPH_DECODED_HANDLER(add_handler)
+CIPH_DECODED_HANDLER(sub_handler)
+CIPH_DECODED_HANDLER(mul_handler)
+CIPH_DECODED_HANDLER(div_handler)
+CIPH_DECODED_HANDLER(add_reg_handler)
+CIPH_DECODED_HANDLER(sub_reg_handler)
+CIPH_DECODED_HANDLER(mul_reg_handler)
+CIPH_DECODED_HANDLER(div_reg_handler)
+CIPH_DECODED_HANDLER(call_handler)
+CIPH_DECODED_HANDLER(return_handler)
+CIPH_DECODED_HANDLER(peek_handler)
+CIPH_DECODED_HANDLER(peek_offset_handler)
+CIPH_DECODED_HANDLER(pop_reg_handler)
+CIPH_DECODED_HANDLER(inc_handler)
+CIPH_DECODED_HANDLER(dec_handler)
+CIPH_DECODED_HANDLER(cmp_handler)
+CIPH_DECODED_HANDLER(mov_handler)
+CIPH_DECODED_HANDLER(put_reg_handler)
+CIPH_DECODED_HANDLER(put_literal_handler)
+CIPH_DECODED_HANDLER(mov_mem_handler)
+CIPH_DECODED_HANDLER(push_mem_handler)
+CIPH_DECODED_HANDLER(jump_eq_handler)
+CIPH_DECODED_HANDLER(jump_nz_handler)
+CIPH_DECODED_HANDLER(jump_gt_handler)
+CIPH_DECODED_HANDLER(jump_lt_handler)
+CIPH_DECODED_HANDLER(trap_handler)
+
+// superinstructions
+CIPH_DECODED_HANDLER(add_offset_handler)
+CIPH_DECODED_HANDLER(sub_offset_handler)
+CIPH_DECODED_HANDLER(mul_offset_handler)
+CIPH_DECODED_HANDLER(div_offset_handler)
+CIPH_DECODED_HANDLER(jump_lt_offset_handler)
+
+// quickened
+CIPH_DECODED_HANDLER(peek_local_handler)
+CIPH_DECODED_HANDLER(peek_local_reg_handler)
+CIPH_DECODED_HANDLER(inc_local_handler)
+CIPH_DECODED_HANDLER(dec_local_handler)
+
+#undef CIPH_DECODED_HANDLER
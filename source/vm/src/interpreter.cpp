@@ -0,0 +1,454 @@
+#include "interpreter.hpp"
+
+#include <array>
+
+#include "decoded_ops.hpp"
+#include "instructions.hpp"
+
+using namespace ciph;
+
+/*
+ * Every opcode that falls through or branches to another instruction, RET and the trap are
+ * handled separately since they can end the loop. The divisions fall through unless the divisor
+ * is zero, they trap then and are listed on their own. The branches and CALL are listed on their
+ * own too, they end a basic block and are where run_metered charges fuel. A RET that goes back to
+ * its caller ends one as well. */
+#define CIPH_INTERPRETER_OPCODES(X)             \
+    CIPH_INTERPRETER_STRAIGHT_OPCODES(X)        \
+    CIPH_INTERPRETER_FAULTING_OPCODES(X)        \
+    CIPH_INTERPRETER_BRANCH_OPCODES(X)
+
+#define CIPH_INTERPRETER_STRAIGHT_OPCODES(X)    \
+    X(PSH, push_handler)                        \
+    X(PSH_REG, push_reg_handler)                \
+    X(PSH_LIT, push_literal_handler)            \
+    X(ADD, add_handler)                         \
+    X(SUB, sub_handler)                         \
+    X(MUL, mul_handler)                         \
+    X(ADD_REG, add_reg_handler)                 \
+    X(SUB_REG, sub_reg_handler)                 \
+    X(MUL_REG, mul_reg_handler)                 \
+    X(POP_REG, pop_reg_handler)                 \
+    X(PEK_REG, peek_handler)                    \
+    X(PEK_OFF, peek_offset_handler)             \
+    X(INC, inc_handler)                         \
+    X(DEC, dec_handler)                         \
+    X(CMP, cmp_handler)                         \
+    X(MOV, mov_handler)                         \
+    X(PUT_REG, put_reg_handler)                 \
+    X(PUT_LIT, put_literal_handler)             \
+    X(MOV_MEM, mov_mem_handler)                 \
+    X(PSH_MEM, push_mem_handler)                \
+    X(JEQ, jump_eq_handler)                     \
+    X(JNZ, jump_nz_handler)                     \
+    X(JGT, jump_gt_handler)                     \
+    X(ADD_OFF, add_offset_handler)              \
+    X(SUB_OFF, sub_offset_handler)              \
+    X(MUL_OFF, mul_offset_handler)              \
+    X(PEK_LOC, peek_local_handler)              \
+    X(PEK_LOC_REG, peek_local_reg_handler)      \
+    X(INC_LOC, inc_local_handler)               \
+    X(DEC_LOC, dec_local_handler)
+
+#define CIPH_INTERPRETER_FAULTING_OPCODES(X)    \
+    X(DIV, div_handler)                         \
+    X(DIV_REG, div_reg_handler)                 \
+    X(DIV_OFF, div_offset_handler)
+
+#define CIPH_INTERPRETER_BRANCH_OPCODES(X)      \
+    X(JLT, jump_lt_handler)                     \
+    X(JLT_OFF, jump_lt_offset_handler)          \
+    X(CALL, call_handler)
+
+namespace {
+
+// Index of the instruction at pc, raises a trap if pc isn't on an instruction boundary.
+uint16_t
+entry_point(ExecutionContext& context, const decoded_program& program) {
+    context.program = &program;
+    uint16_t ip = program.index_of(context.registry[+registers::def::pc]);
+    if (ip == decoded_program::halt)
+        context.trap = trap_code::invalid_instruction;
+    return ip;
+}
+
+int16_t
+trapped(ExecutionContext& context, const decoded_program& program, uint16_t ip) {
+    context.registry[+registers::def::pc] = program.byte_pc[ip];
+    return context.return_value;
+}
+
+// Writes the cached registers back, pc is left on the faulting instruction.
+int16_t
+trapped(instruction::local_registers& regs, const decoded_program& program, uint16_t ip) {
+    regs.pc() = program.byte_pc[ip];
+    regs.sync();
+    return regs.context.return_value;
+}
+
+} // namespace
+
+int16_t
+interpreter::run(ExecutionContext& context, const decoded_program& program) {
+#if defined(CIPH_VM_DISPATCH_TABLE)
+    return run_table(context, program);
+#elif defined(CIPH_VM_DISPATCH_SWITCH) || !CIPH_HAS_COMPUTED_GOTO
+    return run_switch(context, program);
+#else
+    return run_threaded(context, program);
+#endif
+}
+
+int16_t
+interpreter::run_table(ExecutionContext& context, const decoded_program& program) {
+    const decoded_instruction* code = program.instructions.data();
+    uint16_t ip = entry_point(context, program);
+    uint16_t last = ip;
+    while (ip != decoded_program::halt) {
+        last = ip;
+        ip = code[ip].handler(context, code[ip], ip);
+    }
+
+    if (context.trap != trap_code::none && last != decoded_program::halt)
+        return trapped(context, program, last);
+    return context.return_value;
+}
+
+int16_t
+interpreter::run_switch(ExecutionContext& context, const decoded_program& program) {
+    using instruction::def;
+    const decoded_instruction* code = program.instructions.data();
+    uint16_t ip = entry_point(context, program);
+    if (ip == decoded_program::halt)
+        return context.return_value;
+
+    instruction::local_registers regs(context);
+    for (;;) {
+        const decoded_instruction& instr = code[ip];
+        switch (instr.opcode) {
+#define CIPH_SWITCH_CASE(name, fn)                          \
+    case def::name:                                         \
+        ip = instruction::ops::fn(regs, instr, ip);         \
+        break;
+            CIPH_INTERPRETER_STRAIGHT_OPCODES(CIPH_SWITCH_CASE)
+            CIPH_INTERPRETER_BRANCH_OPCODES(CIPH_SWITCH_CASE)
+#undef CIPH_SWITCH_CASE
+#define CIPH_SWITCH_FAULTING(name, fn)                      \
+    case def::name: {                                       \
+        uint16_t next = instruction::ops::fn(regs, instr, ip); \
+        if (next == decoded_program::halt)                  \
+            return trapped(regs, program, ip);              \
+        ip = next;                                          \
+        break;                                              \
+    }
+            CIPH_INTERPRETER_FAULTING_OPCODES(CIPH_SWITCH_FAULTING)
+#undef CIPH_SWITCH_FAULTING
+            case def::RET: {
+                uint16_t next = instruction::ops::return_handler(regs, instr, ip);
+                if (next != decoded_program::halt) {
+                    ip = next;
+                    break;
+                }
+                if (context.trap != trap_code::none)
+                    return trapped(regs, program, ip);
+                regs.sync();
+                return context.return_value;
+            }
+            default:
+                instruction::ops::trap_handler(regs, instr, ip);
+                return trapped(regs, program, ip);
+        }
+    }
+}
+
+run_status
+interpreter::run_metered(ExecutionContext& context, const decoded_program& program, uint32_t& fuel) {
+    using instruction::def;
+    const decoded_instruction* code = program.instructions.data();
+    const uint16_t* cost = program.block_cost.data();
+    uint16_t ip = entry_point(context, program);
+    if (ip == decoded_program::halt)
+        return run_status::trapped;
+    if (cost[ip] > fuel)
+        return run_status::out_of_fuel;
+    fuel -= cost[ip];
+
+    instruction::local_registers regs(context);
+    for (;;) {
+        const decoded_instruction& instr = code[ip];
+        switch (instr.opcode) {
+#define CIPH_METERED_CASE(name, fn)                         \
+    case def::name:                                         \
+        ip = instruction::ops::fn(regs, instr, ip);         \
+        break;
+            CIPH_INTERPRETER_STRAIGHT_OPCODES(CIPH_METERED_CASE)
+#undef CIPH_METERED_CASE
+#define CIPH_METERED_FAULTING(name, fn)                     \
+    case def::name: {                                       \
+        uint16_t next = instruction::ops::fn(regs, instr, ip); \
+        if (next == decoded_program::halt) {                \
+            trapped(regs, program, ip);                     \
+            return run_status::trapped;                     \
+        }                                                   \
+        ip = next;                                          \
+        break;                                              \
+    }
+            CIPH_INTERPRETER_FAULTING_OPCODES(CIPH_METERED_FAULTING)
+#undef CIPH_METERED_FAULTING
+#define CIPH_METERED_BRANCH(name, fn)                       \
+    case def::name: {                                       \
+        uint16_t next = instruction::ops::fn(regs, instr, ip); \
+        if (cost[next] > fuel) {                            \
+            regs.pc() = program.byte_pc[next];              \
+            regs.sync();                                    \
+            return run_status::out_of_fuel;                 \
+        }                                                   \
+        fuel -= cost[next];                                 \
+        ip = next;                                          \
+        break;                                              \
+    }
+            CIPH_INTERPRETER_BRANCH_OPCODES(CIPH_METERED_BRANCH)
+#undef CIPH_METERED_BRANCH
+            case def::RET: {
+                uint16_t next = instruction::ops::return_handler(regs, instr, ip);
+                if (next == decoded_program::halt) {
+                    if (context.trap != trap_code::none) {
+                        trapped(regs, program, ip);
+                        return run_status::trapped;
+                    }
+                    regs.sync();
+                    return run_status::completed;
+                }
+                if (cost[next] > fuel) {
+                    regs.pc() = program.byte_pc[next];
+                    regs.sync();
+                    return run_status::out_of_fuel;
+                }
+                fuel -= cost[next];
+                ip = next;
+                break;
+            }
+            default:
+                instruction::ops::trap_handler(regs, instr, ip);
+                trapped(regs, program, ip);
+                return run_status::trapped;
+        }
+    }
+}
+
+namespace {
+
+// One instruction on the checked registers, RET and a trap return halt.
+uint16_t
+checked_dispatch(instruction::checked_registers& regs, const decoded_instruction& instr, uint16_t ip) {
+    using instruction::def;
+    switch (instr.opcode) {
+#define CIPH_CHECKED_CASE(name, fn)                         \
+    case def::name:                                         \
+        return instruction::ops::fn(regs, instr, ip);
+        CIPH_INTERPRETER_OPCODES(CIPH_CHECKED_CASE)
+#undef CIPH_CHECKED_CASE
+        case def::RET:
+            return instruction::ops::return_handler(regs, instr, ip);
+        default:
+            return instruction::ops::trap_handler(regs, instr, ip);
+    }
+}
+
+// Ends a basic block and continues somewhere else, RET only gets here when it returns to a caller.
+bool
+is_branch(instruction::def opcode) {
+    using instruction::def;
+    return opcode == def::JLT || opcode == def::JLT_OFF || opcode == def::CALL || opcode == def::RET;
+}
+
+// run_metered on the checked registers, without fuel when fuel is null.
+run_status
+checked_loop(ExecutionContext& context, const decoded_program& program, uint32_t memory_size, uint32_t* fuel) {
+    const decoded_instruction* code = program.instructions.data();
+    const uint16_t* cost = program.block_cost.data();
+    size_t count = program.instructions.size();
+    uint16_t ip = entry_point(context, program);
+    if (ip == decoded_program::halt)
+        return run_status::trapped;
+    if (fuel != nullptr) {
+        if (cost[ip] > *fuel)
+            return run_status::out_of_fuel;
+        *fuel -= cost[ip];
+    }
+
+    instruction::checked_registers regs(context, memory_size);
+    for (;;) {
+        const decoded_instruction& instr = code[ip];
+        uint16_t next = checked_dispatch(regs, instr, ip);
+        if (context.trap != trap_code::none) {
+            trapped(context, program, ip);
+            return run_status::trapped;
+        }
+        if (next == decoded_program::halt)
+            return run_status::completed;
+        if (next >= count) {
+            // fell through the last instruction, pc is left on the end of the program.
+            context.trap = trap_code::invalid_instruction;
+            trapped(context, program, next);
+            return run_status::trapped;
+        }
+        if (fuel != nullptr && is_branch(instr.opcode)) {
+            if (cost[next] > *fuel) {
+                context.registry[+registers::def::pc] = program.byte_pc[next];
+                return run_status::out_of_fuel;
+            }
+            *fuel -= cost[next];
+        }
+        ip = next;
+    }
+}
+
+} // namespace
+
+run_status
+interpreter::run_checked(ExecutionContext& context, const decoded_program& program, uint32_t memory_size,
+                         uint32_t& fuel) {
+    return checked_loop(context, program, memory_size, &fuel);
+}
+
+int16_t
+interpreter::run_checked(ExecutionContext& context, const decoded_program& program, uint32_t memory_size) {
+    checked_loop(context, program, memory_size, nullptr);
+    return context.return_value;
+}
+
+bool
+interpreter::step_checked(ExecutionContext& context, const decoded_program& program, uint32_t memory_size) {
+    uint16_t ip = entry_point(context, program);
+    if (ip == decoded_program::halt)
+        return false;
+
+    instruction::checked_registers regs(context, memory_size);
+    uint16_t next = checked_dispatch(regs, program.instructions[ip], ip);
+    if (context.trap != trap_code::none) {
+        trapped(context, program, ip);
+        return false;
+    }
+    if (next == decoded_program::halt)
+        return false;
+    if (next >= program.instructions.size()) {
+        context.trap = trap_code::invalid_instruction;
+        trapped(context, program, next);
+        return false;
+    }
+
+    context.registry[+registers::def::pc] = program.byte_pc[next];
+    return true;
+}
+
+#if CIPH_HAS_COMPUTED_GOTO
+namespace {
+
+// Position of each opcode's label in run_threaded's label array, zero is the trap.
+enum class label : uint8_t {
+    trap = 0,
+#define CIPH_LABEL_INDEX(name, fn) name,
+    CIPH_INTERPRETER_OPCODES(CIPH_LABEL_INDEX)
+#undef CIPH_LABEL_INDEX
+    RET
+};
+
+constexpr std::array<uint8_t, 256>
+make_label_table() {
+    std::array<uint8_t, 256> table{};
+    table.fill(static_cast<uint8_t>(label::trap));
+#define CIPH_LABEL_ENTRY(name, fn) table[+instruction::def::name] = static_cast<uint8_t>(label::name);
+    CIPH_INTERPRETER_OPCODES(CIPH_LABEL_ENTRY)
+#undef CIPH_LABEL_ENTRY
+    table[+instruction::def::RET] = static_cast<uint8_t>(label::RET);
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> label_of = make_label_table();
+
+} // namespace
+
+// label addresses and computed gotos are a GNU extension, -Wpedantic warns on every one of them.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+int16_t
+interpreter::run_threaded(ExecutionContext& context, const decoded_program& program) {
+    // ordered as enum class label.
+    static void* const labels[] = {
+        &&op_trap,
+#define CIPH_LABEL_ADDRESS(name, fn) &&op_##name,
+        CIPH_INTERPRETER_OPCODES(CIPH_LABEL_ADDRESS)
+#undef CIPH_LABEL_ADDRESS
+        &&op_RET
+    };
+
+    const decoded_instruction* code = program.instructions.data();
+    uint16_t ip = entry_point(context, program);
+    if (ip == decoded_program::halt)
+        return context.return_value;
+
+    instruction::local_registers regs(context);
+
+#define CIPH_DISPATCH() goto* labels[label_of[+code[ip].opcode]]
+
+    CIPH_DISPATCH();
+
+#define CIPH_THREADED_OP(name, fn)                          \
+    op_##name:                                              \
+    ip = instruction::ops::fn(regs, code[ip], ip);          \
+    CIPH_DISPATCH();
+    CIPH_INTERPRETER_STRAIGHT_OPCODES(CIPH_THREADED_OP)
+    CIPH_INTERPRETER_BRANCH_OPCODES(CIPH_THREADED_OP)
+#undef CIPH_THREADED_OP
+
+#define CIPH_THREADED_FAULTING(name, fn)                    \
+    op_##name: {                                            \
+        uint16_t next = instruction::ops::fn(regs, code[ip], ip); \
+        if (next == decoded_program::halt)                  \
+            return trapped(regs, program, ip);              \
+        ip = next;                                          \
+        CIPH_DISPATCH();                                    \
+    }
+    CIPH_INTERPRETER_FAULTING_OPCODES(CIPH_THREADED_FAULTING)
+#undef CIPH_THREADED_FAULTING
+
+op_RET: {
+    uint16_t next = instruction::ops::return_handler(regs, code[ip], ip);
+    if (next != decoded_program::halt) {
+        ip = next;
+        CIPH_DISPATCH();
+    }
+    if (context.trap != trap_code::none)
+        return trapped(regs, program, ip);
+    regs.sync();
+    return context.return_value;
+}
+
+op_trap:
+    instruction::ops::trap_handler(regs, code[ip], ip);
+    return trapped(regs, program, ip);
+
+#undef CIPH_DISPATCH
+}
+#pragma GCC diagnostic pop
+#endif
+
+bool
+interpreter::step(ExecutionContext& context, const decoded_program& program) {
+    uint16_t ip = entry_point(context, program);
+    if (ip == decoded_program::halt)
+        return false;
+
+    const decoded_instruction& instr = program.instructions[ip];
+    uint16_t next = instr.handler(context, instr, ip);
+    if (context.trap != trap_code::none) {
+        trapped(context, program, ip);
+        return false;
+    }
+    if (next == decoded_program::halt)
+        return false; // RET already moved pc to the end of the program.
+
+    context.registry[+registers::def::pc] = program.byte_pc[next];
+    return true;
+}
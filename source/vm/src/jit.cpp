@@ -0,0 +1,201 @@
+#include "jit.hpp"
+
+#include <cstring>
+
+#include "interpreter.hpp"
+#include "jit_emitter.hpp"
+
+#if CIPH_HAS_JIT
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace ciph;
+
+jit::ExecutableMemory::ExecutableMemory(const std::vector<uint8_t>& code) {
+#if CIPH_HAS_JIT
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = (code.size() + page - 1) / page * page;
+    void* region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED)
+        return; // stays empty, the program runs interpreted.
+
+    std::memcpy(region, code.data(), code.size());
+    if (mprotect(region, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(region, size);
+        return;
+    }
+    m_data = static_cast<uint8_t*>(region);
+    m_size = size;
+#else
+    (void)code;
+#endif
+}
+
+jit::ExecutableMemory::~ExecutableMemory() {
+    release();
+}
+
+jit::ExecutableMemory::ExecutableMemory(ExecutableMemory&& other) noexcept
+    : m_data(other.m_data)
+    , m_size(other.m_size) {
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+jit::ExecutableMemory&
+jit::ExecutableMemory::operator=(ExecutableMemory&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+void
+jit::ExecutableMemory::release() {
+#if CIPH_HAS_JIT
+    if (m_data != nullptr)
+        munmap(m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+#if CIPH_HAS_JIT
+namespace {
+
+// Whole program, every instruction gets a label and branches jump straight to their target.
+class ProgramCompiler : public jit::Emitter {
+public:
+    explicit ProgramCompiler(const decoded_program& program)
+        : m_program(program) {}
+
+    jit::compiled_program compile() {
+        const std::vector<decoded_instruction>& code = m_program.instructions;
+        m_labels.reserve(code.size());
+        for (size_t i = 0; i < code.size(); i++)
+            m_labels.push_back(m_asm.new_label());
+
+        for (size_t i = 0; i + 1 < code.size(); i++) {
+            if (code[i].opcode == instruction::def::CALL)
+                m_returns.emplace(static_cast<uint16_t>(i + 1), m_asm.new_label());
+        }
+
+        prologue();
+
+        jit::compiled_program result;
+        result.entry.reserve(code.size());
+        for (size_t i = 0; i < code.size(); i++) {
+            m_asm.bind(m_labels[i]);
+            result.entry.push_back(static_cast<uint32_t>(m_asm.position()));
+            if (code[i].opcode == instruction::def::CALL) {
+                enter_frame(static_cast<uint16_t>(code[i].literal));
+                m_asm.jmp(m_labels[code[i].target]);
+            }
+            else if (code[i].opcode == instruction::def::RET) {
+                ret(static_cast<uint16_t>(i));
+            }
+            else if (instruction(code[i], static_cast<uint16_t>(i)) == false) {
+                exit_now(static_cast<uint16_t>(i));
+                result.fallbacks++;
+            }
+        }
+        // running off the end of the program.
+        exit_now(static_cast<uint16_t>(code.size()));
+
+        // every RET returning from a call lands here, with the address it found already matched.
+        for (auto [site, landing] : m_returns) {
+            m_asm.bind(landing);
+            leave_frame();
+            m_asm.jmp(m_labels[site]);
+        }
+
+        result.code = jit::ExecutableMemory(finish());
+        if (result.empty())
+            result.entry.clear();
+        return result;
+    }
+
+private:
+    void branch(const decoded_instruction& instr, uint16_t) override {
+        m_asm.jcc(x64::condition::sign, m_labels[instr.target]);
+    }
+
+    /*
+     * Native code has no instruction index for a byte address, the return address is compared
+     * against every instruction that follows a CALL. One that matches none was overwritten by
+     * the program, RET then runs in the interpreter and traps there. */
+    void ret(uint16_t ip) {
+        label outermost = m_asm.new_label();
+        test_call_depth();
+        m_asm.jcc(x64::condition::zero, outermost);
+        load_return_address(x64::reg::rax);
+        for (auto [site, landing] : m_returns) {
+            m_asm.cmp32(x64::reg::rax, static_cast<int32_t>(m_program.byte_pc[site]));
+            m_asm.jcc(x64::condition::zero, landing);
+        }
+        m_asm.jmp(exit_label(ip));
+
+        m_asm.bind(outermost);
+        end_program();
+    }
+
+    const decoded_program& m_program;
+    std::vector<label> m_labels;
+    // landing pad of every instruction a RET can return to.
+    std::map<uint16_t, label> m_returns;
+};
+
+} // namespace
+#endif
+
+jit::compiled_program
+jit::compile(const decoded_program& program) {
+#if CIPH_HAS_JIT
+    if (program.instructions.empty())
+        return {};
+    return ProgramCompiler(program).compile();
+#else
+    (void)program;
+    return {};
+#endif
+}
+
+int16_t
+jit::run(ExecutionContext& context, const decoded_program& program, const compiled_program& native) {
+#if CIPH_HAS_JIT
+    if (native.empty())
+        return interpreter::run(context, program);
+
+    auto function = reinterpret_cast<native_function>(const_cast<uint8_t*>(native.code.data()));
+    uint16_t ip = program.index_of(context.registry[+registers::def::pc]);
+    if (ip == decoded_program::halt) {
+        context.trap = trap_code::invalid_instruction;
+        return context.return_value;
+    }
+
+    for (;;) {
+        ip = function(context.bytecode, context.registry, native.code.data() + native.entry[ip]);
+        if (ip == decoded_program::halt) {
+            context.return_value = i16(context.registry[+registers::def::ret]);
+            return context.return_value;
+        }
+        if (ip >= program.instructions.size()) {
+            context.registry[+registers::def::pc] = program.byte_pc.back();
+            return context.return_value;
+        }
+
+        context.registry[+registers::def::pc] = program.byte_pc[ip];
+        if (interpreter::step(context, program) == false)
+            return context.return_value;
+        ip = program.index_of(context.registry[+registers::def::pc]);
+    }
+#else
+    (void)native;
+    return interpreter::run(context, program);
+#endif
+}
@@ -0,0 +1,400 @@
+#include "jit_emitter.hpp"
+
+using namespace ciph;
+using x64::condition;
+using x64::mem;
+using x64::reg;
+
+namespace {
+
+constexpr reg memory_base = reg::rbx;
+constexpr reg registry_base = reg::r12;
+constexpr reg vm_sp = reg::r13;     // zero extended, only ever written with 16 bit operations.
+constexpr reg vm_fp = reg::r14;
+
+mem
+register_slot(uint8_t vmreg) {
+    return mem(registry_base, vmreg * 2);
+}
+
+// Word at sp + disp, the stack word below sp is disp -2.
+mem
+stack_slot(int32_t disp) {
+    return mem(memory_base, vm_sp, disp);
+}
+
+/*
+ * Stack slot PEK_OFF reads at offset, fp + offset * 2 + 2 is one past it. Addresses don't wrap
+ * at 64K like the interpreter's, compiled code only runs when unchecked() holds and the verified
+ * extent fits in VM memory. */
+mem
+local_slot(int32_t offset) {
+    return mem(memory_base, vm_fp, offset * 2);
+}
+
+// Stack slot at a displacement from fp the quicken pass computed, PEK_LOC and friends.
+mem
+frame_slot(int32_t displacement) {
+    return mem(memory_base, vm_fp, displacement - 2);
+}
+
+bool
+touches_pc(const decoded_instruction& instr) {
+    using instruction::def;
+    constexpr uint8_t pc = +registers::def::pc;
+    switch (instr.opcode) {
+        case def::PSH_REG:
+        case def::POP_REG:
+        case def::PEK_REG:
+        case def::PEK_OFF:
+        case def::PEK_LOC_REG:
+        case def::PUT_REG:
+        case def::INC:
+        case def::DEC:
+            return instr.reg_a == pc;
+        case def::MOV:
+        case def::ADD_REG:
+        case def::SUB_REG:
+        case def::MUL_REG:
+        case def::DIV_REG:
+            return instr.reg_a == pc || instr.reg_b == pc;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+jit::Emitter::Emitter()
+    : m_epilogue(m_asm.new_label()) {}
+
+bool
+jit::Emitter::supported(const decoded_instruction& instr) {
+    using instruction::def;
+    return instr.opcode != decoder::invalid_opcode && instr.opcode != def::CALL && instr.opcode != def::RET &&
+           touches_pc(instr) == false;
+}
+
+void
+jit::Emitter::prologue() {
+    m_asm.push(reg::rbx);
+    m_asm.push(reg::r12);
+    m_asm.push(reg::r13);
+    m_asm.push(reg::r14);
+    m_asm.mov64(memory_base, reg::rdi);
+    m_asm.mov64(registry_base, reg::rsi);
+    m_asm.movzx16(vm_sp, register_slot(+registers::def::sp));
+    m_asm.movzx16(vm_fp, register_slot(+registers::def::fp));
+    m_asm.jmp(reg::rdx);
+}
+
+const std::vector<uint8_t>&
+jit::Emitter::finish() {
+    for (auto [ip, target] : m_exits) {
+        m_asm.bind(target);
+        exit_now(ip);
+    }
+
+    m_asm.bind(m_epilogue);
+    m_asm.store16(register_slot(+registers::def::sp), vm_sp);
+    m_asm.store16(register_slot(+registers::def::fp), vm_fp);
+    m_asm.pop(reg::r14);
+    m_asm.pop(reg::r13);
+    m_asm.pop(reg::r12);
+    m_asm.pop(reg::rbx);
+    m_asm.ret();
+    return m_asm.finalize();
+}
+
+void
+jit::Emitter::exit_now(uint16_t ip) {
+    m_asm.mov32(reg::rax, static_cast<uint32_t>(ip));
+    m_asm.jmp(m_epilogue);
+}
+
+jit::Emitter::label
+jit::Emitter::exit_label(uint16_t ip) {
+    auto itr = m_exits.find(ip);
+    if (itr == m_exits.end())
+        itr = m_exits.emplace(ip, m_asm.new_label()).first;
+    return itr->second;
+}
+
+void
+jit::Emitter::load(reg dst, uint8_t vmreg) {
+    if (vmreg == +registers::def::sp)
+        m_asm.movsx16(dst, vm_sp);
+    else if (vmreg == +registers::def::fp)
+        m_asm.movsx16(dst, vm_fp);
+    else
+        m_asm.movsx16(dst, register_slot(vmreg));
+}
+
+void
+jit::Emitter::store(uint8_t vmreg, reg src) {
+    if (vmreg == +registers::def::sp)
+        m_asm.movzx16(vm_sp, src);
+    else if (vmreg == +registers::def::fp)
+        m_asm.movzx16(vm_fp, src);
+    else
+        m_asm.store16(register_slot(vmreg), src);
+}
+
+void
+jit::Emitter::push(reg src) {
+    m_asm.store16(stack_slot(0), src);
+    m_asm.add16(vm_sp, 2);
+}
+
+void
+jit::Emitter::pop(reg dst) {
+    m_asm.sub16(vm_sp, 2);
+    m_asm.movsx16(dst, stack_slot(0));
+}
+
+void
+jit::Emitter::enter_frame(uint16_t return_address) {
+    m_asm.store16(stack_slot(0), return_address);
+    m_asm.store16(stack_slot(2), vm_fp);
+    m_asm.add16(vm_sp, 4);
+    m_asm.mov32(vm_fp, vm_sp);
+    m_asm.movzx16(reg::rax, register_slot(+registers::def::cd));
+    m_asm.add32(reg::rax, 1);
+    m_asm.store16(register_slot(+registers::def::cd), reg::rax);
+}
+
+void
+jit::Emitter::test_call_depth() {
+    m_asm.movzx16(reg::rax, register_slot(+registers::def::cd));
+    m_asm.test32(reg::rax, reg::rax);
+}
+
+void
+jit::Emitter::load_return_address(reg dst) {
+    m_asm.movzx16(dst, mem(memory_base, vm_fp, -4));
+}
+
+void
+jit::Emitter::leave_frame() {
+    m_asm.mov32(vm_sp, vm_fp);
+    m_asm.sub16(vm_sp, 4);
+    m_asm.movzx16(vm_fp, stack_slot(2));
+    m_asm.movzx16(reg::rcx, register_slot(+registers::def::cd));
+    m_asm.sub32(reg::rcx, 1);
+    m_asm.store16(register_slot(+registers::def::cd), reg::rcx);
+}
+
+void
+jit::Emitter::end_program() {
+    m_asm.mov32(vm_sp, vm_fp);
+    m_asm.store16(register_slot(+registers::def::pc), vm_fp);
+    exit_now(decoded_program::halt);
+}
+
+// eax = eax <op> ecx.
+void
+jit::Emitter::arithmetic(instruction::def op) {
+    using instruction::def;
+    switch (op) {
+        case def::ADD:
+        case def::ADD_REG:
+        case def::ADD_OFF:
+            m_asm.add32(reg::rax, reg::rcx);
+            break;
+        case def::SUB:
+        case def::SUB_REG:
+        case def::SUB_OFF:
+            m_asm.sub32(reg::rax, reg::rcx);
+            break;
+        case def::MUL:
+        case def::MUL_REG:
+        case def::MUL_OFF:
+            m_asm.imul32(reg::rax, reg::rcx);
+            break;
+        default:
+            // operands are sign extended to 32 bits, so -32768 / -1 can't fault like a 16 bit idiv.
+            m_asm.cdq();
+            m_asm.idiv32(reg::rcx);
+            break;
+    }
+}
+
+// A zero divisor side-exits before the instruction writes anything, interpreter::step then runs
+// the division and traps with trap_code::division_by_zero, pc left on it.
+void
+jit::Emitter::divisor_check(uint16_t ip) {
+    m_asm.test32(reg::rcx, reg::rcx);
+    m_asm.jcc(condition::zero, exit_label(ip));
+}
+
+bool
+jit::Emitter::instruction(const decoded_instruction& instr, uint16_t ip) {
+    using instruction::def;
+    if (supported(instr) == false)
+        return false;
+
+    switch (instr.opcode) {
+        case def::PSH:
+            load(reg::rax, +registers::def::imm);
+            push(reg::rax);
+            return true;
+
+        case def::PSH_LIT:
+            m_asm.store16(stack_slot(0), static_cast<uint16_t>(instr.literal));
+            m_asm.add16(vm_sp, 2);
+            return true;
+
+        case def::PSH_REG:
+            load(reg::rax, instr.reg_a);
+            push(reg::rax);
+            return true;
+
+        case def::ADD:
+        case def::SUB:
+        case def::MUL:
+        case def::DIV:
+            if (instr.opcode == def::DIV) {
+                m_asm.movsx16(reg::rcx, stack_slot(-2));
+                divisor_check(ip);
+            }
+            pop(reg::rcx);
+            pop(reg::rax);
+            arithmetic(instr.opcode);
+            push(reg::rax);
+            return true;
+
+        case def::ADD_REG:
+        case def::SUB_REG:
+        case def::MUL_REG:
+        case def::DIV_REG:
+            load(reg::rax, instr.reg_a);
+            load(reg::rcx, instr.reg_b);
+            if (instr.opcode == def::DIV_REG)
+                divisor_check(ip);
+            arithmetic(instr.opcode);
+            store(instr.reg_a, reg::rax);
+            return true;
+
+        case def::PEK_REG:
+            m_asm.movsx16(reg::rax, stack_slot(-2));
+            store(instr.reg_a, reg::rax);
+            return true;
+
+        case def::PEK_OFF:
+            m_asm.movsx16(reg::rax, local_slot(instr.literal));
+            if (instr.reg_a == +registers::def::sp)
+                push(reg::rax);
+            else
+                store(instr.reg_a, reg::rax);
+            return true;
+
+        case def::POP_REG:
+            pop(reg::rax);
+            store(instr.reg_a, reg::rax);
+            return true;
+
+        case def::INC:
+        case def::DEC: {
+            int32_t delta = instr.opcode == def::INC ? 1 : -1;
+            if (instr.reg_a == +registers::def::sp) {
+                m_asm.movsx16(reg::rax, local_slot(instr.literal));
+                m_asm.add32(reg::rax, delta);
+                m_asm.store16(local_slot(instr.literal), reg::rax);
+            }
+            else {
+                load(reg::rax, instr.reg_a);
+                m_asm.add32(reg::rax, delta);
+                store(instr.reg_a, reg::rax);
+            }
+            return true;
+        }
+
+        case def::CMP:
+            if (instr.reg_a == +registers::def::sp) {
+                pop(reg::rcx);
+                pop(reg::rax);
+                m_asm.sub32(reg::rax, reg::rcx);
+                m_asm.store16(register_slot(+registers::def::imm), reg::rax);
+            }
+            return true;
+
+        case def::MOV:
+            load(reg::rax, instr.reg_b);
+            store(instr.reg_a, reg::rax);
+            return true;
+
+        case def::PUT_REG:
+            load(reg::rax, +registers::def::imm);
+            store(instr.reg_a, reg::rax);
+            return true;
+
+        case def::PUT_LIT:
+            m_asm.store16(register_slot(+registers::def::imm), static_cast<uint16_t>(instr.literal));
+            return true;
+
+        // the verifier keeps memory operands off the register file, sp and fp live in host registers.
+        case def::MOV_MEM:
+            load(reg::rax, +registers::def::imm);
+            m_asm.store16(mem(memory_base, static_cast<uint16_t>(instr.literal)), reg::rax);
+            return true;
+
+        case def::PSH_MEM:
+            m_asm.movsx16(reg::rax, mem(memory_base, static_cast<uint16_t>(instr.literal)));
+            push(reg::rax);
+            return true;
+
+        case def::JEQ:
+        case def::JNZ:
+        case def::JGT:
+            return true; // not implemented by the interpreter either.
+
+        case def::JLT:
+            m_asm.movsx16(reg::rax, register_slot(+registers::def::imm));
+            m_asm.test32(reg::rax, reg::rax);
+            branch(instr, ip);
+            return true;
+
+        case def::ADD_OFF:
+        case def::SUB_OFF:
+        case def::MUL_OFF:
+        case def::DIV_OFF:
+            // the first value goes where PEK_OFF would have pushed it, so a second offset
+            // naming that slot reads it back the same way the unfused sequence does.
+            m_asm.movsx16(reg::rax, local_slot(instr.reg_a));
+            m_asm.store16(stack_slot(0), reg::rax);
+            m_asm.movsx16(reg::rcx, local_slot(instr.reg_b));
+            if (instr.opcode == def::DIV_OFF)
+                divisor_check(ip);
+            arithmetic(instr.opcode);
+            push(reg::rax);
+            return true;
+
+        case def::JLT_OFF:
+            m_asm.movsx16(reg::rax, local_slot(instr.reg_a));
+            m_asm.sub32(reg::rax, static_cast<int32_t>(instr.literal));
+            m_asm.store16(register_slot(+registers::def::imm), reg::rax);
+            m_asm.test16(reg::rax, reg::rax);
+            branch(instr, ip);
+            return true;
+
+        case def::PEK_LOC:
+            m_asm.movsx16(reg::rax, frame_slot(instr.literal));
+            push(reg::rax);
+            return true;
+
+        case def::PEK_LOC_REG:
+            m_asm.movsx16(reg::rax, frame_slot(instr.literal));
+            store(instr.reg_a, reg::rax);
+            return true;
+
+        case def::INC_LOC:
+        case def::DEC_LOC:
+            m_asm.movsx16(reg::rax, frame_slot(instr.literal));
+            m_asm.add32(reg::rax, instr.opcode == def::INC_LOC ? 1 : -1);
+            m_asm.store16(frame_slot(instr.literal), reg::rax);
+            return true;
+
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,109 @@
+#include "memory_pool.hpp"
+
+#include <array>
+#include <vector>
+
+using namespace ciph;
+
+namespace {
+
+constexpr uint32_t smallest_block = 0x100;
+constexpr size_t size_classes = 9; // 0x100 to 0x10000
+
+size_t
+size_class(uint32_t size) {
+    size_t index = 0;
+    for (uint32_t block = smallest_block; block < size && index + 1 < size_classes; block <<= 1)
+        index++;
+    return index;
+}
+
+uint32_t
+block_size(size_t index) {
+    return smallest_block << index;
+}
+
+// Set once this thread's free lists are gone, a Memory destroyed later than them frees directly.
+thread_local bool t_torn_down = false;
+
+struct free_lists {
+    ~free_lists() {
+        t_torn_down = true;
+        for (std::vector<uint8_t*>& list : blocks) {
+            for (uint8_t* block : list)
+                delete[] block;
+        }
+    }
+
+    std::array<std::vector<uint8_t*>, size_classes> blocks;
+    size_t limit = 32;
+    memory_pool::stats counters;
+};
+
+free_lists&
+local() {
+    thread_local free_lists lists;
+    return lists;
+}
+
+} // namespace
+
+uint8_t*
+memory_pool::acquire(uint32_t size) {
+    size_t index = size_class(size);
+    if (t_torn_down)
+        return new uint8_t[block_size(index)];
+    free_lists& lists = local();
+    std::vector<uint8_t*>& list = lists.blocks[index];
+    if (list.empty()) {
+        lists.counters.misses++;
+        return new uint8_t[block_size(index)];
+    }
+
+    uint8_t* block = list.back();
+    list.pop_back();
+    lists.counters.hits++;
+    lists.counters.cached--;
+    return block;
+}
+
+void
+memory_pool::release(uint8_t* block, uint32_t size) {
+    if (block == nullptr)
+        return;
+    if (t_torn_down) {
+        delete[] block;
+        return;
+    }
+    free_lists& lists = local();
+    std::vector<uint8_t*>& list = lists.blocks[size_class(size)];
+    if (list.size() >= lists.limit) {
+        delete[] block;
+        return;
+    }
+    list.push_back(block);
+    lists.counters.cached++;
+}
+
+void
+memory_pool::set_cache_limit(size_t blocks) {
+    free_lists& lists = local();
+    lists.limit = blocks;
+    for (std::vector<uint8_t*>& list : lists.blocks) {
+        while (list.size() > blocks) {
+            delete[] list.back();
+            list.pop_back();
+            lists.counters.cached--;
+        }
+    }
+}
+
+size_t
+memory_pool::cache_limit() {
+    return local().limit;
+}
+
+memory_pool::stats
+memory_pool::thread_stats() {
+    return local().counters;
+}
@@ -1,53 +1,286 @@
 #include "processing_unit.hpp"
 #include "instructions.hpp"
+#include "interpreter.hpp"
+#include "jit.hpp"
+#include "tracing.hpp"
+#include "verifier.hpp"
 #include <fmt/core.h>
 
 using namespace ciph;
 
-ProcessingUnit::ProcessingUnit() {
+namespace {
+
+// What program() refers to before anything is loaded, every entry point traps on it.
+const std::shared_ptr<const decoded_program>&
+no_program() {
+    static const std::shared_ptr<const decoded_program> empty = std::make_shared<const decoded_program>();
+    return empty;
+}
+
+// The verifier's verdict on no_program, which it rejects.
+const std::shared_ptr<const verifier::report>&
+no_verification() {
+    static const std::shared_ptr<const verifier::report> empty =
+        std::make_shared<const verifier::report>(verifier::verify(decoded_program{}, 0));
+    return empty;
+}
+
+} // namespace
+
+ProcessingUnit::ProcessingUnit(uint32_t memorySize)
+    : m_program(no_program())
+    , m_verification(no_verification())
+    , m_memory(memorySize) {
     m_reg_memory = m_memory.allocate(static_cast<uint16_t>(registers::def::reg_cnt));
     m_registers.set(m_reg_memory);    
 }
 
-void ProcessingUnit::load_program(uint8_t* program, uint16_t size)
+ProcessingUnit::ProcessingUnit(const vm_snapshot& from)
+    : ProcessingUnit(from.memory_size) {
+    restore(from);
+}
+
+void ProcessingUnit::load_program(const uint8_t* program, uint16_t size)
 {
-    uint16_t addrs = m_memory.load(program, static_cast<uint16_t>(size));    
+    load_program(std::make_shared<const std::vector<uint8_t>>(program, program + size));
+}
+
+void ProcessingUnit::load_program(std::shared_ptr<const std::vector<uint8_t>> image)
+{
+    // the same image again only needs its memory reset, the decoded program still matches it.
+    if (image != nullptr && image == m_image && m_program != no_program()) {
+        reset_memory();
+        return;
+    }
+
+    m_image = image ? std::move(image) : std::make_shared<const std::vector<uint8_t>>();
+    reset_memory();
+
+    m_native.reset();
+    if (out_of_memory()) {
+        m_program = no_program();
+        m_stepping.reset();
+        m_verification = no_verification();
+        m_traces.reset(0);
+        return;
+    }
+
+    // decoded at its own length, the byte the stack is padded by isn't part of the program.
+    uint16_t size = static_cast<uint16_t>(m_image->size());
+    m_program = std::make_shared<const decoded_program>(decoder::decode(m_image->data(), size, m_layout.code));
+    m_stepping.reset();
+    m_verification = std::make_shared<const verifier::report>(verifier::verify(*m_program, m_layout.stack));
+    m_traces.reset(m_program->instructions.size());
+    if (m_mode == execution_mode::jit)
+        m_native = std::make_shared<const jit::compiled_program>(jit::compile(*m_program));
+}
+
+void ProcessingUnit::restart()
+{
+    reset_memory();
+}
+
+void ProcessingUnit::reset()
+{
+    // only the register file is cleared, the rest of memory is garbage to a new program anyway.
+    m_image.reset();
+    m_memory.set_allocated(static_cast<uint32_t>(+registers::def::reg_cnt * 2));
+    std::fill_n(m_reg_memory, +registers::def::reg_cnt, uint16_t(0));
+    m_layout = memory_layout{};
+    m_context = ExecutionContext(m_reg_memory, m_memory.getMemory());
+
+    m_program = no_program();
+    m_stepping.reset();
+    m_verification = no_verification();
+    m_native.reset();
+    m_traces.reset(0);
+    m_fuel = 0;
+}
+
+void ProcessingUnit::reset_memory()
+{
+    uint16_t registerBytes = static_cast<uint16_t>(+registers::def::reg_cnt * 2);
+    m_memory.set_allocated(registerBytes);
+    std::fill_n(m_reg_memory, +registers::def::reg_cnt, uint16_t(0));
+    m_context = ExecutionContext(m_reg_memory, m_memory.getMemory());
+
+    // the stack needs at least one word above the program, sp can't wrap around to the registers.
+    uint16_t size = m_image ? static_cast<uint16_t>(m_image->size()) : uint16_t(0);
+    uint32_t padded = static_cast<uint32_t>(size) + (size % 2);
+    if (m_memory.fits(padded + 2) == false) {
+        m_layout = memory_layout{};
+        m_context.trap = trap_code::out_of_memory;
+        return;
+    }
+
+    // the code keeps its addresses but is read from the shared image, memory there is never touched.
+    uint16_t addrs = m_memory.reserve(size);
+    m_context = ExecutionContext(m_reg_memory, m_memory.getMemory(), m_image->data(), addrs);
     m_reg_memory[+registers::def::pc] = addrs;
     m_reg_memory[+registers::def::bp] = addrs;
-    if (size % 2 != 0)
-        size += 1;
 
-    uint16_t stackAddrs = static_cast<uint16_t>(addrs + size);
+    // stack starts on the next even address after the program.
+    uint16_t stackAddrs = static_cast<uint16_t>(addrs + padded);
     m_reg_memory[+registers::def::sp] = stackAddrs; 
     m_reg_memory[+registers::def::fp] = stackAddrs;
 
-    m_context.bytecode = m_memory.getMemory();
-    m_context.registry = m_reg_memory;
+    m_layout.registers = 0;
+    m_layout.code = addrs;
+    m_layout.stack = stackAddrs;
+    m_layout.end = m_memory.size();
 }
 
-int16_t ProcessingUnit::execute()
+std::shared_ptr<const vm_snapshot> ProcessingUnit::snapshot() const
+{
+    auto result = std::make_shared<vm_snapshot>();
+    result->program = m_program;
+    result->native = m_native;
+    result->verification = m_verification;
+    result->image = m_image;
+
+    // a verified program never touches a byte past its extent, others may have written anywhere.
+    uint32_t end = m_memory.size();
+    if (m_verification->fits(end))
+        end = std::max<uint32_t>(m_verification->extent, m_reg_memory[+registers::def::sp]);
+    end = std::max<uint32_t>(std::min(end, m_memory.size()), +registers::def::reg_cnt * 2);
+    const uint8_t* memory = m_memory.getMemory();
+    result->memory.assign(memory, memory + end);
+
+    result->memory_size = m_memory.size();
+    result->allocated = m_memory.allocated();
+    result->layout = m_layout;
+    result->return_value = m_context.return_value;
+    result->trap = m_context.trap;
+    result->mode = m_mode;
+    result->tracing = m_tracing;
+    return result;
+}
+
+void ProcessingUnit::restore(const vm_snapshot& from)
 {
-    instruction::def instr = instruction::def::RET;
-    
-    uint16_t& pc = m_reg_memory[+registers::def::pc];
-    do {
-        instr = static_cast<instruction::def>(m_context.bytecode[pc]);
-        instruction::handlers[instr](m_context);
-        pc++;
+    m_context = ExecutionContext(m_reg_memory, m_memory.getMemory());
+    m_native.reset();
+    if (from.memory.size() > m_memory.size() || from.allocated > m_memory.size()) {
+        std::fill_n(m_reg_memory, +registers::def::reg_cnt, uint16_t(0));
+        m_program = no_program();
+        m_stepping.reset();
+        m_verification = no_verification();
+        m_traces.reset(0);
+        m_image.reset();
+        m_layout = memory_layout{};
+        m_context.trap = trap_code::out_of_memory;
+        return;
+    }
+
+    uint8_t* memory = m_memory.getMemory();
+    std::copy(from.memory.begin(), from.memory.end(), memory);
+    m_memory.set_allocated(from.allocated);
+    m_image = from.image;
+    m_layout = from.layout;
+    m_layout.end = m_memory.size();
+
+    if (m_image)
+        m_context = ExecutionContext(m_reg_memory, memory, m_image->data(), m_layout.code);
+    m_context.return_value = from.return_value;
+    m_context.trap = from.trap;
 
+    m_program = from.program ? from.program : no_program();
+    m_stepping.reset();
+    m_verification = from.verification ? from.verification : no_verification();
+    m_native = from.native;
+    m_traces.reset(m_program->instructions.size());
+    m_tracing = from.tracing;
+    set_execution_mode(from.mode);
+}
+
+std::unique_ptr<ProcessingUnit> ProcessingUnit::fork(const vm_snapshot& from)
+{
+    return std::make_unique<ProcessingUnit>(from);
+}
+
+const jit::compiled_program& ProcessingUnit::native() const
+{
+    static const jit::compiled_program none;
+    return m_native ? *m_native : none;
+}
+
+void ProcessingUnit::set_execution_mode(execution_mode mode)
+{
+    m_mode = mode;
+    if (m_mode == execution_mode::jit && native().empty())
+        m_native = std::make_shared<const jit::compiled_program>(jit::compile(*m_program));
+}
+
+bool ProcessingUnit::unchecked() const
+{
+    const verifier::report& report = *m_verification;
+    if (report.fits(m_memory.size()) == false)
+        return false;
+
+    uint16_t ip = m_program->index_of(m_reg_memory[+registers::def::pc]);
+    if (ip == decoded_program::halt || report.depth[ip] == verifier::unreachable)
+        return false;
+    return m_reg_memory[+registers::def::fp] == m_layout.stack && m_reg_memory[+registers::def::cd] == 0 &&
+           m_reg_memory[+registers::def::sp] == static_cast<uint16_t>(m_layout.stack + report.depth[ip] * 2);
+}
+
+const decoded_program& ProcessingUnit::stepping_program()
+{
+    // quickening keeps one decoded instruction per instruction, only fusion has to be left out.
+    if (m_stepping == nullptr) {
+        if (m_program->fusions == 0 || m_image == nullptr)
+            m_stepping = m_program;
+        else
+            m_stepping = std::make_shared<const decoded_program>(
+                decoder::decode(m_image->data(), static_cast<uint16_t>(m_image->size()), m_layout.code, false));
     }
-    while (instr != instruction::def::RET);
+    return *m_stepping;
+}
 
-    return m_context.return_value;
+bool ProcessingUnit::inside_superinstruction()
+{
+    uint16_t pc = m_reg_memory[+registers::def::pc];
+    return m_program->fusions != 0 && m_program->index_of(pc) == decoded_program::halt &&
+           stepping_program().index_of(pc) != decoded_program::halt;
 }
 
-bool ProcessingUnit::step()
+int16_t ProcessingUnit::execute()
 {
-    instruction::def instr = instruction::def::RET;    
-    uint16_t& pc = m_reg_memory[+registers::def::pc];
-    instr = static_cast<instruction::def>(m_context.bytecode[pc]);
-    instruction::handlers[instr](m_context);
-    pc++;
+    if (out_of_memory())
+        return m_context.return_value;
+    while (inside_superinstruction()) {
+        if (step() == false)
+            return m_context.return_value;
+    }
+    if (unchecked() == false)
+        return interpreter::run_checked(m_context, *m_program, m_memory.size());
+    if (m_mode == execution_mode::jit)
+        return jit::run(m_context, *m_program, native());
+    if (m_mode == execution_mode::tracing)
+        return tracing::run(m_context, *m_program, m_traces, m_tracing);
+    return interpreter::run(m_context, *m_program);
+}
+
+run_status ProcessingUnit::execute(uint32_t budget)
+{
+    m_fuel = budget;
+    if (out_of_memory())
+        return run_status::trapped;
+    while (inside_superinstruction()) {
+        if (m_fuel == 0)
+            return run_status::out_of_fuel;
+        m_fuel--;
+        if (step() == false)
+            return m_context.trap == trap_code::none ? run_status::completed : run_status::trapped;
+    }
+    if (unchecked() == false)
+        return interpreter::run_checked(m_context, *m_program, m_memory.size(), m_fuel);
+    return interpreter::run_metered(m_context, *m_program, m_fuel);
+}
 
-    return instr != instruction::def::RET;
+bool ProcessingUnit::step()
+{
+    if (out_of_memory())
+        return false;
+    return interpreter::step_checked(m_context, stepping_program(), m_memory.size());
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "tracing.hpp"
+
+#include "interpreter.hpp"
+#include "jit_emitter.hpp"
+
+using namespace ciph;
+
+void
+tracing::trace_cache::reset(size_t instructions) {
+    back_edges.assign(instructions, 0);
+    aborts.assign(instructions, 0);
+    trace_of.assign(instructions, no_trace);
+    traces.clear();
+    entries = 0;
+}
+
+#if CIPH_HAS_JIT
+namespace {
+
+// One recorded instruction and the instruction that ran after it.
+struct trace_step {
+    uint16_t ip;
+    uint16_t next;
+};
+
+bool
+conditional(instruction::def opcode) {
+    return opcode == instruction::def::JLT || opcode == instruction::def::JLT_OFF;
+}
+
+/*
+ * Straight line code for the recorded iteration. Every branch becomes a guard, the direction
+ * recorded falls through and the other one exits to the interpreter. */
+class TraceCompiler : public jit::Emitter {
+public:
+    TraceCompiler(const decoded_program& program, const std::vector<trace_step>& steps)
+        : m_program(program)
+        , m_steps(steps) {}
+
+    tracing::compiled_trace compile() {
+        tracing::compiled_trace result;
+        result.header = m_steps.front().ip;
+        result.length = static_cast<uint16_t>(m_steps.size());
+
+        prologue();
+        label loop = m_asm.new_label();
+        m_asm.bind(loop);
+        result.entry = static_cast<uint32_t>(m_asm.position());
+        for (const trace_step& step : m_steps) {
+            m_next = step.next;
+            instruction(m_program.instructions[step.ip], step.ip);
+        }
+        m_asm.jmp(loop);
+
+        result.code = jit::ExecutableMemory(finish());
+        return result;
+    }
+
+private:
+    void branch(const decoded_instruction& instr, uint16_t ip) override {
+        uint16_t fallthrough = static_cast<uint16_t>(ip + 1);
+        if (instr.target == fallthrough)
+            return;
+        if (m_next == instr.target)
+            m_asm.jcc(x64::condition::not_sign, exit_label(fallthrough));
+        else
+            m_asm.jcc(x64::condition::sign, exit_label(instr.target));
+    }
+
+    const decoded_program& m_program;
+    const std::vector<trace_step>& m_steps;
+    uint16_t m_next = 0;
+};
+
+/*
+ * Collects one iteration of a loop from the interpreter. record() is called after every
+ * executed instruction and returns true once the loop closed back on its header. */
+class Recorder {
+public:
+    bool active() const { return m_active; }
+
+    void start(uint16_t header) {
+        m_active = true;
+        m_header = header;
+        m_steps.clear();
+    }
+
+    void abort(tracing::trace_cache& cache) {
+        cache.aborts[m_header]++;
+        m_active = false;
+    }
+
+    // False if the recording had to be given up.
+    bool record(const decoded_instruction& instr, uint16_t ip, uint16_t next, const tracing::options& opts) {
+        if (jit::Emitter::supported(instr) == false || m_steps.size() >= opts.max_trace_length)
+            return false;
+        if (next <= ip && next != m_header)
+            return false;
+        m_steps.push_back({ ip, next });
+        return true;
+    }
+
+    bool closed(uint16_t next) const { return next == m_header; }
+
+    void install(tracing::trace_cache& cache, const decoded_program& program) {
+        m_active = false;
+        tracing::compiled_trace trace = TraceCompiler(program, m_steps).compile();
+        if (trace.code.data() == nullptr) {
+            cache.aborts[m_header] = UINT16_MAX;
+            return;
+        }
+        cache.trace_of[m_header] = static_cast<uint16_t>(cache.traces.size());
+        cache.traces.push_back(std::move(trace));
+    }
+
+private:
+    std::vector<trace_step> m_steps;
+    uint16_t m_header = 0;
+    bool m_active = false;
+};
+
+} // namespace
+#endif
+
+int16_t
+tracing::run(ExecutionContext& context, const decoded_program& program, trace_cache& cache, const options& opts) {
+#if CIPH_HAS_JIT
+    const decoded_instruction* code = program.instructions.data();
+    context.program = &program;
+    uint16_t ip = program.index_of(context.registry[+registers::def::pc]);
+    if (ip == decoded_program::halt) {
+        context.trap = trap_code::invalid_instruction;
+        return context.return_value;
+    }
+    if (cache.trace_of.size() != program.instructions.size())
+        cache.reset(program.instructions.size());
+
+    Recorder recorder;
+    for (;;) {
+        const decoded_instruction& instr = code[ip];
+        uint16_t next = instr.handler(context, instr, ip);
+        if (next == decoded_program::halt) {
+            if (context.trap != trap_code::none)
+                context.registry[+registers::def::pc] = program.byte_pc[ip];
+            return context.return_value;
+        }
+
+        if (recorder.active()) {
+            if (recorder.record(instr, ip, next, opts) == false)
+                recorder.abort(cache);
+            else if (recorder.closed(next))
+                recorder.install(cache, program);
+        }
+
+        if (next <= ip && conditional(instr.opcode)) {
+            uint16_t trace = cache.trace_of[next];
+            if (trace != trace_cache::no_trace) {
+                const compiled_trace& native = cache.traces[trace];
+                auto function = reinterpret_cast<jit::native_function>(const_cast<uint8_t*>(native.code.data()));
+                cache.entries++;
+                next = function(context.bytecode, context.registry, native.code.data() + native.entry);
+                if (next >= program.instructions.size()) {
+                    context.registry[+registers::def::pc] = program.byte_pc.back();
+                    return context.return_value;
+                }
+            }
+            else if (recorder.active() == false && cache.aborts[next] < opts.max_aborts
+                     && ++cache.back_edges[next] >= opts.hot_threshold) {
+                recorder.start(next);
+            }
+        }
+        ip = next;
+    }
+#else
+    (void)cache;
+    (void)opts;
+    return interpreter::run(context, program);
+#endif
+}
@@ -0,0 +1,332 @@
+#include "verifier.hpp"
+
+#include <algorithm>
+#include <utility>
+
+using namespace ciph;
+
+namespace {
+
+// What one decoded instruction does to the stack and the register file.
+struct effect {
+    uint16_t needs = 0;     // words that have to be on the stack already.
+    int16_t delta = 0;      // change in depth once it ran.
+    uint32_t reach = 0;     // one past the highest byte it addresses above fp, 0 if none.
+    uint16_t arguments = 0; // words it reads from under the frame, the caller pushed them before its CALL.
+    int16_t writes = -1;    // register it writes, -1 if none.
+    bool memory = false;    // literal is the address of a word in VM memory.
+    bool branches = false;  // target is a successor as well as the next instruction.
+    bool calls = false;     // target is the entry of a function, the next instruction follows once it returns.
+    bool ends = false;      // RET, nothing follows.
+    bool invalid = false;
+};
+
+// Stack slot n is the word at fp + n * 2.
+uint32_t
+slot_reach(int32_t slot) {
+    return static_cast<uint32_t>(std::max(slot * 2 + 2, 0));
+}
+
+effect
+effect_of(const decoded_instruction& instr) {
+    using instruction::def;
+    bool local = instr.reg_a == +registers::def::sp;
+    effect out;
+    switch (instr.opcode) {
+        case def::PSH:
+        case def::PSH_REG:
+        case def::PSH_LIT:
+            out.delta = 1;
+            break;
+        case def::ADD:
+        case def::SUB:
+        case def::MUL:
+        case def::DIV:
+            out.needs = 2;
+            out.delta = -1;
+            break;
+        case def::ADD_REG:
+        case def::SUB_REG:
+        case def::MUL_REG:
+        case def::DIV_REG:
+        case def::MOV:
+        case def::PUT_REG:
+            out.writes = instr.reg_a;
+            break;
+        case def::PUT_LIT:
+            break;
+        case def::MOV_MEM:
+            out.memory = true;
+            break;
+        case def::PSH_MEM:
+            out.memory = true;
+            out.delta = 1;
+            break;
+        case def::POP_REG:
+            out.needs = 1;
+            out.delta = -1;
+            out.writes = instr.reg_a;
+            break;
+        case def::PEK_REG:
+            out.needs = 1;
+            out.writes = instr.reg_a;
+            break;
+        case def::PEK_OFF:
+            out.reach = slot_reach(instr.literal);
+            if (local)
+                out.delta = 1;
+            else
+                out.writes = instr.reg_a;
+            break;
+        case def::INC:
+        case def::DEC:
+            if (local)
+                out.reach = slot_reach(instr.literal);
+            else
+                out.writes = instr.reg_a;
+            break;
+        case def::CMP:
+            if (local) {
+                out.needs = 2;
+                out.delta = -2;
+            }
+            break;
+        case def::JEQ:
+        case def::JNZ:
+        case def::JGT:
+            break;
+        case def::JLT:
+            out.branches = true;
+            break;
+        case def::CALL:
+            out.calls = true;
+            break;
+        case def::RET:
+            out.ends = true;
+            break;
+        case def::ADD_OFF:
+        case def::SUB_OFF:
+        case def::MUL_OFF:
+        case def::DIV_OFF:
+            out.reach = std::max(slot_reach(instr.reg_a), slot_reach(instr.reg_b));
+            out.delta = 1;
+            break;
+        case def::JLT_OFF:
+            out.reach = slot_reach(instr.reg_a);
+            out.branches = true;
+            break;
+        case def::PEK_LOC:
+        case def::PEK_LOC_REG:
+            // a negative displacement is PEK_ARG, argument n is at -(n * 2) - 4.
+            if (instr.literal < 0)
+                out.arguments = static_cast<uint16_t>((-instr.literal - 4) / 2 + 1);
+            else
+                out.reach = static_cast<uint32_t>(instr.literal);
+            if (instr.opcode == def::PEK_LOC)
+                out.delta = 1;
+            else
+                out.writes = instr.reg_a;
+            break;
+        case def::INC_LOC:
+        case def::DEC_LOC:
+            out.reach = static_cast<uint32_t>(std::max<int32_t>(instr.literal, 0));
+            break;
+        default:
+            out.invalid = true;
+            break;
+    }
+    return out;
+}
+
+bool
+frame_register(int16_t reg) {
+    return reg == +registers::def::sp || reg == +registers::def::fp || reg == +registers::def::cd;
+}
+
+/*
+ * Words the function entered at root reads from under its frame, and the instruction reading the
+ * deepest of them. Functions it calls read their own arguments, they aren't followed. */
+std::pair<uint16_t, uint16_t>
+arguments_of(const std::vector<decoded_instruction>& code, uint16_t root) {
+    std::pair<uint16_t, uint16_t> deepest{ 0, root };
+    std::vector<bool> seen(code.size(), false);
+    std::vector<uint16_t> pending{ root };
+    seen[root] = true;
+    auto follow = [&](uint16_t next) {
+        if (seen[next] == false) {
+            seen[next] = true;
+            pending.push_back(next);
+        }
+    };
+    while (pending.empty() == false) {
+        uint16_t ip = pending.back();
+        pending.pop_back();
+        effect step = effect_of(code[ip]);
+        if (step.arguments > deepest.first)
+            deepest = { step.arguments, ip };
+        if (step.ends)
+            continue;
+        if (step.branches)
+            follow(code[ip].target);
+        follow(static_cast<uint16_t>(ip + 1));
+    }
+    return deepest;
+}
+
+/*
+ * Bytes above fp the function entered at root can touch, its own slots and the frames of the
+ * functions it calls stacked on top. unbounded when it can end up calling itself. */
+class FrameSizes {
+public:
+    FrameSizes(const decoded_program& program, const std::vector<uint16_t>& depth,
+               const std::vector<uint32_t>& frame)
+        : m_code(program.instructions)
+        , m_depth(depth)
+        , m_frame(frame)
+        , m_state(program.instructions.size(), state::unvisited)
+        , m_size(program.instructions.size(), 0) {}
+
+    uint32_t of(uint16_t root) {
+        if (m_state[root] == state::done)
+            return m_size[root];
+        if (m_state[root] == state::open)
+            return verifier::unbounded;
+        m_state[root] = state::open;
+
+        uint32_t size = 0;
+        std::vector<bool> seen(m_code.size(), false);
+        std::vector<uint16_t> pending{ root };
+        seen[root] = true;
+        auto follow = [&](uint16_t next) {
+            if (seen[next] == false) {
+                seen[next] = true;
+                pending.push_back(next);
+            }
+        };
+        while (pending.empty() == false && size != verifier::unbounded) {
+            uint16_t ip = pending.back();
+            pending.pop_back();
+            const decoded_instruction& instr = m_code[ip];
+            size = std::max(size, m_frame[ip]);
+            if (instr.opcode == instruction::def::RET)
+                continue;
+            if (instr.opcode == instruction::def::CALL) {
+                // the return address and saved fp go on top of the caller's stack, the callee's fp above them.
+                uint32_t callee = of(instr.target);
+                if (callee == verifier::unbounded)
+                    size = verifier::unbounded;
+                else
+                    size = std::max(size, m_depth[ip] * 2u + 4u + callee);
+            }
+            else if (effect_of(instr).branches) {
+                follow(instr.target);
+            }
+            follow(static_cast<uint16_t>(ip + 1));
+        }
+
+        m_state[root] = state::done;
+        m_size[root] = size;
+        return size;
+    }
+
+private:
+    enum class state : uint8_t { unvisited, open, done };
+
+    const std::vector<decoded_instruction>& m_code;
+    const std::vector<uint16_t>& m_depth;
+    const std::vector<uint32_t>& m_frame;
+    std::vector<state> m_state;
+    std::vector<uint32_t> m_size;
+};
+
+} // namespace
+
+verifier::report
+verifier::verify(const decoded_program& program, uint16_t stack) {
+    const std::vector<decoded_instruction>& code = program.instructions;
+    size_t count = code.size();
+    report out;
+    auto fail = [&](status why, size_t at) {
+        out.result = why;
+        out.at = static_cast<uint16_t>(at);
+        out.depth.clear();
+        return out;
+    };
+    if (count == 0)
+        return fail(status::falls_off_end, 0);
+
+    std::vector<uint16_t> depth(count, unreachable);
+    std::vector<uint16_t> pending{ 0 };
+    depth[0] = 0;
+    // bytes above fp each instruction touches, its slots or the stack it leaves.
+    std::vector<uint32_t> frame(count, 0);
+    uint32_t memory_end = 0;
+
+    // every instruction is visited once, the depth it was first reached with has to hold on every path.
+    auto reached = [&](size_t next, uint16_t words) {
+        if (depth[next] == unreachable) {
+            depth[next] = words;
+            pending.push_back(static_cast<uint16_t>(next));
+            return true;
+        }
+        return depth[next] == words;
+    };
+
+    while (pending.empty() == false) {
+        uint16_t ip = pending.back();
+        pending.pop_back();
+        const decoded_instruction& instr = code[ip];
+        effect step = effect_of(instr);
+
+        if (step.invalid)
+            return fail(status::invalid_instruction, ip);
+        if (frame_register(step.writes))
+            return fail(status::frame_write, ip);
+        if (depth[ip] < step.needs)
+            return fail(status::stack_underflow, ip);
+        if (step.memory) {
+            uint16_t address = static_cast<uint16_t>(instr.literal);
+            if (address < +registers::def::reg_cnt * 2)
+                return fail(status::register_memory, ip);
+            memory_end = std::max(memory_end, address + 2u);
+        }
+
+        uint16_t after = static_cast<uint16_t>(depth[ip] + step.delta);
+        out.max_depth = std::max(out.max_depth, after);
+        frame[ip] = std::max<uint32_t>(step.reach, after * 2u);
+        if (step.ends)
+            continue;
+
+        if (ip + 1u >= count)
+            return fail(status::falls_off_end, ip);
+        if (reached(ip + 1u, after) == false)
+            return fail(status::stack_mismatch, ip + 1u);
+        if (step.branches && reached(instr.target, after) == false)
+            return fail(status::stack_mismatch, instr.target);
+        // every function starts on an empty stack of its own, whoever calls it.
+        if (step.calls && reached(instr.target, 0) == false)
+            return fail(status::stack_mismatch, instr.target);
+    }
+
+    // arguments are words on the caller's stack, every CALL has to leave as many as its function reads.
+    if (auto [words, at] = arguments_of(code, 0); words > 0)
+        return fail(status::stack_underflow, at);
+    std::vector<uint16_t> arguments(count, unreachable);
+    for (size_t ip = 0; ip < count; ip++) {
+        if (depth[ip] == unreachable || code[ip].opcode != instruction::def::CALL)
+            continue;
+        uint16_t callee = code[ip].target;
+        if (arguments[callee] == unreachable)
+            arguments[callee] = arguments_of(code, callee).first;
+        if (depth[ip] < arguments[callee])
+            return fail(status::stack_underflow, ip);
+    }
+
+    uint32_t size = FrameSizes(program, depth, frame).of(0);
+    if (size == unbounded)
+        out.extent = unbounded;
+    else
+        out.extent = std::max(static_cast<uint32_t>(stack) + size, memory_end);
+    out.depth = std::move(depth);
+    return out;
+}
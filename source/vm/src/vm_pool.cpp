@@ -0,0 +1,185 @@
+#include "vm_pool.hpp"
+
+#include <algorithm>
+
+#include "processing_unit.hpp"
+
+using namespace ciph;
+
+namespace {
+
+// Set on worker threads, lets submit keep jobs a worker creates on its own deque.
+thread_local const VmPool* t_pool = nullptr;
+thread_local size_t t_worker = 0;
+
+uint64_t
+nanoseconds(std::chrono::steady_clock::duration duration) {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+}
+
+pool::job_result
+execute(ProcessingUnit& unit, const pool::job& job) {
+    pool::job_result result;
+    if (job.program == nullptr) {
+        result.trap = trap_code::invalid_instruction;
+        return result;
+    }
+
+    // shares the job's bytes, and only restarts when the worker's last job had the same program.
+    unit.load_program(job.program);
+
+    uint16_t* registries = unit.registries();
+    registries[+registers::def::pc] = static_cast<uint16_t>(registries[+registers::def::bp] + job.entry);
+    for (size_t reg = 0; reg < job.inputs.size(); reg++)
+        registries[+registers::def::r0 + reg] = static_cast<uint16_t>(job.inputs[reg]);
+
+    result.return_value = unit.execute();
+    result.trap = unit.context().trap;
+    return result;
+}
+
+} // namespace
+
+VmPool::VmPool(size_t workers)
+    : m_started(std::chrono::steady_clock::now()) {
+    workers = std::max<size_t>(workers, 1);
+    m_workers.reserve(workers);
+    for (size_t index = 0; index < workers; index++)
+        m_workers.push_back(std::make_unique<worker>());
+    // every deque exists before the first worker can try to steal from it.
+    for (size_t index = 0; index < workers; index++)
+        m_workers[index]->thread = std::thread(&VmPool::work, this, index);
+}
+
+VmPool::~VmPool() {
+    m_stopping = true;
+    m_wake++;
+    m_wake.notify_all();
+    for (auto& entry : m_workers)
+        entry->thread.join();
+}
+
+std::future<pool::job_result>
+VmPool::submit(pool::job job) {
+    auto promise = std::make_shared<std::promise<pool::job_result>>();
+    std::future<pool::job_result> result = promise->get_future();
+    submit(std::move(job), [promise](const pool::job_result& value) { promise->set_value(value); });
+    return result;
+}
+
+void
+VmPool::submit(pool::job job, std::function<void(const pool::job_result&)> done) {
+    m_submitted++;
+    enqueue({ std::move(job), std::move(done), std::chrono::steady_clock::now() });
+}
+
+std::vector<pool::job_result>
+VmPool::run(const std::vector<pool::job>& jobs) {
+    std::vector<pool::job_result> results(jobs.size());
+    // shared with the callbacks, the last one still notifies after run may have seen zero and returned.
+    auto remaining = std::make_shared<std::atomic<size_t>>(jobs.size());
+
+    for (size_t index = 0; index < jobs.size(); index++) {
+        submit(jobs[index], [&results, remaining, index](const pool::job_result& value) {
+            results[index] = value;
+            if (--*remaining == 0)
+                remaining->notify_one();
+        });
+    }
+
+    for (size_t left = remaining->load(); left != 0; left = remaining->load())
+        remaining->wait(left);
+    return results;
+}
+
+void
+VmPool::wait_idle() {
+    for (uint64_t completed = m_completed.load(); completed != m_submitted.load(); completed = m_completed.load())
+        m_completed.wait(completed);
+}
+
+pool::counters
+VmPool::counters() const {
+    pool::counters result;
+    result.submitted = m_submitted.load();
+    result.completed = m_completed.load();
+    result.stolen = m_stolen.load();
+    result.queue_wait_total_ns = m_wait_total.load();
+    result.queue_wait_max_ns = m_wait_max.load();
+    result.uptime_ns = nanoseconds(std::chrono::steady_clock::now() - m_started);
+    return result;
+}
+
+void
+VmPool::enqueue(task&& item) {
+    size_t target = t_pool == this ? t_worker : m_next++ % m_workers.size();
+    {
+        std::lock_guard<std::mutex> guard(m_workers[target]->lock);
+        m_workers[target]->tasks.push_back(std::move(item));
+    }
+    m_wake++;
+    m_wake.notify_one();
+}
+
+bool
+VmPool::take(size_t self, task& item) {
+    {
+        worker& own = *m_workers[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (own.tasks.empty() == false) {
+            item = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < m_workers.size(); offset++) {
+        worker& victim = *m_workers[(self + offset) % m_workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.tasks.empty() == false) {
+            item = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+VmPool::work(size_t self) {
+    t_pool = this;
+    t_worker = self;
+
+    ProcessingUnit unit;
+    for (;;) {
+        // read before looking for work, a job enqueued after the deques were found empty changes it.
+        uint32_t wake = m_wake.load();
+        task item;
+        if (take(self, item)) {
+            std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+            pool::job_result result = execute(unit, item.job);
+            if (item.done)
+                item.done(result);
+            finished(item, started);
+            continue;
+        }
+
+        // every deque was empty, a job still running can only queue more on its own worker.
+        if (m_stopping)
+            return;
+        m_wake.wait(wake);
+    }
+}
+
+void
+VmPool::finished(const task& item, std::chrono::steady_clock::time_point started) {
+    uint64_t wait = nanoseconds(started - item.queued);
+    m_wait_total += wait;
+    uint64_t longest = m_wait_max.load();
+    while (wait > longest && m_wait_max.compare_exchange_weak(longest, wait) == false) {
+    }
+
+    if (++m_completed == m_submitted.load())
+        m_completed.notify_all();
+}
@@ -0,0 +1,295 @@
+#include "x64_assembler.hpp"
+
+using namespace ciph;
+using namespace ciph::x64;
+
+namespace {
+
+uint8_t
+code(reg r) {
+    return static_cast<uint8_t>(r);
+}
+
+} // namespace
+
+Assembler::label
+Assembler::new_label() {
+    m_labels.push_back(-1);
+    return m_labels.size() - 1;
+}
+
+void
+Assembler::bind(label target) {
+    m_labels[target] = static_cast<int64_t>(m_code.size());
+}
+
+bool
+Assembler::bound(label target) const {
+    return m_labels[target] >= 0;
+}
+
+void
+Assembler::emit32(uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        emit(static_cast<uint8_t>(value >> (i * 8)));
+}
+
+void
+Assembler::rex(bool wide, uint8_t r, uint8_t x, uint8_t b, bool force) {
+    uint8_t prefix = static_cast<uint8_t>(0x40 | (wide << 3) | ((r >> 3) << 2) | ((x >> 3) << 1) | (b >> 3));
+    if (prefix != 0x40 || force)
+        emit(prefix);
+}
+
+void
+Assembler::rex_mem(bool wide, uint8_t r, const mem& m) {
+    rex(wide, r, m.has_index ? code(m.index) : 0, code(m.base));
+}
+
+void
+Assembler::modrm_reg(uint8_t r, uint8_t rm) {
+    emit(static_cast<uint8_t>(0xC0 | ((r & 7) << 3) | (rm & 7)));
+}
+
+void
+Assembler::modrm_mem(uint8_t r, const mem& m) {
+    uint8_t base = code(m.base) & 7;
+    if (m.has_index) {
+        emit(static_cast<uint8_t>(0x80 | ((r & 7) << 3) | 0x04));
+        emit(static_cast<uint8_t>(((code(m.index) & 7) << 3) | base));
+    }
+    else if (base == 0x04) {
+        // rsp and r12 as base always need a SIB byte.
+        emit(static_cast<uint8_t>(0x80 | ((r & 7) << 3) | 0x04));
+        emit(0x24);
+    }
+    else {
+        emit(static_cast<uint8_t>(0x80 | ((r & 7) << 3) | base));
+    }
+    emit32(static_cast<uint32_t>(m.disp));
+}
+
+void
+Assembler::push(reg r) {
+    rex(false, 0, 0, code(r));
+    emit(static_cast<uint8_t>(0x50 | (code(r) & 7)));
+}
+
+void
+Assembler::pop(reg r) {
+    rex(false, 0, 0, code(r));
+    emit(static_cast<uint8_t>(0x58 | (code(r) & 7)));
+}
+
+void
+Assembler::ret() {
+    emit(0xC3);
+}
+
+void
+Assembler::mov64(reg dst, reg src) {
+    rex(true, code(src), 0, code(dst));
+    emit(0x89);
+    modrm_reg(code(src), code(dst));
+}
+
+void
+Assembler::mov32(reg dst, reg src) {
+    alu32(0x89, dst, src);
+}
+
+void
+Assembler::mov32(reg dst, uint32_t imm) {
+    rex(false, 0, 0, code(dst));
+    emit(static_cast<uint8_t>(0xB8 | (code(dst) & 7)));
+    emit32(imm);
+}
+
+void
+Assembler::mov16(reg dst, reg src) {
+    emit(0x66);
+    alu32(0x89, dst, src);
+}
+
+void
+Assembler::movzx16(reg dst, reg src) {
+    rex(false, code(dst), 0, code(src));
+    emit(0x0F);
+    emit(0xB7);
+    modrm_reg(code(dst), code(src));
+}
+
+void
+Assembler::movzx16(reg dst, const mem& src) {
+    rex_mem(false, code(dst), src);
+    emit(0x0F);
+    emit(0xB7);
+    modrm_mem(code(dst), src);
+}
+
+void
+Assembler::movsx16(reg dst, reg src) {
+    rex(false, code(dst), 0, code(src));
+    emit(0x0F);
+    emit(0xBF);
+    modrm_reg(code(dst), code(src));
+}
+
+void
+Assembler::movsx16(reg dst, const mem& src) {
+    rex_mem(false, code(dst), src);
+    emit(0x0F);
+    emit(0xBF);
+    modrm_mem(code(dst), src);
+}
+
+void
+Assembler::store16(const mem& dst, reg src) {
+    emit(0x66);
+    rex_mem(false, code(src), dst);
+    emit(0x89);
+    modrm_mem(code(src), dst);
+}
+
+void
+Assembler::store16(const mem& dst, uint16_t imm) {
+    emit(0x66);
+    rex_mem(false, 0, dst);
+    emit(0xC7);
+    modrm_mem(0, dst);
+    emit(static_cast<uint8_t>(imm & 0xFF));
+    emit(static_cast<uint8_t>(imm >> 8));
+}
+
+void
+Assembler::alu32(uint8_t opcode, reg dst, reg src) {
+    rex(false, code(src), 0, code(dst));
+    emit(opcode);
+    modrm_reg(code(src), code(dst));
+}
+
+void
+Assembler::alu32_imm(uint8_t ext, reg dst, int32_t imm) {
+    rex(false, 0, 0, code(dst));
+    emit(0x81);
+    modrm_reg(ext, code(dst));
+    emit32(static_cast<uint32_t>(imm));
+}
+
+void
+Assembler::alu16_imm(uint8_t ext, reg dst, int16_t imm) {
+    emit(0x66);
+    rex(false, 0, 0, code(dst));
+    emit(0x81);
+    modrm_reg(ext, code(dst));
+    emit(static_cast<uint8_t>(imm & 0xFF));
+    emit(static_cast<uint8_t>((imm >> 8) & 0xFF));
+}
+
+void
+Assembler::add16(reg dst, int16_t imm) {
+    alu16_imm(0, dst, imm);
+}
+
+void
+Assembler::sub16(reg dst, int16_t imm) {
+    alu16_imm(5, dst, imm);
+}
+
+void
+Assembler::add32(reg dst, reg src) {
+    alu32(0x01, dst, src);
+}
+
+void
+Assembler::add32(reg dst, int32_t imm) {
+    alu32_imm(0, dst, imm);
+}
+
+void
+Assembler::sub32(reg dst, reg src) {
+    alu32(0x29, dst, src);
+}
+
+void
+Assembler::sub32(reg dst, int32_t imm) {
+    alu32_imm(5, dst, imm);
+}
+
+void
+Assembler::imul32(reg dst, reg src) {
+    rex(false, code(dst), 0, code(src));
+    emit(0x0F);
+    emit(0xAF);
+    modrm_reg(code(dst), code(src));
+}
+
+void
+Assembler::cmp32(reg a, reg b) {
+    alu32(0x39, a, b);
+}
+
+void
+Assembler::cmp32(reg a, int32_t imm) {
+    alu32_imm(7, a, imm);
+}
+
+void
+Assembler::test32(reg a, reg b) {
+    alu32(0x85, a, b);
+}
+
+void
+Assembler::test16(reg a, reg b) {
+    emit(0x66);
+    alu32(0x85, a, b);
+}
+
+void
+Assembler::cdq() {
+    emit(0x99);
+}
+
+void
+Assembler::idiv32(reg divisor) {
+    rex(false, 0, 0, code(divisor));
+    emit(0xF7);
+    modrm_reg(7, code(divisor));
+}
+
+void
+Assembler::rel32(label target) {
+    m_fixups.emplace_back(m_code.size(), target);
+    emit32(0);
+}
+
+void
+Assembler::jmp(label target) {
+    emit(0xE9);
+    rel32(target);
+}
+
+void
+Assembler::jmp(reg target) {
+    rex(false, 0, 0, code(target));
+    emit(0xFF);
+    modrm_reg(4, code(target));
+}
+
+void
+Assembler::jcc(condition cc, label target) {
+    emit(0x0F);
+    emit(static_cast<uint8_t>(0x80 | static_cast<uint8_t>(cc)));
+    rel32(target);
+}
+
+const std::vector<uint8_t>&
+Assembler::finalize() {
+    for (auto [position, target] : m_fixups) {
+        int64_t offset = m_labels[target] - static_cast<int64_t>(position + 4);
+        for (size_t i = 0; i < 4; i++)
+            m_code[position + i] = static_cast<uint8_t>(static_cast<uint32_t>(offset) >> (i * 8));
+    }
+    m_fixups.clear();
+    return m_code;
+}
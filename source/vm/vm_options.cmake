@@ -0,0 +1,27 @@
+# ---- VM build options ----
+
+# Interpreter loop used by ProcessingUnit::execute. "threaded" uses computed goto and falls
+# back to "switch" on compilers without labels-as-values, "table" is the central handler loop.
+set(CIPH_VM_DISPATCH "threaded" CACHE STRING "Interpreter dispatch (threaded, switch or table)")
+set_property(CACHE CIPH_VM_DISPATCH PROPERTY STRINGS threaded switch table)
+
+if(NOT CIPH_VM_DISPATCH MATCHES "^(threaded|switch|table)$")
+  message(FATAL_ERROR "CIPH_VM_DISPATCH must be one of threaded, switch or table")
+endif()
+
+string(TOUPPER ${CIPH_VM_DISPATCH} CIPH_VM_DISPATCH_UPPER)
+set(VM_COMPILE_DEFINITIONS CIPH_VM_DISPATCH_${CIPH_VM_DISPATCH_UPPER})
+
+# Baseline JIT used by ProcessingUnit in execution_mode::jit, only built for x86-64 Linux.
+# Without it the jit mode runs on the interpreter.
+option(CIPH_VM_JIT "Build the x86-64 JIT" ON)
+if(CIPH_VM_JIT)
+  list(APPEND VM_COMPILE_DEFINITIONS CIPH_VM_JIT)
+endif()
+
+# AVX2 lanes of the batched executor, compiled for AVX2 function by function so the rest of the VM
+# keeps the baseline instruction set. BatchExecutor checks the host CPU before using them.
+option(CIPH_VM_AVX2 "Build the AVX2 lanes of the batched executor" ON)
+if(CIPH_VM_AVX2)
+  list(APPEND VM_COMPILE_DEFINITIONS CIPH_VM_AVX2)
+endif()
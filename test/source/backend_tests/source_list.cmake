@@ -0,0 +1,6 @@
+set(BACKEND_TEST_DIR ${CMAKE_CURRENT_SOURCE_DIR}/source/backend_tests)
+set(BACKEND_TEST_SRC
+    ${BACKEND_TEST_DIR}/main.cpp
+
+    ${BACKEND_TEST_DIR}/tests_c_generator.cpp
+)
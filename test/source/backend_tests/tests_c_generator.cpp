@@ -0,0 +1,473 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ast.hpp"
+#include "c_generator.hpp"
+#include "code_generator.hpp"
+#include "parser.hpp"
+#include "processing_unit.hpp"
+#include "shared_defines.hpp"
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace ciph;
+
+namespace {
+
+struct native_result {
+    int16_t return_value = 0;
+    int trapped = 0;
+};
+
+/*
+ * Generates C for source, builds it with the host compiler next to a main that prints the
+ * result and runs it. Fails the current test if any step fails. */
+native_result
+run_native(const std::string& name, const std::string& source) {
+    Parser parser(source);
+    auto parser_result = parser.parse();
+    auto* program = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result));
+    CGenerator generator(program);
+    generator.generateCode();
+    std::string code = generator.readSource();
+    delete program;
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "ciph_backend_tests";
+    std::filesystem::create_directories(directory);
+    std::filesystem::path file = directory / (name + ".c");
+    std::filesystem::path executable = directory / name;
+    {
+        std::ofstream out(file);
+        out << code;
+        out << "#include <stdio.h>\n"
+               "int main(void) { int16_t result = ciph_main(); printf(\"%d %d\\n\", result, ciph_main_trapped); return 0; }\n";
+    }
+
+    std::string compile = std::string("\"") + CIPH_HOST_C_COMPILER + "\" -std=c99 -O2 -Wall -Werror -o \"" +
+                          executable.string() + "\" \"" + file.string() + "\"";
+    EXPECT_EQ(0, std::system(compile.c_str())) << code;
+
+    native_result result;
+    FILE* output = popen(("\"" + executable.string() + "\"").c_str(), "r");
+    EXPECT_NE(nullptr, output);
+    if (output == nullptr)
+        return result;
+    int value = 0;
+    EXPECT_EQ(2, std::fscanf(output, "%d %d", &value, &result.trapped));
+    pclose(output);
+    result.return_value = static_cast<int16_t>(value);
+    return result;
+}
+
+std::vector<uint8_t>
+compile(const std::string& source, Evaluation evaluation) {
+    Parser parser(source);
+    auto* program = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser.parse()));
+    CodeGenerator generator(program, evaluation);
+    generator.generateCode();
+    auto [bytes, size] = generator.readRawBytecode();
+    std::vector<uint8_t> bytecode(bytes, bytes + size);
+    delete[] bytes;
+    delete program;
+    return bytecode;
+}
+
+int16_t
+run_vm(std::vector<uint8_t> bytecode, trap_code& trap) {
+    ProcessingUnit unit;
+    unit.load_program(bytecode.data(), static_cast<uint16_t>(bytecode.size()));
+    int16_t result = unit.execute();
+    trap = unit.context().trap;
+    return result;
+}
+
+// A ciph program and the bytecode CodeGenerator is expected to produce for its body.
+struct backend_case {
+    std::string name;
+    std::string source;
+    std::vector<uint8_t> bytecode;
+};
+
+std::vector<backend_case>
+backend_cases() {
+    using instruction::def;
+    using reg = registers::def;
+    return {
+        { "Add", "return 26 + 16", {
+            +def::PSH_LIT, 0, 26,
+            +def::PSH_LIT, 0, 16,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "MulBeforeAdd", "return 2 * 2 + 3", {
+            +def::PSH_LIT, 0, 2,
+            +def::PSH_LIT, 0, 2,
+            +def::MUL,
+            +def::PSH_LIT, 0, 3,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "ParenthasesBeforeMul", "return 2 * (2 + 3)", {
+            +def::PSH_LIT, 0, 2,
+            +def::PSH_LIT, 0, 2,
+            +def::PSH_LIT, 0, 3,
+            +def::ADD,
+            +def::MUL,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "LetStatement_MultipleVariables", "let x = 2\nlet y = 3\nlet z = x + y\nreturn z + y", {
+            +def::PSH_LIT, 0, 2,
+            +def::PSH_LIT, 0, 3,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::ADD,
+            +def::PEK_OFF, +reg::sp, 2,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "Return_Equals", "let a = 10\nreturn a == 10", {
+            +def::PSH_LIT, 0, 10,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PSH_LIT, 0, 10,
+            +def::CMP, +reg::sp,
+            +def::MOV, +reg::ret, +reg::imm,
+            +def::RET } },
+        { "While", "let i = 0\nwhile (i < 10) {\ni++\n}\nreturn i", {
+            +def::PSH_LIT, 0, 0,
+            +def::INC, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PSH_LIT, 0, 10,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x0E,
+            +def::PEK_OFF, +reg::ret, 0,
+            +def::RET } },
+        { "Wraparound_Add", "return 32767 + 1", {
+            +def::PSH_LIT, 0x7F, 0xFF,
+            +def::PSH_LIT, 0, 1,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "Wraparound_Mul", "return 300 * 300", {
+            +def::PSH_LIT, 0x01, 0x2C,
+            +def::PSH_LIT, 0x01, 0x2C,
+            +def::MUL,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "Division_TruncatesTowardsZero", "return (0 - 7) / 2 - 9 / (0 - 4)", {
+            +def::PSH_LIT, 0, 0,
+            +def::PSH_LIT, 0, 7,
+            +def::SUB,
+            +def::PSH_LIT, 0, 2,
+            +def::DIV,
+            +def::PSH_LIT, 0, 9,
+            +def::PSH_LIT, 0, 0,
+            +def::PSH_LIT, 0, 4,
+            +def::SUB,
+            +def::DIV,
+            +def::SUB,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "DecrementingLoop", "let i = 50\nwhile (0 < i) {\ni--\n}\nreturn i", {
+            +def::PSH_LIT, 0, 50,
+            +def::DEC, +reg::sp, 0,
+            +def::PSH_LIT, 0, 0,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x0E,
+            +def::PEK_OFF, +reg::ret, 0,
+            +def::RET } },
+        { "Call_ReturnsToCaller", "fn seven() {\nreturn 3 + 4\n}\nlet a = seven()\nreturn a * seven()", {
+            +def::CALL, 0x00, 0x11,
+            +def::PSH_REG, +reg::ret,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::CALL, 0x00, 0x11,
+            +def::PSH_REG, +reg::ret,
+            +def::MUL,
+            +def::POP_REG, +reg::ret,
+            +def::RET,
+            // seven, after the program.
+            +def::PSH_LIT, 0, 3,
+            +def::PSH_LIT, 0, 4,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "Call_MixedArguments",
+          "fn mix(a, b, c, d, e, f) {\nreturn (a - b) * c + d * (e - f)\n}\nlet x = 9\nreturn mix(x, 2, x - 4, 4, x, 6)", {
+            +def::PSH_LIT, 0, 9,
+            +def::PSH_LIT, 0, 6,                // f and e, last first
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PEK_OFF, +reg::r0, 0,         // a to d in r0 to r3
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PSH_LIT, 0, 4,
+            +def::SUB,
+            +def::POP_REG, +reg::r2,
+            +def::PUT_LIT, 0, 2,
+            +def::PUT_REG, +reg::r1,
+            +def::PUT_LIT, 0, 4,
+            +def::PUT_REG, +reg::r3,
+            +def::CALL, 0x00, 0x27,
+            +def::POP_REG, +reg::imm,
+            +def::POP_REG, +reg::imm,
+            +def::RET,
+            // mix, every parameter copied into a stack slot.
+            +def::PSH_REG, +reg::r0,
+            +def::PSH_REG, +reg::r1,
+            +def::PSH_REG, +reg::r2,
+            +def::PSH_REG, +reg::r3,
+            +def::PEK_ARG, +reg::sp, 0,
+            +def::PEK_ARG, +reg::sp, 1,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::SUB,
+            +def::PEK_OFF, +reg::sp, 2,
+            +def::MUL,
+            +def::PEK_OFF, +reg::sp, 3,
+            +def::PEK_OFF, +reg::sp, 4,
+            +def::PEK_OFF, +reg::sp, 5,
+            +def::SUB,
+            +def::MUL,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        // q is never read, the C has to build under -Wall -Werror all the same.
+        { "UnreadLet", "let s = 3\nlet i = 0\nwhile (i < 5) {\nlet q = i + s\ni++\n}\nreturn i", {
+            +def::PSH_LIT, 0, 3,
+            +def::PSH_LIT, 0, 0,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::ADD,
+            +def::INC, +reg::sp, 1,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::PSH_LIT, 0, 5,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x15,
+            +def::PEK_OFF, +reg::ret, 1,
+            +def::RET } },
+    };
+}
+
+// Names the instances of a suite instantiated over backend_cases() after their program.
+struct backend_name {
+    std::string operator()(const ::testing::TestParamInfo<backend_case>& info) const {
+        return info.param.name;
+    }
+};
+
+} // namespace
+
+class CGeneratorDifferentialTest : public ::testing::TestWithParam<backend_case>
+{
+};
+
+TEST_P(CGeneratorDifferentialTest, MatchesProcessingUnit)
+{
+    trap_code trap = trap_code::none;
+    int16_t expected = run_vm(GetParam().bytecode, trap);
+    native_result actual = run_native(GetParam().name, GetParam().source);
+
+    EXPECT_EQ(trap_code::none, trap);
+    EXPECT_EQ(expected, actual.return_value);
+    EXPECT_EQ(0, actual.trapped);
+}
+
+INSTANTIATE_TEST_SUITE_P(Programs, CGeneratorDifferentialTest, ::testing::ValuesIn(backend_cases()),
+                         backend_name());
+
+TEST(CGeneratorTest, Function_BecomesNativeFunction)
+{
+    std::string code(R"(fn number() {
+                            return 42
+                        }
+                        return number())");
+
+    Parser parser(code);
+    auto* program = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser.parse()));
+    CGenerator generator(program);
+    generator.generateCode();
+    EXPECT_NE(std::string::npos, generator.readSource().find("static int16_t ciph_main_fn_number(void) {"));
+    delete program;
+
+    EXPECT_EQ(42, run_native("Function", code).return_value);
+}
+
+TEST(CGeneratorTest, DivisionByZero_SetsTrapped)
+{
+    native_result result = run_native("DivisionByZero", "return 7 / 0");
+    EXPECT_EQ(0, result.return_value);
+    EXPECT_EQ(1, result.trapped);
+}
+
+TEST(CGeneratorTest, DivisionByZero_TrapsOnEveryBackend)
+{
+    std::string code(R"(let a = 0
+                        return 5 / a)");
+
+    trap_code stackTrap = trap_code::none;
+    trap_code registerTrap = trap_code::none;
+    run_vm(compile(code, Evaluation::Stack), stackTrap);
+    run_vm(compile(code, Evaluation::Registers), registerTrap);
+    EXPECT_EQ(trap_code::division_by_zero, stackTrap);
+    EXPECT_EQ(trap_code::division_by_zero, registerTrap);
+    EXPECT_EQ(1, run_native("DivisionByVariable", code).trapped);
+}
+
+TEST(CGeneratorTest, DivisionByZero_StopsTheProgram)
+{
+    // the VM stops on the division, nothing after it runs and the return value stays 0.
+    std::string code(R"(fn inverse(x) {
+                            let q = 1 / x
+                            return 7
+                        }
+                        let r = inverse(0)
+                        return 9)");
+
+    trap_code trap = trap_code::none;
+    EXPECT_EQ(0, run_vm(compile(code, Evaluation::Stack), trap));
+    EXPECT_EQ(trap_code::division_by_zero, trap);
+
+    native_result result = run_native("DivisionStops", code);
+    EXPECT_EQ(0, result.return_value);
+    EXPECT_EQ(1, result.trapped);
+}
+
+TEST(CGeneratorTest, While_BecomesNativeLoop)
+{
+    std::string code(R"(let i = 0
+                        while (i < 5) {
+                            i++
+                        }
+                        return i)");
+
+    Parser parser(code);
+    auto* program = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser.parse()));
+    CGenerator generator(program);
+    generator.generateCode();
+    const std::string& source = generator.readSource();
+    EXPECT_NE(std::string::npos, source.find("int16_t v_i = 0;"));
+    EXPECT_NE(std::string::npos, source.find("do {"));
+    EXPECT_NE(std::string::npos, source.find("} while (ciph_sub(v_i, (int16_t)5) < 0);"));
+    delete program;
+}
+
+class CodeGeneratorDifferentialTest : public ::testing::TestWithParam<backend_case>
+{
+};
+
+TEST_P(CodeGeneratorDifferentialTest, Stack_ExpectedBytecode)
+{
+    EXPECT_EQ(GetParam().bytecode, compile(GetParam().source, Evaluation::Stack));
+}
+
+TEST_P(CodeGeneratorDifferentialTest, Registers_MatchesStack)
+{
+    trap_code stackTrap = trap_code::none;
+    trap_code registerTrap = trap_code::none;
+    int16_t expected = run_vm(compile(GetParam().source, Evaluation::Stack), stackTrap);
+    int16_t actual = run_vm(compile(GetParam().source, Evaluation::Registers), registerTrap);
+
+    EXPECT_EQ(stackTrap, registerTrap);
+    EXPECT_EQ(expected, actual);
+}
+
+INSTANTIATE_TEST_SUITE_P(Programs, CodeGeneratorDifferentialTest, ::testing::ValuesIn(backend_cases()),
+                         backend_name());
+
+// Nested deeper on the right than there are registers, the innermost operands go through the stack.
+TEST(CodeGeneratorRegistersTest, OutOfRegisters_MatchesNative)
+{
+    std::string code(R"(let a = 7
+                        let b = 3
+                        return a - (b * (a - (b + (a - (b * (a - (b + (a - (b - a)))))))))
+                        )");
+
+    std::vector<uint8_t> bytecode = compile(code, Evaluation::Registers);
+    const uint8_t spill[] = { +instruction::def::POP_REG, +registers::def::imm };
+    EXPECT_NE(bytecode.end(), std::search(bytecode.begin(), bytecode.end(), std::begin(spill), std::end(spill)));
+
+    trap_code trap = trap_code::none;
+    EXPECT_EQ(run_native("OutOfRegisters", code).return_value, run_vm(bytecode, trap));
+    EXPECT_EQ(trap_code::none, trap);
+}
+
+// More locals live at once than RegisterAllocator keeps in registers, the cold ones get stack slots.
+TEST(CodeGeneratorRegistersTest, RegisterPressure_MatchesNative)
+{
+    std::string code(R"(let a = 1
+                        let b = 2
+                        let c = 3
+                        let d = 4
+                        let e = 5
+                        let f = 6
+                        let i = 0
+                        while (i < 20) {
+                            i++
+                            f++
+                        }
+                        return ((a + b) * (c + d)) + ((e * f) - i)
+                        )");
+
+    std::vector<uint8_t> bytecode = compile(code, Evaluation::Registers);
+    EXPECT_NE(bytecode.end(), std::find(bytecode.begin(), bytecode.end(), +instruction::def::PEK_OFF));
+
+    trap_code trap = trap_code::none;
+    EXPECT_EQ(run_native("RegisterPressure", code).return_value, run_vm(bytecode, trap));
+    EXPECT_EQ(trap_code::none, trap);
+}
+
+// Locals and operands held in registers across calls, the callee reuses the same registers.
+TEST(CodeGeneratorRegistersTest, CallsBetweenLiveRegisters_MatchesNative)
+{
+    std::string code(R"(fn two() {
+                            let x = 1
+                            return x + 1
+                        }
+                        fn five() {
+                            let y = two()
+                            return (y + two()) + 1
+                        }
+                        let a = 3
+                        let b = 4
+                        return (a + b) * (five() + (b - two()))
+                        )");
+
+    std::vector<uint8_t> bytecode = compile(code, Evaluation::Registers);
+    trap_code trap = trap_code::none;
+    EXPECT_EQ(run_native("CallsBetweenLiveRegisters", code).return_value, run_vm(bytecode, trap));
+    EXPECT_EQ(trap_code::none, trap);
+    EXPECT_EQ(49, run_vm(bytecode, trap));
+}
+
+// Arguments in registers, on the stack and calls among them, a swap of two register locals included.
+TEST(CodeGeneratorRegistersTest, CallArguments_MatchesNative)
+{
+    std::string code(R"(fn sub(a, b) {
+                            return a - b
+                        }
+                        fn mix(a, b, c, d, e, f) {
+                            return (a - b) * c + d * (e - f)
+                        }
+                        let x = 7
+                        let y = 3
+                        return mix(y, x, sub(x, y), x + y, sub(y, x), 2) + sub(y, x)
+                        )");
+
+    trap_code stackTrap = trap_code::none;
+    trap_code registerTrap = trap_code::none;
+    int16_t expected = run_vm(compile(code, Evaluation::Stack), stackTrap);
+    EXPECT_EQ(-80, expected);
+    EXPECT_EQ(expected, run_vm(compile(code, Evaluation::Registers), registerTrap));
+    EXPECT_EQ(expected, run_native("CallArguments", code).return_value);
+    EXPECT_EQ(trap_code::none, stackTrap);
+    EXPECT_EQ(trap_code::none, registerTrap);
+}
@@ -6,5 +6,6 @@ set(COMPILER_TEST_SRC
     ${COMPILER_TEST_DIR}/tests_code_generator.cpp
     ${COMPILER_TEST_DIR}/tests_lexar.cpp
     ${COMPILER_TEST_DIR}/tests_parser.cpp
+    ${COMPILER_TEST_DIR}/tests_register_allocator.cpp
 )
 
@@ -1,6 +1,8 @@
 #include <gtest/gtest.h>
 #include <fmt/core.h>
 
+#include "byte_order.hpp"
+#include "disassembler.hpp"
 #include "shared_defines.hpp"
 
 #include "ast.hpp"
@@ -443,14 +445,13 @@ TEST_F(CodeGeneratorTestFixture, SimpleFunctionReturn) {
     std::string actual = generator.outputBytecode();
     auto [actualProgram, actualSize] = generator.readRawBytecode();
 
-    // validate
-    uint8_t expectedProgram[] = {   +instruction::def::PSH_LIT, 0, 0,
-                                    +instruction::def::INC, +registers::def::sp, 0,
-                                    +instruction::def::PEK_OFF, +registers::def::sp, 0,
+    // validate, the function is laid out after the program and called by its offset.
+    uint8_t expectedProgram[] = {   +instruction::def::CALL, 0x00, 0x04,
+                                    +instruction::def::RET,
                                     +instruction::def::PSH_LIT, 0, 5,
-                                    +instruction::def::CMP, +registers::def::sp,
-                                    +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
-                                    +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                                    +instruction::def::PSH_LIT, 0, 5,
+                                    +instruction::def::ADD,
+                                    +instruction::def::POP_REG, +registers::def::ret,
                                     +instruction::def::RET};
 
     std::string dissassembly = generator.disassemble();
@@ -459,4 +460,240 @@ TEST_F(CodeGeneratorTestFixture, SimpleFunctionReturn) {
 
     EXPECT_EQ(expectedSize, actualSize);
     EXPECT_TRUE(compareBytecode(expectedProgram, actualProgram, actualSize));
-}
\ No newline at end of file
+}
+
+TEST_F(CodeGeneratorTestFixture, Registers_Call_SavesLiveLocals) {
+    // setup
+    std::string code(R"(fn two() {
+                            return 2
+                        }
+                        let a = 3
+                        return a + two())");
+    Parser parser(code);
+    auto parser_result = parser.parse();
+    auto programNode = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result));
+    CodeGenerator generator(programNode, Evaluation::Registers);
+
+    // do
+    generator.generateCode();
+    auto [actualProgram, actualSize] = generator.readRawBytecode();
+
+    // validate, a and the left operand in ret are still needed after the call, two() may use any register.
+    uint8_t expectedProgram[] = {   +instruction::def::PUT_LIT, 0, 3,
+                                    +instruction::def::PUT_REG, +registers::def::r0,
+                                    +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                                    +instruction::def::PSH_REG, +registers::def::r0,
+                                    +instruction::def::PSH_REG, +registers::def::ret,
+                                    +instruction::def::CALL, 0x00, 0x1A,
+                                    +instruction::def::MOV, +registers::def::r1, +registers::def::ret,
+                                    +instruction::def::POP_REG, +registers::def::ret,
+                                    +instruction::def::POP_REG, +registers::def::r0,
+                                    +instruction::def::ADD_REG, +registers::def::ret, +registers::def::r1,
+                                    +instruction::def::RET,
+                                    +instruction::def::PUT_LIT, 0, 2,
+                                    +instruction::def::PUT_REG, +registers::def::ret,
+                                    +instruction::def::RET};
+
+    EXPECT_EQ(sizeof(expectedProgram), actualSize);
+    EXPECT_TRUE(compareBytecode(expectedProgram, actualProgram, actualSize));
+}
+
+TEST_F(CodeGeneratorTestFixture, Registers_Call_ArgumentsInRegisters) {
+    // setup
+    std::string code(R"(fn add(a, b) {
+                            return a + b
+                        }
+                        let x = 2
+                        let y = 3
+                        return add(x, y))");
+    Parser parser(code);
+    auto parser_result = parser.parse();
+    auto programNode = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result));
+    CodeGenerator generator(programNode, Evaluation::Registers);
+
+    // do
+    generator.generateCode();
+    auto [actualProgram, actualSize] = generator.readRawBytecode();
+
+    // validate, x and y already are in the argument registers and dead after the call, nothing is pushed.
+    uint8_t expectedProgram[] = {   +instruction::def::PUT_LIT, 0, 2,
+                                    +instruction::def::PUT_REG, +registers::def::r0,
+                                    +instruction::def::PUT_LIT, 0, 3,
+                                    +instruction::def::PUT_REG, +registers::def::r1,
+                                    +instruction::def::CALL, 0x00, 0x0E,
+                                    +instruction::def::RET,
+                                    +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                                    +instruction::def::ADD_REG, +registers::def::ret, +registers::def::r1,
+                                    +instruction::def::RET};
+
+    EXPECT_EQ(sizeof(expectedProgram), actualSize);
+    EXPECT_TRUE(compareBytecode(expectedProgram, actualProgram, actualSize));
+}
+
+TEST_F(CodeGeneratorTestFixture, Registers_Call_StackArguments) {
+    // setup
+    std::string code(R"(fn mix(a, b, c, d, e, f) {
+                            return (a + e) - f
+                        }
+                        return mix(10, 2, 3, 4, 5, 6))");
+    Parser parser(code);
+    auto parser_result = parser.parse();
+    auto programNode = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result));
+    CodeGenerator generator(programNode, Evaluation::Registers);
+
+    // do
+    generator.generateCode();
+    auto [actualProgram, actualSize] = generator.readRawBytecode();
+
+    // validate, e and f are pushed last first and dropped after the call, mix loads e into a register
+    // and f, out of registers, into a stack slot.
+    uint8_t expectedProgram[] = {   +instruction::def::PSH_LIT, 0, 6,
+                                    +instruction::def::PSH_LIT, 0, 5,
+                                    +instruction::def::PUT_LIT, 0, 10,
+                                    +instruction::def::PUT_REG, +registers::def::r0,
+                                    +instruction::def::PUT_LIT, 0, 2,
+                                    +instruction::def::PUT_REG, +registers::def::r1,
+                                    +instruction::def::PUT_LIT, 0, 3,
+                                    +instruction::def::PUT_REG, +registers::def::r2,
+                                    +instruction::def::PUT_LIT, 0, 4,
+                                    +instruction::def::PUT_REG, +registers::def::r3,
+                                    +instruction::def::CALL, 0x00, 0x22,
+                                    +instruction::def::POP_REG, +registers::def::imm,
+                                    +instruction::def::POP_REG, +registers::def::imm,
+                                    +instruction::def::RET,
+                                    +instruction::def::PEK_ARG, +registers::def::r4, 0,
+                                    +instruction::def::PEK_ARG, +registers::def::sp, 1,
+                                    +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                                    +instruction::def::ADD_REG, +registers::def::ret, +registers::def::r4,
+                                    +instruction::def::PEK_OFF, +registers::def::r5, 0,
+                                    +instruction::def::SUB_REG, +registers::def::ret, +registers::def::r5,
+                                    +instruction::def::RET};
+
+    EXPECT_EQ(sizeof(expectedProgram), actualSize);
+    EXPECT_TRUE(compareBytecode(expectedProgram, actualProgram, actualSize));
+}
+
+TEST_F(CodeGeneratorTestFixture, Registers_ReturnStatement_Expression)
+{
+    // setup
+    std::string code("return 2 * (2 + 3)");
+    Parser parser(code);
+    auto parser_result = parser.parse();
+    auto programNode = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result));
+    CodeGenerator generator(programNode, Evaluation::Registers);
+
+    // do
+    generator.generateCode();
+    auto [actualProgram, actualSize] = generator.readRawBytecode();
+
+    // validate
+    uint8_t expectedProgram[] = {   +instruction::def::PUT_LIT, 0, 2,
+                                    +instruction::def::PUT_REG, +registers::def::ret,
+                                    +instruction::def::PUT_LIT, 0, 2,
+                                    +instruction::def::PUT_REG, +registers::def::r0,
+                                    +instruction::def::PUT_LIT, 0, 3,
+                                    +instruction::def::ADD_REG, +registers::def::r0, +registers::def::imm,
+                                    +instruction::def::MUL_REG, +registers::def::ret, +registers::def::r0,
+                                    +instruction::def::RET };
+    uint32_t expectedSize = sizeof(expectedProgram);
+
+    EXPECT_EQ(expectedSize, actualSize);
+    EXPECT_TRUE(compareBytecode(expectedProgram, actualProgram, actualSize));
+}
+
+TEST_F(CodeGeneratorTestFixture, Registers_LetStatement_MultipleVariables)
+{
+    // setup
+    std::string code(R"(let x = 2
+                        let y = 3
+                        let z = x + y
+                        return z + y)");
+    Parser parser(code);
+    auto parser_result = parser.parse();
+    auto programNode = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result));
+    CodeGenerator generator(programNode, Evaluation::Registers);
+
+    // do
+    generator.generateCode();
+    auto [actualProgram, actualSize] = generator.readRawBytecode();
+
+    // validate, x and y are still live when z is defined so each local gets its own register.
+    uint8_t expectedProgram[] = {   +instruction::def::PUT_LIT, 0, 2,
+                                    +instruction::def::PUT_REG, +registers::def::r0,
+                                    +instruction::def::PUT_LIT, 0, 3,
+                                    +instruction::def::PUT_REG, +registers::def::r1,
+                                    +instruction::def::MOV, +registers::def::r2, +registers::def::r0,
+                                    +instruction::def::ADD_REG, +registers::def::r2, +registers::def::r1,
+                                    +instruction::def::MOV, +registers::def::ret, +registers::def::r2,
+                                    +instruction::def::ADD_REG, +registers::def::ret, +registers::def::r1,
+                                    +instruction::def::RET };
+    uint32_t expectedSize = sizeof(expectedProgram);
+
+    EXPECT_EQ(expectedSize, actualSize);
+    EXPECT_TRUE(compareBytecode(expectedProgram, actualProgram, actualSize));
+}
+
+TEST_F(CodeGeneratorTestFixture, Registers_WhileStatement_CounterInRegister)
+{
+    // setup
+    std::string code(R"(let i = 0
+                        while (i < 5) {
+                            i++
+                        }
+                        return i)");
+    Parser parser(code);
+    auto parser_result = parser.parse();
+    auto programNode = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result));
+    CodeGenerator generator(programNode, Evaluation::Registers);
+
+    // do
+    generator.generateCode();
+    auto [actualProgram, actualSize] = generator.readRawBytecode();
+
+    // validate, i never touches its stack slot, only the comparison is pushed.
+    uint8_t expectedProgram[] = {   +instruction::def::PUT_LIT, 0, 0,
+                                    +instruction::def::PUT_REG, +registers::def::r0,
+                                    +instruction::def::INC, +registers::def::r0,
+                                    +instruction::def::PSH_REG, +registers::def::r0,
+                                    +instruction::def::PSH_LIT, 0, 5,
+                                    +instruction::def::CMP, +registers::def::sp,
+                                    +instruction::def::JLT, 0x00, 0x0C, // jump back twelve bytes
+                                    +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                                    +instruction::def::RET };
+    uint32_t expectedSize = sizeof(expectedProgram);
+
+    EXPECT_EQ(expectedSize, actualSize);
+    EXPECT_TRUE(compareBytecode(expectedProgram, actualProgram, actualSize));
+}
+
+TEST(DisassemblerTest, RegisterForms)
+{
+    uint8_t program[] = { +instruction::def::PUT_LIT, 0, 7,
+                          +instruction::def::PUT_REG, +registers::def::r0,
+                          +instruction::def::PSH_REG, +registers::def::r0,
+                          +instruction::def::MOV_MEM, 0, 0x40,
+                          +instruction::def::PSH_MEM, 0, 0x40,
+                          +instruction::def::INC, +registers::def::r0,
+                          +instruction::def::RET };
+
+    Disassembler disassembler(program, sizeof(program));
+    EXPECT_EQ("PUT 7\nPUT r0\nPSH r0\nMOV 64\nPSH 64\nINC r0\nRET \n", disassembler.disassemble());
+}
+
+TEST(DisassemblerTest, Operand_ReadInBytecodeOrder)
+{
+    uint8_t program[] = { +instruction::def::PSH_LIT, 0, 0, +instruction::def::RET };
+    byte_order::store_operand(&program[1], -300);
+    EXPECT_EQ(0xFE, program[1]);
+
+    Disassembler disassembler(program, sizeof(program));
+    EXPECT_EQ("PSH -300\nRET \n", disassembler.disassemble());
+}
+
+TEST(DisassemblerTest, DecoderOpcodes_Unknown)
+{
+    uint8_t program[] = { +instruction::def::ADD_OFF, +instruction::def::RET };
+
+    Disassembler disassembler(program, sizeof(program));
+    EXPECT_EQ("?? \nRET \n", disassembler.disassemble());
+}
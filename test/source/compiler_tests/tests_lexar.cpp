@@ -270,4 +270,26 @@ TEST(LexarTest, FunctionAndScopeAndCall) {
     EXPECT_EQ(token.readType(), TokenType::CLOSE_PAREN);
     token = lx.pop();
     EXPECT_EQ(token.readType(), TokenType::END_OF_FILE);
-}
\ No newline at end of file
+}
+TEST(LexarTest, CallWithArguments) {
+    Lexar lx("add(a, 2)");
+    lx.lex();
+
+    auto token = lx.pop();
+    EXPECT_EQ(token.readType(), TokenType::IDENTIFIER);
+    EXPECT_EQ(token.readValue(), "add");
+    token = lx.pop();
+    EXPECT_EQ(token.readType(), TokenType::OPEN_PAREN);
+    token = lx.pop();
+    EXPECT_EQ(token.readType(), TokenType::IDENTIFIER);
+    EXPECT_EQ(token.readValue(), "a");
+    token = lx.pop();
+    EXPECT_EQ(token.readType(), TokenType::COMMA);
+    token = lx.pop();
+    EXPECT_EQ(token.readType(), TokenType::NUMBER);
+    EXPECT_EQ(token.readValue(), "2");
+    token = lx.pop();
+    EXPECT_EQ(token.readType(), TokenType::CLOSE_PAREN);
+    token = lx.pop();
+    EXPECT_EQ(token.readType(), TokenType::END_OF_FILE);
+}
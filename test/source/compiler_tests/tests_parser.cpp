@@ -1,6 +1,10 @@
 #include <fmt/core.h>
 #include <gtest/gtest.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "ast.hpp"
 #include "error_defines.hpp"
 #include "parser.hpp"
@@ -304,3 +308,53 @@ TEST(ParserTest, SimpleFunction_ReturnsConstant) {
 	EXPECT_EQ(result->readStatements()[1]->readType(), ASTNodeType::RETURN);
 	EXPECT_EQ(static_cast<const ASTReturnNode*>(result->readStatements()[1])->readExpression()->readType(), ASTNodeType::CALL_EXPRESSION);
 }
+
+TEST(ParserTest, Function_ParametersAndArguments) {
+	// setup
+	std::string code(
+		R"(
+			fn add(a, b) {
+				return a + b
+			}
+			return add(1, 2 * 3))");
+	Parser parser(code);
+
+	// do
+	auto parser_result = parser.parse();
+	ASSERT_TRUE(std::holds_alternative<ASTBaseNode*>(parser_result));
+	std::unique_ptr<ASTProgramNode> result(static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result)));
+
+	// validate
+	ASSERT_EQ(result->readStatements().size(), 2);
+	auto functionNode = static_cast<const ASTFunctionNode*>(result->readStatements()[0]);
+	EXPECT_EQ(functionNode->readParameters(), (std::vector<std::string>{ "a", "b" }));
+
+	auto callNode = static_cast<const ASTCallNode*>(static_cast<const ASTReturnNode*>(result->readStatements()[1])->readExpression());
+	ASSERT_EQ(callNode->readArguments().size(), 2);
+	EXPECT_EQ(callNode->readArguments()[0]->readType(), ASTNodeType::NUMERIC_LITERAL);
+	EXPECT_EQ(callNode->readArguments()[1]->readType(), ASTNodeType::BINARY_EXPRESSION);
+}
+
+TEST(ParserTest, Function_MissingParameterName) {
+	// setup
+	std::string code("fn add(a, ) { return a }");
+	Parser parser(code);
+
+	// do
+	auto parser_result = parser.parse();
+	auto error = std::get<ParserError>(parser_result);
+
+	EXPECT_EQ(error.code, ErrorCode::SYNTAX_ERROR_EXPECTED_IDENTIFIER);
+}
+
+TEST(ParserTest, Call_MissingComma) {
+	// setup
+	std::string code("return add(1 2)");
+	Parser parser(code);
+
+	// do
+	auto parser_result = parser.parse();
+	auto error = std::get<ParserError>(parser_result);
+
+	EXPECT_EQ(error.code, ErrorCode::SYNTAX_ERROR_PARENTHESIS_MISSMATCH);
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <memory>
+
+#include "ast.hpp"
+#include "parser.hpp"
+#include "register_allocator.hpp"
+#include "shared_defines.hpp"
+
+using namespace ciph;
+
+namespace {
+
+std::unique_ptr<ASTProgramNode>
+parse(const std::string& code) {
+    Parser parser(code);
+    auto parser_result = parser.parse();
+    return std::unique_ptr<ASTProgramNode>(static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser_result)));
+}
+
+const LiveRange&
+rangeOf(const RegisterAllocator& allocator, const std::string& name) {
+    const std::vector<LiveRange>& ranges = allocator.readRanges();
+    return *std::find_if(ranges.begin(), ranges.end(), [&](const LiveRange& range) { return range.name == name; });
+}
+
+} // namespace
+
+TEST(RegisterAllocatorTest, RegisterReused_AfterRangeEnds) {
+    // setup
+    auto program = parse(R"(let a = 1
+                            let b = a + 1
+                            let c = b + 1
+                            return c)");
+    RegisterAllocator allocator(program.get());
+
+    // do
+    allocator.allocate();
+
+    // validate, a and b overlap where b is defined, a is dead by the time c is.
+    EXPECT_EQ(registers::def::r0, allocator.registerOf("a"));
+    EXPECT_EQ(registers::def::r1, allocator.registerOf("b"));
+    EXPECT_EQ(registers::def::r0, allocator.registerOf("c"));
+    EXPECT_EQ(1, rangeOf(allocator, "a").end);
+}
+
+TEST(RegisterAllocatorTest, UsedInLoop_LiveToLoopEnd) {
+    // setup
+    auto program = parse(R"(let k = 3
+                            let i = 0
+                            while (i < 10) {
+                                k++
+                                i++
+                            }
+                            return i)");
+    RegisterAllocator allocator(program.get());
+
+    // do
+    allocator.allocate();
+
+    // validate, k is last written in the body but the condition after it loops back to it.
+    const ASTWhileNode* loop = static_cast<const ASTWhileNode*>(program->readStatements()[2]);
+    std::optional<uint16_t> condition = allocator.positionOf(loop->readCondition());
+    ASSERT_TRUE(condition.has_value());
+    EXPECT_EQ(condition.value(), rangeOf(allocator, "k").end);
+
+    std::vector<registers::def> live = allocator.liveAt(condition.value());
+    EXPECT_NE(live.end(), std::find(live.begin(), live.end(), allocator.registerOf("k").value()));
+    EXPECT_NE(allocator.registerOf("k"), allocator.registerOf("i"));
+}
+
+TEST(RegisterAllocatorTest, Pressure_SpillsColdest) {
+    // setup
+    auto program = parse(R"(let a = 1
+                            let b = 2
+                            let c = 3
+                            let d = 4
+                            let e = 5
+                            let i = 0
+                            while (i < 10) {
+                                i++
+                            }
+                            return ((a + b) + (c + d)) + (e + i))");
+    RegisterAllocator allocator(program.get());
+
+    // do
+    allocator.allocate();
+
+    // validate, all six are live at once, the loop counter takes the register of a cold local.
+    EXPECT_GT(rangeOf(allocator, "i").weight, rangeOf(allocator, "a").weight);
+    EXPECT_FALSE(allocator.registerOf("a").has_value());
+    EXPECT_EQ(registers::def::r0, allocator.registerOf("i"));
+    for (const char* name : { "b", "c", "d", "e" })
+        EXPECT_TRUE(allocator.registerOf(name).has_value()) << name;
+}
+
+TEST(RegisterAllocatorTest, Parameters_FixedInArgumentRegisters) {
+    // setup
+    auto program = parse(R"(fn mix(a, b, c, d, e) {
+                                return ((a + b) + (c + d)) + e
+                            }
+                            return 0)");
+    const auto* function = static_cast<const ASTFunctionNode*>(program->readStatements()[0]);
+    RegisterAllocator allocator(function);
+
+    // do
+    allocator.allocate();
+
+    // validate, the first four arrive in r0 to r3 and stay there, the fifth is loaded into a free one.
+    EXPECT_EQ(registers::def::r0, allocator.registerOf("a"));
+    EXPECT_EQ(registers::def::r1, allocator.registerOf("b"));
+    EXPECT_EQ(registers::def::r2, allocator.registerOf("c"));
+    EXPECT_EQ(registers::def::r3, allocator.registerOf("d"));
+    EXPECT_EQ(registers::def::r4, allocator.registerOf("e"));
+    EXPECT_EQ(0, rangeOf(allocator, "a").start);
+    EXPECT_TRUE(rangeOf(allocator, "a").fixed);
+    EXPECT_FALSE(rangeOf(allocator, "e").fixed);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <execution_context.hpp>
+#include <memory.hpp>
+#include <shared_defines.hpp>
+
+namespace ciph::bench {
+
+/*
+ * let x = 0
+ * while (x < iterations) {
+ *     x++
+ * }
+ * return x */
+inline std::vector<uint8_t>
+count_loop(int16_t iterations) {
+    return {
+        +instruction::def::PSH_LIT, 0, 0,
+        +instruction::def::INC, +registers::def::sp, 0,
+        +instruction::def::PEK_OFF, +registers::def::sp, 0,
+        +instruction::def::PSH_LIT, u8((iterations >> 8) & 0xFF), u8(iterations & 0xFF),
+        +instruction::def::CMP, +registers::def::sp,
+        +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
+        +instruction::def::PEK_OFF, +registers::def::ret, 0,
+        +instruction::def::RET
+    };
+}
+
+/*
+ * let x = 0
+ * let y = 3
+ * while (x < iterations) {
+ *     x++
+ *     x * y + y
+ * }
+ * return x */
+inline std::vector<uint8_t>
+arithmetic_loop(int16_t iterations) {
+    return {
+        +instruction::def::PSH_LIT, 0, 0,
+        +instruction::def::PSH_LIT, 0, 3,
+        +instruction::def::INC, +registers::def::sp, 0,
+        +instruction::def::PEK_OFF, +registers::def::sp, 0,
+        +instruction::def::PEK_OFF, +registers::def::sp, 1,
+        +instruction::def::MUL,
+        +instruction::def::PEK_OFF, +registers::def::sp, 1,
+        +instruction::def::ADD,
+        +instruction::def::POP_REG, +registers::def::r0,
+        +instruction::def::PEK_OFF, +registers::def::sp, 0,
+        +instruction::def::PSH_LIT, u8((iterations >> 8) & 0xFF), u8(iterations & 0xFF),
+        +instruction::def::CMP, +registers::def::sp,
+        +instruction::def::JLT, 0x00, 0x1B, // jump back twenty seven bytes
+        +instruction::def::PEK_OFF, +registers::def::ret, 0,
+        +instruction::def::RET
+    };
+}
+
+/*
+ * fn fib(n) {
+ *     if (n < 2) return n
+ *     return fib(n - 1) + fib(n - 2)
+ * }
+ * return fib(n), n passed in r0. */
+inline std::vector<uint8_t>
+fib(int16_t n) {
+    return {
+        +instruction::def::PUT_LIT, u8((n >> 8) & 0xFF), u8(n & 0xFF),
+        +instruction::def::PUT_REG, +registers::def::r0,
+        +instruction::def::CALL, 0x00, 0x09,
+        +instruction::def::RET,
+        +instruction::def::PSH_REG, +registers::def::r0,
+        +instruction::def::PSH_LIT, 0, 2,
+        +instruction::def::CMP, +registers::def::sp,
+        +instruction::def::JLT, 0xFF, 0xE6, // forward twenty six bytes, to n < 2
+        +instruction::def::PSH_REG, +registers::def::r0,
+        +instruction::def::DEC, +registers::def::r0,
+        +instruction::def::CALL, 0x00, 0x09,
+        +instruction::def::PSH_REG, +registers::def::ret,
+        +instruction::def::PEK_OFF, +registers::def::r0, 0,
+        +instruction::def::DEC, +registers::def::r0,
+        +instruction::def::DEC, +registers::def::r0,
+        +instruction::def::CALL, 0x00, 0x09,
+        +instruction::def::PEK_OFF, +registers::def::r1, 1,
+        +instruction::def::ADD_REG, +registers::def::ret, +registers::def::r1,
+        +instruction::def::RET,
+        +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+        +instruction::def::RET
+    };
+}
+
+/*
+ * fn next(x) { return x + 1 }
+ * let x = 0
+ * while (x < iterations) {
+ *     x = next(x)
+ * }
+ * return x */
+inline std::vector<uint8_t>
+helper_loop(int16_t iterations) {
+    return {
+        +instruction::def::PSH_LIT, 0, 0,
+        +instruction::def::PEK_OFF, +registers::def::r0, 0,
+        +instruction::def::CALL, 0x00, 0x1C,
+        +instruction::def::POP_REG, +registers::def::r1,
+        +instruction::def::PSH_REG, +registers::def::ret,
+        +instruction::def::PEK_OFF, +registers::def::sp, 0,
+        +instruction::def::PSH_LIT, u8((iterations >> 8) & 0xFF), u8(iterations & 0xFF),
+        +instruction::def::CMP, +registers::def::sp,
+        +instruction::def::JLT, 0x00, 0x15, // jump back twenty one bytes
+        +instruction::def::PEK_OFF, +registers::def::ret, 0,
+        +instruction::def::RET,
+        +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+        +instruction::def::INC, +registers::def::ret,
+        +instruction::def::RET
+    };
+}
+
+/*
+ * Bare machine used by benchmarks that drive the handlers directly, laid out the same way
+ * ProcessingUnit::load_program lays out memory. */
+struct BenchMachine {
+    explicit BenchMachine(std::vector<uint8_t> program)
+        : bytes(std::move(program)) {
+        registry = memory.allocate(static_cast<uint16_t>(registers::def::reg_cnt));
+        entry = memory.load(bytes.data(), static_cast<uint16_t>(bytes.size()));
+        stack = static_cast<uint16_t>(entry + bytes.size() + (bytes.size() % 2));
+        context = ExecutionContext(registry, memory.getMemory());
+        reset();
+    }
+
+    void reset() {
+        registry[+registers::def::pc] = entry;
+        registry[+registers::def::bp] = entry;
+        registry[+registers::def::sp] = stack;
+        registry[+registers::def::fp] = stack;
+        registry[+registers::def::cd] = 0;
+        context.trap = trap_code::none;
+    }
+
+    std::vector<uint8_t> bytes;
+    Memory memory;
+    uint16_t* registry = nullptr;
+    ExecutionContext context;
+    uint16_t entry = 0;
+    uint16_t stack = 0;
+};
+
+} // namespace ciph::bench
@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+
+#include <functional>
+
+#include <instructions.hpp>
+
+#include "benchmark_programs.hpp"
+
+using namespace ciph;
+
+namespace {
+
+// binary_stack_expression as it was before it became a template, one std::function per op.
+void
+function_stack_expression(ExecutionContext& context, std::function<int16_t(int16_t, int16_t)> op) {
+    int16_t b = instruction::pop_helper(context);
+    int16_t a = instruction::pop_helper(context);
+    instruction::push_helper(context, op(a, b));
+}
+
+void
+function_add_handler(ExecutionContext& context) {
+    function_stack_expression(context, [](int16_t a, int16_t b) { return a + b; });
+}
+
+void
+function_mul_handler(ExecutionContext& context) {
+    function_stack_expression(context, [](int16_t a, int16_t b) { return a * b; });
+}
+
+/*
+ * Calls a stack form handler on two freshly pushed operands per iteration, the handler is called
+ * through a pointer so every variant pays the same for the call itself. */
+void
+stack_op_benchmark(benchmark::State& state, instruction::handler handler) {
+    bench::BenchMachine machine({ +instruction::def::RET });
+    benchmark::DoNotOptimize(handler);
+    for (auto _ : state) {
+        instruction::push_helper(machine.context, 7);
+        instruction::push_helper(machine.context, 3);
+        handler(machine.context);
+        benchmark::DoNotOptimize(instruction::pop_helper(machine.context));
+    }
+    state.counters["ops"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+void
+register_op_benchmark(benchmark::State& state, instruction::def opcode) {
+    bench::BenchMachine machine({ +opcode, +registers::def::r0, +registers::def::r1 });
+    instruction::handler handler = instruction::handlers[opcode];
+    benchmark::DoNotOptimize(handler);
+    machine.registry[+registers::def::r1] = 3;
+    for (auto _ : state) {
+        machine.registry[+registers::def::pc] = machine.entry;
+        machine.registry[+registers::def::r0] = 7;
+        handler(machine.context);
+        benchmark::DoNotOptimize(machine.registry[+registers::def::r0]);
+    }
+    state.counters["ops"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+static void
+BM_Op_Add_StdFunction(benchmark::State& state) {
+    stack_op_benchmark(state, function_add_handler);
+}
+BENCHMARK(BM_Op_Add_StdFunction);
+
+static void
+BM_Op_Add_Template(benchmark::State& state) {
+    stack_op_benchmark(state, instruction::add_handler);
+}
+BENCHMARK(BM_Op_Add_Template);
+
+static void
+BM_Op_Mul_StdFunction(benchmark::State& state) {
+    stack_op_benchmark(state, function_mul_handler);
+}
+BENCHMARK(BM_Op_Mul_StdFunction);
+
+static void
+BM_Op_Mul_Template(benchmark::State& state) {
+    stack_op_benchmark(state, instruction::mul_handler);
+}
+BENCHMARK(BM_Op_Mul_Template);
+
+static void
+BM_Op_AddReg_Template(benchmark::State& state) {
+    register_op_benchmark(state, instruction::def::ADD_REG);
+}
+BENCHMARK(BM_Op_AddReg_Template);
+
+static void
+BM_Op_MulReg_Template(benchmark::State& state) {
+    register_op_benchmark(state, instruction::def::MUL_REG);
+}
+BENCHMARK(BM_Op_MulReg_Template);
@@ -0,0 +1,80 @@
+#include <benchmark/benchmark.h>
+
+#include <batch.hpp>
+#include <processing_unit.hpp>
+
+#include "benchmark_programs.hpp"
+
+using namespace ciph;
+
+namespace {
+
+// Instructions one run of program retires, counted on the byte handlers.
+uint64_t
+retired_per_run(const std::vector<uint8_t>& program) {
+    std::vector<uint8_t> bytes = program;
+    ProcessingUnit unit;
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    uint64_t retired = 1;
+    while (unit.step())
+        retired++;
+    return retired;
+}
+
+void
+batch_benchmark(benchmark::State& state, batch::backend backend) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(100);
+    size_t instances = static_cast<size_t>(state.range(0));
+    BatchExecutor executor;
+    executor.set_backend(backend);
+    executor.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    uint64_t perRun = retired_per_run(program);
+
+    uint64_t retired = 0;
+    for (auto _ : state) {
+        batch::result result = executor.execute(instances);
+        benchmark::DoNotOptimize(result.return_values.data());
+        retired += perRun * instances;
+    }
+    state.counters["instructions"] = benchmark::Counter(static_cast<double>(retired), benchmark::Counter::kIsRate);
+    state.counters["instances"] = benchmark::Counter(static_cast<double>(state.iterations()) * static_cast<double>(instances), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+// The baseline, one ProcessingUnit after another.
+static void
+BM_Batch_ProcessingUnits_ArithmeticLoop(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(100);
+    size_t instances = static_cast<size_t>(state.range(0));
+    uint64_t perRun = retired_per_run(program);
+
+    uint64_t retired = 0;
+    for (auto _ : state) {
+        for (size_t instance = 0; instance < instances; instance++) {
+            ProcessingUnit unit;
+            unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+            benchmark::DoNotOptimize(unit.execute());
+        }
+        retired += perRun * instances;
+    }
+    state.counters["instructions"] = benchmark::Counter(static_cast<double>(retired), benchmark::Counter::kIsRate);
+    state.counters["instances"] = benchmark::Counter(static_cast<double>(state.iterations()) * static_cast<double>(instances), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Batch_ProcessingUnits_ArithmeticLoop)->Arg(1024);
+
+static void
+BM_Batch_Scalar_ArithmeticLoop(benchmark::State& state) {
+    batch_benchmark(state, batch::backend::scalar);
+}
+BENCHMARK(BM_Batch_Scalar_ArithmeticLoop)->Arg(1024);
+
+static void
+BM_Batch_Avx2_ArithmeticLoop(benchmark::State& state) {
+    if (batch::avx2_supported() == false) {
+        state.SkipWithError("no AVX2 on this host");
+        return;
+    }
+    batch_benchmark(state, batch::backend::avx2);
+}
+BENCHMARK(BM_Batch_Avx2_ArithmeticLoop)->Arg(1024);
@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+
+#include <decoder.hpp>
+#include <interpreter.hpp>
+#include <jit.hpp>
+#include <processing_unit.hpp>
+
+#include "benchmark_programs.hpp"
+
+using namespace ciph;
+
+namespace {
+
+uint64_t
+count_calls(const std::vector<uint8_t>& program) {
+    std::vector<uint8_t> bytes = program;
+    ProcessingUnit unit;
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    uint64_t calls = 0;
+    do {
+        uint16_t pc = unit.registries()[+registers::def::pc];
+        if (unit.context().bytecode[pc] == +instruction::def::CALL)
+            calls++;
+    } while (unit.step());
+    return calls;
+}
+
+// Every call and its return counted as one, the rate is what a round trip through a frame costs.
+template <typename Engine>
+void
+call_benchmark(benchmark::State& state, std::vector<uint8_t> program, Engine engine) {
+    uint64_t perRun = count_calls(program);
+    bench::BenchMachine machine(std::move(program));
+    decoded_program decoded = decoder::decode(machine.bytes.data(), u16(machine.bytes.size()), machine.entry);
+
+    uint64_t calls = 0;
+    for (auto _ : state) {
+        machine.reset();
+        benchmark::DoNotOptimize(engine(machine.context, decoded));
+        calls += perRun;
+    }
+    state.counters["calls"] = benchmark::Counter(static_cast<double>(calls), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+static void
+BM_Call_Switch_Fib(benchmark::State& state) {
+    call_benchmark(state, bench::fib(i16(state.range(0))), interpreter::run_switch);
+}
+BENCHMARK(BM_Call_Switch_Fib)->Arg(15);
+
+#if CIPH_HAS_COMPUTED_GOTO
+static void
+BM_Call_Threaded_Fib(benchmark::State& state) {
+    call_benchmark(state, bench::fib(i16(state.range(0))), interpreter::run_threaded);
+}
+BENCHMARK(BM_Call_Threaded_Fib)->Arg(15);
+#endif
+
+// Recursion can't be bounded by the verifier, this is the engine ProcessingUnit runs fib on.
+static void
+BM_Call_Checked_Fib(benchmark::State& state) {
+    call_benchmark(state, bench::fib(i16(state.range(0))),
+        [](ExecutionContext& context, const decoded_program& decoded) {
+            return interpreter::run_checked(context, decoded, Memory::default_size);
+        });
+}
+BENCHMARK(BM_Call_Checked_Fib)->Arg(15);
+
+static void
+BM_Call_Switch_HelperLoop(benchmark::State& state) {
+    call_benchmark(state, bench::helper_loop(i16(state.range(0))), interpreter::run_switch);
+}
+BENCHMARK(BM_Call_Switch_HelperLoop)->Arg(10000);
+
+#if CIPH_HAS_JIT
+static void
+BM_Call_Jit_Fib(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::fib(i16(state.range(0)));
+    bench::BenchMachine machine(program);
+    jit::compiled_program native = jit::compile(
+        decoder::decode(machine.bytes.data(), u16(machine.bytes.size()), machine.entry));
+    call_benchmark(state, program, [&native](ExecutionContext& context, const decoded_program& decoded) {
+        return jit::run(context, decoded, native);
+    });
+}
+BENCHMARK(BM_Call_Jit_Fib)->Arg(15);
+
+static void
+BM_Call_Jit_HelperLoop(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::helper_loop(i16(state.range(0)));
+    bench::BenchMachine machine(program);
+    jit::compiled_program native = jit::compile(
+        decoder::decode(machine.bytes.data(), u16(machine.bytes.size()), machine.entry));
+    call_benchmark(state, program, [&native](ExecutionContext& context, const decoded_program& decoded) {
+        return jit::run(context, decoded, native);
+    });
+}
+BENCHMARK(BM_Call_Jit_HelperLoop)->Arg(10000);
+#endif
@@ -0,0 +1,129 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include <ast.hpp>
+#include <code_generator.hpp>
+#include <parser.hpp>
+#include <processing_unit.hpp>
+
+using namespace ciph;
+
+namespace {
+
+/*
+ * The language has no assignment, so the loop does its arithmetic in the condition, which comes
+ * to 2i, the body runs 8000 times. The parser takes two terms per additive or multiplicative
+ * level, hence the parentheses. */
+const std::string expression_loop = R"(let i = 0
+while (((i * 4 + 6) / 2 - (i + 3)) + (i * 2 - (i + i) / 2) < 16000) {
+    i++
+}
+return i)";
+
+// Straight line, every let and the return is an expression tree over the locals before it,
+// parenthesised the same way.
+const std::string expression_lets = R"(let a = 7
+let b = 3
+let c = (a * b + a / b) - 2
+let d = (a + b) * (a - b) + c * 2
+let e = ((c + d) * (a - 1)) / (b + 1)
+return ((a * b + c * d) - e) / ((a + b) + c) + (d - e) * (c - a))";
+
+// A two argument helper called on every iteration, the arguments go in r0 and r1.
+const std::string helper_calls = R"(fn add(a, b) {
+    return a + b
+}
+let i = 0
+while (add(i, i) < 16000) {
+    i++
+}
+return i)";
+
+std::vector<uint8_t>
+compile(const std::string& source, Evaluation evaluation) {
+    Parser parser(source);
+    auto* program = static_cast<ASTProgramNode*>(std::get<ASTBaseNode*>(parser.parse()));
+    CodeGenerator generator(program, evaluation);
+    generator.generateCode();
+    auto [bytes, size] = generator.readRawBytecode();
+    std::vector<uint8_t> bytecode(bytes, bytes + size);
+    delete[] bytes;
+    delete program;
+    return bytecode;
+}
+
+/*
+ * Runs what CodeGenerator emits for source on one unit, the argument is the execution_mode.
+ * instructions counts decoded instructions retired, fused pairs once, the same program in the
+ * other evaluation mode does the same work in a different number of them. */
+void
+codegen_benchmark(benchmark::State& state, const std::string& source, Evaluation evaluation) {
+    std::vector<uint8_t> program = compile(source, evaluation);
+    ProcessingUnit unit;
+    unit.set_execution_mode(static_cast<execution_mode>(state.range(0)));
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    uint64_t perRun = 1;
+    while (unit.step())
+        perRun++;
+    if (unit.context().trap != trap_code::none || unit.verification().verified() == false) {
+        state.SkipWithError("generated program doesn't verify or traps");
+        return;
+    }
+
+    uint64_t retired = 0;
+    for (auto _ : state) {
+        unit.restart();
+        benchmark::DoNotOptimize(unit.execute());
+        retired += perRun;
+    }
+    state.counters["instructions"] = benchmark::Counter(static_cast<double>(retired), benchmark::Counter::kIsRate);
+    state.counters["retired"] = static_cast<double>(perRun);
+    state.counters["bytes"] = static_cast<double>(program.size());
+}
+
+void
+engines(benchmark::internal::Benchmark* benchmark) {
+    benchmark->Arg(static_cast<int64_t>(execution_mode::interpreter));
+    benchmark->Arg(static_cast<int64_t>(execution_mode::jit));
+}
+
+} // namespace
+
+static void
+BM_Codegen_Stack_ExpressionLoop(benchmark::State& state) {
+    codegen_benchmark(state, expression_loop, Evaluation::Stack);
+}
+BENCHMARK(BM_Codegen_Stack_ExpressionLoop)->Apply(engines);
+
+static void
+BM_Codegen_Registers_ExpressionLoop(benchmark::State& state) {
+    codegen_benchmark(state, expression_loop, Evaluation::Registers);
+}
+BENCHMARK(BM_Codegen_Registers_ExpressionLoop)->Apply(engines);
+
+static void
+BM_Codegen_Stack_ExpressionLets(benchmark::State& state) {
+    codegen_benchmark(state, expression_lets, Evaluation::Stack);
+}
+BENCHMARK(BM_Codegen_Stack_ExpressionLets)->Apply(engines);
+
+static void
+BM_Codegen_Registers_ExpressionLets(benchmark::State& state) {
+    codegen_benchmark(state, expression_lets, Evaluation::Registers);
+}
+BENCHMARK(BM_Codegen_Registers_ExpressionLets)->Apply(engines);
+
+static void
+BM_Codegen_Stack_HelperCalls(benchmark::State& state) {
+    codegen_benchmark(state, helper_calls, Evaluation::Stack);
+}
+BENCHMARK(BM_Codegen_Stack_HelperCalls)->Apply(engines);
+
+static void
+BM_Codegen_Registers_HelperCalls(benchmark::State& state) {
+    codegen_benchmark(state, helper_calls, Evaluation::Registers);
+}
+BENCHMARK(BM_Codegen_Registers_HelperCalls)->Apply(engines);
@@ -0,0 +1,236 @@
+#include <benchmark/benchmark.h>
+
+#include <unordered_map>
+
+#include <decoder.hpp>
+#include <instructions.hpp>
+#include <interpreter.hpp>
+#include <jit.hpp>
+#include <processing_unit.hpp>
+#include <tracing.hpp>
+
+#include "benchmark_programs.hpp"
+
+using namespace ciph;
+
+namespace {
+
+// The dispatch used before the dense table, one hash lookup per retired instruction.
+std::unordered_map<instruction::def, instruction::handler>
+make_hashed_handlers() {
+    std::unordered_map<instruction::def, instruction::handler> table;
+    for (int opcode = 0; opcode < 256; opcode++) {
+        instruction::handler entry = instruction::handlers[u8(opcode)];
+        if (entry != instruction::trap_handler)
+            table.emplace(static_cast<instruction::def>(opcode), entry);
+    }
+    return table;
+}
+
+template <typename Table>
+uint64_t
+run_dispatch_loop(bench::BenchMachine& machine, Table& table) {
+    uint64_t retired = 0;
+    instruction::def instr = instruction::def::RET;
+    uint16_t& pc = machine.registry[+registers::def::pc];
+    do {
+        instr = static_cast<instruction::def>(machine.context.bytecode[pc]);
+        table[instr](machine.context);
+        pc++;
+        retired++;
+    } while (instr != instruction::def::RET);
+    return retired;
+}
+
+template <typename Table>
+void
+dispatch_benchmark(benchmark::State& state, std::vector<uint8_t> program, Table table) {
+    bench::BenchMachine machine(std::move(program));
+    uint64_t retired = 0;
+    for (auto _ : state) {
+        machine.reset();
+        retired += run_dispatch_loop(machine, table);
+        benchmark::DoNotOptimize(machine.context.return_value);
+    }
+    state.counters["instructions"] = benchmark::Counter(static_cast<double>(retired), benchmark::Counter::kIsRate);
+}
+
+template <typename Engine>
+void
+engine_benchmark(benchmark::State& state, std::vector<uint8_t> program, Engine engine, bool fuse = true,
+                 bool quicken = true) {
+    bench::BenchMachine machine(std::move(program));
+    decoded_program decoded =
+        decoder::decode(machine.bytes.data(), u16(machine.bytes.size()), machine.entry, fuse, quicken);
+    machine.reset();
+    uint64_t perRun = 0;
+    {
+        bench::BenchMachine counter(machine.bytes);
+        perRun = run_dispatch_loop(counter, instruction::handlers);
+    }
+
+    uint64_t retired = 0;
+    for (auto _ : state) {
+        machine.reset();
+        benchmark::DoNotOptimize(engine(machine.context, decoded));
+        retired += perRun;
+    }
+    state.counters["instructions"] = benchmark::Counter(static_cast<double>(retired), benchmark::Counter::kIsRate);
+    state.counters["dispatches"] = static_cast<double>(decoded.instructions.size());
+    state.counters["fusions"] = decoded.fusions;
+    state.counters["quickened"] = decoded.quickened;
+}
+
+uint64_t
+count_retired(const std::vector<uint8_t>& program) {
+    std::vector<uint8_t> bytes = program;
+    ProcessingUnit unit;
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    uint64_t retired = 1;
+    while (unit.step())
+        retired++;
+    return retired;
+}
+
+void
+execute_benchmark(benchmark::State& state, std::vector<uint8_t> program) {
+    uint64_t perRun = count_retired(program);
+    uint64_t retired = 0;
+    for (auto _ : state) {
+        ProcessingUnit unit;
+        unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        benchmark::DoNotOptimize(unit.execute());
+        retired += perRun;
+    }
+    state.counters["instructions"] = benchmark::Counter(static_cast<double>(retired), benchmark::Counter::kIsRate);
+}
+
+} // namespace
+
+static void
+BM_Dispatch_HashMap_CountLoop(benchmark::State& state) {
+    dispatch_benchmark(state, bench::count_loop(i16(state.range(0))), make_hashed_handlers());
+}
+BENCHMARK(BM_Dispatch_HashMap_CountLoop)->Arg(10000);
+
+static void
+BM_Dispatch_DenseTable_CountLoop(benchmark::State& state) {
+    dispatch_benchmark(state, bench::count_loop(i16(state.range(0))), instruction::handlers);
+}
+BENCHMARK(BM_Dispatch_DenseTable_CountLoop)->Arg(10000);
+
+static void
+BM_Dispatch_HashMap_ArithmeticLoop(benchmark::State& state) {
+    dispatch_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), make_hashed_handlers());
+}
+BENCHMARK(BM_Dispatch_HashMap_ArithmeticLoop)->Arg(10000);
+
+static void
+BM_Dispatch_DenseTable_ArithmeticLoop(benchmark::State& state) {
+    dispatch_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), instruction::handlers);
+}
+BENCHMARK(BM_Dispatch_DenseTable_ArithmeticLoop)->Arg(10000);
+
+static void
+BM_Execute_CountLoop(benchmark::State& state) {
+    execute_benchmark(state, bench::count_loop(i16(state.range(0))));
+}
+BENCHMARK(BM_Execute_CountLoop)->Arg(10000);
+
+static void
+BM_Execute_ArithmeticLoop(benchmark::State& state) {
+    execute_benchmark(state, bench::arithmetic_loop(i16(state.range(0))));
+}
+BENCHMARK(BM_Execute_ArithmeticLoop)->Arg(10000);
+
+static void
+BM_Engine_Table_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), interpreter::run_table);
+}
+BENCHMARK(BM_Engine_Table_ArithmeticLoop)->Arg(10000);
+
+static void
+BM_Engine_Switch_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), interpreter::run_switch);
+}
+BENCHMARK(BM_Engine_Switch_ArithmeticLoop)->Arg(10000);
+
+#if CIPH_HAS_COMPUTED_GOTO
+static void
+BM_Engine_Threaded_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), interpreter::run_threaded);
+}
+BENCHMARK(BM_Engine_Threaded_ArithmeticLoop)->Arg(10000);
+#endif
+
+// Fuel is only charged on block entry, compare against BM_Engine_Switch_ArithmeticLoop for the overhead.
+static void
+BM_Engine_Metered_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))),
+        [](ExecutionContext& context, const decoded_program& decoded) {
+            uint32_t fuel = UINT32_MAX;
+            return interpreter::run_metered(context, decoded, fuel);
+        });
+}
+BENCHMARK(BM_Engine_Metered_ArithmeticLoop)->Arg(10000);
+
+static void
+BM_Engine_Unfused_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), interpreter::run, false);
+}
+BENCHMARK(BM_Engine_Unfused_ArithmeticLoop)->Arg(10000);
+
+static void
+BM_Engine_Fused_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), interpreter::run, true);
+}
+BENCHMARK(BM_Engine_Fused_ArithmeticLoop)->Arg(10000);
+
+// Without fusion, so every PEK_OFF and INC of the loop is left for the quicken pass.
+static void
+BM_Engine_Unquickened_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), interpreter::run, false, false);
+}
+BENCHMARK(BM_Engine_Unquickened_ArithmeticLoop)->Arg(10000);
+
+static void
+BM_Engine_Quickened_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))), interpreter::run, false, true);
+}
+BENCHMARK(BM_Engine_Quickened_ArithmeticLoop)->Arg(10000);
+
+#if CIPH_HAS_JIT
+static void
+BM_Engine_Jit_ArithmeticLoop(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(i16(state.range(0)));
+    bench::BenchMachine machine(program);
+    jit::compiled_program native = jit::compile(
+        decoder::decode(machine.bytes.data(), u16(machine.bytes.size()), machine.entry));
+    engine_benchmark(state, program, [&native](ExecutionContext& context, const decoded_program& decoded) {
+        return jit::run(context, decoded, native);
+    });
+}
+BENCHMARK(BM_Engine_Jit_ArithmeticLoop)->Arg(10000);
+
+// Traces stay in the cache between iterations, so this measures a loop that is already hot.
+static void
+BM_Engine_Tracing_ArithmeticLoop(benchmark::State& state) {
+    tracing::trace_cache cache;
+    tracing::options opts;
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))),
+        [&cache, &opts](ExecutionContext& context, const decoded_program& decoded) {
+            return tracing::run(context, decoded, cache, opts);
+        });
+}
+BENCHMARK(BM_Engine_Tracing_ArithmeticLoop)->Arg(10000);
+#endif
+
+// What an unverified program pays, every stack access bounds checked and no locals cached.
+static void
+BM_Engine_Checked_ArithmeticLoop(benchmark::State& state) {
+    engine_benchmark(state, bench::arithmetic_loop(i16(state.range(0))),
+        [](ExecutionContext& context, const decoded_program& decoded) {
+            return interpreter::run_checked(context, decoded, Memory::default_size);
+        });
+}
+BENCHMARK(BM_Engine_Checked_ArithmeticLoop)->Arg(10000);
@@ -0,0 +1,47 @@
+#include <benchmark/benchmark.h>
+
+#include <green.hpp>
+#include <processing_unit.hpp>
+
+#include "benchmark_programs.hpp"
+
+using namespace ciph;
+
+// Tens of thousands of live VMs on one thread, each yielding every quantum.
+static void
+BM_Green_ArithmeticLoop(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(100);
+    auto image = green::make_image(program.data(), static_cast<uint16_t>(program.size()));
+    size_t vms = static_cast<size_t>(state.range(0));
+    green::options options;
+    options.quantum = static_cast<uint32_t>(state.range(1));
+
+    for (auto _ : state) {
+        GreenScheduler scheduler(options);
+        for (size_t vm = 0; vm < vms; vm++)
+            scheduler.spawn(image);
+        scheduler.run();
+        benchmark::DoNotOptimize(scheduler.result(vms - 1).return_value);
+    }
+    state.counters["vms"] = benchmark::Counter(static_cast<double>(state.iterations()) * static_cast<double>(vms), benchmark::Counter::kIsRate);
+    state.counters["bytes_per_vm"] = static_cast<double>(image->stack + options.stack_bytes);
+}
+BENCHMARK(BM_Green_ArithmeticLoop)->Args({ 10000, 64 })->Args({ 10000, 1024 });
+
+// The same VMs one after another, each on its own ProcessingUnit.
+static void
+BM_Green_ProcessingUnits_ArithmeticLoop(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(100);
+    size_t vms = static_cast<size_t>(state.range(0));
+
+    for (auto _ : state) {
+        for (size_t vm = 0; vm < vms; vm++) {
+            ProcessingUnit unit;
+            unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+            benchmark::DoNotOptimize(unit.execute());
+        }
+    }
+    state.counters["vms"] = benchmark::Counter(static_cast<double>(state.iterations()) * static_cast<double>(vms), benchmark::Counter::kIsRate);
+    state.counters["bytes_per_vm"] = 0x1000;
+}
+BENCHMARK(BM_Green_ProcessingUnits_ArithmeticLoop)->Arg(10000);
@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+
+#include <memory_pool.hpp>
+#include <processing_unit.hpp>
+
+#include "benchmark_programs.hpp"
+
+using namespace ciph;
+
+/*
+ * Construct, run and destroy a ProcessingUnit per job. The argument is the pool's cache limit,
+ * 0 is every unit allocating its memory with new[] like before the pool. */
+static void
+BM_Lifecycle_ConstructRunDestroy(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(1);
+    size_t previous = memory_pool::cache_limit();
+    memory_pool::set_cache_limit(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        ProcessingUnit unit;
+        unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        benchmark::DoNotOptimize(unit.execute());
+    }
+    memory_pool::set_cache_limit(previous);
+    state.counters["cycles"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Lifecycle_ConstructRunDestroy)->Arg(0)->Arg(32);
+
+// The same at the largest memory size, where new[] hands back fresh pages from the OS.
+static void
+BM_Lifecycle_ConstructRunDestroy_64K(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(1);
+    size_t previous = memory_pool::cache_limit();
+    memory_pool::set_cache_limit(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        ProcessingUnit unit(Memory::max_size);
+        unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        benchmark::DoNotOptimize(unit.execute());
+    }
+    memory_pool::set_cache_limit(previous);
+    state.counters["cycles"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Lifecycle_ConstructRunDestroy_64K)->Arg(0)->Arg(32);
+
+// One unit reset between jobs, nothing is allocated or freed.
+static void
+BM_Lifecycle_ResetRun(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(1);
+    ProcessingUnit unit;
+    for (auto _ : state) {
+        unit.reset();
+        unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        benchmark::DoNotOptimize(unit.execute());
+    }
+    state.counters["cycles"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Lifecycle_ResetRun);
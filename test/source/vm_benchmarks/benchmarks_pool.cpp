@@ -0,0 +1,46 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <vm_pool.hpp>
+
+#include "benchmark_programs.hpp"
+
+using namespace ciph;
+
+namespace {
+
+// Jobs per iteration, enough that every worker has a queue to drain and steal from.
+constexpr size_t jobs_per_batch = 4096;
+
+void
+thread_counts(benchmark::internal::Benchmark* benchmark) {
+    int most = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int threads = 1; threads < most; threads *= 2)
+        benchmark->Arg(threads);
+    benchmark->Arg(most);
+}
+
+} // namespace
+
+// Scaling from one worker up to one per hardware thread, on jobs that each run a short loop.
+static void
+BM_Pool_ArithmeticLoop(benchmark::State& state) {
+    auto program = std::make_shared<const std::vector<uint8_t>>(bench::arithmetic_loop(100));
+    std::vector<pool::job> jobs(jobs_per_batch);
+    for (pool::job& job : jobs)
+        job.program = program;
+
+    VmPool pool(static_cast<size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::vector<pool::job_result> results = pool.run(jobs);
+        benchmark::DoNotOptimize(results.data());
+    }
+
+    pool::counters counters = pool.counters();
+    state.counters["jobs"] = benchmark::Counter(static_cast<double>(state.iterations()) * static_cast<double>(jobs_per_batch), benchmark::Counter::kIsRate);
+    state.counters["queue_wait_ns"] = counters.mean_queue_wait_ns();
+    state.counters["stolen"] = counters.completed == 0 ? 0.0 : static_cast<double>(counters.stolen) / static_cast<double>(counters.completed);
+}
+BENCHMARK(BM_Pool_ArithmeticLoop)->Apply(thread_counts)->UseRealTime();
@@ -0,0 +1,66 @@
+#include <benchmark/benchmark.h>
+
+#include <processing_unit.hpp>
+
+#include "benchmark_programs.hpp"
+
+using namespace ciph;
+
+// Startup as it is without snapshots, a new unit that decodes the program again. The argument is
+// the memory size, a small script shouldn't pay for a large one.
+static void
+BM_Startup_LoadProgram(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(1);
+    uint32_t memorySize = static_cast<uint32_t>(state.range(0));
+    for (auto _ : state) {
+        ProcessingUnit unit(memorySize);
+        unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        benchmark::DoNotOptimize(unit.execute());
+    }
+    state.counters["starts"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Startup_LoadProgram)->Arg(Memory::default_size)->Arg(Memory::max_size);
+
+// A new unit on an image shared by every run, decoded again but never copied.
+static void
+BM_Startup_SharedImage(benchmark::State& state) {
+    auto image = std::make_shared<const std::vector<uint8_t>>(bench::arithmetic_loop(1));
+    for (auto _ : state) {
+        ProcessingUnit unit;
+        unit.load_program(image);
+        benchmark::DoNotOptimize(unit.execute());
+    }
+    state.counters["starts"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Startup_SharedImage);
+
+// A new unit from a snapshot, memory allocation is still paid for.
+static void
+BM_Startup_Fork(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(1);
+    ProcessingUnit warm;
+    warm.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    std::shared_ptr<const vm_snapshot> snapshot = warm.snapshot();
+    for (auto _ : state) {
+        std::unique_ptr<ProcessingUnit> unit = ProcessingUnit::fork(*snapshot);
+        benchmark::DoNotOptimize(unit->execute());
+    }
+    state.counters["starts"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Startup_Fork);
+
+// One unit restored per request, only the snapshot's memory is copied.
+static void
+BM_Startup_Restore(benchmark::State& state) {
+    std::vector<uint8_t> program = bench::arithmetic_loop(1);
+    ProcessingUnit warm;
+    warm.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    std::shared_ptr<const vm_snapshot> snapshot = warm.snapshot();
+    ProcessingUnit unit;
+    for (auto _ : state) {
+        unit.restore(*snapshot);
+        benchmark::DoNotOptimize(unit.execute());
+    }
+    state.counters["starts"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Startup_Restore);
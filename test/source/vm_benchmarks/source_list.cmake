@@ -0,0 +1,16 @@
+
+set(VM_BENCHMARK_DIR ${CMAKE_CURRENT_SOURCE_DIR}/source/vm_benchmarks)
+set(VM_BENCHMARK_SRC
+    ${VM_BENCHMARK_DIR}/main.cpp
+
+    ${VM_BENCHMARK_DIR}/benchmark_programs.hpp
+    ${VM_BENCHMARK_DIR}/benchmarks_arithmetic.cpp
+    ${VM_BENCHMARK_DIR}/benchmarks_batch.cpp
+    ${VM_BENCHMARK_DIR}/benchmarks_calls.cpp
+    ${VM_BENCHMARK_DIR}/benchmarks_codegen.cpp
+    ${VM_BENCHMARK_DIR}/benchmarks_dispatch.cpp
+    ${VM_BENCHMARK_DIR}/benchmarks_green.cpp
+    ${VM_BENCHMARK_DIR}/benchmarks_memory.cpp
+    ${VM_BENCHMARK_DIR}/benchmarks_pool.cpp
+    ${VM_BENCHMARK_DIR}/benchmarks_snapshot.cpp
+)
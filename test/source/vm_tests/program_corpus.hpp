@@ -0,0 +1,330 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <shared_defines.hpp>
+
+namespace ciph::test {
+
+struct corpus_program {
+    std::string name;
+    std::vector<uint8_t> bytes;
+};
+
+/*
+ * Programs every execution engine has to agree on: the programs from the VM tests plus a few
+ * that stress wrap around, register forms, frame registers and side exits. Used by the
+ * differential tests, so new engines get compared against the interpreter for free. */
+inline const std::vector<corpus_program>&
+program_corpus() {
+    using instruction::def;
+    using reg = registers::def;
+    static const std::vector<corpus_program> corpus = {
+        { "Add", {
+            +def::PSH_LIT, 0, 26,
+            +def::PSH_LIT, 0, 16,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "Variables_Expression", {
+            +def::PSH_LIT, 0, 25,
+            +def::PSH_LIT, 0, 10,
+            +def::PEK_OFF, 0, 0,
+            +def::PEK_OFF, 0, 1,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "MulBeforeAdd", {
+            +def::PSH_LIT, 0, 2,
+            +def::PSH_LIT, 0, 2,
+            +def::MUL,
+            +def::PSH_LIT, 0, 3,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "ParenthasesBeforeMul", {
+            +def::PSH_LIT, 0, 2,
+            +def::PSH_LIT, 0, 2,
+            +def::PSH_LIT, 0, 3,
+            +def::ADD,
+            +def::MUL,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "Return_Variable", {
+            +def::PSH_LIT, 0, 25,
+            +def::PEK_OFF, 0, 0,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "LetStatement_MultipleVariables", {
+            +def::PSH_LIT, 0, 2,
+            +def::PSH_LIT, 0, 3,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::ADD,
+            +def::PEK_OFF, +reg::sp, 2,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "Return_Equals", {
+            +def::PSH_LIT, 0, 10,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PSH_LIT, 0, 10,
+            +def::CMP, +reg::sp,
+            +def::MOV, +reg::ret, +reg::imm,
+            +def::RET } },
+        { "While", {
+            +def::PSH_LIT, 0, 0,
+            +def::INC, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PSH_LIT, 0, 10,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x0E,
+            +def::PEK_OFF, +reg::ret, 0,
+            +def::RET } },
+        { "ArithmeticLoop", {
+            +def::PSH_LIT, 0, 0,
+            +def::PSH_LIT, 0, 3,
+            +def::INC, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::MUL,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::ADD,
+            +def::POP_REG, +reg::r0,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PSH_LIT, 0x03, 0xE8,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x1B,
+            +def::PEK_OFF, +reg::ret, 0,
+            +def::RET } },
+        { "LoopWithInnerBranch", {
+            // the forward branch changes direction half way, traces leave through its guard.
+            +def::PSH_LIT, 0, 0,
+            +def::PSH_LIT, 0, 0,
+            +def::INC, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PSH_LIT, 0, 5,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0xFF, 0xFD,          // skips the INC below while i < 5
+            +def::INC, +reg::sp, 1,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PSH_LIT, 0, 10,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x1C,
+            +def::PEK_OFF, +reg::ret, 1,
+            +def::RET } },
+        { "DecrementingLoop_Unfused", {
+            // literal first in the condition, the fusion pass leaves it alone.
+            +def::PSH_LIT, 0, 50,
+            +def::DEC, +reg::sp, 0,
+            +def::PSH_LIT, 0, 0,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x0E,
+            +def::PEK_OFF, +reg::ret, 0,
+            +def::RET } },
+        { "Wraparound", {
+            +def::PSH_LIT, 0x7F, 0xFF,
+            +def::PSH_LIT, 0, 1,
+            +def::ADD,                      // 32767 + 1 wraps to -32768
+            +def::PSH_LIT, 0xFF, 0xFF,
+            +def::DIV,                      // -32768 / -1 stays -32768
+            +def::PSH_LIT, 0x01, 0x01,
+            +def::MUL,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "NegativeDivision", {
+            +def::PSH_LIT, 0xFF, 0xF9,      // -7
+            +def::PSH_LIT, 0, 2,
+            +def::DIV,                      // truncates towards zero
+            +def::PSH_LIT, 0, 9,
+            +def::PSH_LIT, 0xFF, 0xFC,      // -4
+            +def::DIV,
+            +def::SUB,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "RegisterArithmetic", {
+            +def::PSH_LIT, 0, 20,
+            +def::POP_REG, +reg::r0,
+            +def::PSH_LIT, 0, 3,
+            +def::POP_REG, +reg::r1,
+            +def::MUL_REG, +reg::r0, +reg::r1,
+            +def::SUB_REG, +reg::r0, +reg::r1,
+            +def::DIV_REG, +reg::r0, +reg::r1,
+            +def::ADD_REG, +reg::r0, +reg::r0,
+            +def::PSH_LIT, 0, 5,
+            +def::POP_REG, +reg::imm,
+            +def::MUL_REG, +reg::r1, +reg::imm,
+            +def::MOV, +reg::ret, +reg::r0,
+            +def::RET } },
+        { "PutAndMemoryOperands", {
+            +def::PUT_LIT, 0x01, 0x2C,
+            +def::PUT_REG, +reg::r0,
+            +def::PUT_LIT, 0xFF, 0xF9,
+            +def::MOV_MEM, 0x00, 0xF0,
+            +def::PSH_MEM, 0x00, 0xF0,
+            +def::PSH_REG, +reg::r0,
+            +def::MUL,
+            +def::PSH_MEM, 0x00, 0xF0,
+            +def::DIV,
+            +def::POP_REG, +reg::imm,
+            +def::PUT_REG, +reg::ret,
+            +def::RET } },
+        { "MemoryOperand_TopOfStack", {
+            // the stack starts at 0x30, right after the program.
+            +def::PSH_LIT, 0, 5,
+            +def::PUT_LIT, 0, 9,
+            +def::MOV_MEM, 0x00, 0x30,
+            +def::PSH_MEM, 0x00, 0x30,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "FrameRegisters", {
+            +def::PSH_LIT, 0, 5,
+            +def::PSH_LIT, 0, 6,
+            +def::MOV, +reg::r0, +reg::sp,
+            +def::MOV, +reg::fp, +reg::sp,
+            +def::POP_REG, +reg::ret,
+            +def::PSH_REG, +reg::fp,
+            +def::POP_REG, +reg::r1,
+            +def::INC, +reg::r1,
+            +def::DEC, +reg::r0,
+            +def::PSH,
+            +def::PEK_REG, +reg::r2,
+            +def::RET } },
+        { "TopOfStack", {
+            +def::PSH_LIT, 0, 4,
+            +def::INC, +reg::sp, 0,
+            +def::PEK_REG, +reg::r0,
+            +def::PSH_LIT, 0, 9,
+            +def::PEK_OFF, +reg::r1, 0,
+            +def::PEK_OFF, +reg::r2, 1,
+            +def::POP_REG, +reg::r3,
+            +def::MOV, +reg::ret, +reg::r0,
+            +def::RET } },
+        { "ProgramCounter_SideExit", {
+            // decoded engines ignore writes to pc, only RET and traps set it.
+            +def::PSH_LIT, 0, 0x40,
+            +def::POP_REG, +reg::pc,
+            +def::MOV, +reg::pc, +reg::r0,
+            +def::PSH_LIT, 0, 3,
+            +def::PSH_LIT, 0, 4,
+            +def::ADD,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "Call_Nested", {
+            +def::PSH_LIT, 0, 7,
+            +def::CALL, 0x00, 12,               // f
+            +def::POP_REG, +reg::r0,
+            +def::ADD_REG, +reg::ret, +reg::r0,
+            +def::RET,
+            // f, 5 plus what g returns.
+            +def::PSH_LIT, 0, 5,
+            +def::CALL, 0x00, 25,               // g
+            +def::PEK_OFF, +reg::r1, 0,
+            +def::ADD_REG, +reg::ret, +reg::r1,
+            +def::RET,
+            // g
+            +def::PUT_LIT, 0, 30,
+            +def::PUT_REG, +reg::ret,
+            +def::RET } },
+        { "Recursion_Fib", {
+            +def::PUT_LIT, 0, 10,
+            +def::PUT_REG, +reg::r0,
+            +def::CALL, 0x00, 9,                // fib
+            +def::RET,
+            // fib, n in r0.
+            +def::PSH_REG, +reg::r0,
+            +def::PSH_LIT, 0, 2,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0xFF, 0xE6,              // forward to n < 2
+            +def::PSH_REG, +reg::r0,
+            +def::DEC, +reg::r0,
+            +def::CALL, 0x00, 9,
+            +def::PSH_REG, +reg::ret,
+            +def::PEK_OFF, +reg::r0, 0,
+            +def::DEC, +reg::r0,
+            +def::DEC, +reg::r0,
+            +def::CALL, 0x00, 9,
+            +def::PEK_OFF, +reg::r1, 1,
+            +def::ADD_REG, +reg::ret, +reg::r1,
+            +def::RET,
+            +def::MOV, +reg::ret, +reg::r0,
+            +def::RET } },
+        { "Call_StackArguments", {
+            +def::PUT_LIT, 0, 10,
+            +def::PUT_REG, +reg::r0,            // a in r0
+            +def::PSH_LIT, 0, 7,                // f, pushed first
+            +def::PSH_LIT, 0, 3,                // e, right under the return address
+            +def::CALL, 0x00, 19,
+            +def::POP_REG, +reg::imm,
+            +def::POP_REG, +reg::imm,
+            +def::RET,
+            // a - e * f
+            +def::PEK_ARG, +reg::r1, 0,
+            +def::PEK_ARG, +reg::sp, 1,
+            +def::PEK_OFF, +reg::r2, 0,
+            +def::MUL_REG, +reg::r1, +reg::r2,
+            +def::MOV, +reg::ret, +reg::r0,
+            +def::SUB_REG, +reg::ret, +reg::r1,
+            +def::RET } },
+        { "UnknownOpcode_Traps", {
+            +def::PSH_LIT, 0, 7,
+            0xEE,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "BranchIntoOperand_Traps", {
+            +def::PSH_LIT, 0, 1,
+            +def::PSH_LIT, 0, 2,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x09,
+            +def::RET } },
+        { "DivByZero_Traps", {
+            +def::PSH_LIT, 0, 7,
+            +def::PSH_LIT, 0, 0,
+            +def::DIV,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        { "DivRegByZero_Traps", {
+            +def::PSH_LIT, 0, 7,
+            +def::POP_REG, +reg::r0,
+            +def::DIV_REG, +reg::r0, +reg::r1,
+            +def::MOV, +reg::ret, +reg::r0,
+            +def::RET } },
+        { "DivOffByZero_Traps", {
+            +def::PSH_LIT, 0, 9,
+            +def::PSH_LIT, 0, 0,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::PEK_OFF, +reg::sp, 1,
+            +def::DIV,
+            +def::POP_REG, +reg::ret,
+            +def::RET } },
+        // 60 / i with i counting down from 3, traps on the fourth pass with 60 left in ret.
+        { "DivByZero_InLoop", {
+            +def::PSH_LIT, 0, 3,
+            +def::PSH_LIT, 0, 60,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::DIV,
+            +def::POP_REG, +reg::ret,
+            +def::DEC, +reg::sp, 0,
+            +def::PSH_LIT, 0xFF, 0xFF,
+            +def::PEK_OFF, +reg::sp, 0,
+            +def::CMP, +reg::sp,
+            +def::JLT, 0x00, 0x17,      // jump back to the second PSH_LIT while -1 < i
+            +def::RET } },
+    };
+    return corpus;
+}
+
+// Names the instances of a suite instantiated over program_corpus() after their program.
+struct corpus_name {
+    std::string operator()(const ::testing::TestParamInfo<corpus_program>& info) const {
+        return info.param.name;
+    }
+};
+
+} // namespace ciph::test
@@ -2,8 +2,20 @@
 set(VM_TEST_DIR ${CMAKE_CURRENT_SOURCE_DIR}/source/vm_tests)
 set(VM_TEST_SRC
     ${VM_TEST_DIR}/main.cpp
+    ${VM_TEST_DIR}/program_corpus.hpp
 
+    ${VM_TEST_DIR}/tests_batch.cpp
+    ${VM_TEST_DIR}/tests_byte_order.cpp
+    ${VM_TEST_DIR}/tests_decoder.cpp
+    ${VM_TEST_DIR}/tests_green.cpp
     ${VM_TEST_DIR}/tests_instructions.cpp
+    ${VM_TEST_DIR}/tests_interpreter.cpp
+    ${VM_TEST_DIR}/tests_jit.cpp
+    ${VM_TEST_DIR}/tests_memory_pool.cpp
+    ${VM_TEST_DIR}/tests_metering.cpp
+    ${VM_TEST_DIR}/tests_pool.cpp
     ${VM_TEST_DIR}/tests_processing_unit.cpp
+    ${VM_TEST_DIR}/tests_tracing.cpp
+    ${VM_TEST_DIR}/tests_verifier.cpp
 )
 
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <batch.hpp>
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+
+#include "program_corpus.hpp"
+
+using namespace ciph;
+
+namespace {
+
+/*
+ * let i = 0
+ * while (i < r0) {
+ *     i++
+ * }
+ * return i */
+std::vector<uint8_t>
+input_loop() {
+    return { +instruction::def::PSH_LIT, 0, 0,
+             +instruction::def::INC, +registers::def::sp, 0,
+             +instruction::def::PEK_OFF, +registers::def::sp, 0,
+             +instruction::def::PSH_REG, +registers::def::r0,
+             +instruction::def::CMP, +registers::def::sp,
+             +instruction::def::JLT, 0x00, 0x0D, // jump back thirteen bytes
+             +instruction::def::PEK_OFF, +registers::def::ret, 0,
+             +instruction::def::RET };
+}
+
+std::vector<batch::backend>
+backends() {
+    std::vector<batch::backend> result = { batch::backend::scalar };
+    if (batch::avx2_supported())
+        result.push_back(batch::backend::avx2);
+    return result;
+}
+
+} // namespace
+
+class BatchDifferentialTest : public ::testing::TestWithParam<test::corpus_program>
+{
+};
+
+// 37 instances, so the last group only has five live lanes.
+TEST_P(BatchDifferentialTest, MatchesProcessingUnit)
+{
+    std::vector<uint8_t> bytes = GetParam().bytes;
+    ProcessingUnit unit;
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    int16_t expected = unit.execute();
+
+    for (batch::backend backend : backends()) {
+        BatchExecutor executor;
+        executor.set_backend(backend);
+        executor.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+        batch::result result = executor.execute(37);
+
+        ASSERT_EQ(37u, result.return_values.size());
+        for (size_t instance = 0; instance < result.return_values.size(); instance++) {
+            EXPECT_EQ(expected, result.return_values[instance]) << "instance " << instance;
+            EXPECT_EQ(unit.context().trap, result.traps[instance]) << "instance " << instance;
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Corpus, BatchDifferentialTest, ::testing::ValuesIn(test::program_corpus()),
+                         test::corpus_name());
+
+TEST(BatchTest, DivergentLoops_EveryLaneOwnResult)
+{
+    std::vector<uint8_t> program = input_loop();
+    std::vector<batch::inputs> inputs(40);
+    for (size_t instance = 0; instance < inputs.size(); instance++)
+        inputs[instance][0] = static_cast<int16_t>((instance * 7) % 23 - 3);
+
+    for (batch::backend backend : backends()) {
+        BatchExecutor executor;
+        executor.set_backend(backend);
+        executor.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        batch::result result = executor.execute(inputs);
+
+        EXPECT_EQ(0u, result.fallbacks);
+        for (size_t instance = 0; instance < inputs.size(); instance++) {
+            // the body runs once before the condition is checked.
+            int16_t expected = std::max<int16_t>(1, inputs[instance][0]);
+            EXPECT_EQ(expected, result.return_values[instance]) << "instance " << instance;
+            EXPECT_EQ(trap_code::none, result.traps[instance]);
+        }
+    }
+}
+
+TEST(BatchTest, SharedRegisterWrite_FallsBack)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 5,
+                                     +instruction::def::MOV, +registers::def::fp, +registers::def::sp,
+                                     +instruction::def::PEK_REG, +registers::def::ret,
+                                     +instruction::def::RET };
+    BatchExecutor executor;
+    executor.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    batch::result result = executor.execute(3);
+
+    EXPECT_EQ(3u, result.fallbacks);
+    for (int16_t value : result.return_values)
+        EXPECT_EQ(5, value);
+}
+
+TEST(BatchTest, DivisionByZero_OnlyThoseLanesTrap)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 84,
+                                     +instruction::def::PSH_REG, +registers::def::r0,
+                                     +instruction::def::DIV,
+                                     +instruction::def::POP_REG, +registers::def::ret,
+                                     +instruction::def::RET };
+    std::vector<batch::inputs> inputs(20);
+    for (size_t instance = 0; instance < inputs.size(); instance++)
+        inputs[instance][0] = static_cast<int16_t>(instance % 4);
+
+    for (batch::backend backend : backends()) {
+        BatchExecutor executor;
+        executor.set_backend(backend);
+        executor.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        batch::result result = executor.execute(inputs);
+
+        EXPECT_EQ(5u, result.fallbacks);
+        for (size_t instance = 0; instance < inputs.size(); instance++) {
+            int16_t divisor = inputs[instance][0];
+            EXPECT_EQ(divisor == 0 ? trap_code::division_by_zero : trap_code::none, result.traps[instance])
+                << "instance " << instance;
+            EXPECT_EQ(divisor == 0 ? 0 : 84 / divisor, result.return_values[instance]) << "instance " << instance;
+        }
+    }
+}
+
+TEST(BatchTest, NoInstances_EmptyResult)
+{
+    std::vector<uint8_t> program = input_loop();
+    BatchExecutor executor;
+    executor.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    batch::result result = executor.execute(0);
+
+    EXPECT_TRUE(result.return_values.empty());
+    EXPECT_TRUE(result.traps.empty());
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include <byte_order.hpp>
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+
+using namespace ciph;
+
+namespace {
+
+const int16_t boundary_values[] = { -32768, -32767, -256, -255, -1, 0, 1, 127, 128, 255, 256, 32767 };
+
+} // namespace
+
+TEST(ByteOrderTest, Word_LittleEndian)
+{
+    uint8_t bytes[2] = {};
+    byte_order::store_word(bytes, 0x1234);
+    EXPECT_EQ(0x34, bytes[0]);
+    EXPECT_EQ(0x12, bytes[1]);
+    EXPECT_EQ(0x1234, byte_order::load_word(bytes));
+}
+
+TEST(ByteOrderTest, Operand_BigEndian)
+{
+    uint8_t bytes[2] = {};
+    byte_order::store_operand(bytes, 0x1234);
+    EXPECT_EQ(0x12, bytes[0]);
+    EXPECT_EQ(0x34, bytes[1]);
+    EXPECT_EQ(0x1234, byte_order::load_operand(bytes));
+}
+
+TEST(ByteOrderTest, Unaligned_RoundTrip)
+{
+    uint8_t bytes[5] = {};
+    for (int16_t value : boundary_values) {
+        byte_order::store_word(bytes + 1, value);
+        EXPECT_EQ(value, byte_order::load_word(bytes + 1));
+        byte_order::store_operand(bytes + 3, value);
+        EXPECT_EQ(value, byte_order::load_operand(bytes + 3));
+    }
+}
+
+// Every value goes in as an operand, through the stack and a register and back out unchanged.
+TEST(ByteOrderTest, ThroughTheStack_RoundTrip)
+{
+    for (int16_t value : boundary_values) {
+        std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 0,
+                                         +instruction::def::PSH_LIT, 0, 0,
+                                         +instruction::def::ADD,
+                                         +instruction::def::POP_REG, +registers::def::ret,
+                                         +instruction::def::RET };
+        byte_order::store_operand(&program[1], value);
+
+        ProcessingUnit unit;
+        unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        EXPECT_EQ(value, unit.execute()) << value;
+    }
+}
@@ -0,0 +1,327 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <initializer_list>
+
+#include <decoder.hpp>
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+
+using namespace ciph;
+
+TEST(DecoderTest, Decode_OperandsAndBytePc)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0xFF, 0xFE,
+                            +instruction::def::PEK_OFF, +registers::def::r0, 3,
+                            +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                            +instruction::def::INC, +registers::def::r1,
+                            +instruction::def::INC, +registers::def::sp, 2,
+                            +instruction::def::RET
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20, false, false);
+
+    ASSERT_EQ(6u, decoded.instructions.size());
+    std::vector<uint16_t> expectedPc = { 0x20, 0x23, 0x26, 0x29, 0x2B, 0x2E, 0x2F };
+    EXPECT_EQ(expectedPc, decoded.byte_pc);
+
+    EXPECT_EQ(instruction::def::PSH_LIT, decoded.instructions[0].opcode);
+    EXPECT_EQ(-2, decoded.instructions[0].literal);
+
+    EXPECT_EQ(+registers::def::r0, decoded.instructions[1].reg_a);
+    EXPECT_EQ(3, decoded.instructions[1].literal);
+
+    EXPECT_EQ(+registers::def::ret, decoded.instructions[2].reg_a);
+    EXPECT_EQ(+registers::def::r0, decoded.instructions[2].reg_b);
+
+    EXPECT_EQ(+registers::def::r1, decoded.instructions[3].reg_a);
+    EXPECT_EQ(2, decoded.instructions[4].literal);
+    EXPECT_EQ(instruction::def::RET, decoded.instructions[5].opcode);
+}
+
+TEST(DecoderTest, Decode_ArgumentsBelowFrame)
+{
+    uint8_t program[] = {   +instruction::def::PEK_ARG, +registers::def::r0, 0,
+                            +instruction::def::PEK_ARG, +registers::def::sp, 2,
+                            +instruction::def::RET
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20, false, false);
+
+    // quickened like a local, the literal is where the word ends relative to fp, under the return address.
+    ASSERT_EQ(3u, decoded.instructions.size());
+    EXPECT_EQ(instruction::def::PEK_LOC_REG, decoded.instructions[0].opcode);
+    EXPECT_EQ(+registers::def::r0, decoded.instructions[0].reg_a);
+    EXPECT_EQ(-4, decoded.instructions[0].literal);
+    EXPECT_EQ(instruction::def::PEK_LOC, decoded.instructions[1].opcode);
+    EXPECT_EQ(-8, decoded.instructions[1].literal);
+}
+
+TEST(DecoderTest, Decode_ResolvesBranchTarget)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::INC, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PSH_LIT, 0, 10,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
+                            +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                            +instruction::def::RET
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20, false);
+
+    ASSERT_EQ(instruction::def::JLT, decoded.instructions[5].opcode);
+    EXPECT_EQ(1, decoded.instructions[5].target); // the INC
+    EXPECT_EQ(1, decoded.index_of(0x23));
+    EXPECT_EQ(decoded_program::halt, decoded.index_of(0x24));
+}
+
+TEST(DecoderTest, Decode_TruncatedAndUnknownTrap)
+{
+    uint8_t program[] = {   0xEE,
+                            +instruction::def::PSH_LIT, 0
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20);
+
+    ASSERT_EQ(2u, decoded.instructions.size());
+    EXPECT_EQ(decoder::invalid_opcode, decoded.instructions[0].opcode);
+    EXPECT_EQ(decoder::invalid_opcode, decoded.instructions[1].opcode);
+    EXPECT_EQ(0x21, decoded.byte_pc[1]);
+}
+
+TEST(DecoderTest, LoadProgram_OddLengthDecodedUnpadded)
+{
+    // eleven bytes, the stack starts one byte later but the padding isn't part of the program.
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 7,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::MOV, +registers::def::r0, +registers::def::ret,
+                            +instruction::def::RET,
+                            +instruction::def::PSH_LIT, 0
+                            };
+    static_assert(sizeof(program) % 2 == 1);
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    const decoded_program& decoded = unit.program();
+    ASSERT_EQ(5u, decoded.instructions.size());
+    EXPECT_EQ(decoder::invalid_opcode, decoded.instructions.back().opcode);
+    EXPECT_EQ(unit.layout().code + sizeof(program), decoded.byte_pc.back());
+    EXPECT_EQ(unit.layout().code + sizeof(program) + 1, unit.layout().stack);
+    EXPECT_EQ(7, unit.execute());
+}
+
+TEST(DecoderTest, MeasureBlocks_EndOnBranchAndReturn)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::INC, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PSH_LIT, 0, 10,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
+                            +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                            +instruction::def::RET
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20, false, false);
+    std::vector<uint16_t> expected = { 6, 5, 4, 3, 2, 1, 2, 1 };
+    EXPECT_EQ(expected, decoded.block_cost);
+    EXPECT_EQ(6, decoded.largest_block);
+
+    // fusion shortens the loop body, the costs follow the fused stream.
+    decoder::fuse(decoded);
+    expected = { 3, 2, 1, 2, 1 };
+    EXPECT_EQ(expected, decoded.block_cost);
+    EXPECT_EQ(3, decoded.largest_block);
+}
+
+TEST(DecoderTest, Fuse_WhileLoopTail)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::INC, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PSH_LIT, 0, 10,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
+                            +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                            +instruction::def::RET
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20);
+
+    EXPECT_EQ(1, decoded.fusions);
+    ASSERT_EQ(5u, decoded.instructions.size());
+    EXPECT_EQ(instruction::def::JLT_OFF, decoded.instructions[2].opcode);
+    EXPECT_EQ(0, decoded.instructions[2].reg_a);
+    EXPECT_EQ(10, decoded.instructions[2].literal);
+    EXPECT_EQ(1, decoded.instructions[2].target);
+    EXPECT_EQ(0x26, decoded.byte_pc[2]);
+    EXPECT_EQ(0x31, decoded.byte_pc[3]);
+}
+
+TEST(DecoderTest, Fuse_LocalsAndLiterals)
+{
+    // let x = 2 * 3
+    // let y = 4
+    // return x - y
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 2,
+                            +instruction::def::PSH_LIT, 0, 3,
+                            +instruction::def::MUL,
+                            +instruction::def::PSH_LIT, 0, 4,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 1,
+                            +instruction::def::SUB,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20);
+
+    EXPECT_EQ(2, decoded.fusions);
+    ASSERT_EQ(5u, decoded.instructions.size());
+    EXPECT_EQ(instruction::def::PSH_LIT, decoded.instructions[0].opcode);
+    EXPECT_EQ(6, decoded.instructions[0].literal);
+    EXPECT_EQ(instruction::def::SUB_OFF, decoded.instructions[2].opcode);
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    EXPECT_EQ(2, unit.execute());
+}
+
+TEST(DecoderTest, Step_ThroughSuperinstructions)
+{
+    // both the folded literals and the SUB_OFF are single instructions to execute().
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 2,
+                            +instruction::def::PSH_LIT, 0, 3,
+                            +instruction::def::MUL,
+                            +instruction::def::PSH_LIT, 0, 4,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 1,
+                            +instruction::def::SUB,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    ASSERT_EQ(2, unit.program().fusions);
+    uint16_t bp = unit.registries()[+registers::def::bp];
+
+    for (uint16_t offset : std::initializer_list<uint16_t>{ 3, 6, 7, 10, 13, 16, 17, 19 }) {
+        EXPECT_TRUE(unit.step());
+        EXPECT_EQ(bp + offset, unit.registries()[+registers::def::pc]);
+    }
+    EXPECT_FALSE(unit.step());
+    EXPECT_EQ(2, unit.context().return_value);
+
+    // execute() picks up in the middle of the folded literals.
+    unit.restart();
+    EXPECT_TRUE(unit.step());
+    EXPECT_TRUE(unit.step());
+    EXPECT_EQ(2, unit.execute());
+
+    // and finishes the SUB_OFF a unit of fuel per instruction before going on.
+    unit.restart();
+    for (int i = 0; i < 5; i++)
+        EXPECT_TRUE(unit.step());
+    EXPECT_EQ(bp + 13, unit.registries()[+registers::def::pc]);
+    EXPECT_EQ(run_status::out_of_fuel, unit.execute(1));
+    EXPECT_EQ(bp + 16, unit.registries()[+registers::def::pc]);
+    EXPECT_EQ(run_status::completed, unit.execute(100));
+    EXPECT_EQ(2, unit.context().return_value);
+}
+
+TEST(DecoderTest, Fuse_NotAcrossBranchTarget)
+{
+    // the loop starts on the second PEK_OFF, fusing it would swallow the branch target.
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::ADD,
+                            +instruction::def::PSH_LIT, 0, 1,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x0C,
+                            +instruction::def::RET
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20, true, false);
+
+    EXPECT_EQ(0, decoded.fusions);
+    EXPECT_EQ(instruction::def::PEK_OFF, decoded.instructions[1].opcode);
+    EXPECT_EQ(2, decoded.instructions[6].target);
+}
+
+TEST(DecoderTest, Quicken_SpecializesOnRegister)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 5,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::r0, 1,
+                            +instruction::def::INC, +registers::def::sp, 0,
+                            +instruction::def::DEC, +registers::def::sp, 1,
+                            +instruction::def::INC, +registers::def::r1,
+                            +instruction::def::RET
+                            };
+
+    decoded_program decoded = decoder::decode(program, sizeof(program), 0x20, false);
+
+    EXPECT_EQ(4, decoded.quickened);
+    EXPECT_EQ(instruction::def::PEK_LOC, decoded.instructions[1].opcode);
+    EXPECT_EQ(2, decoded.instructions[1].literal);
+    EXPECT_EQ(instruction::def::PEK_LOC_REG, decoded.instructions[2].opcode);
+    EXPECT_EQ(+registers::def::r0, decoded.instructions[2].reg_a);
+    EXPECT_EQ(4, decoded.instructions[2].literal);
+    EXPECT_EQ(instruction::def::INC_LOC, decoded.instructions[3].opcode);
+    EXPECT_EQ(2, decoded.instructions[3].literal);
+    EXPECT_EQ(instruction::def::DEC_LOC, decoded.instructions[4].opcode);
+    EXPECT_EQ(4, decoded.instructions[4].literal);
+    // register increments have nothing to specialize on.
+    EXPECT_EQ(instruction::def::INC, decoded.instructions[5].opcode);
+}
+
+TEST(DecoderTest, Quicken_AfterFusion)
+{
+    // the loop condition still fuses, the INC that starts the loop is quickened.
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::INC, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PSH_LIT, 0, 10,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x0E,
+                            +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+
+    const decoded_program& decoded = unit.program();
+    EXPECT_EQ(1, decoded.fusions);
+    EXPECT_EQ(2, decoded.quickened);
+    EXPECT_EQ(instruction::def::INC_LOC, decoded.instructions[1].opcode);
+    EXPECT_EQ(instruction::def::JLT_OFF, decoded.instructions[2].opcode);
+    EXPECT_EQ(instruction::def::PEK_LOC_REG, decoded.instructions[3].opcode);
+    EXPECT_EQ(10, unit.execute());
+
+    // the program image is never rewritten.
+    EXPECT_EQ(0, std::memcmp(program, unit.context().code, sizeof(program)));
+}
+
+TEST(DecoderTest, Step_KeepsBytePc)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 25,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    uint16_t bp = unit.registries()[+registers::def::bp];
+
+    EXPECT_TRUE(unit.step());
+    EXPECT_EQ(bp + 3, unit.registries()[+registers::def::pc]);
+    EXPECT_TRUE(unit.step());
+    EXPECT_EQ(bp + 5, unit.registries()[+registers::def::pc]);
+    EXPECT_FALSE(unit.step());
+    EXPECT_EQ(25, unit.context().return_value);
+}
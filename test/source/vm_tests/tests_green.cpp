@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include <green.hpp>
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+
+#include "program_corpus.hpp"
+
+using namespace ciph;
+
+namespace {
+
+/*
+ * let i = 0
+ * while (i < r0) {
+ *     i++
+ * }
+ * return i */
+std::vector<uint8_t>
+input_loop() {
+    return { +instruction::def::PSH_LIT, 0, 0,
+             +instruction::def::INC, +registers::def::sp, 0,
+             +instruction::def::PEK_OFF, +registers::def::sp, 0,
+             +instruction::def::PSH_REG, +registers::def::r0,
+             +instruction::def::CMP, +registers::def::sp,
+             +instruction::def::JLT, 0x00, 0x0D, // jump back thirteen bytes
+             +instruction::def::PEK_OFF, +registers::def::ret, 0,
+             +instruction::def::RET };
+}
+
+} // namespace
+
+class GreenDifferentialTest : public ::testing::TestWithParam<test::corpus_program>
+{
+};
+
+// The smallest quantum, so every VM yields at each block it can't fit.
+TEST_P(GreenDifferentialTest, MatchesProcessingUnit)
+{
+    std::vector<uint8_t> bytes = GetParam().bytes;
+    ProcessingUnit unit;
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    int16_t expected = unit.execute();
+
+    green::options options;
+    options.quantum = 1;
+    GreenScheduler scheduler(options);
+    auto image = green::make_image(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    for (int copy = 0; copy < 3; copy++)
+        scheduler.spawn(image);
+    scheduler.run();
+
+    for (green::vm_id id = 0; id < scheduler.size(); id++) {
+        const green::result& result = scheduler.result(id);
+        EXPECT_EQ(unit.context().trap == trap_code::none ? run_status::completed : run_status::trapped, result.status);
+        EXPECT_EQ(expected, result.return_value);
+        EXPECT_EQ(unit.context().trap, result.trap);
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(Corpus, GreenDifferentialTest, ::testing::ValuesIn(test::program_corpus()),
+                         test::corpus_name());
+
+TEST(GreenSchedulerTest, RunOnce_YieldsOnQuantum)
+{
+    std::vector<uint8_t> program = input_loop();
+    green::options options;
+    options.quantum = 20;
+    GreenScheduler scheduler(options);
+    auto image = green::make_image(program.data(), static_cast<uint16_t>(program.size()));
+    scheduler.spawn(image, { 100 });
+    scheduler.spawn(image, { 2 });
+
+    // both VMs started, the short one fits in its first quantum.
+    EXPECT_EQ(1u, scheduler.run_once());
+    EXPECT_EQ(run_status::out_of_fuel, scheduler.result(0).status);
+    EXPECT_EQ(run_status::completed, scheduler.result(1).status);
+    EXPECT_EQ(2, scheduler.result(1).return_value);
+
+    scheduler.run();
+    EXPECT_EQ(0u, scheduler.live());
+    EXPECT_EQ(100, scheduler.result(0).return_value);
+}
+
+TEST(GreenSchedulerTest, ManyVms_OneThread)
+{
+    std::vector<uint8_t> program = input_loop();
+    GreenScheduler scheduler;
+    auto image = green::make_image(program.data(), static_cast<uint16_t>(program.size()));
+    for (int16_t index = 0; index < 20000; index++)
+        scheduler.spawn(image, { static_cast<int16_t>(index % 50) });
+    scheduler.run();
+
+    for (green::vm_id id = 0; id < scheduler.size(); id++)
+        ASSERT_EQ(std::max<int16_t>(1, static_cast<int16_t>(id % 50)), scheduler.result(id).return_value) << "vm " << id;
+}
+
+TEST(GreenSchedulerTest, UnknownOpcode_Trapped)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 1, 0xEE };
+    GreenScheduler scheduler;
+    scheduler.spawn(green::make_image(program.data(), static_cast<uint16_t>(program.size())));
+    scheduler.run();
+
+    EXPECT_EQ(run_status::trapped, scheduler.result(0).status);
+    EXPECT_EQ(trap_code::invalid_instruction, scheduler.result(0).trap);
+}
+
+TEST(GreenSchedulerTest, DeepSlot_FaultsPastStackBytes)
+{
+    // slot 100 is 202 bytes above fp, verified but outside a VM with 64 bytes of stack.
+    std::vector<uint8_t> program = { +instruction::def::PEK_OFF, +registers::def::ret, 100,
+                                     +instruction::def::RET };
+    auto image = green::make_image(program.data(), static_cast<uint16_t>(program.size()));
+    ASSERT_TRUE(image->verification.verified());
+
+    green::options small;
+    small.stack_bytes = 64;
+    GreenScheduler scheduler(small);
+    scheduler.spawn(image);
+    scheduler.run();
+    EXPECT_EQ(trap_code::stack_fault, scheduler.result(0).trap);
+
+    GreenScheduler roomy;
+    roomy.spawn(image);
+    roomy.run();
+    EXPECT_EQ(run_status::completed, roomy.result(0).status);
+}
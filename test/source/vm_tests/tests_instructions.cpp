@@ -57,7 +57,7 @@ protected:
         registries[+registers::def::fp] = stackAddrs;
     }
 public:
-    Memory<0x100> mem;
+    Memory mem{ 0x100 };
     uint16_t* registries = nullptr;
 };
 
@@ -193,6 +193,84 @@ TEST_F(InstructionsTest, BinaryExpressionHandlersTests)
     }
 }
 
+TEST_F(InstructionsTest, RegisterBinaryExpressionHandlersTests)
+{
+    using namespace instruction;
+    std::vector<std::tuple<int16_t, int16_t, def, int16_t>> tests = {
+        std::make_tuple(7,         3,      def::ADD_REG, 10),
+        std::make_tuple(9,         5,      def::SUB_REG, 4),
+        std::make_tuple(3,         5,      def::MUL_REG, 15),
+        std::make_tuple(9,         3,      def::DIV_REG, 3),
+        std::make_tuple(16384,     32006,  def::SUB_REG, -15622),
+        std::make_tuple(-1,        1,      def::ADD_REG, 0)
+    };
+
+    ExecutionContext context(registries, mem.getMemory());
+    for (auto& test : tests)
+    {
+        auto [a, b, instruction, expected] = test;
+        uint8_t program[] = { +instruction, +registers::def::r0, +registers::def::r1 };
+        mem.load(program, sizeof(program));
+        registries[+registers::def::pc] = registries[+registers::def::bp];
+        registries[+registers::def::r0] = static_cast<uint16_t>(a);
+        registries[+registers::def::r1] = static_cast<uint16_t>(b);
+
+        instruction::handlers[instruction](context);
+        EXPECT_EQ(i16(registries[+registers::def::r0]), expected);
+        EXPECT_EQ(i16(registries[+registers::def::r1]), b);
+        // left on the last operand byte.
+        EXPECT_EQ(registries[+registers::def::bp] + 2, registries[+registers::def::pc]);
+    }
+}
+
+TEST_F(InstructionsTest, DivisionHandlers_ZeroDivisorTraps)
+{
+    ExecutionContext context(registries, mem.getMemory());
+    for (instruction::def instruction : { instruction::def::DIV, instruction::def::DIV_REG })
+    {
+        uint8_t program[] = { +instruction, +registers::def::r0, +registers::def::r1 };
+        mem.load(program, sizeof(program));
+        uint16_t sp = registries[+registers::def::sp];
+        push_helper(context, 7);
+        push_helper(context, 0);
+        context.trap = trap_code::none;
+        registries[+registers::def::pc] = registries[+registers::def::bp];
+        registries[+registers::def::r0] = 7;
+        registries[+registers::def::r1] = 0;
+
+        instruction::handlers[instruction](context);
+        EXPECT_EQ(trap_code::division_by_zero, context.trap);
+        EXPECT_EQ(7, i16(registries[+registers::def::r0]));
+        EXPECT_EQ(sp + 4, registries[+registers::def::sp]);
+        // on the opcode once the dispatch loop advances pc.
+        EXPECT_EQ(registries[+registers::def::bp], registries[+registers::def::pc] + 1);
+        registries[+registers::def::sp] = sp;
+    }
+}
+
+TEST_F(InstructionsTest, RegisterBinaryExpression_ImmAsOperand)
+{
+    uint8_t program[] = {
+        +instruction::def::PSH_LIT, 0, 6,
+        +instruction::def::POP_REG, +registers::def::imm,
+        +instruction::def::PSH_LIT, 0, 7,
+        +instruction::def::POP_REG, +registers::def::r2,
+        +instruction::def::MUL_REG, +registers::def::r2, +registers::def::imm,
+    };
+
+    mem.load(program, sizeof(program));
+    ExecutionContext context(registries, mem.getMemory());
+
+    uint16_t& pc = registries[+registers::def::pc];
+    for (int i = 0; i < 5; i++)
+    {
+        instruction::handlers[context.bytecode[pc]](context);
+        pc++;
+    }
+
+    EXPECT_EQ(42, i16(context.registry[+registers::def::r2]));
+}
+
 TEST_F(InstructionsTest, PopReg_ExpectValueInReturnRegister)
 {
     uint8_t program[] = {
@@ -322,6 +400,53 @@ TEST_F(InstructionsTest, MoveHandler_RegToReg)
     EXPECT_EQ(value, 42);
 }
 
+TEST_F(InstructionsTest, PutHandlers_LiteralThroughImm)
+{
+    uint8_t program[] = {
+        +instruction::def::PUT_LIT, 0xFE, 0xD4,
+        +instruction::def::PUT_REG, +registers::def::r3,
+    };
+
+    mem.load(program, sizeof(program));
+    ExecutionContext context(registries, mem.getMemory());
+
+    uint16_t& pc = registries[+registers::def::pc];
+    for (int i = 0; i < 2; i++)
+    {
+        instruction::handlers[context.bytecode[pc]](context);
+        pc++;
+    }
+
+    EXPECT_EQ(i16(context.registry[+registers::def::imm]), -300);
+    EXPECT_EQ(i16(context.registry[+registers::def::r3]), -300);
+    EXPECT_EQ(registries[+registers::def::bp] + sizeof(program), pc);
+}
+
+TEST_F(InstructionsTest, MemoryHandlers_StoreAndPush)
+{
+    uint16_t address = static_cast<uint16_t>(registries[+registers::def::bp] + 32);
+    uint8_t program[] = {
+        +instruction::def::PUT_LIT, 0x12, 0x34,
+        +instruction::def::MOV_MEM, 0, u8(address),
+        +instruction::def::PSH_MEM, 0, u8(address),
+    };
+
+    mem.load(program, sizeof(program));
+    ExecutionContext context(registries, mem.getMemory());
+
+    uint16_t& pc = registries[+registers::def::pc];
+    for (int i = 0; i < 3; i++)
+    {
+        instruction::handlers[context.bytecode[pc]](context);
+        pc++;
+    }
+
+    // memory words are in stack order.
+    EXPECT_EQ(0x34, context.bytecode[address]);
+    EXPECT_EQ(0x12, context.bytecode[address + 1]);
+    EXPECT_EQ(0x1234, pop_helper(context));
+}
+
 TEST_F(InstructionsTest, CompareHandler_Stack_ResultInImm)
 {
     uint8_t program[] = {
@@ -345,4 +470,77 @@ TEST_F(InstructionsTest, CompareHandler_Stack_ResultInImm)
 
     EXPECT_EQ(instruction, instruction::def::CMP);
     EXPECT_EQ(context.registry[+registers::def::imm], 0);
-}
\ No newline at end of file
+}
+TEST_F(InstructionsTest, CallAndReturnHandlers_Frame)
+{
+    uint8_t program[] = {
+        +instruction::def::PSH_LIT, 0, 9,
+        +instruction::def::CALL, 0, 7,     // to the PSH_LIT below
+        +instruction::def::RET,
+        +instruction::def::PSH_LIT, 0, 1,
+        +instruction::def::RET,
+    };
+
+    mem.load(program, sizeof(program));
+    ExecutionContext context(registries, mem.getMemory());
+
+    uint16_t bp = registries[+registers::def::bp];
+    uint16_t& pc = registries[+registers::def::pc];
+    uint16_t stack = registries[+registers::def::sp];
+    for (int i = 0; i < 2; i++)
+    {
+        instruction::handlers[context.bytecode[pc]](context);
+        pc++;
+    }
+
+    // return address and the caller's fp on top of its stack, the callee's fp above them.
+    EXPECT_EQ(bp + 7, pc);
+    EXPECT_EQ(1, registries[+registers::def::cd]);
+    EXPECT_EQ(stack + 6, registries[+registers::def::fp]);
+    EXPECT_EQ(stack + 6, registries[+registers::def::sp]);
+    EXPECT_EQ(bp + 6, u16(peek_word(context.bytecode, static_cast<int16_t>(stack + 4))));
+    EXPECT_EQ(stack, u16(peek_word(context.bytecode, static_cast<int16_t>(stack + 6))));
+
+    for (int i = 0; i < 2; i++)
+    {
+        instruction::handlers[context.bytecode[pc]](context);
+        pc++;
+    }
+
+    EXPECT_EQ(bp + 6, pc);
+    EXPECT_EQ(0, registries[+registers::def::cd]);
+    EXPECT_EQ(stack, registries[+registers::def::fp]);
+    EXPECT_EQ(stack + 2, registries[+registers::def::sp]);
+    EXPECT_EQ(9, pop_helper(context));
+}
+
+TEST_F(InstructionsTest, PeekArgumentHandler_UnderFrame)
+{
+    uint8_t program[] = {
+        +instruction::def::PSH_LIT, 0, 4,
+        +instruction::def::PSH_LIT, 0, 9,
+        +instruction::def::CALL, 0, 10,    // to the PEK_ARG below
+        +instruction::def::RET,
+        +instruction::def::PEK_ARG, +registers::def::r0, 0,
+        +instruction::def::PEK_ARG, +registers::def::sp, 1,
+        +instruction::def::RET,
+    };
+
+    mem.load(program, sizeof(program));
+    ExecutionContext context(registries, mem.getMemory());
+
+    uint16_t& pc = registries[+registers::def::pc];
+    uint16_t fp = 0;
+    for (int i = 0; i < 5; i++)
+    {
+        instruction::handlers[context.bytecode[pc]](context);
+        pc++;
+        if (i == 2)
+            fp = registries[+registers::def::fp];
+    }
+
+    // the argument pushed last is the first one under the return address.
+    EXPECT_EQ(9, registries[+registers::def::r0]);
+    EXPECT_EQ(fp + 2, registries[+registers::def::sp]);
+    EXPECT_EQ(4, pop_helper(context));
+}
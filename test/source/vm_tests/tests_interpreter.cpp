@@ -0,0 +1,264 @@
+#include <gtest/gtest.h>
+
+#include <decoder.hpp>
+#include <interpreter.hpp>
+#include <memory.hpp>
+#include <shared_defines.hpp>
+
+using namespace ciph;
+
+using engine = int16_t (*)(ExecutionContext&, const decoded_program&);
+
+namespace {
+
+// The checked engine bounded by the fixture's memory, every test below has to behave the same on it.
+int16_t
+run_checked(ExecutionContext& context, const decoded_program& program) {
+    return interpreter::run_checked(context, program, 0x100);
+}
+
+} // namespace
+
+class InterpreterTest : public ::testing::TestWithParam<engine>
+{
+protected:
+    int16_t run(uint8_t* program, uint16_t size)
+    {
+        uint16_t* registries = mem.allocate(static_cast<uint16_t>(registers::def::reg_cnt));
+        uint16_t addrs = mem.load(program, size);
+        registries[+registers::def::pc] = addrs;
+        registries[+registers::def::bp] = addrs;
+        uint16_t stackAddrs = static_cast<uint16_t>(addrs + size + (size % 2));
+        registries[+registers::def::sp] = stackAddrs;
+        registries[+registers::def::fp] = stackAddrs;
+
+        context = ExecutionContext(registries, mem.getMemory());
+        decoded = decoder::decode(program, size, addrs);
+        return GetParam()(context, decoded);
+    }
+
+    Memory mem{ 0x100 };
+    ExecutionContext context;
+    decoded_program decoded;
+};
+
+TEST_P(InterpreterTest, While_Returns10)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::INC, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PSH_LIT, 0, 10,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
+                            +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                            +instruction::def::RET
+                            };
+
+    EXPECT_EQ(10, run(program, sizeof(program)));
+    EXPECT_EQ(trap_code::none, context.trap);
+}
+
+TEST_P(InterpreterTest, UnknownOpcode_Traps)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 7,
+                            0xEE,
+                            +instruction::def::RET
+                            };
+
+    run(program, sizeof(program));
+    EXPECT_EQ(trap_code::invalid_instruction, context.trap);
+    EXPECT_EQ(context.registry[+registers::def::bp] + 3, context.registry[+registers::def::pc]);
+}
+
+TEST_P(InterpreterTest, BranchIntoOperand_Traps)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 1,
+                            +instruction::def::PSH_LIT, 0, 2,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x09, // lands on the operand of the first PSH_LIT
+                            +instruction::def::RET
+                            };
+
+    run(program, sizeof(program));
+    EXPECT_EQ(trap_code::invalid_instruction, context.trap);
+    EXPECT_EQ(context.registry[+registers::def::bp] + 8, context.registry[+registers::def::pc]);
+}
+
+TEST_P(InterpreterTest, RegisterArithmetic)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 20,
+                            +instruction::def::POP_REG, +registers::def::r0,
+                            +instruction::def::PSH_LIT, 0, 3,
+                            +instruction::def::POP_REG, +registers::def::r1,
+                            +instruction::def::MUL_REG, +registers::def::r0, +registers::def::r1,   // 60
+                            +instruction::def::SUB_REG, +registers::def::r0, +registers::def::r1,   // 57
+                            +instruction::def::DIV_REG, +registers::def::r0, +registers::def::r1,   // 19
+                            +instruction::def::ADD_REG, +registers::def::r0, +registers::def::r0,   // 38
+                            +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                            +instruction::def::RET
+                            };
+
+    EXPECT_EQ(38, run(program, sizeof(program)));
+    EXPECT_EQ(trap_code::none, context.trap);
+}
+
+TEST_P(InterpreterTest, RegisterFile_WrittenBack)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 5,
+                            +instruction::def::PSH_LIT, 0, 6,
+                            +instruction::def::MOV, +registers::def::r0, +registers::def::sp,
+                            +instruction::def::MOV, +registers::def::fp, +registers::def::sp,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::PSH_REG, +registers::def::fp,
+                            +instruction::def::POP_REG, +registers::def::r1,
+                            +instruction::def::RET
+                            };
+
+    EXPECT_EQ(6, run(program, sizeof(program)));
+    uint16_t stack = static_cast<uint16_t>(context.registry[+registers::def::bp] + sizeof(program) + (sizeof(program) % 2));
+    EXPECT_EQ(stack + 4, context.registry[+registers::def::r0]);
+    EXPECT_EQ(stack + 4, context.registry[+registers::def::r1]);
+    EXPECT_EQ(stack + 4, context.registry[+registers::def::fp]);
+    EXPECT_EQ(stack + 4, context.registry[+registers::def::sp]);
+    EXPECT_EQ(stack + 4, context.registry[+registers::def::pc]);
+}
+
+TEST_P(InterpreterTest, TopOfStack_VisibleToStackAccess)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 4,
+                            +instruction::def::INC, +registers::def::sp, 0,     // slot 0 is the top of the stack
+                            +instruction::def::PEK_REG, +registers::def::r0,
+                            +instruction::def::PSH_LIT, 0, 9,
+                            +instruction::def::PEK_OFF, +registers::def::r1, 0,
+                            +instruction::def::PEK_OFF, +registers::def::r2, 1,
+                            +instruction::def::POP_REG, +registers::def::r3,
+                            +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                            +instruction::def::RET
+                            };
+
+    EXPECT_EQ(5, run(program, sizeof(program)));
+    EXPECT_EQ(5, context.registry[+registers::def::r1]);
+    EXPECT_EQ(9, context.registry[+registers::def::r2]);
+    EXPECT_EQ(9, context.registry[+registers::def::r3]);
+
+    // slot 0 is still below sp once the program returns and has to be in memory.
+    uint16_t stack = context.registry[+registers::def::fp];
+    EXPECT_EQ(5, context.bytecode[stack] | (context.bytecode[stack + 1] << 8));
+}
+
+TEST_P(InterpreterTest, Call_ReturnsPastCall)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 3,
+                            +instruction::def::CALL, 0x00, 0x0A,
+                            +instruction::def::POP_REG, +registers::def::r0,
+                            +instruction::def::RET,
+                            0xEE,                                               // never reached
+                            +instruction::def::PSH_LIT, 0, 8,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    EXPECT_EQ(8, run(program, sizeof(program)));
+    EXPECT_EQ(trap_code::none, context.trap);
+    EXPECT_EQ(3, context.registry[+registers::def::r0]);
+    EXPECT_EQ(0, context.registry[+registers::def::cd]);
+    uint16_t stack = static_cast<uint16_t>(context.registry[+registers::def::bp] + sizeof(program) + (sizeof(program) % 2));
+    EXPECT_EQ(stack, context.registry[+registers::def::fp]);
+    EXPECT_EQ(stack, context.registry[+registers::def::sp]);
+}
+
+TEST_P(InterpreterTest, Call_ArgumentsUnderFrame)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 7,
+                            +instruction::def::PSH_LIT, 0, 3,
+                            +instruction::def::CALL, 0x00, 0x0E,
+                            +instruction::def::POP_REG, +registers::def::imm,
+                            +instruction::def::POP_REG, +registers::def::imm,
+                            +instruction::def::RET,
+                            +instruction::def::PEK_ARG, +registers::def::ret, 1,    // pushed first, deepest
+                            +instruction::def::PEK_ARG, +registers::def::r0, 0,
+                            +instruction::def::SUB_REG, +registers::def::ret, +registers::def::r0,
+                            +instruction::def::RET
+                            };
+
+    EXPECT_EQ(4, run(program, sizeof(program)));
+    EXPECT_EQ(trap_code::none, context.trap);
+    uint16_t stack = static_cast<uint16_t>(context.registry[+registers::def::bp] + sizeof(program) + (sizeof(program) % 2));
+    EXPECT_EQ(stack, context.registry[+registers::def::sp]);
+}
+
+TEST_P(InterpreterTest, ReturnAddressOverwritten_Traps)
+{
+    uint8_t program[] = {   +instruction::def::CALL, 0x00, 0x04,
+                            +instruction::def::RET,
+                            +instruction::def::PUT_LIT, 0x00, 0x21,             // into the operand of the CALL
+                            +instruction::def::MOV_MEM, 0x00, 0x2C,             // the return address, at the bottom of the stack
+                            +instruction::def::RET
+                            };
+
+    run(program, sizeof(program));
+    EXPECT_EQ(trap_code::invalid_instruction, context.trap);
+    EXPECT_EQ(context.registry[+registers::def::bp] + 10, context.registry[+registers::def::pc]);
+}
+
+TEST_P(InterpreterTest, DivByZero_Traps)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 7,
+                            +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::DIV,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    run(program, sizeof(program));
+    EXPECT_EQ(trap_code::division_by_zero, context.trap);
+    EXPECT_EQ(context.registry[+registers::def::bp] + 6, context.registry[+registers::def::pc]);
+    // both operands are still on the stack.
+    uint16_t stack = static_cast<uint16_t>(context.registry[+registers::def::bp] + sizeof(program) + (sizeof(program) % 2));
+    EXPECT_EQ(stack + 4, context.registry[+registers::def::sp]);
+    EXPECT_EQ(0, context.registry[+registers::def::ret]);
+}
+
+TEST_P(InterpreterTest, DivRegByZero_Traps)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 7,
+                            +instruction::def::POP_REG, +registers::def::r0,
+                            +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::POP_REG, +registers::def::r1,
+                            +instruction::def::DIV_REG, +registers::def::r0, +registers::def::r1,
+                            +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                            +instruction::def::RET
+                            };
+
+    run(program, sizeof(program));
+    EXPECT_EQ(trap_code::division_by_zero, context.trap);
+    EXPECT_EQ(context.registry[+registers::def::bp] + 10, context.registry[+registers::def::pc]);
+    EXPECT_EQ(7, context.registry[+registers::def::r0]);
+}
+
+TEST_P(InterpreterTest, DivOffByZero_Traps)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 9,
+                            +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,    // fused into DIV_OFF
+                            +instruction::def::PEK_OFF, +registers::def::sp, 1,
+                            +instruction::def::DIV,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    run(program, sizeof(program));
+    EXPECT_EQ(trap_code::division_by_zero, context.trap);
+    EXPECT_EQ(context.registry[+registers::def::bp] + 6, context.registry[+registers::def::pc]);
+    uint16_t stack = static_cast<uint16_t>(context.registry[+registers::def::bp] + sizeof(program) + (sizeof(program) % 2));
+    EXPECT_EQ(stack + 4, context.registry[+registers::def::sp]);
+}
+
+#if CIPH_HAS_COMPUTED_GOTO
+INSTANTIATE_TEST_SUITE_P(Engines, InterpreterTest,
+                         ::testing::Values(interpreter::run_table, interpreter::run_switch, interpreter::run_threaded,
+                                           run_checked));
+#else
+INSTANTIATE_TEST_SUITE_P(Engines, InterpreterTest,
+                         ::testing::Values(interpreter::run_table, interpreter::run_switch, run_checked));
+#endif
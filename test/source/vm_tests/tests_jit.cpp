@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include <jit.hpp>
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+
+#include "program_corpus.hpp"
+
+using namespace ciph;
+
+namespace {
+
+struct run_result {
+    int16_t return_value = 0;
+    trap_code trap = trap_code::none;
+    std::vector<uint16_t> registers;
+};
+
+run_result
+run_program(std::vector<uint8_t> bytes, execution_mode mode) {
+    ProcessingUnit unit;
+    unit.set_execution_mode(mode);
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+
+    run_result result;
+    result.return_value = unit.execute();
+    result.trap = unit.context().trap;
+    uint16_t* registries = unit.registries();
+    result.registers.assign(registries, registries + +registers::def::reg_cnt);
+    return result;
+}
+
+const std::vector<uint8_t>&
+corpus_bytes(const std::string& name) {
+    for (const test::corpus_program& program : test::program_corpus()) {
+        if (program.name == name)
+            return program.bytes;
+    }
+    throw std::out_of_range(name);
+}
+
+} // namespace
+
+class JitDifferentialTest : public ::testing::TestWithParam<test::corpus_program>
+{
+};
+
+TEST_P(JitDifferentialTest, MatchesInterpreter)
+{
+    run_result interpreted = run_program(GetParam().bytes, execution_mode::interpreter);
+    run_result compiled = run_program(GetParam().bytes, execution_mode::jit);
+
+    EXPECT_EQ(interpreted.return_value, compiled.return_value);
+    EXPECT_EQ(interpreted.trap, compiled.trap);
+    for (uint8_t reg = 0; reg < +registers::def::reg_cnt; reg++)
+        EXPECT_EQ(interpreted.registers[reg], compiled.registers[reg]) << "register " << int(reg);
+}
+
+INSTANTIATE_TEST_SUITE_P(Corpus, JitDifferentialTest, ::testing::ValuesIn(test::program_corpus()),
+                         test::corpus_name());
+
+#if CIPH_HAS_JIT
+TEST(JitTest, Compile_WholeProgramNative)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 26,
+                            +instruction::def::PSH_LIT, 0, 16,
+                            +instruction::def::ADD,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    EXPECT_TRUE(unit.native().empty());
+
+    unit.set_execution_mode(execution_mode::jit);
+    ASSERT_FALSE(unit.native().empty());
+    EXPECT_EQ(unit.program().instructions.size(), unit.native().entry.size());
+    EXPECT_EQ(0, unit.native().fallbacks);
+    EXPECT_EQ(42, unit.execute());
+}
+
+TEST(JitTest, ProgramCounterAccess_FallsBack)
+{
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 9,
+                            +instruction::def::POP_REG, +registers::def::pc,
+                            +instruction::def::PSH_LIT, 0, 4,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.set_execution_mode(execution_mode::jit);
+    unit.load_program(program, sizeof(program));
+
+    EXPECT_EQ(1, unit.native().fallbacks);
+    EXPECT_EQ(4, unit.execute());
+    EXPECT_EQ(trap_code::none, unit.context().trap);
+}
+
+TEST(JitTest, DivisionByZero_Traps)
+{
+    // DIV, DIV_OFF once fused and DIV_REG, each with a zero divisor.
+    std::vector<std::vector<uint8_t>> programs = {
+        {   +instruction::def::PSH_LIT, 0, 7,
+            +instruction::def::PSH_LIT, 0, 0,
+            +instruction::def::DIV,
+            +instruction::def::POP_REG, +registers::def::ret,
+            +instruction::def::RET },
+        {   +instruction::def::PSH_LIT, 0, 7,
+            +instruction::def::PSH_LIT, 0, 0,
+            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+            +instruction::def::PEK_OFF, +registers::def::sp, 1,
+            +instruction::def::DIV,
+            +instruction::def::POP_REG, +registers::def::ret,
+            +instruction::def::RET },
+        {   +instruction::def::PSH_LIT, 0, 7,
+            +instruction::def::POP_REG, +registers::def::r0,
+            +instruction::def::PSH_LIT, 0, 0,
+            +instruction::def::POP_REG, +registers::def::r1,
+            +instruction::def::DIV_REG, +registers::def::r0, +registers::def::r1,
+            +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+            +instruction::def::RET } };
+    const uint16_t faulting[] = { 6, 6, 10 };
+
+    for (size_t index = 0; index < programs.size(); index++) {
+        std::vector<uint8_t>& program = programs[index];
+        ProcessingUnit unit;
+        unit.set_execution_mode(execution_mode::jit);
+        unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+        EXPECT_EQ(0, unit.native().fallbacks);
+
+        unit.execute();
+        EXPECT_EQ(trap_code::division_by_zero, unit.context().trap) << "program " << index;
+        EXPECT_EQ(unit.registries()[+registers::def::bp] + faulting[index], unit.registries()[+registers::def::pc])
+            << "program " << index;
+    }
+}
+
+TEST(JitTest, DivisorExit_LandsOnTrap)
+{
+    const std::vector<uint8_t>& program = corpus_bytes("DivByZero_InLoop");
+
+    ProcessingUnit unit;
+    unit.set_execution_mode(execution_mode::jit);
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    ASSERT_EQ(0, unit.native().fallbacks);
+
+    unit.execute();
+    EXPECT_EQ(trap_code::division_by_zero, unit.context().trap);
+    EXPECT_EQ(60, unit.registries()[+registers::def::ret]);
+    EXPECT_EQ(unit.registries()[+registers::def::bp] + 9, unit.registries()[+registers::def::pc]);
+}
+
+TEST(JitTest, Recursion_RunsNative)
+{
+    const std::vector<uint8_t>& program = corpus_bytes("Recursion_Fib");
+
+    ProcessingUnit unit;
+    unit.set_execution_mode(execution_mode::jit);
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    ASSERT_EQ(0, unit.native().fallbacks);
+
+    // recursion has no bounded extent, execute() would take the checked engine, so run the code directly.
+    ExecutionContext context = unit.context();
+    EXPECT_EQ(55, jit::run(context, unit.program(), unit.native()));
+    EXPECT_EQ(trap_code::none, context.trap);
+    EXPECT_EQ(0, unit.registries()[+registers::def::cd]);
+}
+#endif
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <memory.hpp>
+#include <memory_pool.hpp>
+
+using namespace ciph;
+
+namespace {
+
+// Restores the limit a test changed, the free lists are per thread and outlive the test.
+class MemoryPoolTest : public ::testing::Test
+{
+protected:
+    void SetUp() override {
+        m_limit = memory_pool::cache_limit();
+        memory_pool::set_cache_limit(32);
+    }
+
+    void TearDown() override {
+        memory_pool::set_cache_limit(m_limit);
+    }
+
+    size_t m_limit = 0;
+};
+
+} // namespace
+
+TEST_F(MemoryPoolTest, Release_BlockReused)
+{
+    uint8_t* first = memory_pool::acquire(0x1000);
+    memory_pool::release(first, 0x1000);
+    memory_pool::stats before = memory_pool::thread_stats();
+
+    uint8_t* second = memory_pool::acquire(0x1000);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(before.hits + 1, memory_pool::thread_stats().hits);
+    memory_pool::release(second, 0x1000);
+}
+
+// Sizes share a block when they round up to the same power of two.
+TEST_F(MemoryPoolTest, SizeClasses_RoundUp)
+{
+    uint8_t* block = memory_pool::acquire(0x900);
+    memory_pool::release(block, 0x900);
+    uint8_t* again = memory_pool::acquire(0xC00);
+    EXPECT_EQ(block, again);
+    memory_pool::release(again, 0xC00);
+
+    uint8_t* other = memory_pool::acquire(0x100);
+    EXPECT_NE(block, other);
+    memory_pool::release(other, 0x100);
+}
+
+TEST_F(MemoryPoolTest, ZeroLimit_NothingCached)
+{
+    memory_pool::set_cache_limit(0);
+    EXPECT_EQ(0u, memory_pool::thread_stats().cached);
+
+    memory_pool::stats before = memory_pool::thread_stats();
+    memory_pool::release(memory_pool::acquire(0x1000), 0x1000);
+    memory_pool::release(memory_pool::acquire(0x1000), 0x1000);
+    EXPECT_EQ(before.misses + 2, memory_pool::thread_stats().misses);
+    EXPECT_EQ(0u, memory_pool::thread_stats().cached);
+}
+
+TEST_F(MemoryPoolTest, Memory_ZeroesOnlyAllocated)
+{
+    {
+        Memory memory(0x1000);
+        std::fill_n(memory.getMemory(), 0x1000, uint8_t(0xAB));
+    }
+    Memory memory(0x1000);
+    uint16_t* registers = memory.allocate(16);
+    for (size_t reg = 0; reg < 16; reg++)
+        EXPECT_EQ(0, registers[reg]);
+}
+
+// Each thread has its own free lists, a block released on another thread is cached there.
+TEST_F(MemoryPoolTest, Threads_OwnFreeLists)
+{
+    uint8_t* block = memory_pool::acquire(0x2000);
+    size_t cachedHere = memory_pool::thread_stats().cached;
+    size_t cachedThere = 0;
+    std::thread other([block, &cachedThere] {
+        memory_pool::release(block, 0x2000);
+        cachedThere = memory_pool::thread_stats().cached;
+    });
+    other.join();
+
+    EXPECT_EQ(1u, cachedThere);
+    EXPECT_EQ(cachedHere, memory_pool::thread_stats().cached);
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+
+#include "program_corpus.hpp"
+
+using namespace ciph;
+
+namespace {
+
+std::vector<uint8_t>
+while_program() {
+    return { +instruction::def::PSH_LIT, 0, 0,
+             +instruction::def::INC, +registers::def::sp, 0,
+             +instruction::def::PEK_OFF, +registers::def::sp, 0,
+             +instruction::def::PSH_LIT, 0, 10,
+             +instruction::def::CMP, +registers::def::sp,
+             +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
+             +instruction::def::PEK_OFF, +registers::def::ret, 0,
+             +instruction::def::RET };
+}
+
+} // namespace
+
+class MeteringDifferentialTest : public ::testing::TestWithParam<test::corpus_program>
+{
+};
+
+// Runs each program in slices no bigger than its largest block, resuming until it ends.
+TEST_P(MeteringDifferentialTest, SlicedMatchesUnbounded)
+{
+    std::vector<uint8_t> bytes = GetParam().bytes;
+    ProcessingUnit reference;
+    reference.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    int16_t expected = reference.execute();
+
+    ProcessingUnit unit;
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    uint32_t slice = unit.largest_block();
+
+    run_status status = run_status::out_of_fuel;
+    for (int slices = 0; slices < 100000 && status == run_status::out_of_fuel; slices++)
+        status = unit.execute(slice);
+
+    EXPECT_EQ(reference.context().trap == trap_code::none ? run_status::completed : run_status::trapped, status);
+    EXPECT_EQ(expected, unit.context().return_value);
+    EXPECT_EQ(reference.context().trap, unit.context().trap);
+    for (uint8_t reg = 0; reg < +registers::def::reg_cnt; reg++)
+        EXPECT_EQ(reference.registries()[reg], unit.registries()[reg]) << "register " << int(reg);
+}
+
+INSTANTIATE_TEST_SUITE_P(Corpus, MeteringDifferentialTest, ::testing::ValuesIn(test::program_corpus()),
+                         test::corpus_name());
+
+TEST(MeteringTest, ExactBudget_Completes)
+{
+    // entry block of 3, nine taken back-edges into a block of 2 and the exit block of 2.
+    std::vector<uint8_t> program = while_program();
+    ProcessingUnit unit;
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    EXPECT_EQ(run_status::completed, unit.execute(23));
+    EXPECT_EQ(0u, unit.fuel());
+    EXPECT_EQ(10, unit.context().return_value);
+}
+
+TEST(MeteringTest, ShortBudget_StopsOnBlockBoundary)
+{
+    std::vector<uint8_t> program = while_program();
+    ProcessingUnit unit;
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    EXPECT_EQ(run_status::out_of_fuel, unit.execute(22));
+    EXPECT_EQ(1u, unit.fuel());
+    // the exit block didn't fit, pc is left on the PEK_OFF after the loop.
+    EXPECT_EQ(unit.registries()[+registers::def::bp] + 17, unit.registries()[+registers::def::pc]);
+
+    EXPECT_EQ(run_status::completed, unit.execute(2));
+    EXPECT_EQ(10, unit.context().return_value);
+}
+
+TEST(MeteringTest, BudgetBelowBlock_MakesNoProgress)
+{
+    std::vector<uint8_t> program = while_program();
+    ProcessingUnit unit;
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    uint16_t entry = unit.registries()[+registers::def::pc];
+    ASSERT_EQ(3u, unit.largest_block());
+
+    EXPECT_EQ(run_status::out_of_fuel, unit.execute(2));
+    EXPECT_EQ(2u, unit.fuel());
+    EXPECT_EQ(entry, unit.registries()[+registers::def::pc]);
+    EXPECT_EQ(trap_code::none, unit.context().trap);
+}
+
+TEST(MeteringTest, Resume_AcrossManySlices)
+{
+    std::vector<uint8_t> program = while_program();
+    ProcessingUnit unit;
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    int slices = 1;
+    run_status status = unit.execute(3);
+    while (status == run_status::out_of_fuel) {
+        status = unit.execute(2);
+        slices++;
+    }
+    EXPECT_EQ(run_status::completed, status);
+    EXPECT_EQ(11, slices);
+    EXPECT_EQ(10, unit.context().return_value);
+}
+
+TEST(MeteringTest, UnknownOpcode_Trapped)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 7,
+                                     0xEE,
+                                     +instruction::def::RET };
+    ProcessingUnit unit;
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    EXPECT_EQ(run_status::trapped, unit.execute(100));
+    EXPECT_EQ(trap_code::invalid_instruction, unit.context().trap);
+    EXPECT_EQ(unit.registries()[+registers::def::bp] + 3, unit.registries()[+registers::def::pc]);
+}
+
+TEST(MeteringTest, DivisionByZero_Trapped)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 9,
+                                     +instruction::def::POP_REG, +registers::def::r0,
+                                     +instruction::def::DIV_REG, +registers::def::r0, +registers::def::r1,
+                                     +instruction::def::MOV, +registers::def::ret, +registers::def::r0,
+                                     +instruction::def::RET };
+    ProcessingUnit unit;
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    EXPECT_EQ(run_status::trapped, unit.execute(100));
+    EXPECT_EQ(trap_code::division_by_zero, unit.context().trap);
+    EXPECT_EQ(unit.registries()[+registers::def::bp] + 5, unit.registries()[+registers::def::pc]);
+}
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+#include <vm_pool.hpp>
+
+#include "program_corpus.hpp"
+
+using namespace ciph;
+
+namespace {
+
+/*
+ * let i = 0
+ * while (i < r0) {
+ *     i++
+ * }
+ * return i */
+std::shared_ptr<const std::vector<uint8_t>>
+input_loop() {
+    return std::make_shared<const std::vector<uint8_t>>(std::vector<uint8_t>{
+        +instruction::def::PSH_LIT, 0, 0,
+        +instruction::def::INC, +registers::def::sp, 0,
+        +instruction::def::PEK_OFF, +registers::def::sp, 0,
+        +instruction::def::PSH_REG, +registers::def::r0,
+        +instruction::def::CMP, +registers::def::sp,
+        +instruction::def::JLT, 0x00, 0x0D, // jump back thirteen bytes
+        +instruction::def::PEK_OFF, +registers::def::ret, 0,
+        +instruction::def::RET });
+}
+
+// Two entry points, returns 1 from offset 0 and 2 from offset 7.
+std::shared_ptr<const std::vector<uint8_t>>
+two_entries() {
+    return std::make_shared<const std::vector<uint8_t>>(std::vector<uint8_t>{
+        +instruction::def::PSH_LIT, 0, 1,
+        +instruction::def::PEK_OFF, +registers::def::ret, 0,
+        +instruction::def::RET,
+        +instruction::def::PSH_LIT, 0, 2,
+        +instruction::def::PEK_OFF, +registers::def::ret, 0,
+        +instruction::def::RET });
+}
+
+pool::job
+make_job(std::shared_ptr<const std::vector<uint8_t>> program, int16_t r0, uint16_t entry = 0) {
+    pool::job result;
+    result.program = std::move(program);
+    result.entry = entry;
+    result.inputs[0] = r0;
+    return result;
+}
+
+} // namespace
+
+TEST(VmPoolTest, Run_EveryJobOwnResult)
+{
+    VmPool pool(4);
+    auto program = input_loop();
+    std::vector<pool::job> jobs;
+    for (int16_t index = 0; index < 500; index++)
+        jobs.push_back(make_job(program, index % 37));
+
+    std::vector<pool::job_result> results = pool.run(jobs);
+
+    ASSERT_EQ(jobs.size(), results.size());
+    for (size_t index = 0; index < results.size(); index++) {
+        EXPECT_EQ(static_cast<int16_t>(std::max(1, static_cast<int>(index % 37))), results[index].return_value) << "job " << index;
+        EXPECT_EQ(trap_code::none, results[index].trap);
+    }
+}
+
+// Workers switching between programs decode again, results don't leak from one program to the next.
+TEST(VmPoolTest, Run_MixedPrograms)
+{
+    VmPool pool(3);
+    auto loop = input_loop();
+    auto entries = two_entries();
+    std::vector<pool::job> jobs;
+    for (int16_t index = 0; index < 300; index++) {
+        if (index % 3 == 0)
+            jobs.push_back(make_job(entries, 0, index % 2 == 0 ? 0 : 7));
+        else
+            jobs.push_back(make_job(loop, 5));
+    }
+
+    std::vector<pool::job_result> results = pool.run(jobs);
+
+    for (size_t index = 0; index < results.size(); index++) {
+        int16_t expected = index % 3 != 0 ? 5 : (index % 2 == 0 ? 1 : 2);
+        EXPECT_EQ(expected, results[index].return_value) << "job " << index;
+    }
+}
+
+TEST(VmPoolTest, Submit_FutureHoldsResult)
+{
+    VmPool pool(2);
+    std::future<pool::job_result> result = pool.submit(make_job(input_loop(), 12));
+    EXPECT_EQ(12, result.get().return_value);
+}
+
+TEST(VmPoolTest, Submit_EntryOffset)
+{
+    VmPool pool(1);
+    auto program = two_entries();
+    EXPECT_EQ(1, pool.submit(make_job(program, 0, 0)).get().return_value);
+    EXPECT_EQ(2, pool.submit(make_job(program, 0, 7)).get().return_value);
+}
+
+TEST(VmPoolTest, Submit_EntryInsideInstruction_Traps)
+{
+    VmPool pool(1);
+    pool::job_result result = pool.submit(make_job(two_entries(), 0, 2)).get();
+    EXPECT_EQ(trap_code::invalid_instruction, result.trap);
+
+    // the worker that trapped still runs the next job.
+    EXPECT_EQ(trap_code::none, pool.submit(make_job(two_entries(), 0, 7)).get().trap);
+}
+
+TEST(VmPoolTest, Submit_NoProgram_Traps)
+{
+    VmPool pool(1);
+    EXPECT_EQ(trap_code::invalid_instruction, pool.submit(pool::job{}).get().trap);
+}
+
+TEST(VmPoolTest, Counters_AfterWaitIdle)
+{
+    VmPool pool(4);
+    auto program = input_loop();
+    std::atomic<int> sum{ 0 };
+    for (int16_t index = 0; index < 200; index++)
+        pool.submit(make_job(program, 10), [&](const pool::job_result& result) { sum += result.return_value; });
+    pool.wait_idle();
+
+    EXPECT_EQ(2000, sum.load());
+    pool::counters counters = pool.counters();
+    EXPECT_EQ(200u, counters.submitted);
+    EXPECT_EQ(200u, counters.completed);
+    EXPECT_LE(counters.stolen, counters.completed);
+    EXPECT_LE(counters.queue_wait_max_ns, counters.queue_wait_total_ns);
+    EXPECT_GT(counters.jobs_per_second(), 0.0);
+}
+
+// Jobs a worker submits stay on its own deque and still all run.
+TEST(VmPoolTest, Submit_FromWorker)
+{
+    VmPool pool(2);
+    auto program = input_loop();
+    std::atomic<int> finished{ 0 };
+    for (int16_t index = 0; index < 10; index++) {
+        pool.submit(make_job(program, 3), [&](const pool::job_result&) {
+            pool.submit(make_job(program, 4), [&](const pool::job_result& inner) { finished += inner.return_value; });
+        });
+    }
+    // an inner job is submitted before the outer one counts as completed, so the pool can't look idle early.
+    pool.wait_idle();
+
+    EXPECT_EQ(40, finished.load());
+    EXPECT_EQ(20u, pool.counters().completed);
+}
+
+TEST(VmPoolTest, Destructor_RunsQueuedJobs)
+{
+    std::atomic<int> finished{ 0 };
+    {
+        VmPool pool(2);
+        auto program = input_loop();
+        for (int16_t index = 0; index < 50; index++)
+            pool.submit(make_job(program, 20), [&](const pool::job_result&) { finished++; });
+    }
+    EXPECT_EQ(50, finished.load());
+}
+
+class ProcessingUnitReuseTest : public ::testing::TestWithParam<test::corpus_program>
+{
+};
+
+// A restarted or reloaded unit gives the same result as a fresh one.
+TEST_P(ProcessingUnitReuseTest, RestartMatchesFresh)
+{
+    std::vector<uint8_t> bytes = GetParam().bytes;
+    ProcessingUnit fresh;
+    fresh.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    int16_t expected = fresh.execute();
+
+    ProcessingUnit unit;
+    std::vector<uint8_t> other = { +instruction::def::PSH_LIT, 0x12, 0x34, +instruction::def::RET };
+    unit.load_program(other.data(), static_cast<uint16_t>(other.size()));
+    unit.execute();
+
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+    EXPECT_EQ(expected, unit.execute());
+    unit.restart();
+    EXPECT_EQ(expected, unit.execute());
+    EXPECT_EQ(fresh.context().trap, unit.context().trap);
+    for (uint8_t reg = 0; reg < +registers::def::reg_cnt; reg++)
+        EXPECT_EQ(fresh.registries()[reg], unit.registries()[reg]) << "register " << int(reg);
+}
+
+INSTANTIATE_TEST_SUITE_P(Corpus, ProcessingUnitReuseTest, ::testing::ValuesIn(test::program_corpus()),
+                         test::corpus_name());
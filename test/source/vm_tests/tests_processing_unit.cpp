@@ -194,4 +194,231 @@ TEST(ProcessingUnitTest, While) {
 
     uint16_t result = testProcessingUnit(program, sizeof(program));
     EXPECT_EQ(result, 10);
-}
\ No newline at end of file
+}
+
+TEST(ProcessingUnitTest, UnknownOpcode_Traps) {
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 7,
+                            0xEE, // not a valid opcode
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    unit.execute();
+
+    EXPECT_EQ(trap_code::invalid_instruction, unit.context().trap);
+    uint16_t faultingPc = unit.registries()[+registers::def::bp] + 3;
+    EXPECT_EQ(faultingPc, unit.registries()[+registers::def::pc]);
+    EXPECT_EQ(0, unit.context().return_value);
+}
+
+TEST(ProcessingUnitTest, Snapshot_ForkSharesProgram) {
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::INC, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PSH_LIT, 0, 10,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
+                            +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    std::shared_ptr<const vm_snapshot> snapshot = unit.snapshot();
+    EXPECT_EQ(10, unit.execute());
+
+    for (int copy = 0; copy < 2; copy++) {
+        std::unique_ptr<ProcessingUnit> fork = ProcessingUnit::fork(*snapshot);
+        EXPECT_EQ(&unit.program(), &fork->program());
+        EXPECT_EQ(10, fork->execute());
+    }
+}
+
+TEST(ProcessingUnitTest, Snapshot_MidExecution_Resumes) {
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 0,
+                            +instruction::def::INC, +registers::def::sp, 0,
+                            +instruction::def::PEK_OFF, +registers::def::sp, 0,
+                            +instruction::def::PSH_LIT, 0, 10,
+                            +instruction::def::CMP, +registers::def::sp,
+                            +instruction::def::JLT, 0x00, 0x0E, // jump back fourteen bytes
+                            +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    ASSERT_EQ(run_status::out_of_fuel, unit.execute(10));
+    std::shared_ptr<const vm_snapshot> snapshot = unit.snapshot();
+
+    // the loop counter lives on the stack, the fork has to carry it over.
+    ProcessingUnit fork(*snapshot);
+    EXPECT_EQ(10, fork.execute());
+    EXPECT_EQ(10, unit.execute());
+    for (uint8_t reg = 0; reg < +registers::def::reg_cnt; reg++)
+        EXPECT_EQ(unit.registries()[reg], fork.registries()[reg]) << "register " << int(reg);
+}
+
+TEST(ProcessingUnitTest, Snapshot_AfterInit_RestoresState) {
+    // init: r1 = 5, main at offset 6: return r1
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 5,
+                            +instruction::def::POP_REG, +registers::def::r1,
+                            +instruction::def::RET,
+                            +instruction::def::PSH_REG, +registers::def::r1,
+                            +instruction::def::PEK_OFF, +registers::def::ret, 0,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit warm;
+    warm.load_program(program, sizeof(program));
+    warm.execute();
+    std::shared_ptr<const vm_snapshot> snapshot = warm.snapshot();
+
+    ProcessingUnit unit;
+    for (int request = 0; request < 3; request++) {
+        unit.restore(*snapshot);
+        EXPECT_EQ(5, unit.registries()[+registers::def::r1]);
+        unit.registries()[+registers::def::pc] = static_cast<uint16_t>(unit.registries()[+registers::def::bp] + 6);
+        EXPECT_EQ(5, unit.execute());
+        unit.registries()[+registers::def::r1] = 9;
+    }
+}
+
+TEST(ProcessingUnitTest, Snapshot_MemoryOperand_Carried) {
+    uint16_t stack = +registers::def::reg_cnt * 2 + 12;
+    uint16_t address = static_cast<uint16_t>(stack + 40);     // well above sp
+    uint8_t program[] = {   +instruction::def::PUT_LIT, 0x12, 0x34,
+                            +instruction::def::MOV_MEM, u8(address >> 8), u8(address & 0xFF),
+                            +instruction::def::PSH_MEM, u8(address >> 8), u8(address & 0xFF),
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+    static_assert(sizeof(program) == 12);
+
+    ProcessingUnit unit;
+    unit.load_program(program, sizeof(program));
+    ASSERT_EQ(stack, unit.layout().stack);
+    ASSERT_TRUE(unit.step());
+    ASSERT_TRUE(unit.step());
+    std::shared_ptr<const vm_snapshot> snapshot = unit.snapshot();
+
+    std::unique_ptr<ProcessingUnit> fork = ProcessingUnit::fork(*snapshot);
+    EXPECT_EQ(0x1234, unit.execute());
+    EXPECT_EQ(0x1234, fork->execute());
+}
+
+namespace {
+
+// Pushes 1 count times and returns the first slot, count * 3 bytes of code and count words of stack.
+std::vector<uint8_t> long_program(size_t count) {
+    std::vector<uint8_t> program;
+    for (size_t index = 0; index < count; index++)
+        program.insert(program.end(), { +instruction::def::PSH_LIT, 0, 1 });
+    program.insert(program.end(), { +instruction::def::PEK_OFF, +registers::def::ret, 0, +instruction::def::RET });
+    return program;
+}
+
+} // namespace
+
+TEST(ProcessingUnitTest, MemorySize_ProgramTooLarge_Traps) {
+    std::vector<uint8_t> program = long_program(1700);
+
+    ProcessingUnit unit;
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    EXPECT_EQ(trap_code::out_of_memory, unit.context().trap);
+    EXPECT_EQ(0, unit.execute());
+    EXPECT_EQ(trap_code::out_of_memory, unit.context().trap);
+    EXPECT_EQ(run_status::trapped, unit.execute(100));
+}
+
+TEST(ProcessingUnitTest, MemorySize_LargerMemory_Runs) {
+    std::vector<uint8_t> program = long_program(1700);
+
+    ProcessingUnit unit(0x4000);
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    EXPECT_EQ(0x4000u, unit.memory_size());
+    EXPECT_EQ(1, unit.execute());
+    EXPECT_EQ(trap_code::none, unit.context().trap);
+}
+
+TEST(ProcessingUnitTest, MemorySize_Clamped) {
+    EXPECT_EQ(Memory::max_size, ProcessingUnit(0x20000).memory_size());
+    EXPECT_EQ(0x100u, ProcessingUnit(0x10).memory_size());
+}
+
+TEST(ProcessingUnitTest, Layout_Segments) {
+    uint8_t program[] = {   +instruction::def::PSH_LIT, 0, 7,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit(0x800);
+    unit.load_program(program, sizeof(program));
+    const memory_layout& layout = unit.layout();
+    EXPECT_EQ(0, layout.registers);
+    EXPECT_EQ(+registers::def::reg_cnt * 2, layout.code);
+    EXPECT_EQ(layout.code + sizeof(program), layout.stack);
+    EXPECT_EQ(0x800u, layout.end);
+    EXPECT_EQ(layout.code, unit.registries()[+registers::def::bp]);
+    EXPECT_EQ(layout.stack, unit.registries()[+registers::def::fp]);
+}
+
+TEST(ProcessingUnitTest, Snapshot_LargerThanUnit_Traps) {
+    std::vector<uint8_t> program = long_program(1700);
+    ProcessingUnit large(0x4000);
+    large.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    std::shared_ptr<const vm_snapshot> snapshot = large.snapshot();
+
+    ProcessingUnit small;
+    small.restore(*snapshot);
+    EXPECT_EQ(trap_code::out_of_memory, small.context().trap);
+
+    // fork sizes the new unit like the one the snapshot came from.
+    std::unique_ptr<ProcessingUnit> fork = ProcessingUnit::fork(*snapshot);
+    EXPECT_EQ(0x4000u, fork->memory_size());
+    EXPECT_EQ(1, fork->execute());
+}
+
+TEST(ProcessingUnitTest, Reset_ReusedForAnotherProgram) {
+    std::vector<uint8_t> first = long_program(3);
+    uint8_t second[] = {    +instruction::def::PSH_LIT, 0, 7,
+                            +instruction::def::POP_REG, +registers::def::ret,
+                            +instruction::def::RET
+                            };
+
+    ProcessingUnit unit;
+    unit.load_program(first.data(), static_cast<uint16_t>(first.size()));
+    EXPECT_EQ(1, unit.execute());
+    uint8_t* memory = unit.memory();
+
+    unit.reset();
+    EXPECT_EQ(0u, unit.program().instructions.size());
+    for (uint8_t reg = 0; reg < +registers::def::reg_cnt; reg++)
+        EXPECT_EQ(0, unit.registries()[reg]) << "register " << int(reg);
+
+    unit.load_program(second, sizeof(second));
+    EXPECT_EQ(memory, unit.memory());
+    EXPECT_EQ(7, unit.execute());
+}
+
+TEST(ProcessingUnitTest, SharedImage_NotCopied) {
+    auto image = std::make_shared<const std::vector<uint8_t>>(long_program(4));
+
+    ProcessingUnit first;
+    ProcessingUnit second;
+    first.load_program(image);
+    second.load_program(image);
+    EXPECT_EQ(image->data(), first.context().code);
+    EXPECT_EQ(image->data(), second.context().code);
+    EXPECT_EQ(first.layout().code, first.context().code_base);
+
+    EXPECT_EQ(1, first.execute());
+    EXPECT_EQ(1, second.execute());
+
+    // loading it again only restarts, the decoded program is kept.
+    const decoded_program* decoded = &first.program();
+    first.load_program(image);
+    EXPECT_EQ(decoded, &first.program());
+    EXPECT_EQ(1, first.execute());
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+#include <tracing.hpp>
+
+#include "program_corpus.hpp"
+
+using namespace ciph;
+
+namespace {
+
+struct run_result {
+    int16_t return_value = 0;
+    trap_code trap = trap_code::none;
+    std::vector<uint16_t> registers;
+};
+
+run_result
+run_program(std::vector<uint8_t> bytes, execution_mode mode) {
+    ProcessingUnit unit;
+    unit.set_execution_mode(mode);
+    // every loop is traced on its first back-edge.
+    unit.set_tracing_options({ 1, 256, 3 });
+    unit.load_program(bytes.data(), static_cast<uint16_t>(bytes.size()));
+
+    run_result result;
+    result.return_value = unit.execute();
+    result.trap = unit.context().trap;
+    uint16_t* registries = unit.registries();
+    result.registers.assign(registries, registries + +registers::def::reg_cnt);
+    return result;
+}
+
+const std::vector<uint8_t>&
+corpus_bytes(const std::string& name) {
+    for (const test::corpus_program& program : test::program_corpus()) {
+        if (program.name == name)
+            return program.bytes;
+    }
+    throw std::out_of_range(name);
+}
+
+} // namespace
+
+class TracingDifferentialTest : public ::testing::TestWithParam<test::corpus_program>
+{
+};
+
+TEST_P(TracingDifferentialTest, MatchesInterpreter)
+{
+    run_result interpreted = run_program(GetParam().bytes, execution_mode::interpreter);
+    run_result traced = run_program(GetParam().bytes, execution_mode::tracing);
+
+    EXPECT_EQ(interpreted.return_value, traced.return_value);
+    EXPECT_EQ(interpreted.trap, traced.trap);
+    for (uint8_t reg = 0; reg < +registers::def::reg_cnt; reg++)
+        EXPECT_EQ(interpreted.registers[reg], traced.registers[reg]) << "register " << int(reg);
+}
+
+INSTANTIATE_TEST_SUITE_P(Corpus, TracingDifferentialTest, ::testing::ValuesIn(test::program_corpus()),
+                         test::corpus_name());
+
+TEST(TracingTest, LoopWithInnerBranch)
+{
+    std::vector<uint8_t> program = corpus_bytes("LoopWithInnerBranch");
+    ProcessingUnit unit;
+    unit.set_execution_mode(execution_mode::tracing);
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    EXPECT_EQ(6, unit.execute());
+}
+
+#if CIPH_HAS_JIT
+TEST(TracingTest, HotLoop_CompilesOneTrace)
+{
+    std::vector<uint8_t> program = corpus_bytes("ArithmeticLoop");
+    ProcessingUnit unit;
+    unit.set_execution_mode(execution_mode::tracing);
+    unit.set_tracing_options({ 10, 256, 3 });
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    EXPECT_EQ(1000, unit.execute());
+    ASSERT_EQ(1u, unit.traces().traces.size());
+    // the whole loop closes in one native entry, the guard on the loop condition ends it.
+    EXPECT_EQ(1u, unit.traces().entries);
+    const tracing::compiled_trace& trace = unit.traces().traces.front();
+    EXPECT_EQ(0, unit.traces().trace_of[trace.header]);
+    EXPECT_EQ(0, unit.traces().aborts[trace.header]);
+}
+
+TEST(TracingTest, ColdLoop_StaysInterpreted)
+{
+    std::vector<uint8_t> program = corpus_bytes("While");
+    ProcessingUnit unit;
+    unit.set_execution_mode(execution_mode::tracing);
+    unit.set_tracing_options({ 100, 256, 3 });
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    EXPECT_EQ(10, unit.execute());
+    EXPECT_TRUE(unit.traces().traces.empty());
+    EXPECT_EQ(0u, unit.traces().entries);
+}
+
+TEST(TracingTest, GuardFailure_ResumesInInterpreter)
+{
+    std::vector<uint8_t> program = corpus_bytes("LoopWithInnerBranch");
+    ProcessingUnit unit;
+    unit.set_execution_mode(execution_mode::tracing);
+    unit.set_tracing_options({ 1, 256, 3 });
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    EXPECT_EQ(6, unit.execute());
+    ASSERT_EQ(1u, unit.traces().traces.size());
+    // recorded while the inner branch was taken, every later iteration leaves through its guard.
+    EXPECT_GT(unit.traces().entries, 1u);
+}
+
+TEST(TracingTest, LongLoop_Aborted)
+{
+    std::vector<uint8_t> program = corpus_bytes("ArithmeticLoop");
+    ProcessingUnit unit;
+    unit.set_execution_mode(execution_mode::tracing);
+    unit.set_tracing_options({ 1, 2, 3 });
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+
+    EXPECT_EQ(1000, unit.execute());
+    EXPECT_TRUE(unit.traces().traces.empty());
+}
+#endif
@@ -0,0 +1,351 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+
+#include <decoder.hpp>
+#include <interpreter.hpp>
+#include <memory.hpp>
+#include <processing_unit.hpp>
+#include <shared_defines.hpp>
+#include <verifier.hpp>
+
+#include "program_corpus.hpp"
+
+using namespace ciph;
+
+namespace {
+
+// Stack address load_program would pick for a program of size bytes at the default code address.
+uint16_t
+stack_of(uint16_t base, size_t size) {
+    return static_cast<uint16_t>(base + size + (size % 2));
+}
+
+verifier::report
+verify(const std::vector<uint8_t>& bytes) {
+    uint16_t base = +registers::def::reg_cnt * 2;
+    decoded_program program = decoder::decode(bytes.data(), static_cast<uint16_t>(bytes.size()), base);
+    return verifier::verify(program, stack_of(base, bytes.size()));
+}
+
+const std::vector<uint8_t>&
+corpus_bytes(const std::string& name) {
+    for (const test::corpus_program& program : test::program_corpus()) {
+        if (program.name == name)
+            return program.bytes;
+    }
+    throw std::out_of_range(name);
+}
+
+// Pushes a word on every iteration and never leaves the loop, sp walks off the end of memory.
+const std::vector<uint8_t> runaway_stack = {
+    +instruction::def::PSH_LIT, 0, 1,
+    +instruction::def::PSH_LIT, 0, 1,
+    +instruction::def::PSH_LIT, 0, 2,
+    +instruction::def::CMP, +registers::def::sp,
+    +instruction::def::JLT, 0x00, 0x0E,     // back to the first PSH_LIT
+    +instruction::def::RET
+};
+
+} // namespace
+
+TEST(VerifierTest, Loop_Verified)
+{
+    const std::vector<uint8_t>& program = corpus_bytes("ArithmeticLoop");
+    verifier::report report = verify(program);
+
+    EXPECT_TRUE(report.verified());
+    EXPECT_TRUE(report.fits(Memory::default_size));
+    // every reachable instruction has the depth its predecessors agree on.
+    EXPECT_EQ(0, report.depth[0]);
+    EXPECT_GE(report.extent, stack_of(0x20, program.size()) + report.max_depth * 2u);
+}
+
+TEST(VerifierTest, Corpus)
+{
+    EXPECT_TRUE(verify(corpus_bytes("While")).verified());
+    EXPECT_TRUE(verify(corpus_bytes("TopOfStack")).verified());
+    EXPECT_TRUE(verify(corpus_bytes("RegisterArithmetic")).verified());
+    EXPECT_EQ(verifier::status::frame_write, verify(corpus_bytes("FrameRegisters")).result);
+    EXPECT_EQ(verifier::status::invalid_instruction, verify(corpus_bytes("UnknownOpcode_Traps")).result);
+    EXPECT_EQ(verifier::status::invalid_instruction, verify(corpus_bytes("BranchIntoOperand_Traps")).result);
+}
+
+TEST(VerifierTest, Underflow_Rejected)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 1,
+                                     +instruction::def::ADD,
+                                     +instruction::def::RET };
+
+    verifier::report report = verify(program);
+    EXPECT_EQ(verifier::status::stack_underflow, report.result);
+    EXPECT_EQ(1, report.at);
+    EXPECT_TRUE(report.depth.empty());
+}
+
+TEST(VerifierTest, LoopGrowingStack_Rejected)
+{
+    verifier::report report = verify(runaway_stack);
+    EXPECT_EQ(verifier::status::stack_mismatch, report.result);
+    EXPECT_EQ(0, report.at);
+}
+
+TEST(VerifierTest, FallsOffEnd_Rejected)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 1 };
+    EXPECT_EQ(verifier::status::falls_off_end, verify(program).result);
+    EXPECT_EQ(verifier::status::falls_off_end, verify({}).result);
+}
+
+TEST(VerifierTest, RegisterOutOfRange_DecodesToTrap)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 1,
+                                     +instruction::def::POP_REG, 0x40,
+                                     +instruction::def::RET };
+
+    decoded_program decoded = decoder::decode(program.data(), static_cast<uint16_t>(program.size()), 0x20);
+    ASSERT_EQ(3u, decoded.instructions.size());
+    EXPECT_EQ(decoder::invalid_opcode, decoded.instructions[1].opcode);
+
+    verifier::report report = verify(program);
+    EXPECT_EQ(verifier::status::invalid_instruction, report.result);
+    EXPECT_EQ(1, report.at);
+}
+
+TEST(VerifierTest, UnreachableTrap_Verified)
+{
+    std::vector<uint8_t> program = { +instruction::def::RET, 0xEE };
+    verifier::report report = verify(program);
+    EXPECT_TRUE(report.verified());
+    EXPECT_EQ(verifier::unreachable, report.depth[1]);
+}
+
+TEST(VerifierTest, Extent_CoversDeepestSlot)
+{
+    std::vector<uint8_t> program = { +instruction::def::PEK_OFF, +registers::def::r0, 120,
+                                     +instruction::def::RET };
+
+    verifier::report report = verify(program);
+    ASSERT_TRUE(report.verified());
+    EXPECT_EQ(stack_of(0x20, program.size()) + 242u, report.extent);
+    EXPECT_FALSE(report.fits(0x100));
+    EXPECT_TRUE(report.fits(0x200));
+}
+
+TEST(VerifierTest, MemoryOperands)
+{
+    std::vector<uint8_t> registerFile = { +instruction::def::PUT_LIT, 0, 1,
+                                          +instruction::def::MOV_MEM, 0, +registers::def::sp * 2,
+                                          +instruction::def::RET };
+    verifier::report report = verify(registerFile);
+    EXPECT_EQ(verifier::status::register_memory, report.result);
+    EXPECT_EQ(1, report.at);
+
+    std::vector<uint8_t> farWord = { +instruction::def::PSH_MEM, 0x01, 0xFE,
+                                     +instruction::def::POP_REG, +registers::def::ret,
+                                     +instruction::def::RET };
+    report = verify(farWord);
+    ASSERT_TRUE(report.verified());
+    EXPECT_EQ(0x200u, report.extent);
+    EXPECT_FALSE(report.fits(0x100));
+}
+
+TEST(VerifierTest, Calls_ExtentCoversCallChain)
+{
+    const std::vector<uint8_t>& program = corpus_bytes("Call_Nested");
+    verifier::report report = verify(program);
+
+    ASSERT_TRUE(report.verified());
+    // every function is checked from an empty stack of its own.
+    EXPECT_EQ(0, report.depth[5]);
+    // main's word, two frames of return address and fp, and the word f leaves under g's frame.
+    EXPECT_EQ(stack_of(0x20, program.size()) + 12u, report.extent);
+}
+
+TEST(VerifierTest, Recursion_Unbounded)
+{
+    verifier::report report = verify(corpus_bytes("Recursion_Fib"));
+    EXPECT_TRUE(report.verified());
+    EXPECT_EQ(verifier::unbounded, report.extent);
+    EXPECT_FALSE(report.fits(Memory::max_size));
+}
+
+TEST(VerifierTest, CallDepthWrite_Rejected)
+{
+    std::vector<uint8_t> program = { +instruction::def::PUT_LIT, 0, 1,
+                                     +instruction::def::PUT_REG, +registers::def::cd,
+                                     +instruction::def::RET };
+
+    verifier::report report = verify(program);
+    EXPECT_EQ(verifier::status::frame_write, report.result);
+    EXPECT_EQ(1, report.at);
+}
+
+TEST(VerifierTest, Arguments_CallerPushesEnough)
+{
+    EXPECT_TRUE(verify(corpus_bytes("Call_StackArguments")).verified());
+
+    // the function reads two words under its frame, the caller pushed one.
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 3,
+                                     +instruction::def::CALL, 0, 9,
+                                     +instruction::def::POP_REG, +registers::def::imm,
+                                     +instruction::def::RET,
+                                     +instruction::def::PEK_ARG, +registers::def::ret, 1,
+                                     +instruction::def::RET };
+    verifier::report report = verify(program);
+    EXPECT_EQ(verifier::status::stack_underflow, report.result);
+    EXPECT_EQ(1, report.at);
+}
+
+TEST(VerifierTest, ArgumentInMain_Rejected)
+{
+    std::vector<uint8_t> program = { +instruction::def::PSH_LIT, 0, 1,
+                                     +instruction::def::PEK_ARG, +registers::def::ret, 0,
+                                     +instruction::def::RET };
+
+    verifier::report report = verify(program);
+    EXPECT_EQ(verifier::status::stack_underflow, report.result);
+    EXPECT_EQ(1, report.at);
+}
+
+TEST(CheckedExecutionTest, MemoryOperandPastEnd_Faults)
+{
+    std::vector<uint8_t> program = { +instruction::def::PUT_LIT, 0, 1,
+                                     +instruction::def::MOV_MEM, 0x01, 0xFF,
+                                     +instruction::def::RET };
+
+    ProcessingUnit unit(0x200);
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    EXPECT_FALSE(unit.verification().fits(unit.memory_size()));
+    unit.execute();
+    EXPECT_EQ(trap_code::stack_fault, unit.context().trap);
+    EXPECT_EQ(unit.layout().code + 3, unit.registries()[+registers::def::pc]);
+}
+
+TEST(CheckedExecutionTest, RunawayStack_Faults)
+{
+    ProcessingUnit unit(0x100);
+    unit.load_program(runaway_stack.data(), static_cast<uint16_t>(runaway_stack.size()));
+    ASSERT_FALSE(unit.verification().verified());
+
+    unit.execute();
+    EXPECT_EQ(trap_code::stack_fault, unit.context().trap);
+    // pc stays on the push that would have left memory, one of the three in the loop.
+    EXPECT_LT(unit.registries()[+registers::def::pc], unit.layout().code + 9);
+}
+
+TEST(CheckedExecutionTest, DeepSlot_FaultsInSmallMemory)
+{
+    std::vector<uint8_t> program = { +instruction::def::PEK_OFF, +registers::def::sp, 200,
+                                     +instruction::def::POP_REG, +registers::def::ret,
+                                     +instruction::def::RET };
+
+    ProcessingUnit small(0x100);
+    small.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    EXPECT_TRUE(small.verification().verified());
+    small.execute();
+    EXPECT_EQ(trap_code::stack_fault, small.context().trap);
+
+    ProcessingUnit large(0x1000);
+    large.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    large.execute();
+    EXPECT_EQ(trap_code::none, large.context().trap);
+}
+
+TEST(CheckedExecutionTest, StackPointerMovedFromOutside_Checked)
+{
+    const std::vector<uint8_t>& program = corpus_bytes("ArithmeticLoop");
+    ProcessingUnit unit(0x100);
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    ASSERT_TRUE(unit.verification().fits(unit.memory_size()));
+
+    // the verified depths no longer hold, the unchecked engines would write past the end of memory.
+    unit.registries()[+registers::def::sp] = 0x200;
+    unit.execute();
+    EXPECT_EQ(trap_code::stack_fault, unit.context().trap);
+}
+
+TEST(CheckedExecutionTest, Step_Faults)
+{
+    ProcessingUnit unit(0x100);
+    unit.load_program(runaway_stack.data(), static_cast<uint16_t>(runaway_stack.size()));
+
+    size_t steps = 0;
+    while (unit.step())
+        steps++;
+    EXPECT_EQ(trap_code::stack_fault, unit.context().trap);
+    EXPECT_GT(steps, 100u);
+}
+
+TEST(CheckedExecutionTest, Budget_ResumesLikeMetered)
+{
+    ProcessingUnit unit(0x100);
+    unit.load_program(runaway_stack.data(), static_cast<uint16_t>(runaway_stack.size()));
+
+    EXPECT_EQ(run_status::out_of_fuel, unit.execute(50));
+    EXPECT_EQ(trap_code::none, unit.context().trap);
+    run_status status = run_status::out_of_fuel;
+    while (status == run_status::out_of_fuel)
+        status = unit.execute(50);
+    EXPECT_EQ(run_status::trapped, status);
+    EXPECT_EQ(trap_code::stack_fault, unit.context().trap);
+}
+
+TEST(CheckedExecutionTest, Recursion_RunsChecked)
+{
+    const std::vector<uint8_t>& program = corpus_bytes("Recursion_Fib");
+    ProcessingUnit unit(0x100);
+    unit.load_program(program.data(), static_cast<uint16_t>(program.size()));
+    ASSERT_TRUE(unit.verification().verified());
+
+    EXPECT_EQ(55, unit.execute());
+    EXPECT_EQ(trap_code::none, unit.context().trap);
+}
+
+class CheckedDifferentialTest : public ::testing::TestWithParam<test::corpus_program>
+{
+protected:
+    struct outcome {
+        int16_t return_value = 0;
+        trap_code trap = trap_code::none;
+        std::vector<uint16_t> registers;
+    };
+
+    template <typename Engine>
+    outcome run(Engine engine)
+    {
+        const std::vector<uint8_t>& bytes = GetParam().bytes;
+        Memory mem{ Memory::max_size };
+        uint16_t size = static_cast<uint16_t>(bytes.size());
+        uint16_t* registries = mem.allocate(static_cast<uint16_t>(registers::def::reg_cnt));
+        uint16_t addrs = mem.load(bytes.data(), size);
+        registries[+registers::def::pc] = addrs;
+        registries[+registers::def::bp] = addrs;
+        registries[+registers::def::sp] = stack_of(addrs, size);
+        registries[+registers::def::fp] = stack_of(addrs, size);
+
+        ExecutionContext context(registries, mem.getMemory());
+        decoded_program program = decoder::decode(bytes.data(), size, addrs);
+        outcome result;
+        result.return_value = engine(context, program);
+        result.trap = context.trap;
+        result.registers.assign(registries, registries + +registers::def::reg_cnt);
+        return result;
+    }
+};
+
+TEST_P(CheckedDifferentialTest, MatchesSwitch)
+{
+    outcome fast = run(interpreter::run_switch);
+    outcome checked = run([](ExecutionContext& context, const decoded_program& program) {
+        return interpreter::run_checked(context, program, Memory::max_size);
+    });
+
+    EXPECT_EQ(fast.return_value, checked.return_value);
+    EXPECT_EQ(fast.trap, checked.trap);
+    for (uint8_t reg = 0; reg < +registers::def::reg_cnt; reg++)
+        EXPECT_EQ(fast.registers[reg], checked.registers[reg]) << "register " << int(reg);
+}
+
+INSTANTIATE_TEST_SUITE_P(Corpus, CheckedDifferentialTest, ::testing::ValuesIn(test::program_corpus()),
+                         test::corpus_name());